@@ -8,15 +8,23 @@
  */
 #include "postgres.h"
 
+#include <math.h>
+
 #include "access/htup_details.h"
 #include "catalog/pg_type.h"
+#include "common/pg_prng.h"
 #include "funcapi.h"
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
+#include "utils/array.h"
+#include "utils/hsearch.h"
 
 
 #define NUM_BUFFERCACHE_PAGES_MIN_ELEM	8
 #define NUM_BUFFERCACHE_PAGES_ELEM	9
+#define NUM_BUFFERCACHE_SUMMARY_ELEM 5
+#define NUM_BUFFERCACHE_USAGE_COUNTS_ELEM 4
+#define NUM_BUFFERCACHE_RELATIONS_ELEM 8
 
 PG_MODULE_MAGIC;
 
@@ -54,11 +62,35 @@ typedef struct
 } BufferCachePagesContext;
 
 
+/*
+ * Hash table entry for pg_buffercache_relations(), one per relation fork.
+ */
+typedef struct
+{
+	Oid			relfilenode;
+	Oid			reltablespace;
+	Oid			reldatabase;
+	ForkNumber	forknum;
+} BufferCacheRelKey;
+
+typedef struct
+{
+	BufferCacheRelKey key;		/* hash key, must be first */
+	int64		buffers;
+	int64		dirty;
+	int64		pinned;
+	int64		usage_counts[BM_MAX_USAGE_COUNT + 1];
+} BufferCacheRelEntry;
+
+
 /*
  * Function returning data from the shared buffer cache - buffer number,
  * relation node/tablespace/database/blocknum and dirty indicator.
  */
 PG_FUNCTION_INFO_V1(pg_buffercache_pages);
+PG_FUNCTION_INFO_V1(pg_buffercache_summary);
+PG_FUNCTION_INFO_V1(pg_buffercache_usage_counts);
+PG_FUNCTION_INFO_V1(pg_buffercache_relations);
 
 Datum
 pg_buffercache_pages(PG_FUNCTION_ARGS)
@@ -152,7 +184,8 @@ pg_buffercache_pages(PG_FUNCTION_ARGS)
 			/* Lock each buffer header before inspecting. */
 			buf_state = LockBufHdr(bufHdr);
 
-			fctx->record[i].bufferid = BufferDescriptorGetBuffer(bufHdr);
+			/* don't trust buf_id, it's not set until the buffer's first use */
+			fctx->record[i].bufferid = i + 1;
 			fctx->record[i].relfilenode = bufHdr->tag.rnode.relNode;
 			fctx->record[i].reltablespace = bufHdr->tag.rnode.spcNode;
 			fctx->record[i].reldatabase = bufHdr->tag.rnode.dbNode;
@@ -237,3 +270,235 @@ pg_buffercache_pages(PG_FUNCTION_ARGS)
 	else
 		SRF_RETURN_DONE(funcctx);
 }
+
+/*
+ * Summarize the state of the whole buffer cache in a single row.
+ *
+ * Unlike pg_buffercache_pages(), this doesn't take the buffer header locks;
+ * the state of each buffer is read with a single atomic load, which is all
+ * we need for the counters reported here.  The result is thus cheap to get
+ * even with a very large shared_buffers, but is not a consistent snapshot.
+ */
+Datum
+pg_buffercache_summary(PG_FUNCTION_ARGS)
+{
+	Datum		result;
+	TupleDesc	tupledesc;
+	HeapTuple	tuple;
+	Datum		values[NUM_BUFFERCACHE_SUMMARY_ELEM];
+	bool		nulls[NUM_BUFFERCACHE_SUMMARY_ELEM];
+
+	int32		buffers_used = 0;
+	int32		buffers_unused = 0;
+	int32		buffers_dirty = 0;
+	int32		buffers_pinned = 0;
+	int64		usagecount_total = 0;
+
+	if (get_call_result_type(fcinfo, NULL, &tupledesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	for (int i = 0; i < NBuffers; i++)
+	{
+		BufferDesc *bufHdr = GetBufferDescriptor(i);
+		uint32		buf_state = pg_atomic_read_u32(&bufHdr->state);
+
+		if (buf_state & BM_VALID)
+		{
+			buffers_used++;
+			usagecount_total += BUF_STATE_GET_USAGECOUNT(buf_state);
+
+			if (buf_state & BM_DIRTY)
+				buffers_dirty++;
+		}
+		else
+			buffers_unused++;
+
+		if (BUF_STATE_GET_REFCOUNT(buf_state) > 0)
+			buffers_pinned++;
+	}
+
+	memset(nulls, 0, sizeof(nulls));
+	values[0] = Int32GetDatum(buffers_used);
+	values[1] = Int32GetDatum(buffers_unused);
+	values[2] = Int32GetDatum(buffers_dirty);
+	values[3] = Int32GetDatum(buffers_pinned);
+
+	if (buffers_used != 0)
+		values[4] = Float8GetDatum((double) usagecount_total / buffers_used);
+	else
+		nulls[4] = true;
+
+	tuple = heap_form_tuple(tupledesc, values, nulls);
+	result = HeapTupleGetDatum(tuple);
+
+	PG_RETURN_DATUM(result);
+}
+
+/*
+ * Histogram of the usage counts of the buffers in use, with the number of
+ * dirty and pinned buffers for each usage count.  Like
+ * pg_buffercache_summary(), this reads the buffer states without locking.
+ */
+Datum
+pg_buffercache_usage_counts(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	int			usage_counts[BM_MAX_USAGE_COUNT + 1] = {0};
+	int			dirty[BM_MAX_USAGE_COUNT + 1] = {0};
+	int			pinned[BM_MAX_USAGE_COUNT + 1] = {0};
+	Datum		values[NUM_BUFFERCACHE_USAGE_COUNTS_ELEM];
+	bool		nulls[NUM_BUFFERCACHE_USAGE_COUNTS_ELEM] = {0};
+
+	SetSingleFuncCall(fcinfo, 0);
+
+	for (int i = 0; i < NBuffers; i++)
+	{
+		BufferDesc *bufHdr = GetBufferDescriptor(i);
+		uint32		buf_state = pg_atomic_read_u32(&bufHdr->state);
+		int			usage_count;
+
+		if (!(buf_state & BM_VALID))
+			continue;
+
+		usage_count = BUF_STATE_GET_USAGECOUNT(buf_state);
+		usage_counts[usage_count]++;
+
+		if (buf_state & BM_DIRTY)
+			dirty[usage_count]++;
+
+		if (BUF_STATE_GET_REFCOUNT(buf_state) > 0)
+			pinned[usage_count]++;
+	}
+
+	for (int i = 0; i < BM_MAX_USAGE_COUNT + 1; i++)
+	{
+		values[0] = Int32GetDatum(i);
+		values[1] = Int32GetDatum(usage_counts[i]);
+		values[2] = Int32GetDatum(dirty[i]);
+		values[3] = Int32GetDatum(pinned[i]);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Scale up a count taken from a sample of the buffers.
+ */
+static int64
+scale_count(int64 count, float8 sample_fraction)
+{
+	return (int64) rint(count / sample_fraction);
+}
+
+/*
+ * Per-relation-fork buffer counts, with a histogram of the usage counts.
+ *
+ * This takes each buffer header lock just long enough to read a consistent
+ * tag, and aggregates in a local hash table, so the result has one row per
+ * relation fork in the cache rather than one per buffer.  If sample_fraction
+ * is less than 1, only about that fraction of the buffers, picked at random,
+ * is looked at, and the counts are scaled up accordingly; they are estimates
+ * then.
+ */
+Datum
+pg_buffercache_relations(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	float8		sample_fraction = PG_GETARG_FLOAT8(0);
+	HASHCTL		ctl;
+	HTAB	   *relations;
+	HASH_SEQ_STATUS status;
+	BufferCacheRelEntry *entry;
+
+	if (isnan(sample_fraction) || sample_fraction <= 0.0 ||
+		sample_fraction > 1.0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("sample fraction must be greater than 0 and at most 1")));
+
+	SetSingleFuncCall(fcinfo, 0);
+
+	ctl.keysize = sizeof(BufferCacheRelKey);
+	ctl.entrysize = sizeof(BufferCacheRelEntry);
+	ctl.hcxt = CurrentMemoryContext;
+	relations = hash_create("pg_buffercache relations", 1024, &ctl,
+							HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	for (int i = 0; i < NBuffers; i++)
+	{
+		BufferDesc *bufHdr = GetBufferDescriptor(i);
+		BufferCacheRelKey key;
+		uint32		buf_state;
+		bool		found;
+
+		if (sample_fraction < 1.0 &&
+			pg_prng_double(&pg_global_prng_state) >= sample_fraction)
+			continue;
+
+		/* skip buffers not in use without bothering with the lock */
+		if (!(pg_atomic_read_u32(&bufHdr->state) & BM_VALID))
+			continue;
+
+		buf_state = LockBufHdr(bufHdr);
+		if (!(buf_state & BM_VALID) || !(buf_state & BM_TAG_VALID))
+		{
+			UnlockBufHdr(bufHdr, buf_state);
+			continue;
+		}
+		memset(&key, 0, sizeof(key));
+		key.relfilenode = bufHdr->tag.rnode.relNode;
+		key.reltablespace = bufHdr->tag.rnode.spcNode;
+		key.reldatabase = bufHdr->tag.rnode.dbNode;
+		key.forknum = bufHdr->tag.forkNum;
+		UnlockBufHdr(bufHdr, buf_state);
+
+		entry = (BufferCacheRelEntry *) hash_search(relations, &key,
+													HASH_ENTER, &found);
+		if (!found)
+		{
+			entry->buffers = 0;
+			entry->dirty = 0;
+			entry->pinned = 0;
+			memset(entry->usage_counts, 0, sizeof(entry->usage_counts));
+		}
+
+		entry->buffers++;
+		if (buf_state & BM_DIRTY)
+			entry->dirty++;
+		if (BUF_STATE_GET_REFCOUNT(buf_state) > 0)
+			entry->pinned++;
+		entry->usage_counts[BUF_STATE_GET_USAGECOUNT(buf_state)]++;
+	}
+
+	hash_seq_init(&status, relations);
+	while ((entry = (BufferCacheRelEntry *) hash_seq_search(&status)) != NULL)
+	{
+		Datum		values[NUM_BUFFERCACHE_RELATIONS_ELEM];
+		bool		nulls[NUM_BUFFERCACHE_RELATIONS_ELEM] = {0};
+		Datum		usage_counts[BM_MAX_USAGE_COUNT + 1];
+
+		values[0] = ObjectIdGetDatum(entry->key.relfilenode);
+		values[1] = ObjectIdGetDatum(entry->key.reltablespace);
+		values[2] = ObjectIdGetDatum(entry->key.reldatabase);
+		values[3] = Int16GetDatum(entry->key.forknum);
+		values[4] = Int64GetDatum(scale_count(entry->buffers, sample_fraction));
+		values[5] = Int64GetDatum(scale_count(entry->dirty, sample_fraction));
+		values[6] = Int64GetDatum(scale_count(entry->pinned, sample_fraction));
+		for (int i = 0; i < BM_MAX_USAGE_COUNT + 1; i++)
+			usage_counts[i] = Int64GetDatum(scale_count(entry->usage_counts[i],
+														sample_fraction));
+		values[7] = PointerGetDatum(construct_array(usage_counts,
+													BM_MAX_USAGE_COUNT + 1,
+													INT8OID, sizeof(int64),
+													FLOAT8PASSBYVAL,
+													TYPALIGN_DOUBLE));
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	hash_destroy(relations);
+
+	return (Datum) 0;
+}
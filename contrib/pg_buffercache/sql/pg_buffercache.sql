@@ -0,0 +1,57 @@
+CREATE EXTENSION pg_buffercache;
+
+select count(*) = (select setting::bigint
+                   from pg_settings
+                   where name = 'shared_buffers')
+from pg_buffercache;
+
+select buffers_used + buffers_unused = (select setting::bigint
+                                        from pg_settings
+                                        where name = 'shared_buffers'),
+        buffers_dirty <= buffers_used,
+        usagecount_avg between 0 and 5
+from pg_buffercache_summary();
+
+select count(*), min(usage_count), max(usage_count),
+        bool_and(dirty <= buffers and pinned <= buffers)
+from pg_buffercache_usage_counts();
+
+-- a relation we just read has buffers, and its usage counts add up
+create table buffercache_test as select g as id from generate_series(1, 1000) g;
+select count(*) from buffercache_test;
+
+select r.buffers > 0 as has_buffers,
+       r.buffers = (select sum(u) from unnest(r.usage_counts) u) as sum_ok,
+       array_length(r.usage_counts, 1) as usage_counts,
+       r.dirty <= r.buffers as dirty_ok
+from pg_buffercache_relations() r
+where r.relfilenode = pg_relation_filenode('buffercache_test')
+  and r.reldatabase = (select oid from pg_database
+                       where datname = current_database())
+  and r.relforknumber = 0;
+
+select count(*) >= 0 from pg_buffercache_relations(0.5);
+
+select * from pg_buffercache_relations(0);
+select * from pg_buffercache_relations(1.5);
+select * from pg_buffercache_relations('NaN');
+
+drop table buffercache_test;
+
+-- Check that the functions / views can't be accessed by default. To avoid
+-- having to create a dedicated user, use the pg_database_owner pseudo-role.
+SET ROLE pg_database_owner;
+SELECT * FROM pg_buffercache;
+SELECT * FROM pg_buffercache_pages() AS p (wrong int);
+SELECT * FROM pg_buffercache_summary();
+SELECT * FROM pg_buffercache_usage_counts();
+SELECT * FROM pg_buffercache_relations();
+RESET role;
+
+-- Check that pg_monitor is allowed to query view / function
+SET ROLE pg_monitor;
+SELECT count(*) > 0 FROM pg_buffercache;
+SELECT buffers_used + buffers_unused > 0 FROM pg_buffercache_summary();
+SELECT count(*) > 0 FROM pg_buffercache_usage_counts();
+SELECT count(*) > 0 FROM pg_buffercache_relations();
+RESET role;
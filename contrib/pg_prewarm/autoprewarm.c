@@ -10,11 +10,18 @@
  *		and we need to lock the relations so that we don't try to prewarm
  *		pages from a relation that is in the process of being dropped.
  *
- *		While prewarming, autoprewarm will use two workers.  There's a
- *		leader worker that reads and sorts the list of blocks to be
- *		prewarmed and then launches a per-database worker for each
- *		relevant database in turn.  The former keeps running after the
- *		initial prewarm is complete to update the dump file periodically.
+ *		While prewarming, there's a leader worker that reads and sorts the
+ *		list of blocks to be prewarmed and then launches a group of
+ *		per-database workers for each relevant database in turn.  The
+ *		per-database workers claim chunks of the sorted list from shared
+ *		memory, so they load the blocks in parallel, and read runs of
+ *		consecutive blocks with one vectored read.  The leader keeps running
+ *		after the initial prewarm is complete to update the dump file
+ *		periodically.
+ *
+ *		The dump records each block's usage count, and blocks with higher
+ *		usage counts are loaded first, so that if shared_buffers runs out of
+ *		free buffers, it's the coldest blocks that are left out.
  *
  *	Copyright (c) 2016-2022, PostgreSQL Global Development Group
  *
@@ -57,6 +64,12 @@
 
 #define AUTOPREWARM_FILE "autoprewarm.blocks"
 
+/* Number of block records a per-database worker claims at a time. */
+#define AUTOPREWARM_CHUNK_SIZE 1024
+
+/* Upper limit for pg_prewarm.autoprewarm_workers. */
+#define MAX_AUTOPREWARM_WORKERS 64
+
 /* Metadata for each block we dump. */
 typedef struct BlockInfoRecord
 {
@@ -65,6 +78,7 @@ typedef struct BlockInfoRecord
 	Oid			filenode;
 	ForkNumber	forknum;
 	BlockNumber blocknum;
+	int			usage_count;
 } BlockInfoRecord;
 
 /* Shared state information for autoprewarm bgworker. */
@@ -74,12 +88,13 @@ typedef struct AutoPrewarmSharedState
 	pid_t		bgworker_pid;	/* for main bgworker */
 	pid_t		pid_using_dumpfile; /* for autoprewarm or block dump */
 
-	/* Following items are for communication with per-database worker */
+	/* Following items are for communication with per-database workers */
 	dsm_handle	block_info_handle;
 	Oid			database;
 	int			prewarm_start_idx;
 	int			prewarm_stop_idx;
-	int			prewarmed_blocks;
+	pg_atomic_uint32 prewarm_next_idx;	/* next record to claim */
+	pg_atomic_uint32 prewarmed_blocks;
 } AutoPrewarmSharedState;
 
 void		_PG_init(void);
@@ -92,7 +107,9 @@ PG_FUNCTION_INFO_V1(autoprewarm_dump_now);
 static void apw_load_buffers(void);
 static int	apw_dump_now(bool is_bgworker, bool dump_unlogged);
 static void apw_start_leader_worker(void);
-static void apw_start_database_worker(void);
+static void apw_start_database_workers(int nworkers);
+static void apw_prewarm_chunk(BlockInfoRecord *block_info, int start_idx,
+							  int stop_idx);
 static bool apw_init_shmem(void);
 static void apw_detach_shmem(int code, Datum arg);
 static int	apw_compare_blockinfo(const void *p, const void *q);
@@ -105,6 +122,7 @@ static AutoPrewarmSharedState *apw_state = NULL;
 /* GUC variables. */
 static bool autoprewarm = true; /* start worker? */
 static int	autoprewarm_interval;	/* dump interval */
+static int	autoprewarm_workers;	/* per-database workers to launch */
 
 /*
  * Module load callback.
@@ -124,6 +142,18 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomIntVariable("pg_prewarm.autoprewarm_workers",
+							"Sets the number of workers used to prewarm each database.",
+							NULL,
+							&autoprewarm_workers,
+							4,
+							1, MAX_AUTOPREWARM_WORKERS,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
 	if (!process_shared_preload_libraries_in_progress)
 		return;
 
@@ -281,8 +311,8 @@ autoprewarm_main(Datum main_arg)
 }
 
 /*
- * Read the dump file and launch per-database workers one at a time to
- * prewarm the buffers found there.
+ * Read the dump file and launch per-database workers, one database at a
+ * time, to prewarm the buffers found there.
  */
 static void
 apw_load_buffers(void)
@@ -341,18 +371,25 @@ apw_load_buffers(void)
 	seg = dsm_create(sizeof(BlockInfoRecord) * num_elements, 0);
 	blkinfo = (BlockInfoRecord *) dsm_segment_address(seg);
 
-	/* Read records, one per line. */
+	/*
+	 * Read records, one per line.  Files written before the usage count was
+	 * recorded lack the last field; treat all their blocks as equally hot.
+	 */
 	for (i = 0; i < num_elements; i++)
 	{
+		char		line[128];
 		unsigned	forknum;
+		unsigned	usage_count = 0;
 
-		if (fscanf(file, "%u,%u,%u,%u,%u\n", &blkinfo[i].database,
+		if (fgets(line, sizeof(line), file) == NULL ||
+			sscanf(line, "%u,%u,%u,%u,%u,%u", &blkinfo[i].database,
 				   &blkinfo[i].tablespace, &blkinfo[i].filenode,
-				   &forknum, &blkinfo[i].blocknum) != 5)
+				   &forknum, &blkinfo[i].blocknum, &usage_count) < 5)
 			ereport(ERROR,
 					(errmsg("autoprewarm block dump file is corrupted at line %d",
 							i + 1)));
 		blkinfo[i].forknum = forknum;
+		blkinfo[i].usage_count = usage_count;
 	}
 
 	FreeFile(file);
@@ -364,7 +401,7 @@ apw_load_buffers(void)
 	/* Populate shared memory state. */
 	apw_state->block_info_handle = dsm_segment_handle(seg);
 	apw_state->prewarm_start_idx = apw_state->prewarm_stop_idx = 0;
-	apw_state->prewarmed_blocks = 0;
+	pg_atomic_write_u32(&apw_state->prewarmed_blocks, 0);
 
 	/* Get the info position of the first block of the next database. */
 	while (apw_state->prewarm_start_idx < num_elements)
@@ -401,9 +438,11 @@ apw_load_buffers(void)
 		if (current_db == InvalidOid)
 			break;
 
-		/* Configure stop point and database for next per-database worker. */
+		/* Configure stop point and database for next per-database workers. */
 		apw_state->prewarm_stop_idx = j;
 		apw_state->database = current_db;
+		pg_atomic_write_u32(&apw_state->prewarm_next_idx,
+							apw_state->prewarm_start_idx);
 		Assert(apw_state->prewarm_start_idx < apw_state->prewarm_stop_idx);
 
 		/* If we've run out of free buffers, don't launch another worker. */
@@ -418,10 +457,14 @@ apw_load_buffers(void)
 			break;
 
 		/*
-		 * Start a per-database worker to load blocks for this database; this
-		 * function will return once the per-database worker exits.
+		 * Start per-database workers to load blocks for this database; this
+		 * function will return once they have all exited.  There's no point
+		 * in starting more workers than there are chunks to claim.
 		 */
-		apw_start_database_worker();
+		apw_start_database_workers(Min(autoprewarm_workers,
+									   (j - apw_state->prewarm_start_idx +
+										AUTOPREWARM_CHUNK_SIZE - 1) /
+									   AUTOPREWARM_CHUNK_SIZE));
 
 		/* Prepare for next database. */
 		apw_state->prewarm_start_idx = apw_state->prewarm_stop_idx;
@@ -438,22 +481,21 @@ apw_load_buffers(void)
 	if (!ShutdownRequestPending)
 		ereport(LOG,
 				(errmsg("autoprewarm successfully prewarmed %d of %d previously-loaded blocks",
-						apw_state->prewarmed_blocks, num_elements)));
+						(int) pg_atomic_read_u32(&apw_state->prewarmed_blocks),
+						num_elements)));
 }
 
 /*
- * Prewarm all blocks for one database (and possibly also global objects, if
- * those got grouped with this database).
+ * Prewarm blocks for one database (and possibly also global objects, if
+ * those got grouped with this database), together with the other workers
+ * launched for the same database.
  */
 void
 autoprewarm_database_main(Datum main_arg)
 {
-	int			pos;
 	BlockInfoRecord *block_info;
-	Relation	rel = NULL;
-	BlockNumber nblocks = 0;
-	BlockInfoRecord *old_blk = NULL;
 	dsm_segment *seg;
+	int			stop_idx;
 
 	/* Establish signal handlers; once that's done, unblock signals. */
 	pqsignal(SIGTERM, die);
@@ -468,27 +510,47 @@ autoprewarm_database_main(Datum main_arg)
 				 errmsg("could not map dynamic shared memory segment")));
 	BackgroundWorkerInitializeConnectionByOid(apw_state->database, InvalidOid, 0);
 	block_info = (BlockInfoRecord *) dsm_segment_address(seg);
-	pos = apw_state->prewarm_start_idx;
+	stop_idx = apw_state->prewarm_stop_idx;
 
 	/*
-	 * Loop until we run out of blocks to prewarm or until we run out of free
-	 * buffers.
+	 * Claim chunks of records until we run out of blocks to prewarm or until
+	 * we run out of free buffers.
 	 */
-	while (pos < apw_state->prewarm_stop_idx && have_free_buffer())
+	while (have_free_buffer())
 	{
-		BlockInfoRecord *blk = &block_info[pos++];
-		Buffer		buf;
-
-		CHECK_FOR_INTERRUPTS();
+		uint32		start_idx;
 
-		/*
-		 * Quit if we've reached records for another database. If previous
-		 * blocks are of some global objects, then continue pre-warming.
-		 */
-		if (old_blk != NULL && old_blk->database != blk->database &&
-			old_blk->database != 0)
+		start_idx = pg_atomic_fetch_add_u32(&apw_state->prewarm_next_idx,
+											AUTOPREWARM_CHUNK_SIZE);
+		if (start_idx >= stop_idx)
 			break;
 
+		apw_prewarm_chunk(block_info, start_idx,
+						  Min(start_idx + AUTOPREWARM_CHUNK_SIZE, stop_idx));
+	}
+
+	dsm_detach(seg);
+}
+
+/*
+ * Prewarm the blocks described by block_info[start_idx .. stop_idx - 1].
+ */
+static void
+apw_prewarm_chunk(BlockInfoRecord *block_info, int start_idx, int stop_idx)
+{
+	Relation	rel = NULL;
+	BlockNumber nblocks = 0;
+	BlockInfoRecord *old_blk = NULL;
+	int			pos = start_idx;
+
+	while (pos < stop_idx && have_free_buffer())
+	{
+		BlockInfoRecord *blk = &block_info[pos];
+		Buffer		buffers[MAX_IO_COMBINE_LIMIT];
+		int			nrun;
+
+		CHECK_FOR_INTERRUPTS();
+
 		/*
 		 * As soon as we encounter a block of a new relation, close the old
 		 * relation. Note that rel will be NULL if try_relation_open failed
@@ -522,6 +584,7 @@ autoprewarm_database_main(Datum main_arg)
 		if (!rel)
 		{
 			old_blk = blk;
+			pos++;
 			continue;
 		}
 
@@ -547,23 +610,37 @@ autoprewarm_database_main(Datum main_arg)
 		{
 			/* Move to next forknum. */
 			old_blk = blk;
+			pos++;
 			continue;
 		}
 
-		/* Prewarm buffer. */
-		buf = ReadBufferExtended(rel, blk->forknum, blk->blocknum, RBM_NORMAL,
-								 NULL);
-		if (BufferIsValid(buf))
-		{
-			apw_state->prewarmed_blocks++;
-			ReleaseBuffer(buf);
-		}
-
-		old_blk = blk;
+		/*
+		 * The records are sorted by file offset, so the following ones may
+		 * well be for the next blocks of the same fork.  Read up to
+		 * io_combine_limit of those with one vectored read.
+		 */
+		nrun = 1;
+		while (nrun < io_combine_limit &&
+			   pos + nrun < stop_idx &&
+			   block_info[pos + nrun].database == blk->database &&
+			   block_info[pos + nrun].tablespace == blk->tablespace &&
+			   block_info[pos + nrun].filenode == blk->filenode &&
+			   block_info[pos + nrun].forknum == blk->forknum &&
+			   block_info[pos + nrun].blocknum == blk->blocknum + nrun &&
+			   blk->blocknum + nrun < nblocks)
+			nrun++;
+
+		/* Prewarm buffers. */
+		ReadBufferRange(rel, blk->forknum, blk->blocknum, nrun, buffers,
+						NULL);
+		for (int i = 0; i < nrun; i++)
+			ReleaseBuffer(buffers[i]);
+		pg_atomic_fetch_add_u32(&apw_state->prewarmed_blocks, nrun);
+
+		pos += nrun;
+		old_blk = &block_info[pos - 1];
 	}
 
-	dsm_detach(seg);
-
 	/* Release lock on previous relation. */
 	if (rel)
 	{
@@ -636,6 +713,8 @@ apw_dump_now(bool is_bgworker, bool dump_unlogged)
 			block_info_array[num_blocks].filenode = bufHdr->tag.rnode.relNode;
 			block_info_array[num_blocks].forknum = bufHdr->tag.forkNum;
 			block_info_array[num_blocks].blocknum = bufHdr->tag.blockNum;
+			block_info_array[num_blocks].usage_count =
+				BUF_STATE_GET_USAGECOUNT(buf_state);
 			++num_blocks;
 		}
 
@@ -668,12 +747,13 @@ apw_dump_now(bool is_bgworker, bool dump_unlogged)
 	{
 		CHECK_FOR_INTERRUPTS();
 
-		ret = fprintf(file, "%u,%u,%u,%u,%u\n",
+		ret = fprintf(file, "%u,%u,%u,%u,%u,%d\n",
 					  block_info_array[i].database,
 					  block_info_array[i].tablespace,
 					  block_info_array[i].filenode,
 					  (uint32) block_info_array[i].forknum,
-					  block_info_array[i].blocknum);
+					  block_info_array[i].blocknum,
+					  block_info_array[i].usage_count);
 		if (ret < 0)
 		{
 			int			save_errno = errno;
@@ -786,6 +866,8 @@ apw_init_shmem(void)
 		LWLockInitialize(&apw_state->lock, LWLockNewTrancheId());
 		apw_state->bgworker_pid = InvalidPid;
 		apw_state->pid_using_dumpfile = InvalidPid;
+		pg_atomic_init_u32(&apw_state->prewarm_next_idx, 0);
+		pg_atomic_init_u32(&apw_state->prewarmed_blocks, 0);
 	}
 	LWLockRelease(AddinShmemInitLock);
 
@@ -851,13 +933,17 @@ apw_start_leader_worker(void)
 }
 
 /*
- * Start autoprewarm per-database worker process.
+ * Start up to nworkers autoprewarm per-database worker processes, and wait
+ * for them to exit.
  */
 static void
-apw_start_database_worker(void)
+apw_start_database_workers(int nworkers)
 {
 	BackgroundWorker worker;
-	BackgroundWorkerHandle *handle;
+	BackgroundWorkerHandle *handles[MAX_AUTOPREWARM_WORKERS];
+	int			nlaunched = 0;
+
+	Assert(nworkers > 0 && nworkers <= MAX_AUTOPREWARM_WORKERS);
 
 	MemSet(&worker, 0, sizeof(BackgroundWorker));
 	worker.bgw_flags =
@@ -872,17 +958,26 @@ apw_start_database_worker(void)
 	/* must set notify PID to wait for shutdown */
 	worker.bgw_notify_pid = MyProcPid;
 
-	if (!RegisterDynamicBackgroundWorker(&worker, &handle))
+	/*
+	 * Make do with fewer workers if we can't get as many as we'd like, since
+	 * any one of them can do all of the work.
+	 */
+	while (nlaunched < nworkers &&
+		   RegisterDynamicBackgroundWorker(&worker, &handles[nlaunched]))
+		nlaunched++;
+
+	if (nlaunched == 0)
 		ereport(ERROR,
 				(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
 				 errmsg("registering dynamic bgworker autoprewarm failed"),
 				 errhint("Consider increasing configuration parameter \"max_worker_processes\".")));
 
 	/*
-	 * Ignore return value; if it fails, postmaster has died, but we have
+	 * Ignore return values; if it fails, postmaster has died, but we have
 	 * checks for that elsewhere.
 	 */
-	WaitForBackgroundWorkerShutdown(handle);
+	for (int i = 0; i < nlaunched; i++)
+		WaitForBackgroundWorkerShutdown(handles[i]);
 }
 
 /* Compare member elements to check whether they are not equal. */
@@ -898,10 +993,12 @@ do { \
  * apw_compare_blockinfo
  *
  * We depend on all records for a particular database being consecutive
- * in the dump file; each per-database worker will preload blocks until
- * it sees a block for some other database.  Sorting by tablespace,
- * filenode, forknum, and blocknum isn't critical for correctness, but
- * helps us get a sequential I/O pattern.
+ * in the dump file; the per-database workers are given the range of records
+ * for one database.  Within a database, we sort hotter blocks first, so that
+ * they get loaded even if we run out of free buffers.  Sorting blocks with
+ * the same usage count by tablespace, filenode, forknum, and blocknum isn't
+ * critical for correctness, but lets us read runs of consecutive blocks
+ * with one vectored read, and get a sequential I/O pattern.
  */
 static int
 apw_compare_blockinfo(const void *p, const void *q)
@@ -910,6 +1007,8 @@ apw_compare_blockinfo(const void *p, const void *q)
 	const BlockInfoRecord *b = (const BlockInfoRecord *) q;
 
 	cmp_member_elem(database);
+	if (a->usage_count != b->usage_count)
+		return (a->usage_count > b->usage_count) ? -1 : 1;
 	cmp_member_elem(tablespace);
 	cmp_member_elem(filenode);
 	cmp_member_elem(forknum);
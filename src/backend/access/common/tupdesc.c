@@ -74,6 +74,8 @@ CreateTemplateTupleDesc(int natts)
 	desc->tdtypeid = RECORDOID;
 	desc->tdtypmod = -1;
 	desc->tdrefcount = -1;		/* assume not reference-counted */
+	desc->tdfixedatts = -1;		/* computed on first use */
+	desc->tdnotnullatts = -1;
 
 	return desc;
 }
@@ -254,6 +256,10 @@ TupleDescCopy(TupleDesc dst, TupleDesc src)
 	 * source's refcount would be wrong in any case.)
 	 */
 	dst->tdrefcount = -1;
+
+	/* attnotnull was cleared above, so this needs to be recomputed */
+	dst->tdfixedatts = -1;
+	dst->tdnotnullatts = -1;
 }
 
 /*
@@ -293,6 +299,8 @@ TupleDescCopyEntry(TupleDesc dst, AttrNumber dstAttno,
 	 */
 	dstAtt->attnum = dstAttno;
 	dstAtt->attcacheoff = -1;
+	dst->tdfixedatts = -1;
+	dst->tdnotnullatts = -1;
 
 	/* since we're not copying constraints or defaults, clear these */
 	dstAtt->attnotnull = false;
@@ -302,6 +310,44 @@ TupleDescCopyEntry(TupleDesc dst, AttrNumber dstAttno,
 	dstAtt->attgenerated = '\0';
 }
 
+/*
+ * TupleDescComputeFixedAtts
+ *		Compute tdfixedatts and tdnotnullatts for a tuple descriptor, and
+ *		set attcacheoff for the leading fixed-width attributes.
+ *
+ * The offsets computed here are the ones slot_deform_heap_tuple() and
+ * friends would compute for a tuple in which none of these attributes is
+ * null.  That holds for every tuple without a null bitmap, and for every
+ * tuple as far as the leading NOT NULL attributes are concerned.
+ */
+void
+TupleDescComputeFixedAtts(TupleDesc tupdesc)
+{
+	int			off = 0;
+	int			attnum;
+	bool		notnull = true;
+
+	tupdesc->tdnotnullatts = 0;
+	for (attnum = 0; attnum < tupdesc->natts; attnum++)
+	{
+		Form_pg_attribute att = TupleDescAttr(tupdesc, attnum);
+
+		if (att->attlen <= 0)
+			break;
+
+		off = att_align_nominal(off, att->attalign);
+		Assert(att->attcacheoff < 0 || att->attcacheoff == off);
+		att->attcacheoff = off;
+		off += att->attlen;
+
+		if (notnull && att->attnotnull && !att->attisdropped)
+			tupdesc->tdnotnullatts = attnum + 1;
+		else
+			notnull = false;
+	}
+	tupdesc->tdfixedatts = attnum;
+}
+
 /*
  * Free a TupleDesc including all substructure
  */
@@ -618,6 +664,8 @@ TupleDescInitEntry(TupleDesc desc,
 	att->attstattarget = -1;
 	att->attcacheoff = -1;
 	att->atttypmod = typmod;
+	desc->tdfixedatts = -1;
+	desc->tdnotnullatts = -1;
 
 	att->attnum = attributeNumber;
 	att->attndims = attdim;
@@ -679,6 +727,8 @@ TupleDescInitBuiltinEntry(TupleDesc desc,
 	att->attstattarget = -1;
 	att->attcacheoff = -1;
 	att->atttypmod = typmod;
+	desc->tdfixedatts = -1;
+	desc->tdnotnullatts = -1;
 
 	att->attnum = attributeNumber;
 	att->attndims = attdim;
@@ -56,6 +56,7 @@
 #include "pgstat.h"
 #include "port/atomics.h"
 #include "port/pg_bitutils.h"
+#include "storage/aio.h"
 #include "storage/bufmgr.h"
 #include "storage/freespace.h"
 #include "storage/lmgr.h"
@@ -322,6 +323,9 @@ initscan(HeapScanDesc scan, ScanKey key, bool keep_startblock)
 	ItemPointerSetInvalid(&scan->rs_ctup.t_self);
 	scan->rs_cbuf = InvalidBuffer;
 	scan->rs_cblock = InvalidBlockNumber;
+	scan->rs_rablock = InvalidBlockNumber;
+	scan->rs_raindex = 0;
+	scan->rs_nrabuffers = 0;
 
 	/* page-at-a-time fields are always invalid when not rs_inited */
 
@@ -381,6 +385,7 @@ heapgetpage(TableScanDesc sscan, BlockNumber page)
 	OffsetNumber lineoff;
 	ItemId		lpp;
 	bool		all_visible;
+	int			nahead = 0;
 
 	Assert(page < scan->rs_nblocks);
 
@@ -398,9 +403,41 @@ heapgetpage(TableScanDesc sscan, BlockNumber page)
 	 */
 	CHECK_FOR_INTERRUPTS();
 
+	/*
+	 * When a non-parallel seqscan moves on to the next block in ascending
+	 * order, read the following blocks along with it, so that they can be
+	 * transferred with one vectored read.  We don't bother for backward
+	 * scans, nor for parallel scans, whose blocks are handed out to workers
+	 * piecemeal.
+	 */
+	if ((scan->rs_base.rs_flags & SO_TYPE_SEQSCAN) &&
+		scan->rs_base.rs_parallel == NULL &&
+		(scan->rs_cblock == InvalidBlockNumber ?
+		 page == scan->rs_startblock : page == scan->rs_cblock + 1))
+	{
+		BlockNumber lastblock;
+		int			window = io_combine_limit;
+
+		/*
+		 * With asynchronous I/O, look further ahead, so that several reads
+		 * can be in flight at once.
+		 */
+		if (io_method != IOMETHOD_SYNC)
+			window = Min(io_combine_limit * Max(effective_io_concurrency, 1),
+						 MAX_IO_COMBINE_LIMIT);
+
+		/* don't read past the end of the relation, nor wrap around */
+		lastblock = scan->rs_nblocks - 1;
+		if (page < scan->rs_startblock)
+			lastblock = scan->rs_startblock - 1;
+		if (scan->rs_numblocks != InvalidBlockNumber)
+			lastblock = Min(lastblock, page + scan->rs_numblocks - 1);
+
+		nahead = (int) Min(lastblock - page, (BlockNumber) (window - 1));
+	}
+
 	/* read page using selected strategy */
-	scan->rs_cbuf = ReadBufferExtended(scan->rs_base.rs_rd, MAIN_FORKNUM, page,
-									   RBM_NORMAL, scan->rs_strategy);
+	scan->rs_cbuf = heap_scan_read_page(scan, page, nahead);
 	scan->rs_cblock = page;
 
 	if (!(scan->rs_base.rs_flags & SO_ALLOW_PAGEMODE))
@@ -481,6 +518,62 @@ heapgetpage(TableScanDesc sscan, BlockNumber page)
 	scan->rs_ntuples = ntup;
 }
 
+/*
+ * heap_scan_read_page - pin a page on behalf of a heap scan
+ *
+ * If the page is in the scan's read-ahead window, its buffer is taken from
+ * there; any window buffers for blocks before it are released, since the
+ * caller evidently skipped them.  Otherwise the window is discarded and the
+ * page is read afresh, together with up to 'nahead' following blocks that
+ * become the new window.  The caller is responsible for knowing that the
+ * following blocks exist and are likely to be wanted next.
+ */
+Buffer
+heap_scan_read_page(HeapScanDesc scan, BlockNumber page, int nahead)
+{
+	Relation	rel = scan->rs_base.rs_rd;
+
+	if (scan->rs_raindex < scan->rs_nrabuffers &&
+		page >= scan->rs_rablock + scan->rs_raindex &&
+		page < scan->rs_rablock + scan->rs_nrabuffers)
+	{
+		int			idx = page - scan->rs_rablock;
+
+		while (scan->rs_raindex < idx)
+			ReleaseBuffer(scan->rs_rabuffers[scan->rs_raindex++]);
+		scan->rs_raindex++;
+		return scan->rs_rabuffers[idx];
+	}
+
+	heap_scan_release_readahead(scan);
+
+	if (nahead <= 0)
+		return ReadBufferExtended(rel, MAIN_FORKNUM, page, RBM_NORMAL,
+								  scan->rs_strategy);
+
+	nahead = Min(nahead, MAX_IO_COMBINE_LIMIT - 1);
+	ReadBufferRange(rel, MAIN_FORKNUM, page, nahead + 1,
+					scan->rs_rabuffers, scan->rs_strategy);
+	scan->rs_rablock = page;
+	scan->rs_raindex = 1;
+	scan->rs_nrabuffers = nahead + 1;
+
+	return scan->rs_rabuffers[0];
+}
+
+/*
+ * heap_scan_release_readahead - drop any unused read-ahead buffers of a scan
+ */
+void
+heap_scan_release_readahead(HeapScanDesc scan)
+{
+	while (scan->rs_raindex < scan->rs_nrabuffers)
+		ReleaseBuffer(scan->rs_rabuffers[scan->rs_raindex++]);
+	scan->rs_rablock = InvalidBlockNumber;
+	scan->rs_raindex = 0;
+	scan->rs_nrabuffers = 0;
+}
+
 /* ----------------
  *		heapgettup - fetch next heap tuple
  *
@@ -801,6 +894,7 @@ heapgettup(HeapScanDesc scan,
 		{
 			if (BufferIsValid(scan->rs_cbuf))
 				ReleaseBuffer(scan->rs_cbuf);
+			heap_scan_release_readahead(scan);
 			scan->rs_cbuf = InvalidBuffer;
 			scan->rs_cblock = InvalidBlockNumber;
 			tuple->t_data = NULL;
@@ -1110,6 +1204,7 @@ heapgettup_pagemode(HeapScanDesc scan,
 		{
 			if (BufferIsValid(scan->rs_cbuf))
 				ReleaseBuffer(scan->rs_cbuf);
+			heap_scan_release_readahead(scan);
 			scan->rs_cbuf = InvalidBuffer;
 			scan->rs_cblock = InvalidBlockNumber;
 			tuple->t_data = NULL;
@@ -1252,6 +1347,7 @@ heap_rescan(TableScanDesc sscan, ScanKey key, bool set_params,
 	 */
 	if (BufferIsValid(scan->rs_cbuf))
 		ReleaseBuffer(scan->rs_cbuf);
+	heap_scan_release_readahead(scan);
 
 	/*
 	 * reinitialize scan descriptor
@@ -1271,6 +1367,7 @@ heap_endscan(TableScanDesc sscan)
 	 */
 	if (BufferIsValid(scan->rs_cbuf))
 		ReleaseBuffer(scan->rs_cbuf);
+	heap_scan_release_readahead(scan);
 
 	/*
 	 * decrement relation reference count and free scan descriptor storage
@@ -1977,6 +2074,7 @@ GetBulkInsertState(void)
 	bistate = (BulkInsertState) palloc(sizeof(BulkInsertStateData));
 	bistate->strategy = GetAccessStrategy(BAS_BULKWRITE);
 	bistate->current_buf = InvalidBuffer;
+	bistate->already_extended_by = 0;
 	return bistate;
 }
 
@@ -2001,6 +2099,7 @@ ReleaseBulkInsertStatePin(BulkInsertState bistate)
 	if (bistate->current_buf != InvalidBuffer)
 		ReleaseBuffer(bistate->current_buf);
 	bistate->current_buf = InvalidBuffer;
+	bistate->already_extended_by = 0;
 }
 
 
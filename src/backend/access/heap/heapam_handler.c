@@ -36,6 +36,7 @@
 #include "executor/executor.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "storage/aio.h"
 #include "storage/bufmgr.h"
 #include "storage/bufpage.h"
 #include "storage/lmgr.h"
@@ -2117,6 +2118,7 @@ heapam_scan_bitmap_next_block(TableScanDesc scan,
 	Buffer		buffer;
 	Snapshot	snapshot;
 	int			ntup;
+	int			window = io_combine_limit;
 
 	hscan->rs_cindex = 0;
 	hscan->rs_ntuples = 0;
@@ -2132,10 +2134,18 @@ heapam_scan_bitmap_next_block(TableScanDesc scan,
 
 	/*
 	 * Acquire pin on the target heap page, trading in any pin we held before.
+	 * If the bitmap tells us that the next pages follow consecutively, read
+	 * them along with this one, looking as far ahead as heapgetpage() does.
 	 */
-	hscan->rs_cbuf = ReleaseAndReadBuffer(hscan->rs_cbuf,
-										  scan->rs_rd,
-										  page);
+	if (io_method != IOMETHOD_SYNC)
+		window = Min(io_combine_limit * Max(effective_io_concurrency, 1),
+					 MAX_IO_COMBINE_LIMIT);
+	if (BufferIsValid(hscan->rs_cbuf))
+		ReleaseBuffer(hscan->rs_cbuf);
+	hscan->rs_cbuf = heap_scan_read_page(hscan, page,
+										 Min((BlockNumber) Min(tbmres->nahead,
+															   window - 1),
+											 hscan->rs_nblocks - page - 1));
 	hscan->rs_cblock = page;
 	buffer = hscan->rs_cbuf;
 	snapshot = scan->rs_snapshot;
@@ -187,78 +187,70 @@ GetVisibilityMapPins(Relation relation, Buffer buffer1, Buffer buffer2,
 
 /*
  * Extend a relation by multiple blocks to avoid future contention on the
- * relation extension lock.  Our goal is to pre-extend the relation by an
- * amount which ramps up as the degree of contention ramps up, but limiting
- * the result to some sane overall value.
+ * relation extension lock, and to avoid extending it one block at a time
+ * during bulk inserts.  Our goal is to pre-extend the relation by an amount
+ * which ramps up as the degree of contention ramps up, or as a bulk insert
+ * goes on, but limiting the result to some sane overall value.
+ *
+ * Caller must hold the relation extension lock, if it needs one.
  */
 static void
 RelationAddExtraBlocks(Relation relation, BulkInsertState bistate)
 {
-	BlockNumber blockNum,
-				firstBlock = InvalidBlockNumber;
-	int			extraBlocks;
-	int			lockWaiters;
-
-	/* Use the length of the lock wait queue to judge how much to extend. */
-	lockWaiters = RelationExtensionLockWaiterCount(relation);
-	if (lockWaiters <= 0)
-		return;
+	BlockNumber firstBlock;
+	int			extraBlocks = 0;
 
 	/*
-	 * It might seem like multiplying the number of lock waiters by as much as
+	 * Use the length of the lock wait queue to judge how much to extend.  It
+	 * might seem like multiplying the number of lock waiters by as much as
 	 * 20 is too aggressive, but benchmarking revealed that smaller numbers
 	 * were insufficient.  512 is just an arbitrary cap to prevent
 	 * pathological results.
 	 */
-	extraBlocks = Min(512, lockWaiters * 20);
-
-	do
+	if (!RELATION_IS_LOCAL(relation))
 	{
-		Buffer		buffer;
-		Page		page;
-		Size		freespace;
-
-		/*
-		 * Extend by one page.  This should generally match the main-line
-		 * extension code in RelationGetBufferForTuple, except that we hold
-		 * the relation extension lock throughout, and we don't immediately
-		 * initialize the page (see below).
-		 */
-		buffer = ReadBufferBI(relation, P_NEW, RBM_ZERO_AND_LOCK, bistate);
-		page = BufferGetPage(buffer);
+		int			lockWaiters = RelationExtensionLockWaiterCount(relation);
 
-		if (!PageIsNew(page))
-			elog(ERROR, "page %u of relation \"%s\" should be empty but is not",
-				 BufferGetBlockNumber(buffer),
-				 RelationGetRelationName(relation));
-
-		/*
-		 * Add the page to the FSM without initializing. If we were to
-		 * initialize here, the page would potentially get flushed out to disk
-		 * before we add any useful content. There's no guarantee that that'd
-		 * happen before a potential crash, so we need to deal with
-		 * uninitialized pages anyway, thus avoid the potential for
-		 * unnecessary writes.
-		 */
+		if (lockWaiters > 0)
+			extraBlocks = Min(512, lockWaiters * 20);
+	}
 
-		/* we'll need this info below */
-		blockNum = BufferGetBlockNumber(buffer);
-		freespace = BufferGetPageSize(buffer) - SizeOfPageHeaderData;
+	/*
+	 * A bulk insert will fill whatever we add, so extend by as many blocks
+	 * as it has added so far, up to 64 at a time.
+	 */
+	if (bistate)
+	{
+		extraBlocks = Max(extraBlocks,
+						  Min(64, bistate->already_extended_by));
+		bistate->already_extended_by += extraBlocks + 1;
+	}
 
-		UnlockReleaseBuffer(buffer);
+	if (extraBlocks <= 0)
+		return;
 
-		/* Remember first block number thus added. */
-		if (firstBlock == InvalidBlockNumber)
-			firstBlock = blockNum;
+	/*
+	 * Extend the relation by all of those blocks at once.  They are zeroed
+	 * on disk, bypassing shared buffers: there's no point in initializing
+	 * the pages here, as we'd only have to write them out again before
+	 * adding any useful content, and we need to cope with uninitialized
+	 * pages anyway in case of a crash.  RelationGetBufferForTuple
+	 * initializes such pages when it gets them from the FSM.
+	 *
+	 * We hold the relation extension lock, so nobody else can be extending
+	 * the relation concurrently.
+	 */
+	firstBlock = RelationGetNumberOfBlocks(relation);
+	smgrzeroextend(RelationGetSmgr(relation), MAIN_FORKNUM, firstBlock,
+				   extraBlocks, false);
 
-		/*
-		 * Immediately update the bottom level of the FSM.  This has a good
-		 * chance of making this page visible to other concurrently inserting
-		 * backends, and we want that to happen without delay.
-		 */
-		RecordPageWithFreeSpace(relation, blockNum, freespace);
-	}
-	while (--extraBlocks > 0);
+	/*
+	 * Immediately update the bottom level of the FSM.  This has a good
+	 * chance of making these pages visible to other concurrently inserting
+	 * backends, and we want that to happen without delay.
+	 */
+	RecordPagesWithFreeSpace(relation, firstBlock, extraBlocks,
+							 BLCKSZ - SizeOfPageHeaderData);
 
 	/*
 	 * Updating the upper levels of the free space map is too expensive to do
@@ -266,7 +258,7 @@ RelationAddExtraBlocks(Relation relation, BulkInsertState bistate)
 	 * subsequent insertion activity sees all of those nifty free pages we
 	 * just inserted.
 	 */
-	FreeSpaceMapVacuumRange(relation, firstBlock, blockNum + 1);
+	FreeSpaceMapVacuumRange(relation, firstBlock, firstBlock + extraBlocks);
 }
 
 /*
@@ -577,10 +569,8 @@ loop:
 	needLock = !RELATION_IS_LOCAL(relation);
 
 	/*
-	 * If we need the lock but are not able to acquire it immediately, we'll
-	 * consider extending the relation by multiple blocks at a time to manage
-	 * contention on the relation extension lock.  However, this only makes
-	 * sense if we're using the FSM; otherwise, there's no point.
+	 * If we need the lock but are not able to acquire it immediately, check
+	 * whether someone else extended the relation while we waited.
 	 */
 	if (needLock)
 	{
@@ -606,12 +596,16 @@ loop:
 				UnlockRelationForExtension(relation, ExclusiveLock);
 				goto loop;
 			}
-
-			/* Time to bulk-extend. */
-			RelationAddExtraBlocks(relation, bistate);
 		}
 	}
 
+	/*
+	 * Time to bulk-extend, if others are waiting for the lock or this is a
+	 * bulk insert.  The extra blocks are only found through the FSM.
+	 */
+	if (use_fsm)
+		RelationAddExtraBlocks(relation, bistate);
+
 	/*
 	 * In addition to whatever extension we performed above, we always add at
 	 * least one block to satisfy our own request.
@@ -56,6 +56,7 @@
 #include "pgstat.h"
 #include "portability/instr_time.h"
 #include "postmaster/autovacuum.h"
+#include "storage/aio.h"
 #include "storage/bufmgr.h"
 #include "storage/freespace.h"
 #include "storage/lmgr.h"
@@ -216,6 +217,15 @@ typedef struct LVRelState
 	int64		live_tuples;	/* # live tuples remaining */
 	int64		recently_dead_tuples;	/* # dead, but not yet removable */
 	int64		missed_dead_tuples; /* # removable, but not removed */
+
+	/*
+	 * Heap pages read ahead by lazy_scan_read_page(), but not yet handed out.
+	 * rabuffers[i] holds block rablock + i, for raindex <= i < nrabuffers.
+	 */
+	Buffer		rabuffers[MAX_IO_COMBINE_LIMIT];
+	BlockNumber rablock;
+	int			raindex;
+	int			nrabuffers;
 } LVRelState;
 
 /*
@@ -251,6 +261,9 @@ static BlockNumber lazy_scan_skip(LVRelState *vacrel, Buffer *vmbuffer,
 								  BlockNumber next_block,
 								  bool *next_unskippable_allvis,
 								  bool *skipping_current_range);
+static Buffer lazy_scan_read_page(LVRelState *vacrel, BlockNumber blkno,
+								  BlockNumber lastblock);
+static void lazy_scan_release_readahead(LVRelState *vacrel);
 static bool lazy_scan_new_or_empty(LVRelState *vacrel, Buffer buf,
 								   BlockNumber blkno, Page page,
 								   bool sharelock, Buffer vmbuffer);
@@ -940,13 +953,15 @@ lazy_scan_heap(LVRelState *vacrel)
 			 * Before beginning index vacuuming, we release any pin we may
 			 * hold on the visibility map page.  This isn't necessary for
 			 * correctness, but we do it anyway to avoid holding the pin
-			 * across a lengthy, unrelated operation.
+			 * across a lengthy, unrelated operation.  The pins on pages read
+			 * ahead must go, though: heap vacuuming needs cleanup locks.
 			 */
 			if (BufferIsValid(vmbuffer))
 			{
 				ReleaseBuffer(vmbuffer);
 				vmbuffer = InvalidBuffer;
 			}
+			lazy_scan_release_readahead(vacrel);
 
 			/* Perform a round of index and heap vacuuming */
 			vacrel->consider_bypass_optimization = false;
@@ -972,9 +987,14 @@ lazy_scan_heap(LVRelState *vacrel)
 		 */
 		visibilitymap_pin(vacrel->rel, blkno, &vmbuffer);
 
-		/* Finished preparatory checks.  Actually scan the page. */
-		buf = ReadBufferExtended(vacrel->rel, MAIN_FORKNUM, blkno,
-								 RBM_NORMAL, vacrel->bstrategy);
+		/*
+		 * Finished preparatory checks.  Actually scan the page.  Unless we
+		 * are about to skip a range of pages, all the pages up to and
+		 * including the next unskippable one will be scanned next.
+		 */
+		buf = lazy_scan_read_page(vacrel, blkno,
+								  skipping_current_range ? blkno :
+								  Min(next_unskippable_block, rel_pages - 1));
 		page = BufferGetPage(buf);
 
 		/*
@@ -1239,6 +1259,7 @@ lazy_scan_heap(LVRelState *vacrel)
 	vacrel->blkno = InvalidBlockNumber;
 	if (BufferIsValid(vmbuffer))
 		ReleaseBuffer(vmbuffer);
+	lazy_scan_release_readahead(vacrel);
 
 	/* report that everything is now scanned */
 	pgstat_progress_update_param(PROGRESS_VACUUM_HEAP_BLKS_SCANNED, blkno);
@@ -1278,6 +1299,59 @@ lazy_scan_heap(LVRelState *vacrel)
 		lazy_cleanup_all_indexes(vacrel);
 }
 
+/*
+ *	lazy_scan_read_page() -- pin a heap page for lazy_scan_heap.
+ *
+ * Like heap_scan_read_page() does for heap scans, read the page together
+ * with the following pages up to lastblock, which the caller is going to
+ * scan next, with ReadBufferRange().  Those pages are kept pinned until the
+ * caller asks for them.
+ */
+static Buffer
+lazy_scan_read_page(LVRelState *vacrel, BlockNumber blkno,
+					BlockNumber lastblock)
+{
+	int			window = io_combine_limit;
+	int			nahead;
+
+	if (vacrel->raindex < vacrel->nrabuffers &&
+		blkno == vacrel->rablock + vacrel->raindex)
+		return vacrel->rabuffers[vacrel->raindex++];
+
+	lazy_scan_release_readahead(vacrel);
+
+	/* with asynchronous I/O, look further ahead, as heap scans do */
+	if (io_method != IOMETHOD_SYNC)
+		window = Min(io_combine_limit * Max(maintenance_io_concurrency, 1),
+					 MAX_IO_COMBINE_LIMIT);
+
+	Assert(lastblock >= blkno);
+	nahead = (int) Min(lastblock - blkno, (BlockNumber) (window - 1));
+	if (nahead <= 0)
+		return ReadBufferExtended(vacrel->rel, MAIN_FORKNUM, blkno,
+								  RBM_NORMAL, vacrel->bstrategy);
+
+	ReadBufferRange(vacrel->rel, MAIN_FORKNUM, blkno, nahead + 1,
+					vacrel->rabuffers, vacrel->bstrategy);
+	vacrel->rablock = blkno;
+	vacrel->raindex = 1;
+	vacrel->nrabuffers = nahead + 1;
+
+	return vacrel->rabuffers[0];
+}
+
+/*
+ *	lazy_scan_release_readahead() -- drop pages read ahead, but not scanned.
+ */
+static void
+lazy_scan_release_readahead(LVRelState *vacrel)
+{
+	while (vacrel->raindex < vacrel->nrabuffers)
+		ReleaseBuffer(vacrel->rabuffers[vacrel->raindex++]);
+	vacrel->raindex = 0;
+	vacrel->nrabuffers = 0;
+}
+
 /*
  *	lazy_scan_skip() -- set up range of skippable blocks using visibility map.
  *
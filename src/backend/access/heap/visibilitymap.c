@@ -16,6 +16,7 @@
  *		visibilitymap_pin_ok - check whether correct map page is already pinned
  *		visibilitymap_set	 - set a bit in a previously pinned page
  *		visibilitymap_get_status - get status of bits
+ *		visibilitymap_block  - map block covering a heap block
  *		visibilitymap_count  - count number of bits set in visibility map
  *		visibilitymap_prepare_truncate -
  *			prepare for truncation of the visibility map
@@ -368,6 +369,15 @@ visibilitymap_get_status(Relation rel, BlockNumber heapBlk, Buffer *buf)
 	return result;
 }
 
+/*
+ *	visibilitymap_block - return the map block covering a heap block
+ */
+BlockNumber
+visibilitymap_block(BlockNumber heapBlk)
+{
+	return HEAPBLK_TO_MAPBLOCK(heapBlk);
+}
+
 /*
  *	visibilitymap_count  - count number of bits set in visibility map
  *
@@ -615,7 +625,7 @@ static void
 vm_extend(Relation rel, BlockNumber vm_nblocks)
 {
 	BlockNumber vm_nblocks_now;
-	PGAlignedBlock pg;
+	PGIOAlignedBlock pg;
 	SMgrRelation reln;
 
 	PageInit((Page) pg.data, BLCKSZ, 0);
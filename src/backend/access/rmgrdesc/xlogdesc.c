@@ -113,7 +113,8 @@ xlog_desc(StringInfo buf, XLogReaderState *record)
 		appendStringInfo(buf, "max_connections=%d max_worker_processes=%d "
 						 "max_wal_senders=%d max_prepared_xacts=%d "
 						 "max_locks_per_xact=%d wal_level=%s "
-						 "wal_log_hints=%s track_commit_timestamp=%s",
+						 "wal_log_hints=%s track_commit_timestamp=%s "
+						 "double_write=%s",
 						 xlrec.MaxConnections,
 						 xlrec.max_worker_processes,
 						 xlrec.max_wal_senders,
@@ -121,7 +122,8 @@ xlog_desc(StringInfo buf, XLogReaderState *record)
 						 xlrec.max_locks_per_xact,
 						 wal_level_str,
 						 xlrec.wal_log_hints ? "on" : "off",
-						 xlrec.track_commit_timestamp ? "on" : "off");
+						 xlrec.track_commit_timestamp ? "on" : "off",
+						 xlrec.double_write ? "on" : "off");
 	}
 	else if (info == XLOG_FPW_CHANGE)
 	{
@@ -148,6 +150,14 @@ xlog_desc(StringInfo buf, XLogReaderState *record)
 						 LSN_FORMAT_ARGS(xlrec.overwritten_lsn),
 						 timestamptz_to_str(xlrec.overwrite_time));
 	}
+	else if (info == XLOG_FPI_DICTIONARY)
+	{
+		xl_fpi_dictionary xlrec;
+
+		memcpy(&xlrec, rec, SizeOfFPIDictionary);
+		appendStringInfo(buf, "id %u; rmgr %u; length %u",
+						 xlrec.dict_id, xlrec.dict_rmid, xlrec.dict_len);
+	}
 }
 
 const char *
@@ -190,6 +200,9 @@ xlog_identify(uint8 info)
 		case XLOG_OVERWRITE_CONTRECORD:
 			id = "OVERWRITE_CONTRECORD";
 			break;
+		case XLOG_FPI_DICTIONARY:
+			id = "FPI_DICTIONARY";
+			break;
 		case XLOG_FPI:
 			id = "FPI";
 			break;
@@ -261,6 +274,8 @@ XLogRecGetBlockRefInfo(XLogReaderState *record, bool pretty,
 						method = "lz4";
 					else if ((bimg_info & BKPIMAGE_COMPRESS_ZSTD) != 0)
 						method = "zstd";
+					else if ((bimg_info & BKPIMAGE_COMPRESS_ZSTD_DICT) != 0)
+						method = "zstd-dict";
 					else
 						method = "unknown";
 
@@ -58,6 +58,7 @@
 #include "access/xact.h"
 #include "access/xlog_internal.h"
 #include "access/xlogarchive.h"
+#include "access/xlogdict.h"
 #include "access/xloginsert.h"
 #include "access/xlogprefetcher.h"
 #include "access/xlogreader.h"
@@ -74,6 +75,7 @@
 #include "pg_trace.h"
 #include "pgstat.h"
 #include "port/atomics.h"
+#include "port/pg_bitutils.h"
 #include "port/pg_iovec.h"
 #include "postmaster/bgwriter.h"
 #include "postmaster/startup.h"
@@ -85,6 +87,7 @@
 #include "replication/walreceiver.h"
 #include "replication/walsender.h"
 #include "storage/bufmgr.h"
+#include "storage/doublewrite.h"
 #include "storage/fd.h"
 #include "storage/ipc.h"
 #include "storage/large_object.h"
@@ -146,9 +149,10 @@ int			wal_segment_size = DEFAULT_XLOG_SEG_SIZE;
 /*
  * Number of WAL insertion locks to use. A higher value allows more insertions
  * to happen concurrently, but adds some CPU overhead to flushing the WAL,
- * which needs to iterate all the locks.
+ * which needs to iterate all the locks.  -1 means to choose a value based on
+ * the number of CPUs; see XLOGChooseNumInsertLocks().
  */
-#define NUM_XLOGINSERT_LOCKS  8
+int			wal_insert_locks = -1;
 
 /*
  * Max distance from last checkpoint, before triggering a new xlog-based
@@ -332,11 +336,12 @@ typedef struct XLogwrtResult
 } XLogwrtResult;
 
 /*
- * Inserting to WAL is protected by a small fixed number of WAL insertion
- * locks. To insert to the WAL, you must hold one of the locks - it doesn't
- * matter which one. To lock out other concurrent insertions, you must hold
- * of them. Each WAL insertion lock consists of a lightweight lock, plus an
- * indicator of how far the insertion has progressed (insertingAt).
+ * Inserting to WAL is protected by a number of WAL insertion locks, fixed at
+ * server start (wal_insert_locks). To insert to the WAL, you must hold one
+ * of the locks - it doesn't matter which one. To lock out other concurrent
+ * insertions, you must hold all of them. Each WAL insertion lock consists of
+ * a lightweight lock, plus an indicator of how far the insertion has
+ * progressed (insertingAt).
  *
  * The insertingAt values are read when a process wants to flush WAL from
  * the in-memory buffers to disk, to check that all the insertions to the
@@ -387,6 +392,38 @@ typedef union WALInsertLockPadded
 	char		pad[PG_CACHE_LINE_SIZE];
 } WALInsertLockPadded;
 
+/*
+ * Space in WAL is reserved with an atomic fetch-add on CurrBytePos, so there
+ * is no lock that would let an inserter also swap in its own start position
+ * as the previous record's.  Instead, each inserter hands its start position
+ * over to the inserter of the record that follows it, through a small
+ * shared hash table of prev-links keyed by the end position of the record
+ * (which is where the next record starts).  An inserter adds its own link as
+ * soon as it has reserved its space, and then waits for the link for its own
+ * start position to appear, which removes it from the table.
+ *
+ * Only inserters holding an insertion lock reserve space, and each of them
+ * leaves at most one link in the table, so it can't fill up as long as it
+ * has more entries than there are insertion locks.
+ */
+typedef struct XLogPrevLink
+{
+	pg_atomic_uint64 endpos;	/* key, or XLOG_PREV_LINK_EMPTY */
+	pg_atomic_uint64 prevpos;	/* start of the record ending at endpos, or
+								 * XLOG_PREV_LINK_EMPTY if not set yet */
+} XLogPrevLink;
+
+#define XLOG_PREV_LINK_EMPTY	PG_UINT64_MAX
+
+/*
+ * Limits for wal_insert_locks.  WALInsertLockAcquireExclusive() holds all of
+ * the locks at once, so the GUC's maximum (128, the same as the auto-tuned
+ * one) must stay well below MAX_SIMUL_LWLOCKS, leaving room for the locks
+ * its callers already hold.
+ */
+#define MIN_AUTO_XLOGINSERT_LOCKS	8
+#define MAX_AUTO_XLOGINSERT_LOCKS	128
+
 /*
  * Session status of running backup, used for sanity checks in SQL-callable
  * functions to start and stop backups.
@@ -398,24 +435,21 @@ static SessionBackupState sessionBackupState = SESSION_BACKUP_NONE;
  */
 typedef struct XLogCtlInsert
 {
-	slock_t		insertpos_lck;	/* protects CurrBytePos and PrevBytePos */
-
 	/*
 	 * CurrBytePos is the end of reserved WAL. The next record will be
-	 * inserted at that position. PrevBytePos is the start position of the
-	 * previously inserted (or rather, reserved) record - it is copied to the
-	 * prev-link of the next record. These are stored as "usable byte
-	 * positions" rather than XLogRecPtrs (see XLogBytePosToRecPtr()).
+	 * inserted at that position. It is stored as a "usable byte position"
+	 * rather than an XLogRecPtr (see XLogBytePosToRecPtr()).  The start
+	 * position of the previously reserved record, which is copied to the
+	 * prev-link of the next record, is passed on through PrevLinks.
 	 */
-	uint64		CurrBytePos;
-	uint64		PrevBytePos;
+	pg_atomic_uint64 CurrBytePos;
 
 	/*
-	 * Make sure the above heavily-contended spinlock and byte positions are
-	 * on their own cache line. In particular, the RedoRecPtr and full page
-	 * write variables below should be on a different cache line. They are
-	 * read on every WAL insertion, but updated rarely, and we don't want
-	 * those reads to steal the cache line containing Curr/PrevBytePos.
+	 * Make sure the above heavily-contended byte position is on its own
+	 * cache line. In particular, the RedoRecPtr and full page write variables
+	 * below should be on a different cache line. They are read on every WAL
+	 * insertion, but updated rarely, and we don't want those reads to steal
+	 * the cache line containing CurrBytePos.
 	 */
 	char		pad[PG_CACHE_LINE_SIZE];
 
@@ -444,9 +478,12 @@ typedef struct XLogCtlInsert
 	XLogRecPtr	lastBackupStart;
 
 	/*
-	 * WAL insertion locks.
+	 * WAL insertion locks, and the prev-link hash table (NumPrevLinks
+	 * entries, a power of 2).
 	 */
 	WALInsertLockPadded *WALInsertLocks;
+	XLogPrevLink *PrevLinks;
+	int			NumPrevLinks;
 } XLogCtlInsert;
 
 /*
@@ -456,6 +493,20 @@ typedef struct XLogCtlData
 {
 	XLogCtlInsert Insert;
 
+	/*
+	 * All WAL insertions before this point are known to have finished.  This
+	 * is advanced by WaitXLogInsertionsToFinish(), and lets later callers
+	 * skip scanning the insertion locks if they don't need to go any further.
+	 */
+	pg_atomic_uint64 logInsertResult;
+
+	/*
+	 * Moving average of the time, in microseconds, that group flush leaders
+	 * spent in XLogWrite().  Only updated while holding WALWriteLock; used to
+	 * size the commit_delay sleep.
+	 */
+	pg_atomic_uint32 avgFlushUsec;
+
 	/* Protected by info_lck: */
 	XLogwrtRqst LogwrtRqst;
 	XLogRecPtr	RedoRecPtr;		/* a recent copy of Insert->RedoRecPtr */
@@ -493,11 +544,12 @@ typedef struct XLogCtlData
 
 	/*
 	 * These values do not change after startup, although the pointed-to pages
-	 * and xlblocks values certainly do.  xlblocks values are protected by
-	 * WALBufMappingLock.
+	 * and xlblocks values certainly do.  xlblocks values are changed while
+	 * holding WALBufMappingLock, but may be read without it; see
+	 * WALReadFromBuffers().
 	 */
 	char	   *pages;			/* buffers for unwritten XLOG pages */
-	XLogRecPtr *xlblocks;		/* 1st byte ptr-s + XLOG_BLCKSZ */
+	pg_atomic_uint64 *xlblocks; /* 1st byte ptr-s + XLOG_BLCKSZ */
 	int			XLogCacheBlck;	/* highest allocated xlog buffer index */
 
 	/*
@@ -651,6 +703,8 @@ static XLogRecPtr XLogGetReplicationSlotMinimumLSN(void);
 static void AdvanceXLInsertBuffer(XLogRecPtr upto, TimeLineID tli,
 								  bool opportunistic);
 static void XLogWrite(XLogwrtRqst WriteRqst, TimeLineID tli, bool flexible);
+static void XLogFlushGroup(XLogRecPtr record, TimeLineID insertTLI);
+static void XLogFlushSingle(XLogRecPtr record, TimeLineID insertTLI);
 static bool InstallXLogFileSegment(XLogSegNo *segno, char *tmppath,
 								   bool find_free, XLogSegNo max_segno,
 								   TimeLineID tli);
@@ -707,6 +761,10 @@ static void WALInsertLockUpdateInsertingAt(XLogRecPtr insertingAt);
  * which pages need a full-page image, and retry.  If fpw_lsn is invalid, the
  * record is always inserted.
  *
+ * If 'dict_lsn' is valid, it is the oldest location among the records that
+ * logged WAL compression dictionaries used for full-page images in this
+ * record.  If dict_lsn < RedoRecPtr, the insertion is likewise not performed.
+ *
  * 'flags' gives more in-depth control on the record being inserted. See
  * XLogSetRecordFlags() for details.
  *
@@ -727,6 +785,7 @@ static void WALInsertLockUpdateInsertingAt(XLogRecPtr insertingAt);
 XLogRecPtr
 XLogInsertRecord(XLogRecData *rdata,
 				 XLogRecPtr fpw_lsn,
+				 XLogRecPtr dict_lsn,
 				 uint8 flags,
 				 int num_fpi,
 				 bool topxid_included)
@@ -763,8 +822,8 @@ XLogInsertRecord(XLogRecData *rdata,
 	 * record to the shared WAL buffer cache is a two-step process:
 	 *
 	 * 1. Reserve the right amount of space from the WAL. The current head of
-	 *	  reserved space is kept in Insert->CurrBytePos, and is protected by
-	 *	  insertpos_lck.
+	 *	  reserved space is kept in Insert->CurrBytePos, and is advanced with
+	 *	  an atomic fetch-add.
 	 *
 	 * 2. Copy the record to the reserved WAL space. This involves finding the
 	 *	  correct WAL buffer containing the reserved space, and copying the
@@ -773,10 +832,10 @@ XLogInsertRecord(XLogRecData *rdata,
 	 * To keep track of which insertions are still in-progress, each concurrent
 	 * inserter acquires an insertion lock. In addition to just indicating that
 	 * an insertion is in progress, the lock tells others how far the inserter
-	 * has progressed. There is a small fixed number of insertion locks,
-	 * determined by NUM_XLOGINSERT_LOCKS. When an inserter crosses a page
-	 * boundary, it updates the value stored in the lock to the how far it has
-	 * inserted, to allow the previous buffer to be flushed.
+	 * has progressed. The number of insertion locks is determined by
+	 * wal_insert_locks. When an inserter crosses a page boundary, it
+	 * updates the value stored in the lock to the how far it has inserted,
+	 * to allow the previous buffer to be flushed.
 	 *
 	 * Holding onto an insertion lock also protects RedoRecPtr and
 	 * fullPageWrites from changing until the insertion is finished.
@@ -830,6 +889,19 @@ XLogInsertRecord(XLogRecData *rdata,
 		return InvalidXLogRecPtr;
 	}
 
+	/*
+	 * Likewise if a full-page image was compressed with a dictionary that
+	 * was logged before the redo pointer; replay starting there wouldn't know
+	 * the dictionary.  This applies even if we aren't doing full-page writes
+	 * anymore, because some images are included regardless.
+	 */
+	if (dict_lsn != InvalidXLogRecPtr && dict_lsn < RedoRecPtr)
+	{
+		WALInsertLockRelease();
+		END_CRIT_SECTION();
+		return InvalidXLogRecPtr;
+	}
+
 	/*
 	 * Reserve space for the record in the WAL. This also sets the xl_prev
 	 * pointer.
@@ -1023,6 +1095,98 @@ XLogInsertRecord(XLogRecData *rdata,
 	return EndPos;
 }
 
+/*
+ * Hash function for the prev-link table.  Records are MAXALIGNed, so the low
+ * bits of a byte position carry no information.
+ */
+static inline int
+XLogPrevLinkSlot(uint64 bytepos)
+{
+	XLogCtlInsert *Insert = &XLogCtl->Insert;
+
+	return (int) ((bytepos / MAXIMUM_ALIGNOF) & (Insert->NumPrevLinks - 1));
+}
+
+/*
+ * Record that the record ending at endbytepos (where the next record will
+ * start) starts at startbytepos, for the inserter of the next record to pick
+ * up with XLogTakePrevLink().
+ */
+static void
+XLogPutPrevLink(uint64 endbytepos, uint64 startbytepos)
+{
+	XLogCtlInsert *Insert = &XLogCtl->Insert;
+	int			slot = XLogPrevLinkSlot(endbytepos);
+	SpinDelayStatus delayStatus;
+
+	init_local_spin_delay(&delayStatus);
+	for (;;)
+	{
+		XLogPrevLink *link = &Insert->PrevLinks[slot];
+		uint64		expected = XLOG_PREV_LINK_EMPTY;
+
+		if (pg_atomic_compare_exchange_u64(&link->endpos, &expected,
+										   endbytepos))
+		{
+			pg_atomic_write_u64(&link->prevpos, startbytepos);
+			break;
+		}
+
+		/* linear probing; the table can't actually be full, but be safe */
+		slot = (slot + 1) & (Insert->NumPrevLinks - 1);
+		if (slot == XLogPrevLinkSlot(endbytepos))
+			perform_spin_delay(&delayStatus);
+	}
+	finish_spin_delay(&delayStatus);
+}
+
+/*
+ * Get the start of the record that ends at bytepos, and remove its entry
+ * from the prev-link table.  If its inserter hasn't added it yet, wait;
+ * that inserter has already reserved its space, so that won't take long.
+ */
+static uint64
+XLogTakePrevLink(uint64 bytepos)
+{
+	XLogCtlInsert *Insert = &XLogCtl->Insert;
+	int			slot = XLogPrevLinkSlot(bytepos);
+	SpinDelayStatus delayStatus;
+	XLogPrevLink *link;
+	uint64		prevbytepos;
+
+	init_local_spin_delay(&delayStatus);
+	for (;;)
+	{
+		link = &Insert->PrevLinks[slot];
+		if (pg_atomic_read_u64(&link->endpos) == bytepos)
+			break;
+
+		slot = (slot + 1) & (Insert->NumPrevLinks - 1);
+		if (slot == XLogPrevLinkSlot(bytepos))
+			perform_spin_delay(&delayStatus);
+	}
+
+	/*
+	 * Don't read prevpos before endpos.  Otherwise we could see the value
+	 * left over from the slot's previous use, before the releaser reset it.
+	 * Pairs with the write barrier when releasing the entry, below.
+	 */
+	pg_read_barrier();
+
+	/* the inserter may not have filled in the value yet */
+	while ((prevbytepos = pg_atomic_read_u64(&link->prevpos)) ==
+		   XLOG_PREV_LINK_EMPTY)
+		perform_spin_delay(&delayStatus);
+	finish_spin_delay(&delayStatus);
+
+	/* Release the entry, value first so it's ready for the next user. */
+	pg_atomic_write_u64(&link->prevpos, XLOG_PREV_LINK_EMPTY);
+	pg_write_barrier();
+	pg_atomic_write_u64(&link->endpos, XLOG_PREV_LINK_EMPTY);
+
+	return prevbytepos;
+}
+
 /*
  * Reserves the right amount of space for a record of given size from the WAL.
  * *StartPos is set to the beginning of the reserved section, *EndPos to
@@ -1030,9 +1194,9 @@ XLogInsertRecord(XLogRecData *rdata,
  * used to set the xl_prev of this record.
  *
  * This is the performance critical part of XLogInsert that must be serialized
- * across backends. The rest can happen mostly in parallel. Try to keep this
- * section as short as possible, insertpos_lck can be heavily contended on a
- * busy system.
+ * across backends. The rest can happen mostly in parallel. It comes down to
+ * a single atomic fetch-add, plus handing over the prev-link, which only
+ * ever waits for the inserter of the immediately preceding record.
  *
  * NB: The space calculation here must match the code in CopyXLogRecordToWAL,
  * where we actually copy the record to the reserved space.
@@ -1052,24 +1216,19 @@ ReserveXLogInsertLocation(int size, XLogRecPtr *StartPos, XLogRecPtr *EndPos,
 	Assert(size > SizeOfXLogRecord);
 
 	/*
-	 * The duration the spinlock needs to be held is minimized by minimizing
-	 * the calculations that have to be done while holding the lock. The
-	 * current tip of reserved WAL is kept in CurrBytePos, as a byte position
-	 * that only counts "usable" bytes in WAL, that is, it excludes all WAL
-	 * page headers. The mapping between "usable" byte positions and physical
-	 * positions (XLogRecPtrs) can be done outside the locked region, and
-	 * because the usable byte position doesn't include any headers, reserving
-	 * X bytes from WAL is almost as simple as "CurrBytePos += X".
+	 * The current tip of reserved WAL is kept in CurrBytePos, as a byte
+	 * position that only counts "usable" bytes in WAL, that is, it excludes
+	 * all WAL page headers. The mapping between "usable" byte positions and
+	 * physical positions (XLogRecPtrs) can be done afterwards, and because
+	 * the usable byte position doesn't include any headers, reserving X bytes
+	 * from WAL is simply "CurrBytePos += X".
 	 */
-	SpinLockAcquire(&Insert->insertpos_lck);
-
-	startbytepos = Insert->CurrBytePos;
+	startbytepos = pg_atomic_fetch_add_u64(&Insert->CurrBytePos, size);
 	endbytepos = startbytepos + size;
-	prevbytepos = Insert->PrevBytePos;
-	Insert->CurrBytePos = endbytepos;
-	Insert->PrevBytePos = startbytepos;
 
-	SpinLockRelease(&Insert->insertpos_lck);
+	/* Pass our start on to the next record, and get the previous one's. */
+	XLogPutPrevLink(endbytepos, startbytepos);
+	prevbytepos = XLogTakePrevLink(startbytepos);
 
 	*StartPos = XLogBytePosToRecPtr(startbytepos);
 	*EndPos = XLogBytePosToEndRecPtr(endbytepos);
@@ -1105,25 +1264,21 @@ ReserveXLogSwitch(XLogRecPtr *StartPos, XLogRecPtr *EndPos, XLogRecPtr *PrevPtr)
 	uint32		segleft;
 
 	/*
-	 * These calculations are a bit heavy-weight to be done while holding a
-	 * spinlock, but since we're holding all the WAL insertion locks, there
-	 * are no other inserters competing for it. GetXLogInsertRecPtr() does
-	 * compete for it, but that's not called very frequently.
+	 * Since we're holding all the WAL insertion locks, there are no other
+	 * inserters competing with us, so we can just read CurrBytePos and set
+	 * it afterwards.
 	 */
-	SpinLockAcquire(&Insert->insertpos_lck);
-
-	startbytepos = Insert->CurrBytePos;
+	Assert(holdingAllLocks);
+	startbytepos = pg_atomic_read_u64(&Insert->CurrBytePos);
 
 	ptr = XLogBytePosToEndRecPtr(startbytepos);
 	if (XLogSegmentOffset(ptr, wal_segment_size) == 0)
 	{
-		SpinLockRelease(&Insert->insertpos_lck);
 		*EndPos = *StartPos = ptr;
 		return false;
 	}
 
 	endbytepos = startbytepos + size;
-	prevbytepos = Insert->PrevBytePos;
 
 	*StartPos = XLogBytePosToRecPtr(startbytepos);
 	*EndPos = XLogBytePosToEndRecPtr(endbytepos);
@@ -1135,10 +1290,10 @@ ReserveXLogSwitch(XLogRecPtr *StartPos, XLogRecPtr *EndPos, XLogRecPtr *PrevPtr)
 		*EndPos += segleft;
 		endbytepos = XLogRecPtrToBytePos(*EndPos);
 	}
-	Insert->CurrBytePos = endbytepos;
-	Insert->PrevBytePos = startbytepos;
+	pg_atomic_write_u64(&Insert->CurrBytePos, endbytepos);
 
-	SpinLockRelease(&Insert->insertpos_lck);
+	XLogPutPrevLink(endbytepos, startbytepos);
+	prevbytepos = XLogTakePrevLink(startbytepos);
 
 	*PrevPtr = XLogBytePosToRecPtr(prevbytepos);
 
@@ -1317,7 +1472,7 @@ WALInsertLockAcquire(void)
 	static int	lockToTry = -1;
 
 	if (lockToTry == -1)
-		lockToTry = MyProc->pgprocno % NUM_XLOGINSERT_LOCKS;
+		lockToTry = MyProc->pgprocno % wal_insert_locks;
 	MyLockNo = lockToTry;
 
 	/*
@@ -1335,7 +1490,7 @@ WALInsertLockAcquire(void)
 		 * than locks, it still helps to distribute the inserters evenly
 		 * across the locks.
 		 */
-		lockToTry = (lockToTry + 1) % NUM_XLOGINSERT_LOCKS;
+		lockToTry = (lockToTry + 1) % wal_insert_locks;
 	}
 }
 
@@ -1353,7 +1508,7 @@ WALInsertLockAcquireExclusive(void)
 	 * indicator is set to 0xFFFFFFFFFFFFFFFF, which is higher than any real
 	 * XLogRecPtr value, to make sure that no-one blocks waiting on those.
 	 */
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS - 1; i++)
+	for (i = 0; i < wal_insert_locks - 1; i++)
 	{
 		LWLockAcquire(&WALInsertLocks[i].l.lock, LW_EXCLUSIVE);
 		LWLockUpdateVar(&WALInsertLocks[i].l.lock,
@@ -1379,7 +1534,7 @@ WALInsertLockRelease(void)
 	{
 		int			i;
 
-		for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+		for (i = 0; i < wal_insert_locks; i++)
 			LWLockReleaseClearVar(&WALInsertLocks[i].l.lock,
 								  &WALInsertLocks[i].l.insertingAt,
 								  0);
@@ -1407,8 +1562,8 @@ WALInsertLockUpdateInsertingAt(XLogRecPtr insertingAt)
 		 * We use the last lock to mark our actual position, see comments in
 		 * WALInsertLockAcquireExclusive.
 		 */
-		LWLockUpdateVar(&WALInsertLocks[NUM_XLOGINSERT_LOCKS - 1].l.lock,
-						&WALInsertLocks[NUM_XLOGINSERT_LOCKS - 1].l.insertingAt,
+		LWLockUpdateVar(&WALInsertLocks[wal_insert_locks - 1].l.lock,
+						&WALInsertLocks[wal_insert_locks - 1].l.insertingAt,
 						insertingAt);
 	}
 	else
@@ -1437,16 +1592,24 @@ WaitXLogInsertionsToFinish(XLogRecPtr upto)
 	uint64		bytepos;
 	XLogRecPtr	reservedUpto;
 	XLogRecPtr	finishedUpto;
+	XLogRecPtr	inserted;
 	XLogCtlInsert *Insert = &XLogCtl->Insert;
 	int			i;
 
 	if (MyProc == NULL)
 		elog(PANIC, "cannot wait without a PGPROC structure");
 
+	/*
+	 * Check if there's any work to do.  With many insertion locks, scanning
+	 * them all is not free, and often someone else has already established
+	 * that everything up to 'upto' has been inserted.
+	 */
+	inserted = pg_atomic_read_u64(&XLogCtl->logInsertResult);
+	if (upto <= inserted)
+		return inserted;
+
 	/* Read the current insert position */
-	SpinLockAcquire(&Insert->insertpos_lck);
-	bytepos = Insert->CurrBytePos;
-	SpinLockRelease(&Insert->insertpos_lck);
+	bytepos = pg_atomic_read_u64(&Insert->CurrBytePos);
 	reservedUpto = XLogBytePosToEndRecPtr(bytepos);
 
 	/*
@@ -1475,7 +1638,7 @@ WaitXLogInsertionsToFinish(XLogRecPtr upto)
 	 * out for any insertion that's still in progress.
 	 */
 	finishedUpto = reservedUpto;
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+	for (i = 0; i < wal_insert_locks; i++)
 	{
 		XLogRecPtr	insertingat = InvalidXLogRecPtr;
 
@@ -1511,6 +1674,15 @@ WaitXLogInsertionsToFinish(XLogRecPtr upto)
 		if (insertingat != InvalidXLogRecPtr && insertingat < finishedUpto)
 			finishedUpto = insertingat;
 	}
+
+	/* Advance the shared watermark, unless someone else got further. */
+	while (inserted < finishedUpto)
+	{
+		if (pg_atomic_compare_exchange_u64(&XLogCtl->logInsertResult,
+										   &inserted, finishedUpto))
+			break;
+	}
+
 	return finishedUpto;
 }
 
@@ -1577,7 +1749,7 @@ GetXLogBuffer(XLogRecPtr ptr, TimeLineID tli)
 	expectedEndPtr = ptr;
 	expectedEndPtr += XLOG_BLCKSZ - ptr % XLOG_BLCKSZ;
 
-	endptr = XLogCtl->xlblocks[idx];
+	endptr = pg_atomic_read_u64(&XLogCtl->xlblocks[idx]);
 	if (expectedEndPtr != endptr)
 	{
 		XLogRecPtr	initializedUpto;
@@ -1608,7 +1780,7 @@ GetXLogBuffer(XLogRecPtr ptr, TimeLineID tli)
 		WALInsertLockUpdateInsertingAt(initializedUpto);
 
 		AdvanceXLInsertBuffer(ptr, tli, false);
-		endptr = XLogCtl->xlblocks[idx];
+		endptr = pg_atomic_read_u64(&XLogCtl->xlblocks[idx]);
 
 		if (expectedEndPtr != endptr)
 			elog(PANIC, "could not find WAL buffer for %X/%X",
@@ -1636,6 +1808,75 @@ GetXLogBuffer(XLogRecPtr ptr, TimeLineID tli)
 	return cachedPos + ptr % XLOG_BLCKSZ;
 }
 
+/*
+ * Read WAL directly from the WAL buffers, if it's still there.
+ *
+ * Copies up to 'count' bytes starting at 'startptr' into 'dstbuf', stopping
+ * at the first page that is no longer (or not yet) in the buffers, and
+ * returns the number of bytes copied.  The caller must read the remainder
+ * from the WAL files.  Nothing is returned during recovery, or when the
+ * requested timeline isn't the one being inserted into, because the buffers
+ * only hold WAL generated on this timeline.
+ *
+ * The caller must not ask for WAL beyond what has been flushed, so that the
+ * requested bytes are no longer being modified by inserters.
+ *
+ * No lock is taken.  For each page, we check xlblocks before and after
+ * copying the data; AdvanceXLInsertBuffer() invalidates a buffer's xlblocks
+ * entry before reinitializing it for a new page, so if the entry is the same
+ * afterwards, the copy wasn't disturbed.
+ */
+Size
+WALReadFromBuffers(char *dstbuf, XLogRecPtr startptr, Size count,
+				   TimeLineID tli)
+{
+	char	   *pdst = dstbuf;
+	XLogRecPtr	recptr = startptr;
+	Size		nbytes = count;
+
+	if (RecoveryInProgress() || tli != GetWALInsertionTimeLine())
+		return 0;
+
+	Assert(!XLogRecPtrIsInvalid(startptr));
+
+	while (nbytes > 0)
+	{
+		XLogRecPtr	expectedEndPtr;
+		XLogRecPtr	endptr;
+		int			idx;
+		char	   *page;
+		Size		off;
+		Size		nread;
+
+		idx = XLogRecPtrToBufIdx(recptr);
+		expectedEndPtr = recptr + (XLOG_BLCKSZ - recptr % XLOG_BLCKSZ);
+
+		endptr = pg_atomic_read_u64(&XLogCtl->xlblocks[idx]);
+		if (expectedEndPtr != endptr)
+			break;
+
+		/* Don't read the page before we've checked that it's the right one. */
+		pg_read_barrier();
+
+		page = XLogCtl->pages + idx * (Size) XLOG_BLCKSZ;
+		off = recptr % XLOG_BLCKSZ;
+		nread = Min(nbytes, XLOG_BLCKSZ - off);
+		memcpy(pdst, page + off, nread);
+
+		/* Recheck, in case the buffer was recycled while we were copying. */
+		pg_read_barrier();
+		endptr = pg_atomic_read_u64(&XLogCtl->xlblocks[idx]);
+		if (expectedEndPtr != endptr)
+			break;
+
+		pdst += nread;
+		recptr += nread;
+		nbytes -= nread;
+	}
+
+	return count - nbytes;
+}
+
 /*
  * Converts a "usable byte position" to XLogRecPtr. A usable byte position
  * is the position starting from the beginning of WAL, excluding all WAL
@@ -1795,7 +2036,7 @@ AdvanceXLInsertBuffer(XLogRecPtr upto, TimeLineID tli, bool opportunistic)
 		 * be zero if the buffer hasn't been used yet).  Fall through if it's
 		 * already written out.
 		 */
-		OldPageRqstPtr = XLogCtl->xlblocks[nextidx];
+		OldPageRqstPtr = pg_atomic_read_u64(&XLogCtl->xlblocks[nextidx]);
 		if (LogwrtResult.Write < OldPageRqstPtr)
 		{
 			/*
@@ -1864,6 +2105,14 @@ AdvanceXLInsertBuffer(XLogRecPtr upto, TimeLineID tli, bool opportunistic)
 
 		NewPage = (XLogPageHeader) (XLogCtl->pages + nextidx * (Size) XLOG_BLCKSZ);
 
+		/*
+		 * Mark the buffer invalid before reinitializing it, so that a
+		 * concurrent WALReadFromBuffers() can't mistake a partially zeroed
+		 * page for the old one.
+		 */
+		pg_atomic_write_u64(&XLogCtl->xlblocks[nextidx], InvalidXLogRecPtr);
+		pg_write_barrier();
+
 		/*
 		 * Be sure to re-zero the buffer so that bytes beyond what we've
 		 * written will look like zeroes and not valid XLOG records...
@@ -1917,7 +2166,7 @@ AdvanceXLInsertBuffer(XLogRecPtr upto, TimeLineID tli, bool opportunistic)
 		 */
 		pg_write_barrier();
 
-		*((volatile XLogRecPtr *) &XLogCtl->xlblocks[nextidx]) = NewPageEndPtr;
+		pg_atomic_write_u64(&XLogCtl->xlblocks[nextidx], NewPageEndPtr);
 
 		XLogCtl->InitializedUpTo = NewPageEndPtr;
 
@@ -2105,7 +2354,7 @@ XLogWrite(XLogwrtRqst WriteRqst, TimeLineID tli, bool flexible)
 		 * if we're passed a bogus WriteRqst.Write that is past the end of the
 		 * last page that's been initialized by AdvanceXLInsertBuffer.
 		 */
-		XLogRecPtr	EndPtr = XLogCtl->xlblocks[curridx];
+		XLogRecPtr	EndPtr = pg_atomic_read_u64(&XLogCtl->xlblocks[curridx]);
 
 		if (LogwrtResult.Write >= EndPtr)
 			elog(PANIC, "xlog write request %X/%X is past end of log %X/%X",
@@ -2441,9 +2690,11 @@ UpdateMinRecoveryPoint(XLogRecPtr lsn, bool force)
 	 * process as it should not update its own reference of minRecoveryPoint
 	 * until it has finished crash recovery to make sure that all WAL
 	 * available is replayed in this case.  This also saves from extra locks
-	 * taken on the control file from the startup process.
+	 * taken on the control file from the startup process.  (Parallel redo
+	 * workers set InRecovery too, but never loaded minRecoveryPoint.)
 	 */
-	if (XLogRecPtrIsInvalid(LocalMinRecoveryPoint) && InRecovery)
+	if (XLogRecPtrIsInvalid(LocalMinRecoveryPoint) && InRecovery &&
+		!IsBackgroundWorker)
 	{
 		updateMinRecoveryPoint = false;
 		return;
@@ -2508,8 +2759,6 @@ UpdateMinRecoveryPoint(XLogRecPtr lsn, bool force)
 void
 XLogFlush(XLogRecPtr record)
 {
-	XLogRecPtr	WriteRqstPtr;
-	XLogwrtRqst WriteRqst;
 	TimeLineID	insertTLI = XLogCtl->InsertTimeLineID;
 
 	/*
@@ -2539,6 +2788,275 @@ XLogFlush(XLogRecPtr record)
 
 	START_CRIT_SECTION();
 
+	/*
+	 * Normally we join a group of backends that all need WAL flushed, and let
+	 * one of them do a single write and fsync for everyone.  Processes
+	 * without a PGPROC can't take part, and compete for WALWriteLock on their
+	 * own.
+	 */
+	if (MyProc != NULL)
+		XLogFlushGroup(record, insertTLI);
+	else
+		XLogFlushSingle(record, insertTLI);
+
+	END_CRIT_SECTION();
+
+	/* wake up walsenders now that we've released heavily contended locks */
+	WalSndWakeupProcessRequests();
+
+	/*
+	 * If we still haven't flushed to the request point then we have a
+	 * problem; most likely, the requested flush point is past end of XLOG.
+	 * This has been seen to occur when a disk page has a corrupted LSN.
+	 *
+	 * Formerly we treated this as a PANIC condition, but that hurts the
+	 * system's robustness rather than helping it: we do not want to take down
+	 * the whole system due to corruption on one data page.  In particular, if
+	 * the bad page is encountered again during recovery then we would be
+	 * unable to restart the database at all!  (This scenario actually
+	 * happened in the field several times with 7.1 releases.)	As of 8.4, bad
+	 * LSNs encountered during recovery are UpdateMinRecoveryPoint's problem;
+	 * the only time we can reach here during recovery is while flushing the
+	 * end-of-recovery checkpoint record, and we don't expect that to have a
+	 * bad LSN.
+	 *
+	 * Note that for calls from xact.c, the ERROR will be promoted to PANIC
+	 * since xact.c calls this routine inside a critical section.  However,
+	 * calls from bufmgr.c are not within critical sections and so we will not
+	 * force a restart for a bad LSN on a data page.
+	 */
+	if (LogwrtResult.Flush < record)
+		elog(ERROR,
+			 "xlog flush request %X/%X is not satisfied --- flushed only to %X/%X",
+			 LSN_FORMAT_ARGS(record),
+			 LSN_FORMAT_ARGS(LogwrtResult.Flush));
+}
+
+/*
+ * How long should the leader of a WAL flush group wait for more members to
+ * join before flushing?
+ *
+ * commit_delay is the upper limit.  Within it, the leader sleeps for half of
+ * the recent average flush time: a backend that becomes ready to flush in
+ * that window would otherwise have had to wait for our whole flush and then
+ * do one of its own.  That way the delay shrinks by itself on storage with
+ * fast fsyncs, rather than adding a fixed latency to every flush.
+ *
+ * As before, we do not sleep if fsync is off, nor if there are fewer than
+ * CommitSiblings other backends with active transactions.
+ */
+static int
+XLogFlushGroupDelay(void)
+{
+	uint32		avgFlushUsec;
+
+	if (CommitDelay <= 0 || !enableFsync ||
+		!MinimumActiveBackends(CommitSiblings))
+		return 0;
+
+	/* Until we have seen a flush, use the configured delay */
+	avgFlushUsec = pg_atomic_read_u32(&XLogCtl->avgFlushUsec);
+	if (avgFlushUsec == 0)
+		return CommitDelay;
+
+	return Min(CommitDelay, avgFlushUsec / 2);
+}
+
+/*
+ * Flush WAL up to 'record' as a member of a flush group.
+ *
+ * Backends that need WAL flushed add themselves to a list.  The first one to
+ * arrive becomes the group leader: it sleeps for a moment to let others join
+ * (see XLogFlushGroupDelay()), takes over the whole list, performs a single
+ * write and fsync far enough to satisfy every member, and then wakes them
+ * all up.  This is the same scheme ProcArrayGroupClearXid() uses.
+ *
+ * Caller must be in a critical section, so that an error in the leader
+ * becomes a PANIC rather than leaving the followers waiting forever.
+ */
+static void
+XLogFlushGroup(XLogRecPtr record, TimeLineID insertTLI)
+{
+	PROC_HDR   *procglobal = ProcGlobal;
+	PGPROC	   *proc = MyProc;
+	uint32		nextidx;
+	uint32		wakeidx;
+	int			delay;
+	XLogRecPtr	groupRqstPtr;
+	XLogRecPtr	WriteRqstPtr;
+
+	/* Add ourselves to the list of processes needing a WAL flush. */
+	proc->walFlushGroupMember = true;
+	proc->walFlushGroupMemberLsn = record;
+	nextidx = pg_atomic_read_u32(&procglobal->walFlushGroupFirst);
+	while (true)
+	{
+		pg_atomic_write_u32(&proc->walFlushGroupNext, nextidx);
+
+		if (pg_atomic_compare_exchange_u32(&procglobal->walFlushGroupFirst,
+										   &nextidx,
+										   (uint32) proc->pgprocno))
+			break;
+	}
+
+	/*
+	 * If the list was not empty, the leader will flush for us.  It is
+	 * impossible to have followers without a leader because the first
+	 * process that has added itself to the list will always have nextidx as
+	 * INVALID_PGPROCNO.
+	 */
+	if (nextidx != INVALID_PGPROCNO)
+	{
+		int			extraWaits = 0;
+
+		/* Sleep until the leader has flushed our WAL. */
+		pgstat_report_wait_start(WAIT_EVENT_WAL_FLUSH_GROUP);
+		for (;;)
+		{
+			/* acts as a read barrier */
+			PGSemaphoreLock(proc->sem);
+			if (!proc->walFlushGroupMember)
+				break;
+			extraWaits++;
+		}
+		pgstat_report_wait_end();
+
+		Assert(pg_atomic_read_u32(&proc->walFlushGroupNext) == INVALID_PGPROCNO);
+
+		/* Fix semaphore count for any absorbed wakeups */
+		while (extraWaits-- > 0)
+			PGSemaphoreUnlock(proc->sem);
+
+		/* update local state, so that our caller can check the result */
+		SpinLockAcquire(&XLogCtl->info_lck);
+		LogwrtResult = XLogCtl->LogwrtResult;
+		SpinLockRelease(&XLogCtl->info_lck);
+		return;
+	}
+
+	/*
+	 * We are the leader.  Give other backends a chance to join the group
+	 * before we close it.
+	 */
+	delay = XLogFlushGroupDelay();
+	if (delay > 0)
+		pg_usleep(delay);
+
+	/*
+	 * Detach the whole list, saving a pointer to its head.  Trying to pop
+	 * elements one at a time could lead to an ABA problem.  Backends that
+	 * arrive from now on form the next group, whose leader will queue up
+	 * behind us on WALWriteLock.
+	 */
+	nextidx = pg_atomic_exchange_u32(&procglobal->walFlushGroupFirst,
+									 INVALID_PGPROCNO);
+	wakeidx = nextidx;
+
+	/* Find out how far we need to flush to satisfy everyone. */
+	groupRqstPtr = record;
+	while (nextidx != INVALID_PGPROCNO)
+	{
+		PGPROC	   *nextproc = &procglobal->allProcs[nextidx];
+
+		if (groupRqstPtr < nextproc->walFlushGroupMemberLsn)
+			groupRqstPtr = nextproc->walFlushGroupMemberLsn;
+
+		nextidx = pg_atomic_read_u32(&nextproc->walFlushGroupNext);
+	}
+
+	/*
+	 * Since fsync is usually a horribly expensive operation, we try to
+	 * piggyback as much data as we can on each fsync, just like
+	 * XLogFlushSingle() does.
+	 */
+	WriteRqstPtr = groupRqstPtr;
+	SpinLockAcquire(&XLogCtl->info_lck);
+	if (WriteRqstPtr < XLogCtl->LogwrtRqst.Write)
+		WriteRqstPtr = XLogCtl->LogwrtRqst.Write;
+	LogwrtResult = XLogCtl->LogwrtResult;
+	SpinLockRelease(&XLogCtl->info_lck);
+
+	if (groupRqstPtr > LogwrtResult.Flush)
+	{
+		XLogRecPtr	insertpos;
+
+		/*
+		 * Wait for in-flight insertions to the pages we're about to write to
+		 * finish.  This must be done before acquiring WALWriteLock, since an
+		 * in-progress insertion might need that lock to make progress.
+		 */
+		insertpos = WaitXLogInsertionsToFinish(WriteRqstPtr);
+
+		LWLockAcquire(WALWriteLock, LW_EXCLUSIVE);
+
+		/* recheck, the previous group's leader may have done it for us */
+		LogwrtResult = XLogCtl->LogwrtResult;
+		if (groupRqstPtr > LogwrtResult.Flush)
+		{
+			XLogwrtRqst WriteRqst;
+			instr_time	start;
+			instr_time	duration;
+			uint64		elapsed;
+			uint32		avgFlushUsec;
+
+			WriteRqst.Write = insertpos;
+			WriteRqst.Flush = insertpos;
+
+			INSTR_TIME_SET_CURRENT(start);
+			XLogWrite(WriteRqst, insertTLI, false);
+			INSTR_TIME_SET_CURRENT(duration);
+			INSTR_TIME_SUBTRACT(duration, start);
+
+			/*
+			 * Fold the time taken into the moving average, giving it a weight
+			 * of 1/8.  We hold WALWriteLock, so nobody else updates it
+			 * concurrently.
+			 */
+			elapsed = Min(INSTR_TIME_GET_MICROSEC(duration), PG_INT32_MAX);
+			avgFlushUsec = pg_atomic_read_u32(&XLogCtl->avgFlushUsec);
+			if (avgFlushUsec == 0)
+				avgFlushUsec = Max(elapsed, 1);
+			else
+				avgFlushUsec = Max(((uint64) avgFlushUsec * 7 + elapsed) / 8, 1);
+			pg_atomic_write_u32(&XLogCtl->avgFlushUsec, avgFlushUsec);
+		}
+
+		LWLockRelease(WALWriteLock);
+	}
+
+	/*
+	 * Now that we've released the lock, go back and wake everybody up.  We
+	 * don't do this under the lock so as to keep lock hold times to a
+	 * minimum.
+	 */
+	while (wakeidx != INVALID_PGPROCNO)
+	{
+		PGPROC	   *nextproc = &procglobal->allProcs[wakeidx];
+
+		wakeidx = pg_atomic_read_u32(&nextproc->walFlushGroupNext);
+		pg_atomic_write_u32(&nextproc->walFlushGroupNext, INVALID_PGPROCNO);
+
+		/* ensure all previous writes are visible before follower continues. */
+		pg_write_barrier();
+
+		nextproc->walFlushGroupMember = false;
+
+		if (nextproc != proc)
+			PGSemaphoreUnlock(nextproc->sem);
+	}
+}
+
+/*
+ * Flush WAL up to 'record' without the help of a flush group.
+ *
+ * Caller must be in a critical section.
+ */
+static void
+XLogFlushSingle(XLogRecPtr record, TimeLineID insertTLI)
+{
+	XLogRecPtr	WriteRqstPtr;
+	XLogwrtRqst WriteRqst;
+
 	/*
 	 * Since fsync is usually a horribly expensive operation, we try to
 	 * piggyback as much data as we can on each fsync: if we see any more data
@@ -2637,38 +3155,6 @@ XLogFlush(XLogRecPtr record)
 		/* done */
 		break;
 	}
-
-	END_CRIT_SECTION();
-
-	/* wake up walsenders now that we've released heavily contended locks */
-	WalSndWakeupProcessRequests();
-
-	/*
-	 * If we still haven't flushed to the request point then we have a
-	 * problem; most likely, the requested flush point is past end of XLOG.
-	 * This has been seen to occur when a disk page has a corrupted LSN.
-	 *
-	 * Formerly we treated this as a PANIC condition, but that hurts the
-	 * system's robustness rather than helping it: we do not want to take down
-	 * the whole system due to corruption on one data page.  In particular, if
-	 * the bad page is encountered again during recovery then we would be
-	 * unable to restart the database at all!  (This scenario actually
-	 * happened in the field several times with 7.1 releases.)	As of 8.4, bad
-	 * LSNs encountered during recovery are UpdateMinRecoveryPoint's problem;
-	 * the only time we can reach here during recovery is while flushing the
-	 * end-of-recovery checkpoint record, and we don't expect that to have a
-	 * bad LSN.
-	 *
-	 * Note that for calls from xact.c, the ERROR will be promoted to PANIC
-	 * since xact.c calls this routine inside a critical section.  However,
-	 * calls from bufmgr.c are not within critical sections and so we will not
-	 * force a restart for a bad LSN on a data page.
-	 */
-	if (LogwrtResult.Flush < record)
-		elog(ERROR,
-			 "xlog flush request %X/%X is not satisfied --- flushed only to %X/%X",
-			 LSN_FORMAT_ARGS(record),
-			 LSN_FORMAT_ARGS(LogwrtResult.Flush));
 }
 
 /*
@@ -2852,7 +3338,8 @@ XLogNeedsFlush(XLogRecPtr record)
 		 * which cannot update its local copy of minRecoveryPoint as long as
 		 * it has not replayed all WAL available when doing crash recovery.
 		 */
-		if (XLogRecPtrIsInvalid(LocalMinRecoveryPoint) && InRecovery)
+		if (XLogRecPtrIsInvalid(LocalMinRecoveryPoint) && InRecovery &&
+			!IsBackgroundWorker)
 			updateMinRecoveryPoint = false;
 
 		/* Quick exit if already known to be updated or cannot be updated */
@@ -2923,6 +3410,7 @@ XLogFileInitInternal(XLogSegNo logsegno, TimeLineID logtli,
 	XLogSegNo	max_segno;
 	int			fd;
 	int			save_errno;
+	int			open_flags;
 
 	Assert(logtli != 0);
 
@@ -2956,7 +3444,10 @@ XLogFileInitInternal(XLogSegNo logsegno, TimeLineID logtli,
 	unlink(tmppath);
 
 	/* do not use get_sync_bit() here --- want to fsync only at end of fill */
-	fd = BasicOpenFile(tmppath, O_RDWR | O_CREAT | O_EXCL | PG_BINARY);
+	open_flags = O_RDWR | O_CREAT | O_EXCL | PG_BINARY;
+	if (io_direct_flags & IO_DIRECT_WAL_INIT)
+		open_flags |= PG_O_DIRECT;
+	fd = BasicOpenFile(tmppath, open_flags);
 	if (fd < 0)
 		ereport(ERROR,
 				(errcode_for_file_access(),
@@ -3008,10 +3499,13 @@ XLogFileInitInternal(XLogSegNo logsegno, TimeLineID logtli,
 	{
 		/*
 		 * Otherwise, seeking to the end and writing a solitary byte is
-		 * enough.
+		 * enough.  Direct I/O can't write a single byte, though, so write
+		 * the whole last page in that case.
 		 */
+		int			nbytes = (open_flags & PG_O_DIRECT) ? XLOG_BLCKSZ : 1;
+
 		errno = 0;
-		if (pg_pwrite(fd, zbuffer.data, 1, wal_segment_size - 1) != 1)
+		if (pg_pwrite(fd, zbuffer.data, nbytes, wal_segment_size - nbytes) != nbytes)
 		{
 			/* if write didn't set errno, assume no disk space */
 			save_errno = errno ? errno : ENOSPC;
@@ -3374,7 +3868,7 @@ XLogFileClose(void)
 	 * use the cache to read the WAL segment.
 	 */
 #if defined(USE_POSIX_FADVISE) && defined(POSIX_FADV_DONTNEED)
-	if (!XLogIsNeeded())
+	if (!XLogIsNeeded() && (io_direct_flags & IO_DIRECT_WAL) == 0)
 		(void) posix_fadvise(openLogFile, 0, 0, POSIX_FADV_DONTNEED);
 #endif
 
@@ -3899,6 +4393,7 @@ InitControlFile(uint64 sysidentifier)
 	ControlFile->wal_level = wal_level;
 	ControlFile->wal_log_hints = wal_log_hints;
 	ControlFile->track_commit_timestamp = track_commit_timestamp;
+	ControlFile->double_write = (double_write_buffers > 0);
 	ControlFile->data_checksum_version = bootstrap_data_checksum_version;
 }
 
@@ -4275,6 +4770,46 @@ XLOGChooseNumBuffers(void)
 	return xbuffers;
 }
 
+/*
+ * Auto-tune the number of WAL insertion locks.
+ *
+ * Insertions can only proceed in parallel up to the number of CPUs, so use
+ * about one lock per CPU, rounded up to a power of 2 to spread backends
+ * evenly over them, but at least the 8 locks we used to have hardwired and
+ * at most MAX_AUTO_XLOGINSERT_LOCKS, since flushing WAL has to check all of
+ * them.
+ */
+static int
+XLOGChooseNumInsertLocks(void)
+{
+	int			ncpus = 0;
+
+#if defined(WIN32)
+	SYSTEM_INFO sysinfo;
+
+	GetSystemInfo(&sysinfo);
+	ncpus = (int) sysinfo.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+	ncpus = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+	if (ncpus <= MIN_AUTO_XLOGINSERT_LOCKS)
+		return MIN_AUTO_XLOGINSERT_LOCKS;
+	if (ncpus >= MAX_AUTO_XLOGINSERT_LOCKS)
+		return MAX_AUTO_XLOGINSERT_LOCKS;
+	return (int) pg_nextpower2_32((uint32) ncpus);
+}
+
+/*
+ * Size of the prev-link hash table: a power of 2 comfortably larger than
+ * the number of insertion locks, see XLogPrevLink.
+ */
+static int
+XLOGNumPrevLinks(void)
+{
+	return (int) pg_nextpower2_32((uint32) wal_insert_locks * 4);
+}
+
 /*
  * GUC check_hook for wal_buffers
  */
@@ -4310,6 +4845,33 @@ check_wal_buffers(int *newval, void **extra, GucSource source)
 	return true;
 }
 
+/*
+ * GUC check_hook for wal_insert_locks
+ */
+bool
+check_wal_insert_locks(int *newval, void **extra, GucSource source)
+{
+	/*
+	 * -1 indicates a request for auto-tune.  If we haven't yet changed the
+	 * boot_val default of -1, just let it be; XLOGShmemSize will fix it.
+	 * Otherwise, substitute the auto-tune value.
+	 */
+	if (*newval == -1)
+	{
+		if (wal_insert_locks == -1)
+			return true;
+		*newval = XLOGChooseNumInsertLocks();
+	}
+
+	if (*newval == 0)
+	{
+		GUC_check_errdetail("\"wal_insert_locks\" must be -1 or positive.");
+		return false;
+	}
+
+	return true;
+}
+
 /*
  * Read the control file, set respective GUCs.
  *
@@ -4362,13 +4924,29 @@ XLOGShmemSize(void)
 	}
 	Assert(XLOGbuffers > 0);
 
+	/* Likewise for wal_insert_locks, which depends only on the machine. */
+	if (wal_insert_locks == -1)
+	{
+		char		buf[32];
+
+		snprintf(buf, sizeof(buf), "%d", XLOGChooseNumInsertLocks());
+		SetConfigOption("wal_insert_locks", buf, PGC_POSTMASTER,
+						PGC_S_DYNAMIC_DEFAULT);
+		if (wal_insert_locks == -1) /* failed to apply it? */
+			SetConfigOption("wal_insert_locks", buf, PGC_POSTMASTER,
+							PGC_S_OVERRIDE);
+	}
+	Assert(wal_insert_locks > 0);
+
 	/* XLogCtl */
 	size = sizeof(XLogCtlData);
 
 	/* WAL insertion locks, plus alignment */
-	size = add_size(size, mul_size(sizeof(WALInsertLockPadded), NUM_XLOGINSERT_LOCKS + 1));
+	size = add_size(size, mul_size(sizeof(WALInsertLockPadded), wal_insert_locks + 1));
+	/* prev-link hash table */
+	size = add_size(size, mul_size(sizeof(XLogPrevLink), XLOGNumPrevLinks()));
 	/* xlblocks array */
-	size = add_size(size, mul_size(sizeof(XLogRecPtr), XLOGbuffers));
+	size = add_size(size, mul_size(sizeof(pg_atomic_uint64), XLOGbuffers));
 	/* extra alignment padding for XLOG I/O buffers */
 	size = add_size(size, XLOG_BLCKSZ);
 	/* and the buffers themselves */
@@ -4446,9 +5024,11 @@ XLOGShmemInit(void)
 	 * needed here.
 	 */
 	allocptr = ((char *) XLogCtl) + sizeof(XLogCtlData);
-	XLogCtl->xlblocks = (XLogRecPtr *) allocptr;
-	memset(XLogCtl->xlblocks, 0, sizeof(XLogRecPtr) * XLOGbuffers);
-	allocptr += sizeof(XLogRecPtr) * XLOGbuffers;
+	XLogCtl->xlblocks = (pg_atomic_uint64 *) allocptr;
+	allocptr += sizeof(pg_atomic_uint64) * XLOGbuffers;
+
+	for (i = 0; i < XLOGbuffers; i++)
+		pg_atomic_init_u64(&XLogCtl->xlblocks[i], InvalidXLogRecPtr);
 
 
 	/* WAL insertion locks. Ensure they're aligned to the full padded size */
@@ -4456,15 +5036,27 @@ XLOGShmemInit(void)
 		((uintptr_t) allocptr) % sizeof(WALInsertLockPadded);
 	WALInsertLocks = XLogCtl->Insert.WALInsertLocks =
 		(WALInsertLockPadded *) allocptr;
-	allocptr += sizeof(WALInsertLockPadded) * NUM_XLOGINSERT_LOCKS;
+	allocptr += sizeof(WALInsertLockPadded) * wal_insert_locks;
 
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+	for (i = 0; i < wal_insert_locks; i++)
 	{
 		LWLockInitialize(&WALInsertLocks[i].l.lock, LWTRANCHE_WAL_INSERT);
 		WALInsertLocks[i].l.insertingAt = InvalidXLogRecPtr;
 		WALInsertLocks[i].l.lastImportantAt = InvalidXLogRecPtr;
 	}
 
+	/* prev-link hash table, empty to begin with */
+	XLogCtl->Insert.PrevLinks = (XLogPrevLink *) allocptr;
+	XLogCtl->Insert.NumPrevLinks = XLOGNumPrevLinks();
+	allocptr += sizeof(XLogPrevLink) * XLogCtl->Insert.NumPrevLinks;
+	for (i = 0; i < XLogCtl->Insert.NumPrevLinks; i++)
+	{
+		pg_atomic_init_u64(&XLogCtl->Insert.PrevLinks[i].endpos,
+						   XLOG_PREV_LINK_EMPTY);
+		pg_atomic_init_u64(&XLogCtl->Insert.PrevLinks[i].prevpos,
+						   XLOG_PREV_LINK_EMPTY);
+	}
+
 	/*
 	 * Align the start of the page buffers to a full xlog block size boundary.
 	 * This simplifies some calculations in XLOG insertion. It is also
@@ -4483,7 +5075,9 @@ XLOGShmemInit(void)
 	XLogCtl->InstallXLogFileSegmentActive = false;
 	XLogCtl->WalWriterSleeping = false;
 
-	SpinLockInit(&XLogCtl->Insert.insertpos_lck);
+	pg_atomic_init_u64(&XLogCtl->Insert.CurrBytePos, 0);
+	pg_atomic_init_u64(&XLogCtl->logInsertResult, InvalidXLogRecPtr);
+	pg_atomic_init_u32(&XLogCtl->avgFlushUsec, 0);
 	SpinLockInit(&XLogCtl->info_lck);
 	SpinLockInit(&XLogCtl->ulsn_lck);
 }
@@ -4854,6 +5448,21 @@ CheckRequiredParameterValues(void)
 				 errhint("Use a backup taken after setting wal_level to higher than minimal.")));
 	}
 
+	/*
+	 * WAL generated with the double-write buffer enabled has no full-page
+	 * images, except during backups.  Pages torn by a crash of this server
+	 * during archive recovery can then only be repaired from its own
+	 * double-write buffer, so it must have one as well.
+	 */
+	if (ArchiveRecoveryRequested && ControlFile->double_write &&
+		double_write_buffers == 0)
+	{
+		ereport(FATAL,
+				(errmsg("WAL was generated with double_write_buffers enabled, cannot recover without it"),
+				 errdetail("Such WAL contains no full-page images to repair torn pages with."),
+				 errhint("Set double_write_buffers to a nonzero value on this server.")));
+	}
+
 	/*
 	 * For Hot Standby, the WAL must be generated with 'replica' mode, and we
 	 * must have at least as many backend slots as the primary.
@@ -5011,6 +5620,12 @@ StartupXLOG(void)
 	else
 		didCrash = false;
 
+	/*
+	 * Repair any torn pages from the double-write buffer before WAL replay
+	 * sees them, and set it up for this run.
+	 */
+	DoubleWriteStartup(didCrash);
+
 	/*
 	 * Prepare for WAL recovery if needed.
 	 *
@@ -5468,8 +6083,9 @@ StartupXLOG(void)
 	 * previous incarnation.
 	 */
 	Insert = &XLogCtl->Insert;
-	Insert->PrevBytePos = XLogRecPtrToBytePos(endOfRecoveryInfo->lastRec);
-	Insert->CurrBytePos = XLogRecPtrToBytePos(EndOfLog);
+	pg_atomic_write_u64(&Insert->CurrBytePos, XLogRecPtrToBytePos(EndOfLog));
+	XLogPutPrevLink(XLogRecPtrToBytePos(EndOfLog),
+					XLogRecPtrToBytePos(endOfRecoveryInfo->lastRec));
 
 	/*
 	 * Tricky point here: lastPage contains the *last* block that the LastRec
@@ -5491,7 +6107,8 @@ StartupXLOG(void)
 		memcpy(page, endOfRecoveryInfo->lastPage, len);
 		memset(page + len, 0, XLOG_BLCKSZ - len);
 
-		XLogCtl->xlblocks[firstIdx] = endOfRecoveryInfo->lastPageBeginPtr + XLOG_BLCKSZ;
+		pg_atomic_write_u64(&XLogCtl->xlblocks[firstIdx],
+							endOfRecoveryInfo->lastPageBeginPtr + XLOG_BLCKSZ);
 		XLogCtl->InitializedUpTo = endOfRecoveryInfo->lastPageBeginPtr + XLOG_BLCKSZ;
 	}
 	else
@@ -5983,7 +6600,7 @@ GetLastImportantRecPtr(void)
 	XLogRecPtr	res = InvalidXLogRecPtr;
 	int			i;
 
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+	for (i = 0; i < wal_insert_locks; i++)
 	{
 		XLogRecPtr	last_important;
 
@@ -6374,7 +6991,7 @@ CreateCheckPoint(int flags)
 	 * determine the checkpoint REDO pointer.
 	 */
 	WALInsertLockAcquireExclusive();
-	curInsert = XLogBytePosToRecPtr(Insert->CurrBytePos);
+	curInsert = XLogBytePosToRecPtr(pg_atomic_read_u64(&Insert->CurrBytePos));
 
 	/*
 	 * If this isn't a shutdown or forced checkpoint, and if there has been no
@@ -6452,6 +7069,15 @@ CreateCheckPoint(int flags)
 	XLogCtl->RedoRecPtr = checkPoint.redo;
 	SpinLockRelease(&XLogCtl->info_lck);
 
+	/*
+	 * Log the WAL compression dictionaries again, so that replay starting at
+	 * the new redo pointer knows them.  Backends compress without them until
+	 * then, so do it before anything else.  Dictionaries don't survive a
+	 * shutdown, so there's nothing to do in a shutdown checkpoint.
+	 */
+	if (!shutdown)
+		XLogDictCheckpoint();
+
 	/*
 	 * If enabled, log checkpoint start.  We postpone this until now so as not
 	 * to log anything if we decided to skip the checkpoint.
@@ -6852,6 +7478,8 @@ CreateOverwriteContrecordRecord(XLogRecPtr aborted_lsn, XLogRecPtr pagePtr,
 static void
 CheckPointGuts(XLogRecPtr checkPointRedo, int flags)
 {
+	uint64		dw_horizon;
+
 	CheckPointRelationMap();
 	CheckPointReplicationSlots();
 	CheckPointSnapBuild();
@@ -6868,10 +7496,15 @@ CheckPointGuts(XLogRecPtr checkPointRedo, int flags)
 	CheckPointPredicate();
 	CheckPointBuffers(flags);
 
-	/* Perform all queued up fsyncs */
+	/*
+	 * Perform all queued up fsyncs.  The double-write buffer slots of writes
+	 * that finished before that are no longer needed afterwards.
+	 */
 	TRACE_POSTGRESQL_BUFFER_CHECKPOINT_SYNC_START();
 	CheckpointStats.ckpt_sync_t = GetCurrentTimestamp();
+	dw_horizon = DoubleWriteCheckpointHorizon();
 	ProcessSyncRequests();
+	DoubleWriteCheckpointDone(dw_horizon);
 	CheckpointStats.ckpt_sync_end_t = GetCurrentTimestamp();
 	TRACE_POSTGRESQL_BUFFER_CHECKPOINT_DONE();
 
@@ -7429,7 +8062,8 @@ XLogReportParameters(void)
 		max_wal_senders != ControlFile->max_wal_senders ||
 		max_prepared_xacts != ControlFile->max_prepared_xacts ||
 		max_locks_per_xact != ControlFile->max_locks_per_xact ||
-		track_commit_timestamp != ControlFile->track_commit_timestamp)
+		track_commit_timestamp != ControlFile->track_commit_timestamp ||
+		(double_write_buffers > 0) != ControlFile->double_write)
 	{
 		/*
 		 * The change in number of backend slots doesn't need to be WAL-logged
@@ -7451,6 +8085,7 @@ XLogReportParameters(void)
 			xlrec.wal_level = wal_level;
 			xlrec.wal_log_hints = wal_log_hints;
 			xlrec.track_commit_timestamp = track_commit_timestamp;
+			xlrec.double_write = (double_write_buffers > 0);
 
 			XLogBeginInsert();
 			XLogRegisterData((char *) &xlrec, sizeof(xlrec));
@@ -7469,6 +8104,7 @@ XLogReportParameters(void)
 		ControlFile->wal_level = wal_level;
 		ControlFile->wal_log_hints = wal_log_hints;
 		ControlFile->track_commit_timestamp = track_commit_timestamp;
+		ControlFile->double_write = (double_write_buffers > 0);
 		UpdateControlFile();
 
 		LWLockRelease(ControlFileLock);
@@ -7487,6 +8123,14 @@ UpdateFullPageWrites(void)
 {
 	XLogCtlInsert *Insert = &XLogCtl->Insert;
 	bool		recoveryInProgress;
+	bool		newFullPageWrites;
+
+	/*
+	 * Torn pages are repaired from the double-write buffer if there is one,
+	 * so full-page images aren't needed for that.  They are still taken
+	 * while a backup is running; see XLogInsertRecord().
+	 */
+	newFullPageWrites = fullPageWrites && double_write_buffers == 0;
 
 	/*
 	 * Do nothing if full_page_writes has not been changed.
@@ -7495,7 +8139,7 @@ UpdateFullPageWrites(void)
 	 * because we assume that there is no concurrently running process which
 	 * can update it.
 	 */
-	if (fullPageWrites == Insert->fullPageWrites)
+	if (newFullPageWrites == Insert->fullPageWrites)
 		return;
 
 	/*
@@ -7514,7 +8158,7 @@ UpdateFullPageWrites(void)
 	 * setting it to false, first write the WAL record and then set the global
 	 * flag.
 	 */
-	if (fullPageWrites)
+	if (newFullPageWrites)
 	{
 		WALInsertLockAcquireExclusive();
 		Insert->fullPageWrites = true;
@@ -7528,12 +8172,12 @@ UpdateFullPageWrites(void)
 	if (XLogStandbyInfoActive() && !recoveryInProgress)
 	{
 		XLogBeginInsert();
-		XLogRegisterData((char *) (&fullPageWrites), sizeof(bool));
+		XLogRegisterData((char *) (&newFullPageWrites), sizeof(bool));
 
 		XLogInsert(RM_XLOG_ID, XLOG_FPW_CHANGE);
 	}
 
-	if (!fullPageWrites)
+	if (!newFullPageWrites)
 	{
 		WALInsertLockAcquireExclusive();
 		Insert->fullPageWrites = false;
@@ -7740,6 +8384,10 @@ xlog_redo(XLogReaderState *record)
 	{
 		/* nothing to do here, handled in xlogrecovery_redo() */
 	}
+	else if (info == XLOG_FPI_DICTIONARY)
+	{
+		/* nothing to do here, the WAL reader has remembered it */
+	}
 	else if (info == XLOG_END_OF_RECOVERY)
 	{
 		xl_end_of_recovery xlrec;
@@ -7828,6 +8476,7 @@ xlog_redo(XLogReaderState *record)
 		ControlFile->max_locks_per_xact = xlrec.max_locks_per_xact;
 		ControlFile->wal_level = xlrec.wal_level;
 		ControlFile->wal_log_hints = xlrec.wal_log_hints;
+		ControlFile->double_write = xlrec.double_write;
 
 		/*
 		 * Update minRecoveryPoint to ensure that if recovery is aborted, we
@@ -7893,10 +8542,18 @@ static int
 get_sync_bit(int method)
 {
 	int			o_direct_flag = 0;
+	int			io_direct_flag = 0;
+
+	/*
+	 * Use O_DIRECT whatever the sync method if io_direct asks for it, except
+	 * in walreceiver; see below.
+	 */
+	if ((io_direct_flags & IO_DIRECT_WAL) && !AmWalReceiverProcess())
+		io_direct_flag = o_direct_flag = PG_O_DIRECT;
 
 	/* If fsync is disabled, never open in sync mode */
 	if (!enableFsync)
-		return 0;
+		return io_direct_flag;
 
 	/*
 	 * Optimize writes by bypassing kernel cache with O_DIRECT when using
@@ -7926,7 +8583,7 @@ get_sync_bit(int method)
 		case SYNC_METHOD_FSYNC:
 		case SYNC_METHOD_FSYNC_WRITETHROUGH:
 		case SYNC_METHOD_FDATASYNC:
-			return 0;
+			return io_direct_flag;
 #ifdef OPEN_SYNC_FLAG
 		case SYNC_METHOD_OPEN:
 			return OPEN_SYNC_FLAG | o_direct_flag;
@@ -8825,9 +9482,7 @@ GetXLogInsertRecPtr(void)
 	XLogCtlInsert *Insert = &XLogCtl->Insert;
 	uint64		current_bytepos;
 
-	SpinLockAcquire(&Insert->insertpos_lck);
-	current_bytepos = Insert->CurrBytePos;
-	SpinLockRelease(&Insert->insertpos_lck);
+	current_bytepos = pg_atomic_read_u64(&Insert->CurrBytePos);
 
 	return XLogBytePosToRecPtr(current_bytepos);
 }
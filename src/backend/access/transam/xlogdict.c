@@ -0,0 +1,459 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogdict.c
+ *		Dictionaries for compressing full-page images in WAL.
+ *
+ * Portions Copyright (c) 2022, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *		src/backend/access/transam/xlogdict.c
+ *
+ * A single page image doesn't give zstd much to work with: the tuple
+ * headers, line pointers and page headers that make up much of a heap or
+ * btree page are only repetitive across pages.  With wal_compression = zstd
+ * and wal_compression_dictionary = on, full-page images of heap and btree
+ * pages are therefore compressed with a dictionary trained on earlier images
+ * of the same kind of page.
+ *
+ * Backends that compress full-page images put the first
+ * XLOG_DICT_NUM_SAMPLES of them since the last training into a sample area
+ * in shared memory.  At the start of each checkpoint, the checkpointer trains
+ * a new dictionary from a full sample area, and then logs the dictionary in
+ * an XLOG_FPI_DICTIONARY record.  WAL readers remember the dictionaries they
+ * see, and images compressed with one refer to it by ID.
+ *
+ * Replay can start at any checkpoint's redo pointer, so an image may only be
+ * compressed with a dictionary that was logged after the redo pointer in
+ * effect when the image is inserted.  The checkpointer logs the dictionaries
+ * again right after establishing each new redo pointer, and until it has
+ * done so, backends fall back to compressing without a dictionary.
+ * XLogInsertRecord() makes the caller start over if the redo pointer moved
+ * past the dictionary between assembling and inserting the record.
+ *
+ * Whole groups of records are not compressed.  WAL positions are byte
+ * offsets into the stream, and readers, walsenders and archive tools depend
+ * on that; compressing at XLogWrite() time would break all of them.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+#include "access/xlog.h"
+#include "access/xlog_internal.h"
+#include "access/xlogdict.h"
+#include "access/xloginsert.h"
+#include "catalog/pg_control.h"
+#include "miscadmin.h"
+#include "port/atomics.h"
+#include "storage/bufpage.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+
+/* GUC variable */
+bool		wal_compression_dictionary = false;
+
+#ifdef USE_ZSTD
+
+/* The kinds of pages we train dictionaries for */
+typedef enum XLogDictKind
+{
+	XLOG_DICT_HEAP,
+	XLOG_DICT_BTREE,
+	XLOG_DICT_NUM_KINDS
+} XLogDictKind;
+
+/* Resource manager to report in XLOG_FPI_DICTIONARY for each kind */
+static const RmgrId XLogDictKindRmgr[XLOG_DICT_NUM_KINDS] = {
+	RM_HEAP_ID,
+	RM_BTREE_ID
+};
+
+typedef struct XLogDictSlot
+{
+	/* The current dictionary; protected by WALCompressionDictLock */
+	uint32		dict_id;		/* 0 if none */
+	uint32		dict_len;
+	XLogRecPtr	dict_lsn;		/* start of the record that last logged it */
+	char		dict[XLOG_DICT_MAX_SIZE];
+
+	/* Copy of dict_lsn that can be checked without the lock */
+	pg_atomic_uint64 dict_lsn_hint;
+
+	/* Set by backends that would like to use a dictionary */
+	pg_atomic_uint32 wanted;
+
+	/*
+	 * Page images to train the next dictionary on.  A backend claims a slot
+	 * by advancing nreserved, and advances nfilled once it has copied the
+	 * image in.
+	 */
+	pg_atomic_uint32 nreserved;
+	pg_atomic_uint32 nfilled;
+	uint32		sample_len[XLOG_DICT_NUM_SAMPLES];
+	PGAlignedBlock samples[XLOG_DICT_NUM_SAMPLES];
+} XLogDictSlot;
+
+typedef struct XLogDictCtlData
+{
+	XLogDictSlot slots[XLOG_DICT_NUM_KINDS];
+} XLogDictCtlData;
+
+static XLogDictCtlData *XLogDictCtl = NULL;
+
+/* A backend's copy of a dictionary, prepared for compression */
+typedef struct XLogDictLocal
+{
+	uint32		dict_id;
+	XLogRecPtr	dict_lsn;
+	XLogRecPtr	checked_redo;	/* redo pointer dict_lsn was checked against */
+	ZSTD_CDict *cdict;
+} XLogDictLocal;
+
+static XLogDictLocal localDicts[XLOG_DICT_NUM_KINDS];
+static ZSTD_CCtx *dictCCtx = NULL;
+
+static int	XLogDictKindOf(RmgrId rmid, const char *page);
+static void XLogDictTakeSample(XLogDictSlot *slot, const char *source,
+							   int32 slen);
+static bool XLogDictRefresh(XLogDictSlot *slot, XLogDictLocal *local,
+							XLogRecPtr RedoRecPtr);
+static void XLogDictTrain(XLogDictSlot *slot, char *dict, uint32 *dict_len,
+						  uint32 *dict_id);
+
+#endif							/* USE_ZSTD */
+
+/*
+ * Initialization of shared memory for WAL compression dictionaries
+ */
+Size
+XLogDictShmemSize(void)
+{
+#ifdef USE_ZSTD
+	return sizeof(XLogDictCtlData);
+#else
+	return 0;
+#endif
+}
+
+void
+XLogDictShmemInit(void)
+{
+#ifdef USE_ZSTD
+	bool		found;
+
+	XLogDictCtl = (XLogDictCtlData *)
+		ShmemInitStruct("WAL Compression Dictionaries",
+						sizeof(XLogDictCtlData), &found);
+
+	if (!found)
+	{
+		for (int i = 0; i < XLOG_DICT_NUM_KINDS; i++)
+		{
+			XLogDictSlot *slot = &XLogDictCtl->slots[i];
+
+			slot->dict_id = 0;
+			slot->dict_len = 0;
+			slot->dict_lsn = InvalidXLogRecPtr;
+			pg_atomic_init_u64(&slot->dict_lsn_hint, InvalidXLogRecPtr);
+			pg_atomic_init_u32(&slot->wanted, 0);
+			pg_atomic_init_u32(&slot->nreserved, 0);
+			pg_atomic_init_u32(&slot->nfilled, 0);
+		}
+	}
+#endif
+}
+
+/*
+ * Try to compress a full-page image with a dictionary.
+ *
+ * 'page' is the page the image was taken of, and 'source' and 'slen' the
+ * image with any hole removed.  RedoRecPtr is the redo pointer the record is
+ * being assembled for.
+ *
+ * Returns true if the image was compressed, setting *dlen, and *dict_id and
+ * *dict_lsn to the ID of the dictionary and the location of the record that
+ * logged it.  Returns false if there is no usable dictionary, in which case
+ * the caller should compress without one.
+ *
+ * This is called in critical sections, so it must not throw errors.
+ */
+bool
+XLogDictCompress(RmgrId rmid, const char *page, XLogRecPtr RedoRecPtr,
+				 const char *source, int32 slen,
+				 char *dest, int32 capacity, int32 *dlen,
+				 uint32 *dict_id, XLogRecPtr *dict_lsn)
+{
+#ifdef USE_ZSTD
+	int			kind;
+	XLogDictSlot *slot;
+	XLogDictLocal *local;
+	size_t		len;
+
+	if (!wal_compression_dictionary)
+		return false;
+
+	kind = XLogDictKindOf(rmid, page);
+	if (kind < 0)
+		return false;
+	slot = &XLogDictCtl->slots[kind];
+	local = &localDicts[kind];
+
+	/* Let the checkpointer know that dictionaries are in use */
+	if (pg_atomic_read_u32(&slot->wanted) == 0)
+		pg_atomic_write_u32(&slot->wanted, 1);
+
+	XLogDictTakeSample(slot, source, slen);
+
+	if (local->checked_redo != RedoRecPtr &&
+		!XLogDictRefresh(slot, local, RedoRecPtr))
+		return false;
+	if (local->cdict == NULL)
+		return false;
+
+	if (dictCCtx == NULL)
+	{
+		dictCCtx = ZSTD_createCCtx();
+		if (dictCCtx == NULL)
+			return false;
+	}
+
+	len = ZSTD_compress_usingCDict(dictCCtx, dest, capacity, source, slen,
+								   local->cdict);
+	if (ZSTD_isError(len))
+		return false;
+
+	*dlen = (int32) len;
+	*dict_id = local->dict_id;
+	*dict_lsn = local->dict_lsn;
+	return true;
+#else
+	return false;
+#endif
+}
+
+/*
+ * Train new dictionaries if we have collected enough samples, and log the
+ * dictionaries in use.
+ *
+ * Called by the checkpointer right after a new redo pointer has been
+ * established.
+ */
+void
+XLogDictCheckpoint(void)
+{
+#ifdef USE_ZSTD
+	char	   *dict = NULL;
+
+	for (int i = 0; i < XLOG_DICT_NUM_KINDS; i++)
+	{
+		XLogDictSlot *slot = &XLogDictCtl->slots[i];
+		xl_fpi_dictionary xlrec;
+		uint32		dict_id;
+		uint32		dict_len;
+
+		/*
+		 * Nobody has compressed this kind of page with a dictionary since the
+		 * last checkpoint.  Don't log the dictionary again; should anyone
+		 * want it after all, it will be logged at the next checkpoint.
+		 */
+		if (pg_atomic_read_u32(&slot->wanted) == 0)
+			continue;
+		pg_atomic_write_u32(&slot->wanted, 0);
+
+		if (dict == NULL)
+			dict = palloc(XLOG_DICT_MAX_SIZE);
+
+		/*
+		 * Only the checkpointer changes the dictionary, so we can read it
+		 * without the lock.
+		 */
+		dict_id = slot->dict_id;
+		dict_len = slot->dict_len;
+		memcpy(dict, slot->dict, dict_len);
+
+		if (pg_atomic_read_u32(&slot->nfilled) >= XLOG_DICT_NUM_SAMPLES)
+			XLogDictTrain(slot, dict, &dict_len, &dict_id);
+
+		if (dict_id == 0)
+			continue;
+
+		xlrec.dict_id = dict_id;
+		xlrec.dict_len = dict_len;
+		xlrec.dict_rmid = XLogDictKindRmgr[i];
+
+		XLogBeginInsert();
+		XLogRegisterData((char *) &xlrec, SizeOfFPIDictionary);
+		XLogRegisterData(dict, dict_len);
+		(void) XLogInsert(RM_XLOG_ID, XLOG_FPI_DICTIONARY);
+
+		LWLockAcquire(WALCompressionDictLock, LW_EXCLUSIVE);
+		slot->dict_id = dict_id;
+		slot->dict_len = dict_len;
+		memcpy(slot->dict, dict, dict_len);
+		slot->dict_lsn = ProcLastRecPtr;
+		pg_atomic_write_u64(&slot->dict_lsn_hint, ProcLastRecPtr);
+		LWLockRelease(WALCompressionDictLock);
+	}
+
+	if (dict)
+		pfree(dict);
+#endif
+}
+
+#ifdef USE_ZSTD
+
+/*
+ * Which kind of dictionary, if any, applies to an image of 'page' in a
+ * record of the given resource manager?  Returns -1 if none does.
+ */
+static int
+XLogDictKindOf(RmgrId rmid, const char *page)
+{
+	switch (rmid)
+	{
+		case RM_HEAP_ID:
+		case RM_HEAP2_ID:
+			return XLOG_DICT_HEAP;
+
+		case RM_BTREE_ID:
+			return XLOG_DICT_BTREE;
+
+		case RM_XLOG_ID:
+
+			/*
+			 * Images logged for hint bit updates are mostly of heap pages,
+			 * which are the only ones without a special space.
+			 */
+			if (PageGetSpecialSize((Page) page) == 0)
+				return XLOG_DICT_HEAP;
+			return -1;
+
+		default:
+			return -1;
+	}
+}
+
+/*
+ * Add a page image to the samples for the next dictionary, if there's room.
+ */
+static void
+XLogDictTakeSample(XLogDictSlot *slot, const char *source, int32 slen)
+{
+	uint32		n;
+
+	if (pg_atomic_read_u32(&slot->nreserved) >= XLOG_DICT_NUM_SAMPLES)
+		return;
+
+	n = pg_atomic_fetch_add_u32(&slot->nreserved, 1);
+	if (n >= XLOG_DICT_NUM_SAMPLES)
+		return;
+
+	memcpy(slot->samples[n].data, source, slen);
+	slot->sample_len[n] = slen;
+
+	/* this is a full barrier, so the checkpointer will see the sample */
+	pg_atomic_fetch_add_u32(&slot->nfilled, 1);
+}
+
+/*
+ * Bring our copy of a dictionary up to date for a new redo pointer.
+ *
+ * Returns false if the dictionary hasn't been logged since RedoRecPtr.
+ */
+static bool
+XLogDictRefresh(XLogDictSlot *slot, XLogDictLocal *local,
+				XLogRecPtr RedoRecPtr)
+{
+	/* Quick exit without the lock, while the checkpointer catches up */
+	if (pg_atomic_read_u64(&slot->dict_lsn_hint) < RedoRecPtr)
+		return false;
+
+	LWLockAcquire(WALCompressionDictLock, LW_SHARED);
+
+	if (slot->dict_lsn < RedoRecPtr)
+	{
+		LWLockRelease(WALCompressionDictLock);
+		return false;
+	}
+
+	if (slot->dict_id != local->dict_id || local->cdict == NULL)
+	{
+		if (local->cdict)
+			ZSTD_freeCDict(local->cdict);
+		local->cdict = ZSTD_createCDict(slot->dict, slot->dict_len,
+										ZSTD_CLEVEL_DEFAULT);
+		local->dict_id = slot->dict_id;
+	}
+	local->dict_lsn = slot->dict_lsn;
+	local->checked_redo = RedoRecPtr;
+
+	LWLockRelease(WALCompressionDictLock);
+
+	return true;
+}
+
+/*
+ * Train a dictionary on the collected samples, and start collecting anew.
+ *
+ * On success, the new dictionary replaces the one passed in 'dict'.  If
+ * training fails, or happens to produce a different dictionary with the same
+ * ID as the current one, the current one is kept.
+ */
+static void
+XLogDictTrain(XLogDictSlot *slot, char *dict, uint32 *dict_len,
+			  uint32 *dict_id)
+{
+	char	   *samples;
+	size_t		sample_sizes[XLOG_DICT_NUM_SAMPLES];
+	char	   *newdict;
+	size_t		newlen;
+	uint32		newid;
+	size_t		total = 0;
+
+	samples = palloc(XLOG_DICT_NUM_SAMPLES * BLCKSZ);
+	for (int i = 0; i < XLOG_DICT_NUM_SAMPLES; i++)
+	{
+		memcpy(samples + total, slot->samples[i].data, slot->sample_len[i]);
+		sample_sizes[i] = slot->sample_len[i];
+		total += slot->sample_len[i];
+	}
+
+	/* We have our copy, let backends fill the sample area again */
+	pg_atomic_write_u32(&slot->nfilled, 0);
+	pg_write_barrier();
+	pg_atomic_write_u32(&slot->nreserved, 0);
+
+	newdict = palloc(XLOG_DICT_MAX_SIZE);
+	newlen = ZDICT_trainFromBuffer(newdict, XLOG_DICT_MAX_SIZE,
+								   samples, sample_sizes,
+								   XLOG_DICT_NUM_SAMPLES);
+	if (ZDICT_isError(newlen))
+	{
+		elog(DEBUG1, "could not train WAL compression dictionary: %s",
+			 ZDICT_getErrorName(newlen));
+	}
+	else
+	{
+		newid = ZDICT_getDictID(newdict, newlen);
+		if (newid != 0 &&
+			(newid != *dict_id ||
+			 (newlen == *dict_len && memcmp(newdict, dict, newlen) == 0)))
+		{
+			memcpy(dict, newdict, newlen);
+			*dict_len = (uint32) newlen;
+			*dict_id = newid;
+		}
+	}
+
+	pfree(newdict);
+	pfree(samples);
+}
+
+#endif							/* USE_ZSTD */
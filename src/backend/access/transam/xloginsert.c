@@ -30,6 +30,7 @@
 #include "access/xact.h"
 #include "access/xlog.h"
 #include "access/xlog_internal.h"
+#include "access/xlogdict.h"
 #include "access/xloginsert.h"
 #include "catalog/pg_control.h"
 #include "common/pg_lzcompress.h"
@@ -137,10 +138,12 @@ static MemoryContext xloginsert_cxt;
 
 static XLogRecData *XLogRecordAssemble(RmgrId rmid, uint8 info,
 									   XLogRecPtr RedoRecPtr, bool doPageWrites,
-									   XLogRecPtr *fpw_lsn, int *num_fpi,
-									   bool *topxid_included);
-static bool XLogCompressBackupBlock(char *page, uint16 hole_offset,
-									uint16 hole_length, char *dest, uint16 *dlen);
+									   XLogRecPtr *fpw_lsn, XLogRecPtr *dict_lsn,
+									   int *num_fpi, bool *topxid_included);
+static bool XLogCompressBackupBlock(RmgrId rmid, XLogRecPtr RedoRecPtr,
+									char *page, uint16 hole_offset,
+									uint16 hole_length, char *dest, uint16 *dlen,
+									uint32 *dict_id, XLogRecPtr *dict_lsn);
 
 /*
  * Begin constructing a WAL record. This must be called before the
@@ -476,6 +479,7 @@ XLogInsert(RmgrId rmid, uint8 info)
 		bool		doPageWrites;
 		bool		topxid_included = false;
 		XLogRecPtr	fpw_lsn;
+		XLogRecPtr	dict_lsn;
 		XLogRecData *rdt;
 		int			num_fpi = 0;
 
@@ -487,10 +491,11 @@ XLogInsert(RmgrId rmid, uint8 info)
 		GetFullPageWriteInfo(&RedoRecPtr, &doPageWrites);
 
 		rdt = XLogRecordAssemble(rmid, info, RedoRecPtr, doPageWrites,
-								 &fpw_lsn, &num_fpi, &topxid_included);
+								 &fpw_lsn, &dict_lsn, &num_fpi,
+								 &topxid_included);
 
-		EndPos = XLogInsertRecord(rdt, fpw_lsn, curinsert_flags, num_fpi,
-								  topxid_included);
+		EndPos = XLogInsertRecord(rdt, fpw_lsn, dict_lsn, curinsert_flags,
+								  num_fpi, topxid_included);
 	} while (EndPos == InvalidXLogRecPtr);
 
 	XLogResetInsertion();
@@ -510,13 +515,19 @@ XLogInsert(RmgrId rmid, uint8 info)
  * signals that the assembled record is only good for insertion on the
  * assumption that the RedoRecPtr and doPageWrites values were up-to-date.
  *
+ * If any full-page image was compressed with a WAL compression dictionary,
+ * *dict_lsn is set to the lowest location of the records that logged the
+ * dictionaries used.  The record is only good for insertion if no redo
+ * pointer has been established after that location since.
+ *
  * *topxid_included is set if the topmost transaction ID is logged with the
  * current subtransaction.
  */
 static XLogRecData *
 XLogRecordAssemble(RmgrId rmid, uint8 info,
 				   XLogRecPtr RedoRecPtr, bool doPageWrites,
-				   XLogRecPtr *fpw_lsn, int *num_fpi, bool *topxid_included)
+				   XLogRecPtr *fpw_lsn, XLogRecPtr *dict_lsn,
+				   int *num_fpi, bool *topxid_included)
 {
 	XLogRecData *rdt;
 	uint32		total_len = 0;
@@ -555,6 +566,7 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
 	 * the headers for the block references in the scratch buffer.
 	 */
 	*fpw_lsn = InvalidXLogRecPtr;
+	*dict_lsn = InvalidXLogRecPtr;
 	for (block_id = 0; block_id < max_registered_block_id; block_id++)
 	{
 		registered_buffer *regbuf = &registered_buffers[block_id];
@@ -565,6 +577,7 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
 		XLogRecordBlockCompressHeader cbimg = {0};
 		bool		samerel;
 		bool		is_compressed = false;
+		uint32		dict_id = 0;
 		bool		include_image;
 
 		if (!regbuf->in_use)
@@ -656,11 +669,19 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
 			 */
 			if (wal_compression != WAL_COMPRESSION_NONE)
 			{
+				XLogRecPtr	this_dict_lsn = InvalidXLogRecPtr;
+
 				is_compressed =
-					XLogCompressBackupBlock(page, bimg.hole_offset,
+					XLogCompressBackupBlock(rmid, RedoRecPtr,
+											page, bimg.hole_offset,
 											cbimg.hole_length,
 											regbuf->compressed_page,
-											&compressed_len);
+											&compressed_len,
+											&dict_id, &this_dict_lsn);
+				if (is_compressed && dict_id != 0 &&
+					(*dict_lsn == InvalidXLogRecPtr ||
+					 this_dict_lsn < *dict_lsn))
+					*dict_lsn = this_dict_lsn;
 			}
 
 			/*
@@ -711,7 +732,10 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
 
 					case WAL_COMPRESSION_ZSTD:
 #ifdef USE_ZSTD
-						bimg.bimg_info |= BKPIMAGE_COMPRESS_ZSTD;
+						if (dict_id != 0)
+							bimg.bimg_info |= BKPIMAGE_COMPRESS_ZSTD_DICT;
+						else
+							bimg.bimg_info |= BKPIMAGE_COMPRESS_ZSTD;
 #else
 						elog(ERROR, "zstd is not supported by this build");
 #endif
@@ -790,6 +814,11 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
 					   SizeOfXLogRecordBlockCompressHeader);
 				scratch += SizeOfXLogRecordBlockCompressHeader;
 			}
+			if (dict_id != 0 && is_compressed)
+			{
+				memcpy(scratch, &dict_id, sizeof(uint32));
+				scratch += sizeof(uint32);
+			}
 		}
 		if (!samerel)
 		{
@@ -879,10 +908,16 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
  * Returns false if compression fails (i.e., compressed result is actually
  * bigger than original). Otherwise, returns true and sets 'dlen' to
  * the length of compressed block image.
+ *
+ * If the image was compressed with a WAL compression dictionary, *dict_id is
+ * set to its ID and *dict_lsn to the location of the record that logged it.
+ * Otherwise *dict_id is set to 0.
  */
 static bool
-XLogCompressBackupBlock(char *page, uint16 hole_offset, uint16 hole_length,
-						char *dest, uint16 *dlen)
+XLogCompressBackupBlock(RmgrId rmid, XLogRecPtr RedoRecPtr,
+						char *page, uint16 hole_offset, uint16 hole_length,
+						char *dest, uint16 *dlen,
+						uint32 *dict_id, XLogRecPtr *dict_lsn)
 {
 	int32		orig_len = BLCKSZ - hole_length;
 	int32		len = -1;
@@ -890,6 +925,8 @@ XLogCompressBackupBlock(char *page, uint16 hole_offset, uint16 hole_length,
 	char	   *source;
 	PGAlignedBlock tmp;
 
+	*dict_id = 0;
+
 	if (hole_length != 0)
 	{
 		/* must skip the hole */
@@ -927,6 +964,14 @@ XLogCompressBackupBlock(char *page, uint16 hole_offset, uint16 hole_length,
 
 		case WAL_COMPRESSION_ZSTD:
 #ifdef USE_ZSTD
+			if (XLogDictCompress(rmid, page, RedoRecPtr, source, orig_len,
+								 dest, COMPRESS_BUFSIZE, &len,
+								 dict_id, dict_lsn))
+			{
+				/* the dictionary ID is stored too */
+				extra_bytes += sizeof(uint32);
+				break;
+			}
 			len = ZSTD_compress(dest, COMPRESS_BUFSIZE, source, orig_len,
 								ZSTD_CLEVEL_DEFAULT);
 			if (ZSTD_isError(len))
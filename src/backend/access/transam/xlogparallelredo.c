@@ -0,0 +1,1078 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogparallelredo.c
+ *		Parallel WAL redo.
+ *
+ * Portions Copyright (c) 2022, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *		src/backend/access/transam/xlogparallelredo.c
+ *
+ * With recovery_parallel_workers > 0, the startup process hands most records
+ * that modify relation data to a set of background workers, instead of
+ * replaying them itself.  Each worker has a queue in shared memory.  Blocks
+ * are assigned to workers in groups of PARALLEL_REDO_BLOCK_GROUP consecutive
+ * blocks of a relation fork, by hashing, and all records that touch a given
+ * block go to its worker.  Any one block is therefore still replayed in WAL
+ * order by a single process, while the blocks of a large relation are spread
+ * over all workers.
+ *
+ * Several processes may thus extend the same relation; XLogReadBufferExtended
+ * serializes that with the relation extension lock.  Heap redo also updates
+ * visibility map and free space map pages without a block reference, but
+ * only under a buffer lock, as it would outside recovery.  A visibility map
+ * bit is cleared only by records that touch its heap block, and set only by
+ * XLOG_HEAP2_VISIBLE records, which reference that same heap block; so the
+ * changes to any one bit still happen in WAL order.
+ *
+ * ParallelRedoDispatch() sorts each record the startup process has decoded
+ * (with the help of the XLogPrefetcher) into one of four classes:
+ *
+ * - Records whose block references all belong to one worker, from resource
+ *	 managers whose redo routines touch nothing but those blocks and the
+ *	 relation's visibility map and free space map, are sent to that worker.
+ *
+ * - Records that don't touch relation data at all, such as transaction
+ *	 status updates that drop no relations, are replayed by the startup
+ *	 process right away.  Workers never touch the SLRUs, so there is nothing
+ *	 to wait for.
+ *
+ * - Records whose blocks belong to several workers are synchronized: the
+ *	 startup process waits for just those workers to drain their queues, so
+ *	 that the blocks are up to date, and then replays the record itself.
+ *	 Later records are only dispatched after that.
+ *
+ * - Everything else is a barrier: the startup process waits for all workers
+ *	 to drain their queues, and then replays the record itself.  That covers
+ *	 DDL, checkpoints and other XLOG records, records to be consistency-
+ *	 checked, and resource managers we know nothing about.
+ *
+ * In hot standby, queries run while we replay, which takes some more care;
+ * see ParallelRedoHotStandbyClass().  Transaction commits and aborts become
+ * barriers, so that queries never see a transaction as finished before all
+ * of its changes have been replayed.  Records that resolve conflicts with
+ * queries, or wait for a cleanup lock, are synchronized: the redo routines
+ * can only do that in the startup process.  So are heap records that clear
+ * visibility map bits, because an index-only scan must not find an index
+ * entry replayed by one worker while the heap page's bit hasn't been
+ * cleared yet by another.  Finally, pausing recovery waits for the workers,
+ * so that queries see a stable state while paused.
+ *
+ * Each worker has its own invalid-page table (see xlogutils.c).  Requests to
+ * forget invalid pages are forwarded to the workers through their queues, and
+ * the startup process asks them to check their tables when it reaches a
+ * consistent state.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/gistxlog.h"
+#include "access/heapam_xlog.h"
+#include "access/nbtxlog.h"
+#include "access/rmgr.h"
+#include "access/spgxlog.h"
+#include "access/xact.h"
+#include "access/xlog.h"
+#include "access/xlog_internal.h"
+#include "access/xlogparallelredo.h"
+#include "access/xlogrecovery.h"
+#include "access/xlogutils.h"
+#include "common/hashfn.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/startup.h"
+#include "storage/condition_variable.h"
+#include "storage/ipc.h"
+#include "storage/shmem.h"
+#include "storage/smgr.h"
+#include "utils/memutils.h"
+#include "utils/resowner.h"
+
+/* Size of each worker's queue */
+#define PARALLEL_REDO_QUEUE_SIZE	(1024 * 1024)
+
+/* Number of consecutive blocks of a relation fork assigned to one worker */
+#define PARALLEL_REDO_BLOCK_GROUP	16
+
+/* Special return values of ParallelRedoChooseWorker() */
+#define PARALLEL_REDO_LOCAL		(-1)
+#define PARALLEL_REDO_BARRIER	(-2)
+#define PARALLEL_REDO_SYNC		(-3)
+
+/* How often the startup process checks that its workers are still alive */
+#define PARALLEL_REDO_CHECK_INTERVAL_MS	1000
+
+typedef enum ParallelRedoMessageType
+{
+	PARALLEL_REDO_RECORD,		/* replay a decoded record */
+	PARALLEL_REDO_FORGET_PAGES, /* forget invalid pages of a relation fork */
+	PARALLEL_REDO_FORGET_DB,	/* forget invalid pages of a database */
+	PARALLEL_REDO_CHECK_PAGES,	/* check for unresolved invalid pages */
+	PARALLEL_REDO_DICTIONARY	/* remember a WAL compression dictionary */
+} ParallelRedoMessageType;
+
+/*
+ * A message in a worker's queue.  For PARALLEL_REDO_RECORD, a copy of the
+ * DecodedXLogRecord follows at the next MAXALIGN boundary, and for
+ * PARALLEL_REDO_DICTIONARY the main data of the XLOG_FPI_DICTIONARY record.
+ */
+typedef struct ParallelRedoMessage
+{
+	ParallelRedoMessageType type;
+	Size		len;			/* total size of the message, MAXALIGN'd */
+
+	/* PARALLEL_REDO_RECORD: address of the record in the startup process */
+	uintptr_t	orig;
+
+	/* PARALLEL_REDO_FORGET_PAGES and PARALLEL_REDO_FORGET_DB */
+	RelFileNode rnode;
+	ForkNumber	forkno;
+	BlockNumber minblkno;
+	Oid			dbid;
+
+	/* PARALLEL_REDO_DICTIONARY: unaligned length of the payload */
+	Size		datalen;
+} ParallelRedoMessage;
+
+#define PARALLEL_REDO_MAX_PAYLOAD \
+	(PARALLEL_REDO_QUEUE_SIZE - MAXALIGN(sizeof(ParallelRedoMessage)))
+
+/*
+ * Queue of messages from the startup process to one worker.  There is only
+ * one reader and one writer, so the positions can be advanced without locks.
+ * Positions only grow; the offset in 'data' is the position modulo
+ * PARALLEL_REDO_QUEUE_SIZE.
+ */
+typedef struct ParallelRedoQueue
+{
+	pg_atomic_uint64 insert_pos;	/* end of messages written by startup */
+	pg_atomic_uint64 done_pos;	/* end of messages the worker has finished */
+	pg_atomic_uint32 have_invalid_pages;	/* worker's table isn't empty */
+	ConditionVariable data_cv;	/* signaled when insert_pos advances */
+	ConditionVariable space_cv; /* signaled when done_pos advances */
+	char		data[PARALLEL_REDO_QUEUE_SIZE];
+} ParallelRedoQueue;
+
+typedef struct ParallelRedoCtlData
+{
+	/* set when workers should exit once their queues are empty */
+	pg_atomic_uint32 shutdown;
+
+	/*
+	 * Advanced whenever the startup process replays a barrier record.  Such
+	 * records may truncate or drop relations, so workers must not trust the
+	 * relation sizes their smgr layer has cached across one.
+	 */
+	pg_atomic_uint64 smgr_generation;
+
+	ParallelRedoQueue queues[FLEXIBLE_ARRAY_MEMBER];
+} ParallelRedoCtlData;
+
+static ParallelRedoCtlData *ParallelRedoCtl = NULL;
+
+/* GUC variable */
+int			recovery_parallel_workers = 0;
+
+/* Startup process state: the workers we launched, if any */
+static int	nParallelRedoWorkers = 0;
+static BackgroundWorkerHandle *parallelRedoHandles[MAX_PARALLEL_REDO_WORKERS];
+
+/* Are we a parallel redo worker? */
+static bool am_parallel_redo_worker = false;
+
+static int	ParallelRedoChooseWorker(XLogReaderState *record);
+static int	ParallelRedoBlockWorker(RelFileNode rnode, ForkNumber forknum,
+									BlockNumber blkno);
+static int	ParallelRedoHotStandbyClass(XLogReaderState *record);
+static bool ParallelRedoXactNeedsBarrier(XLogReaderState *record);
+static void ParallelRedoWaitForWorker(int worker);
+static void ParallelRedoEnqueue(int worker, ParallelRedoMessage *msg,
+								const char *payload, Size payload_len);
+static void ParallelRedoBroadcast(ParallelRedoMessage *msg);
+static void ParallelRedoSleep(ConditionVariable *cv, int worker);
+static void ParallelRedoQueueWrite(ParallelRedoQueue *queue, uint64 pos,
+								   const void *src, Size len);
+static void ParallelRedoQueueRead(ParallelRedoQueue *queue, uint64 pos,
+								  void *dest, Size len);
+static void ParallelRedoRememberDictionary(XLogReaderState *reader,
+										   ParallelRedoQueue *queue,
+										   uint64 pos,
+										   ParallelRedoMessage *msg);
+static void ParallelRedoReplay(XLogReaderState *reader,
+							   ParallelRedoQueue *queue, uint64 pos,
+							   ParallelRedoMessage *msg);
+static void parallel_redo_error_callback(void *arg);
+
+
+/*
+ * Report shared-memory space needed by ParallelRedoShmemInit.
+ */
+Size
+ParallelRedoShmemSize(void)
+{
+	return add_size(offsetof(ParallelRedoCtlData, queues),
+					mul_size(recovery_parallel_workers,
+							 sizeof(ParallelRedoQueue)));
+}
+
+/*
+ * Allocate and initialize shared memory for parallel redo.
+ */
+void
+ParallelRedoShmemInit(void)
+{
+	bool		found;
+
+	ParallelRedoCtl = (ParallelRedoCtlData *)
+		ShmemInitStruct("Parallel Redo Ctl", ParallelRedoShmemSize(), &found);
+
+	if (!found)
+	{
+		pg_atomic_init_u32(&ParallelRedoCtl->shutdown, 0);
+		pg_atomic_init_u64(&ParallelRedoCtl->smgr_generation, 0);
+		for (int i = 0; i < recovery_parallel_workers; i++)
+		{
+			ParallelRedoQueue *queue = &ParallelRedoCtl->queues[i];
+
+			pg_atomic_init_u64(&queue->insert_pos, 0);
+			pg_atomic_init_u64(&queue->done_pos, 0);
+			pg_atomic_init_u32(&queue->have_invalid_pages, 0);
+			ConditionVariableInit(&queue->data_cv);
+			ConditionVariableInit(&queue->space_cv);
+		}
+	}
+}
+
+/*
+ * Launch the parallel redo workers, if configured and possible.
+ *
+ * Called by the startup process before the main redo loop.  If we can't get
+ * all the workers we asked for, we go ahead with fewer, or with none at all,
+ * in which case the startup process replays everything itself as usual.
+ */
+void
+ParallelRedoStartup(void)
+{
+	int			i;
+
+	Assert(nParallelRedoWorkers == 0);
+
+	if (recovery_parallel_workers == 0 || !IsUnderPostmaster)
+		return;
+
+	pg_atomic_write_u32(&ParallelRedoCtl->shutdown, 0);
+
+	for (i = 0; i < recovery_parallel_workers; i++)
+	{
+		ParallelRedoQueue *queue = &ParallelRedoCtl->queues[i];
+		BackgroundWorker worker;
+
+		pg_atomic_write_u64(&queue->insert_pos, 0);
+		pg_atomic_write_u64(&queue->done_pos, 0);
+		pg_atomic_write_u32(&queue->have_invalid_pages, 0);
+
+		memset(&worker, 0, sizeof(worker));
+		worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+		worker.bgw_start_time = BgWorkerStart_PostmasterStart;
+		worker.bgw_restart_time = BGW_NEVER_RESTART;
+		sprintf(worker.bgw_library_name, "postgres");
+		sprintf(worker.bgw_function_name, "ParallelRedoWorkerMain");
+		snprintf(worker.bgw_name, BGW_MAXLEN, "parallel redo worker %d", i);
+		snprintf(worker.bgw_type, BGW_MAXLEN, "parallel redo worker");
+		worker.bgw_main_arg = Int32GetDatum(i);
+		worker.bgw_notify_pid = MyProcPid;
+
+		if (!RegisterDynamicBackgroundWorker(&worker, &parallelRedoHandles[i]))
+			break;
+	}
+
+	nParallelRedoWorkers = i;
+
+	if (nParallelRedoWorkers < recovery_parallel_workers)
+		ereport(LOG,
+				(errmsg("could only register %d of %d parallel redo workers",
+						nParallelRedoWorkers, recovery_parallel_workers),
+				 errhint("You might need to increase max_worker_processes.")));
+	else
+		ereport(DEBUG1,
+				(errmsg_internal("started %d parallel redo workers",
+								 nParallelRedoWorkers)));
+}
+
+/*
+ * Wait for all workers to finish their queues, then tell them to exit.
+ *
+ * Called by the startup process at the end of redo.
+ */
+void
+ParallelRedoShutdown(void)
+{
+	if (nParallelRedoWorkers == 0)
+		return;
+
+	ParallelRedoWaitForWorkers();
+
+	pg_atomic_write_u32(&ParallelRedoCtl->shutdown, 1);
+	for (int i = 0; i < nParallelRedoWorkers; i++)
+		ConditionVariableBroadcast(&ParallelRedoCtl->queues[i].data_cv);
+
+	for (int i = 0; i < nParallelRedoWorkers; i++)
+	{
+		(void) WaitForBackgroundWorkerShutdown(parallelRedoHandles[i]);
+		pfree(parallelRedoHandles[i]);
+		parallelRedoHandles[i] = NULL;
+	}
+
+	nParallelRedoWorkers = 0;
+
+	/* The workers may have extended relations behind our back */
+	smgrcloseall();
+}
+
+/*
+ * Hand a record to a parallel redo worker, if it can be replayed by one.
+ *
+ * Returns true if the record was queued for a worker.  Otherwise returns
+ * false, and the caller must replay the record itself; if the record needs
+ * it, we have already waited for the workers to catch up.
+ */
+bool
+ParallelRedoDispatch(XLogReaderState *record)
+{
+	DecodedXLogRecord *decoded = record->record;
+	ParallelRedoMessage msg;
+	int			worker;
+
+	if (nParallelRedoWorkers == 0)
+		return false;
+
+	/*
+	 * Workers decompress full-page images themselves, so they need to know
+	 * the WAL compression dictionaries.  There's nothing to replay.
+	 */
+	if (XLogRecGetRmid(record) == RM_XLOG_ID &&
+		(XLogRecGetInfo(record) & ~XLR_INFO_MASK) == XLOG_FPI_DICTIONARY)
+	{
+		memset(&msg, 0, sizeof(msg));
+		msg.type = PARALLEL_REDO_DICTIONARY;
+		msg.datalen = XLogRecGetDataLen(record);
+		for (int i = 0; i < nParallelRedoWorkers; i++)
+			ParallelRedoEnqueue(i, &msg, XLogRecGetData(record), msg.datalen);
+		return false;
+	}
+
+	worker = ParallelRedoChooseWorker(record);
+
+	if (worker == PARALLEL_REDO_LOCAL)
+		return false;
+
+	if (worker == PARALLEL_REDO_SYNC)
+	{
+		/* Wait for the workers that own the record's blocks */
+		for (int block_id = 0; block_id <= XLogRecMaxBlockId(record); block_id++)
+		{
+			RelFileNode rnode;
+			ForkNumber	forknum;
+			BlockNumber blkno;
+
+			if (XLogRecGetBlockTagExtended(record, block_id, &rnode, &forknum,
+										   &blkno, NULL))
+				ParallelRedoWaitForWorker(ParallelRedoBlockWorker(rnode,
+																  forknum,
+																  blkno));
+		}
+		return false;
+	}
+
+	if (worker == PARALLEL_REDO_BARRIER ||
+		decoded->size > PARALLEL_REDO_MAX_PAYLOAD)
+	{
+		ParallelRedoWaitForWorkers();
+
+		/*
+		 * Sizes cached by our smgr layer may be stale, because workers have
+		 * been extending relations.  And the record may truncate or drop
+		 * relations that workers have cached.
+		 */
+		smgrcloseall();
+		pg_atomic_fetch_add_u64(&ParallelRedoCtl->smgr_generation, 1);
+
+		return false;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = PARALLEL_REDO_RECORD;
+	msg.orig = (uintptr_t) decoded;
+	ParallelRedoEnqueue(worker, &msg, (const char *) decoded, decoded->size);
+
+	return true;
+}
+
+/*
+ * Wait until all workers have replayed everything queued for them.
+ */
+void
+ParallelRedoWaitForWorkers(void)
+{
+	for (int i = 0; i < nParallelRedoWorkers; i++)
+		ParallelRedoWaitForWorker(i);
+}
+
+/*
+ * Wait until one worker has replayed everything queued for it.
+ */
+static void
+ParallelRedoWaitForWorker(int worker)
+{
+	ParallelRedoQueue *queue = &ParallelRedoCtl->queues[worker];
+	uint64		insert_pos = pg_atomic_read_u64(&queue->insert_pos);
+
+	while (pg_atomic_read_u64(&queue->done_pos) != insert_pos)
+		ParallelRedoSleep(&queue->space_cv, worker);
+	ConditionVariableCancelSleep();
+}
+
+/*
+ * Is parallel redo in progress, so that processes other than us may be
+ * replaying WAL concurrently?
+ */
+bool
+ParallelRedoActive(void)
+{
+	return nParallelRedoWorkers > 0 || am_parallel_redo_worker;
+}
+
+/*
+ * Tell the workers to forget invalid pages of a relation fork, at or beyond
+ * minblkno.  Counterpart of forget_invalid_pages().
+ */
+void
+ParallelRedoForgetInvalidPages(RelFileNode rnode, ForkNumber forkno,
+							   BlockNumber minblkno)
+{
+	ParallelRedoMessage msg;
+
+	if (nParallelRedoWorkers == 0)
+		return;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = PARALLEL_REDO_FORGET_PAGES;
+	msg.rnode = rnode;
+	msg.forkno = forkno;
+	msg.minblkno = minblkno;
+	ParallelRedoBroadcast(&msg);
+}
+
+/*
+ * Tell the workers to forget invalid pages of a database.  Counterpart of
+ * forget_invalid_pages_db().
+ */
+void
+ParallelRedoForgetInvalidPagesDb(Oid dbid)
+{
+	ParallelRedoMessage msg;
+
+	if (nParallelRedoWorkers == 0)
+		return;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = PARALLEL_REDO_FORGET_DB;
+	msg.dbid = dbid;
+	ParallelRedoBroadcast(&msg);
+}
+
+/*
+ * Do any of the workers have unresolved references to invalid pages?
+ *
+ * The answer is only exact if the workers are idle, which is the case when
+ * the startup process is replaying a barrier record.
+ */
+bool
+ParallelRedoHaveInvalidPages(void)
+{
+	for (int i = 0; i < nParallelRedoWorkers; i++)
+	{
+		if (pg_atomic_read_u32(&ParallelRedoCtl->queues[i].have_invalid_pages))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Have the workers check for unresolved references to invalid pages, like
+ * XLogCheckInvalidPages() does, and wait for them to do so.
+ *
+ * A worker PANICs if it finds any.  Afterwards, the workers consider recovery
+ * to be consistent, and PANIC immediately on any further invalid reference.
+ */
+void
+ParallelRedoCheckInvalidPages(void)
+{
+	ParallelRedoMessage msg;
+
+	if (nParallelRedoWorkers == 0)
+		return;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = PARALLEL_REDO_CHECK_PAGES;
+	ParallelRedoBroadcast(&msg);
+
+	ParallelRedoWaitForWorkers();
+}
+
+/*
+ * Decide who should replay a record: returns the number of the worker to
+ * send it to, PARALLEL_REDO_LOCAL if the startup process can replay it
+ * without waiting for the workers, PARALLEL_REDO_SYNC if it must wait for
+ * the workers owning the record's blocks first, or PARALLEL_REDO_BARRIER if
+ * it must wait for all of them.
+ */
+static int
+ParallelRedoChooseWorker(XLogReaderState *record)
+{
+	RmgrId		rmid = XLogRecGetRmid(record);
+	uint8		info = XLogRecGetInfo(record) & ~XLR_INFO_MASK;
+	int			worker = -1;
+
+	/* Consistency checks read back the pages right after redo */
+	if ((XLogRecGetInfo(record) & XLR_CHECK_CONSISTENCY) != 0)
+		return PARALLEL_REDO_BARRIER;
+
+	if (standbyState != STANDBY_DISABLED)
+	{
+		int			class = ParallelRedoHotStandbyClass(record);
+
+		if (class != 0)
+			return class;
+	}
+
+	switch (rmid)
+	{
+		case RM_XLOG_ID:
+			if (info != XLOG_FPI && info != XLOG_FPI_FOR_HINT)
+				return PARALLEL_REDO_BARRIER;
+			break;
+
+		case RM_HEAP_ID:
+			/* nothing to do, the actions are logged as SMGR records */
+			if ((info & XLOG_HEAP_OPMASK) == XLOG_HEAP_TRUNCATE)
+				return PARALLEL_REDO_LOCAL;
+			break;
+
+		case RM_HEAP2_ID:
+			/* these don't touch relation data */
+			if ((info & XLOG_HEAP_OPMASK) == XLOG_HEAP2_REWRITE ||
+				(info & XLOG_HEAP_OPMASK) == XLOG_HEAP2_NEW_CID)
+				return PARALLEL_REDO_LOCAL;
+			break;
+
+		case RM_BTREE_ID:
+		case RM_HASH_ID:
+		case RM_GIN_ID:
+		case RM_GIST_ID:
+		case RM_SEQ_ID:
+		case RM_SPGIST_ID:
+		case RM_BRIN_ID:
+		case RM_GENERIC_ID:
+			break;
+
+		case RM_XACT_ID:
+			return ParallelRedoXactNeedsBarrier(record) ?
+				PARALLEL_REDO_BARRIER : PARALLEL_REDO_LOCAL;
+
+		case RM_CLOG_ID:
+		case RM_MULTIXACT_ID:
+		case RM_COMMIT_TS_ID:
+		case RM_STANDBY_ID:
+		case RM_REPLORIGIN_ID:
+		case RM_LOGICALMSG_ID:
+			return PARALLEL_REDO_LOCAL;
+
+		default:
+			return PARALLEL_REDO_BARRIER;
+	}
+
+	/* All block references must belong to the same worker */
+	for (int block_id = 0; block_id <= XLogRecMaxBlockId(record); block_id++)
+	{
+		RelFileNode rnode;
+		ForkNumber	forknum;
+		BlockNumber blkno;
+		int			blk_worker;
+
+		if (!XLogRecGetBlockTagExtended(record, block_id, &rnode, &forknum,
+										&blkno, NULL))
+			continue;
+
+		blk_worker = ParallelRedoBlockWorker(rnode, forknum, blkno);
+		if (worker < 0)
+			worker = blk_worker;
+		else if (worker != blk_worker)
+			return PARALLEL_REDO_SYNC;
+	}
+
+	/* Records without block references are rare; keep it simple */
+	if (worker < 0)
+		return PARALLEL_REDO_BARRIER;
+
+	return worker;
+}
+
+/*
+ * The worker that replays all records touching the given block.
+ */
+static int
+ParallelRedoBlockWorker(RelFileNode rnode, ForkNumber forknum,
+						BlockNumber blkno)
+{
+	struct
+	{
+		RelFileNode rnode;
+		ForkNumber	forknum;
+		BlockNumber group;
+	}			key;
+
+	memset(&key, 0, sizeof(key));
+	key.rnode = rnode;
+	key.forknum = forknum;
+	key.group = blkno / PARALLEL_REDO_BLOCK_GROUP;
+
+	return hash_bytes((const unsigned char *) &key, sizeof(key)) %
+		nParallelRedoWorkers;
+}
+
+/*
+ * Classify a record that needs special treatment in hot standby; see the
+ * file header comment.  Returns PARALLEL_REDO_BARRIER, PARALLEL_REDO_SYNC,
+ * or 0 if the record can be dispatched as usual.
+ */
+static int
+ParallelRedoHotStandbyClass(XLogReaderState *record)
+{
+	RmgrId		rmid = XLogRecGetRmid(record);
+	uint8		info = XLogRecGetInfo(record) & ~XLR_INFO_MASK;
+	char	   *data = XLogRecGetData(record);
+
+	switch (rmid)
+	{
+		case RM_XACT_ID:
+			switch (info & XLOG_XACT_OPMASK)
+			{
+				case XLOG_XACT_COMMIT:
+				case XLOG_XACT_COMMIT_PREPARED:
+				case XLOG_XACT_ABORT:
+				case XLOG_XACT_ABORT_PREPARED:
+					return PARALLEL_REDO_BARRIER;
+			}
+			break;
+
+		case RM_HEAP_ID:
+			switch (info & XLOG_HEAP_OPMASK)
+			{
+				case XLOG_HEAP_INSERT:
+					if (((xl_heap_insert *) data)->flags &
+						XLH_INSERT_ALL_VISIBLE_CLEARED)
+						return PARALLEL_REDO_SYNC;
+					break;
+				case XLOG_HEAP_DELETE:
+					if (((xl_heap_delete *) data)->flags &
+						XLH_DELETE_ALL_VISIBLE_CLEARED)
+						return PARALLEL_REDO_SYNC;
+					break;
+				case XLOG_HEAP_UPDATE:
+				case XLOG_HEAP_HOT_UPDATE:
+					if (((xl_heap_update *) data)->flags &
+						(XLH_UPDATE_OLD_ALL_VISIBLE_CLEARED |
+						 XLH_UPDATE_NEW_ALL_VISIBLE_CLEARED))
+						return PARALLEL_REDO_SYNC;
+					break;
+			}
+			break;
+
+		case RM_HEAP2_ID:
+			switch (info & XLOG_HEAP_OPMASK)
+			{
+				case XLOG_HEAP2_PRUNE:
+				case XLOG_HEAP2_FREEZE_PAGE:
+				case XLOG_HEAP2_VISIBLE:
+					return PARALLEL_REDO_SYNC;
+				case XLOG_HEAP2_MULTI_INSERT:
+					if (((xl_heap_multi_insert *) data)->flags &
+						XLH_INSERT_ALL_VISIBLE_CLEARED)
+						return PARALLEL_REDO_SYNC;
+					break;
+			}
+			break;
+
+		case RM_BTREE_ID:
+			if (info == XLOG_BTREE_VACUUM || info == XLOG_BTREE_DELETE ||
+				info == XLOG_BTREE_REUSE_PAGE)
+				return PARALLEL_REDO_SYNC;
+			break;
+
+		case RM_HASH_ID:
+			/* many hash records need cleanup locks; not worth sorting out */
+			return PARALLEL_REDO_SYNC;
+
+		case RM_GIST_ID:
+			if (info == XLOG_GIST_DELETE || info == XLOG_GIST_PAGE_REUSE)
+				return PARALLEL_REDO_SYNC;
+			break;
+
+		case RM_SPGIST_ID:
+			if (info == XLOG_SPGIST_VACUUM_REDIRECT)
+				return PARALLEL_REDO_SYNC;
+			break;
+	}
+
+	return 0;
+}
+
+/*
+ * Does a transaction record need the workers to catch up before it is
+ * replayed?  That's the case if it drops relations, or if the primary is
+ * waiting for us to report it as applied.
+ */
+static bool
+ParallelRedoXactNeedsBarrier(XLogReaderState *record)
+{
+	uint8		info = XLogRecGetInfo(record) & XLOG_XACT_OPMASK;
+
+	if (info == XLOG_XACT_COMMIT || info == XLOG_XACT_COMMIT_PREPARED)
+	{
+		xl_xact_parsed_commit parsed;
+
+		ParseCommitRecord(XLogRecGetInfo(record),
+						  (xl_xact_commit *) XLogRecGetData(record),
+						  &parsed);
+		return parsed.nrels > 0 || XactCompletionApplyFeedback(parsed.xinfo);
+	}
+	else if (info == XLOG_XACT_ABORT || info == XLOG_XACT_ABORT_PREPARED)
+	{
+		xl_xact_parsed_abort parsed;
+
+		ParseAbortRecord(XLogRecGetInfo(record),
+						 (xl_xact_abort *) XLogRecGetData(record),
+						 &parsed);
+		return parsed.nrels > 0 || XactCompletionApplyFeedback(parsed.xinfo);
+	}
+
+	return false;
+}
+
+/*
+ * Append a message to a worker's queue, waiting for space if necessary.
+ */
+static void
+ParallelRedoEnqueue(int worker, ParallelRedoMessage *msg,
+					const char *payload, Size payload_len)
+{
+	ParallelRedoQueue *queue = &ParallelRedoCtl->queues[worker];
+	uint64		insert_pos = pg_atomic_read_u64(&queue->insert_pos);
+
+	Assert(payload_len <= PARALLEL_REDO_MAX_PAYLOAD);
+	msg->len = MAXALIGN(sizeof(ParallelRedoMessage)) + MAXALIGN(payload_len);
+
+	while (insert_pos + msg->len - pg_atomic_read_u64(&queue->done_pos) >
+		   PARALLEL_REDO_QUEUE_SIZE)
+		ParallelRedoSleep(&queue->space_cv, worker);
+	ConditionVariableCancelSleep();
+
+	/* don't overwrite data before the worker is done reading it */
+	pg_memory_barrier();
+
+	ParallelRedoQueueWrite(queue, insert_pos, msg, sizeof(ParallelRedoMessage));
+	if (payload_len > 0)
+		ParallelRedoQueueWrite(queue,
+							   insert_pos + MAXALIGN(sizeof(ParallelRedoMessage)),
+							   payload, payload_len);
+
+	/* make the message visible before advancing the insert position */
+	pg_write_barrier();
+	pg_atomic_write_u64(&queue->insert_pos, insert_pos + msg->len);
+
+	ConditionVariableSignal(&queue->data_cv);
+}
+
+/*
+ * Append a message without payload to all workers' queues.
+ */
+static void
+ParallelRedoBroadcast(ParallelRedoMessage *msg)
+{
+	for (int i = 0; i < nParallelRedoWorkers; i++)
+		ParallelRedoEnqueue(i, msg, NULL, 0);
+}
+
+/*
+ * Sleep on one of a worker's condition variables, in the startup process.
+ *
+ * Since a worker that exits on error will never signal us, we wake up
+ * periodically to check that it's still there.  A worker failing to replay a
+ * record is as fatal as the startup process failing to do so.
+ */
+static void
+ParallelRedoSleep(ConditionVariable *cv, int worker)
+{
+	if (ConditionVariableTimedSleep(cv, PARALLEL_REDO_CHECK_INTERVAL_MS,
+									WAIT_EVENT_PARALLEL_REDO_QUEUE))
+	{
+		pid_t		pid;
+
+		if (GetBackgroundWorkerPid(parallelRedoHandles[worker], &pid) ==
+			BGWH_STOPPED)
+			ereport(FATAL,
+					(errmsg("parallel redo worker %d exited unexpectedly",
+							worker)));
+	}
+
+	HandleStartupProcInterrupts();
+}
+
+/*
+ * Copy data into a queue, wrapping around at the end.
+ */
+static void
+ParallelRedoQueueWrite(ParallelRedoQueue *queue, uint64 pos,
+					   const void *src, Size len)
+{
+	Size		offset = pos % PARALLEL_REDO_QUEUE_SIZE;
+	Size		first = Min(len, PARALLEL_REDO_QUEUE_SIZE - offset);
+
+	memcpy(queue->data + offset, src, first);
+	if (first < len)
+		memcpy(queue->data, (const char *) src + first, len - first);
+}
+
+/*
+ * Copy data out of a queue, wrapping around at the end.
+ */
+static void
+ParallelRedoQueueRead(ParallelRedoQueue *queue, uint64 pos,
+					  void *dest, Size len)
+{
+	Size		offset = pos % PARALLEL_REDO_QUEUE_SIZE;
+	Size		first = Min(len, PARALLEL_REDO_QUEUE_SIZE - offset);
+
+	memcpy(dest, queue->data + offset, first);
+	if (first < len)
+		memcpy((char *) dest + first, queue->data, len - first);
+}
+
+/*
+ * Main entry point for parallel redo worker processes.
+ */
+void
+ParallelRedoWorkerMain(Datum main_arg)
+{
+	int			worker = DatumGetInt32(main_arg);
+	ParallelRedoQueue *queue = &ParallelRedoCtl->queues[worker];
+	XLogReaderState *reader;
+	MemoryContext redo_context;
+	uint64		smgr_generation;
+	uint64		done_pos;
+
+	BackgroundWorkerUnblockSignals();
+
+	am_parallel_redo_worker = true;
+
+	/* We need a resource owner to keep track of buffer pins */
+	CreateAuxProcessResourceOwner();
+
+	/*
+	 * We replay WAL on behalf of the startup process, and redo routines
+	 * expect to see this.
+	 */
+	InRecovery = true;
+
+	/* Only the decoded record and error message buffer are ever used */
+	reader = XLogReaderAllocate(wal_segment_size, NULL, XL_ROUTINE(), NULL);
+	if (reader == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory"),
+				 errdetail("Failed while allocating a WAL reading processor.")));
+
+	redo_context = AllocSetContextCreate(TopMemoryContext,
+										 "Parallel redo",
+										 ALLOCSET_DEFAULT_SIZES);
+
+	RmgrStartup();
+
+	smgr_generation = pg_atomic_read_u64(&ParallelRedoCtl->smgr_generation);
+	done_pos = pg_atomic_read_u64(&queue->done_pos);
+
+	for (;;)
+	{
+		ParallelRedoMessage msg;
+		uint64		generation;
+
+		CHECK_FOR_INTERRUPTS();
+
+		/* Wait for a message, or to be told to exit */
+		while (pg_atomic_read_u64(&queue->insert_pos) == done_pos &&
+			   !pg_atomic_read_u32(&ParallelRedoCtl->shutdown))
+			ConditionVariableSleep(&queue->data_cv,
+								   WAIT_EVENT_PARALLEL_REDO_WORKER_MAIN);
+		ConditionVariableCancelSleep();
+
+		if (pg_atomic_read_u64(&queue->insert_pos) == done_pos)
+			break;
+
+		/* read the message only after seeing the insert position */
+		pg_read_barrier();
+		ParallelRedoQueueRead(queue, done_pos, &msg, sizeof(msg));
+
+		generation = pg_atomic_read_u64(&ParallelRedoCtl->smgr_generation);
+		if (generation != smgr_generation)
+		{
+			smgrcloseall();
+			smgr_generation = generation;
+		}
+
+		MemoryContextSwitchTo(redo_context);
+
+		switch (msg.type)
+		{
+			case PARALLEL_REDO_RECORD:
+				ParallelRedoReplay(reader, queue, done_pos, &msg);
+				break;
+
+			case PARALLEL_REDO_FORGET_PAGES:
+				XLogTruncateRelation(msg.rnode, msg.forkno, msg.minblkno);
+				break;
+
+			case PARALLEL_REDO_FORGET_DB:
+				XLogDropDatabase(msg.dbid);
+				break;
+
+			case PARALLEL_REDO_CHECK_PAGES:
+				XLogCheckInvalidPages();
+				reachedConsistency = true;
+				break;
+
+			case PARALLEL_REDO_DICTIONARY:
+				ParallelRedoRememberDictionary(reader, queue, done_pos, &msg);
+				break;
+		}
+
+		MemoryContextSwitchTo(TopMemoryContext);
+		MemoryContextReset(redo_context);
+
+		pg_atomic_write_u32(&queue->have_invalid_pages,
+							XLogHaveInvalidPages() ? 1 : 0);
+
+		/* we must be done with the message before it can be overwritten */
+		pg_memory_barrier();
+		done_pos += msg.len;
+		pg_atomic_write_u64(&queue->done_pos, done_pos);
+
+		ConditionVariableSignal(&queue->space_cv);
+	}
+
+	RmgrCleanup();
+
+	proc_exit(0);
+}
+
+/*
+ * Remember a WAL compression dictionary received from the startup process.
+ */
+static void
+ParallelRedoRememberDictionary(XLogReaderState *reader,
+							   ParallelRedoQueue *queue, uint64 pos,
+							   ParallelRedoMessage *msg)
+{
+	char	   *data;
+
+	data = palloc(msg->datalen);
+	ParallelRedoQueueRead(queue, pos + MAXALIGN(sizeof(ParallelRedoMessage)),
+						  data, msg->datalen);
+
+	if (!XLogReaderRememberDictionary(reader, data, msg->datalen))
+		elog(ERROR, "%s", reader->errormsg_buf);
+}
+
+/*
+ * Replay a record received from the startup process.
+ */
+static void
+ParallelRedoReplay(XLogReaderState *reader, ParallelRedoQueue *queue,
+				   uint64 pos, ParallelRedoMessage *msg)
+{
+	Size		size = msg->len - MAXALIGN(sizeof(ParallelRedoMessage));
+	DecodedXLogRecord *decoded;
+	ErrorContextCallback errcallback;
+
+	decoded = palloc(size);
+	ParallelRedoQueueRead(queue, pos + MAXALIGN(sizeof(ParallelRedoMessage)),
+						  decoded, size);
+
+	/*
+	 * The record points into itself.  Adjust the pointers for its new
+	 * address; the offsets keep their alignment, since both copies start at
+	 * a MAXALIGN'd address.
+	 */
+#define RELOCATE(ptr) \
+	((ptr) = (char *) decoded + ((uintptr_t) (ptr) - msg->orig))
+
+	decoded->next = NULL;
+	if (decoded->main_data_len > 0)
+		RELOCATE(decoded->main_data);
+	for (int block_id = 0; block_id <= decoded->max_block_id; block_id++)
+	{
+		DecodedBkpBlock *blk = &decoded->blocks[block_id];
+
+		if (!blk->in_use)
+			continue;
+		if (blk->has_image)
+			RELOCATE(blk->bkp_image);
+		if (blk->has_data)
+			RELOCATE(blk->data);
+	}
+
+#undef RELOCATE
+
+	reader->record = decoded;
+	reader->ReadRecPtr = decoded->lsn;
+	reader->EndRecPtr = decoded->next_lsn;
+
+	/* Setup error traceback support for ereport() */
+	errcallback.callback = parallel_redo_error_callback;
+	errcallback.arg = (void *) reader;
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	GetRmgr(decoded->header.xl_rmid).rm_redo(reader);
+
+	error_context_stack = errcallback.previous;
+
+	reader->record = NULL;
+}
+
+/*
+ * Error context callback for errors occurring during rm_redo() in a worker.
+ */
+static void
+parallel_redo_error_callback(void *arg)
+{
+	XLogReaderState *record = (XLogReaderState *) arg;
+	StringInfoData buf;
+
+	initStringInfo(&buf);
+	xlog_outdesc(&buf, record);
+
+	/* translator: %s is a WAL record description */
+	errcontext("WAL redo at %X/%X for %s",
+			   LSN_FORMAT_ARGS(record->ReadRecPtr),
+			   buf.data);
+
+	pfree(buf.data);
+}
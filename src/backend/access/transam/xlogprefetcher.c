@@ -18,7 +18,10 @@
  * recorded in the decoded record so that XLogReadBufferForRedo() can try to
  * avoid a second buffer mapping table lookup.
  *
- * Currently, only the main fork is considered for prefetching.  Currently,
+ * Besides the blocks that records reference explicitly, some records cause
+ * replay to read pages that aren't mentioned in the WAL: heap records that
+ * clear visibility map bits or record free space, and records that update
+ * CLOG or multixact SLRU pages.  Those are prefetched too.  Currently,
  * prefetching is only effective on systems where BufferPrefetch() does
  * something useful (mainly Linux).
  *
@@ -27,6 +30,11 @@
 
 #include "postgres.h"
 
+#include "access/clog.h"
+#include "access/heapam_xlog.h"
+#include "access/multixact.h"
+#include "access/visibilitymap.h"
+#include "access/xact.h"
 #include "access/xlog.h"
 #include "access/xlogprefetcher.h"
 #include "access/xlogreader.h"
@@ -42,6 +50,7 @@
 #include "miscadmin.h"
 #include "port/atomics.h"
 #include "storage/bufmgr.h"
+#include "storage/freespace.h"
 #include "storage/shmem.h"
 #include "storage/smgr.h"
 #include "utils/guc.h"
@@ -57,7 +66,13 @@
  * To detect repeated access to the same block and skip useless extra system
  * calls, we remember a small window of recently prefetched blocks.
  */
-#define XLOGPREFETCHER_SEQ_WINDOW_SIZE 4
+#define XLOGPREFETCHER_SEQ_WINDOW_SIZE 8
+
+/*
+ * Maximum number of pages that replaying one record reads without
+ * referencing them as blocks.
+ */
+#define XLOGPREFETCHER_MAX_IMPLICIT 4
 
 /*
  * When maintenance_io_concurrency is not saturated, we're prepared to look
@@ -121,6 +136,33 @@ typedef struct LsnReadQueue
 	}			queue[FLEXIBLE_ARRAY_MEMBER];
 } LsnReadQueue;
 
+/*
+ * Kinds of pages that records read implicitly.
+ */
+typedef enum XLogPrefetcherPageKind
+{
+	XLOGPREFETCHER_PAGE_BLOCK,	/* visibility map or free space map block */
+	XLOGPREFETCHER_PAGE_CLOG,	/* CLOG page */
+	XLOGPREFETCHER_PAGE_MULTIXACT_OFFSET,	/* multixact offsets page */
+	XLOGPREFETCHER_PAGE_MULTIXACT_MEMBER	/* multixact members page */
+} XLogPrefetcherPageKind;
+
+#define XLOGPREFETCHER_NUM_SLRUS \
+	(XLOGPREFETCHER_PAGE_MULTIXACT_MEMBER - XLOGPREFETCHER_PAGE_CLOG + 1)
+
+/*
+ * A page that replaying the current record will read, although the record
+ * doesn't reference it as a block.
+ */
+typedef struct XLogPrefetcherImplicitPage
+{
+	XLogPrefetcherPageKind kind;
+	RelFileNode rnode;			/* for XLOGPREFETCHER_PAGE_BLOCK */
+	ForkNumber	forknum;
+	BlockNumber blkno;
+	int			pageno;			/* for SLRU pages */
+} XLogPrefetcherImplicitPage;
+
 /*
  * A prefetcher.  This is a mechanism that wraps an XLogReader, prefetching
  * blocks that will be soon be referenced, to try to avoid IO stalls.
@@ -132,6 +174,11 @@ struct XLogPrefetcher
 	DecodedXLogRecord *record;
 	int			next_block_id;
 
+	/* Pages read implicitly by the current record, and our position. */
+	XLogPrefetcherImplicitPage implicit[XLOGPREFETCHER_MAX_IMPLICIT];
+	int			nimplicit;
+	int			next_implicit;
+
 	/* When to publish stats. */
 	XLogRecPtr	next_stats_shm_lsn;
 
@@ -141,8 +188,10 @@ struct XLogPrefetcher
 
 	/* Book-keeping to avoid repeat prefetches. */
 	RelFileNode recent_rnode[XLOGPREFETCHER_SEQ_WINDOW_SIZE];
+	ForkNumber	recent_forknum[XLOGPREFETCHER_SEQ_WINDOW_SIZE];
 	BlockNumber recent_block[XLOGPREFETCHER_SEQ_WINDOW_SIZE];
 	int			recent_idx;
+	int			recent_slru_page[XLOGPREFETCHER_NUM_SLRUS];
 
 	/* Book-keeping to disable prefetching temporarily. */
 	XLogRecPtr	no_readahead_until;
@@ -175,8 +224,10 @@ typedef struct XLogPrefetcherFilter
 typedef struct XLogPrefetchStats
 {
 	pg_atomic_uint64 reset_time;	/* Time of last reset. */
-	pg_atomic_uint64 prefetch;	/* Prefetches initiated. */
-	pg_atomic_uint64 hit;		/* Blocks already in cache. */
+	pg_atomic_uint64 prefetch[MAX_FORKNUM + 1]; /* Prefetches initiated. */
+	pg_atomic_uint64 hit[MAX_FORKNUM + 1];	/* Blocks already in cache. */
+	pg_atomic_uint64 prefetch_slru; /* SLRU prefetches initiated. */
+	pg_atomic_uint64 hit_slru;	/* SLRU pages already in cache. */
 	pg_atomic_uint64 skip_init; /* Zero-inited blocks skipped. */
 	pg_atomic_uint64 skip_new;	/* New/missing blocks filtered. */
 	pg_atomic_uint64 skip_fpw;	/* FPWs skipped. */
@@ -197,6 +248,17 @@ static inline bool XLogPrefetcherIsFiltered(XLogPrefetcher *prefetcher,
 											BlockNumber blockno);
 static inline void XLogPrefetcherCompleteFilters(XLogPrefetcher *prefetcher,
 												 XLogRecPtr replaying_lsn);
+static void XLogPrefetcherComputeImplicitPages(XLogPrefetcher *prefetcher,
+											   DecodedXLogRecord *record);
+static LsnReadQueueNextStatus XLogPrefetcherPrefetchBlock(XLogPrefetcher *prefetcher,
+														  XLogRecPtr lsn,
+														  RelFileNode rnode,
+														  ForkNumber forknum,
+														  BlockNumber blkno,
+														  Buffer *recent_buffer);
+static LsnReadQueueNextStatus XLogPrefetcherPrefetchSlruPage(XLogPrefetcher *prefetcher,
+															 XLogPrefetcherPageKind kind,
+															 int pageno);
 static LsnReadQueueNextStatus XLogPrefetcherNextBlock(uintptr_t pgsr_private,
 													  XLogRecPtr *lsn);
 
@@ -307,8 +369,13 @@ void
 XLogPrefetchResetStats(void)
 {
 	pg_atomic_write_u64(&SharedStats->reset_time, GetCurrentTimestamp());
-	pg_atomic_write_u64(&SharedStats->prefetch, 0);
-	pg_atomic_write_u64(&SharedStats->hit, 0);
+	for (int i = 0; i <= MAX_FORKNUM; ++i)
+	{
+		pg_atomic_write_u64(&SharedStats->prefetch[i], 0);
+		pg_atomic_write_u64(&SharedStats->hit[i], 0);
+	}
+	pg_atomic_write_u64(&SharedStats->prefetch_slru, 0);
+	pg_atomic_write_u64(&SharedStats->hit_slru, 0);
 	pg_atomic_write_u64(&SharedStats->skip_init, 0);
 	pg_atomic_write_u64(&SharedStats->skip_new, 0);
 	pg_atomic_write_u64(&SharedStats->skip_fpw, 0);
@@ -328,8 +395,13 @@ XLogPrefetchShmemInit(void)
 	if (!found)
 	{
 		pg_atomic_init_u64(&SharedStats->reset_time, GetCurrentTimestamp());
-		pg_atomic_init_u64(&SharedStats->prefetch, 0);
-		pg_atomic_init_u64(&SharedStats->hit, 0);
+		for (int i = 0; i <= MAX_FORKNUM; ++i)
+		{
+			pg_atomic_init_u64(&SharedStats->prefetch[i], 0);
+			pg_atomic_init_u64(&SharedStats->hit[i], 0);
+		}
+		pg_atomic_init_u64(&SharedStats->prefetch_slru, 0);
+		pg_atomic_init_u64(&SharedStats->hit_slru, 0);
 		pg_atomic_init_u64(&SharedStats->skip_init, 0);
 		pg_atomic_init_u64(&SharedStats->skip_new, 0);
 		pg_atomic_init_u64(&SharedStats->skip_fpw, 0);
@@ -378,6 +450,8 @@ XLogPrefetcherAllocate(XLogReaderState *reader)
 										   &hash_table_ctl,
 										   HASH_ELEM | HASH_BLOBS);
 	dlist_init(&prefetcher->filter_queue);
+	for (int i = 0; i < XLOGPREFETCHER_NUM_SLRUS; ++i)
+		prefetcher->recent_slru_page[i] = -1;
 
 	SharedStats->wal_distance = 0;
 	SharedStats->block_distance = 0;
@@ -445,17 +519,426 @@ XLogPrefetcherComputeStats(XLogPrefetcher *prefetcher)
 		prefetcher->reader->ReadRecPtr + XLOGPREFETCHER_STATS_DISTANCE;
 }
 
+/*
+ * Remember that replay of the current record will read a visibility map or
+ * free space map block, because it updates the entry for the heap block
+ * referenced as block_id.
+ */
+static inline void
+XLogPrefetcherAddImplicitBlock(XLogPrefetcher *prefetcher,
+							   DecodedXLogRecord *record,
+							   int block_id, ForkNumber forknum)
+{
+	DecodedBkpBlock *block;
+	XLogPrefetcherImplicitPage *page;
+
+	if (block_id > record->max_block_id || !record->blocks[block_id].in_use)
+		return;
+	block = &record->blocks[block_id];
+
+	Assert(prefetcher->nimplicit < XLOGPREFETCHER_MAX_IMPLICIT);
+	page = &prefetcher->implicit[prefetcher->nimplicit++];
+	page->kind = XLOGPREFETCHER_PAGE_BLOCK;
+	page->rnode = block->rnode;
+	page->forknum = forknum;
+	if (forknum == VISIBILITYMAP_FORKNUM)
+		page->blkno = visibilitymap_block(block->blkno);
+	else
+		page->blkno = FreeSpaceMapBlockForHeapBlock(block->blkno);
+}
+
+/*
+ * Remember that replay of the current record will read an SLRU page.
+ */
+static inline void
+XLogPrefetcherAddImplicitSlruPage(XLogPrefetcher *prefetcher,
+								  XLogPrefetcherPageKind kind, int pageno)
+{
+	XLogPrefetcherImplicitPage *page;
+
+	Assert(prefetcher->nimplicit < XLOGPREFETCHER_MAX_IMPLICIT);
+	page = &prefetcher->implicit[prefetcher->nimplicit++];
+	page->kind = kind;
+	page->pageno = pageno;
+}
+
+/*
+ * Work out which pages replay of a record will read, other than the blocks
+ * it references.  Heap redo clears visibility map bits and records free space
+ * using the map pages covering the heap block, and transaction and multixact
+ * redo update SLRU pages.
+ *
+ * Free space is only recorded when the page is getting full, which we can't
+ * tell from here, so the free space map page is prefetched for every insert
+ * into an existing page.  Consecutive inserts usually share one map page, so
+ * the repeat filter suppresses most of those.
+ */
+static void
+XLogPrefetcherComputeImplicitPages(XLogPrefetcher *prefetcher,
+								   DecodedXLogRecord *record)
+{
+	uint8		rmid = record->header.xl_rmid;
+	uint8		info = record->header.xl_info & ~XLR_INFO_MASK;
+
+	prefetcher->nimplicit = 0;
+	prefetcher->next_implicit = 0;
+
+	if (rmid == RM_HEAP_ID)
+	{
+		switch (info & XLOG_HEAP_OPMASK)
+		{
+			case XLOG_HEAP_INSERT:
+				{
+					xl_heap_insert *xlrec = (xl_heap_insert *) record->main_data;
+
+					if (xlrec->flags & XLH_INSERT_ALL_VISIBLE_CLEARED)
+						XLogPrefetcherAddImplicitBlock(prefetcher, record, 0,
+													   VISIBILITYMAP_FORKNUM);
+					if (!(info & XLOG_HEAP_INIT_PAGE))
+						XLogPrefetcherAddImplicitBlock(prefetcher, record, 0,
+													   FSM_FORKNUM);
+				}
+				break;
+			case XLOG_HEAP_DELETE:
+				{
+					xl_heap_delete *xlrec = (xl_heap_delete *) record->main_data;
+
+					if (xlrec->flags & XLH_DELETE_ALL_VISIBLE_CLEARED)
+						XLogPrefetcherAddImplicitBlock(prefetcher, record, 0,
+													   VISIBILITYMAP_FORKNUM);
+				}
+				break;
+			case XLOG_HEAP_UPDATE:
+			case XLOG_HEAP_HOT_UPDATE:
+				{
+					xl_heap_update *xlrec = (xl_heap_update *) record->main_data;
+					int			old_block_id;
+
+					/* The old tuple is on block 1, unless it's the same page. */
+					old_block_id = record->max_block_id >= 1 &&
+						record->blocks[1].in_use ? 1 : 0;
+
+					if (xlrec->flags & XLH_UPDATE_OLD_ALL_VISIBLE_CLEARED)
+						XLogPrefetcherAddImplicitBlock(prefetcher, record,
+													   old_block_id,
+													   VISIBILITYMAP_FORKNUM);
+					if (old_block_id != 0 &&
+						(xlrec->flags & XLH_UPDATE_NEW_ALL_VISIBLE_CLEARED))
+						XLogPrefetcherAddImplicitBlock(prefetcher, record, 0,
+													   VISIBILITYMAP_FORKNUM);
+					if ((info & XLOG_HEAP_OPMASK) == XLOG_HEAP_UPDATE &&
+						!(info & XLOG_HEAP_INIT_PAGE))
+						XLogPrefetcherAddImplicitBlock(prefetcher, record, 0,
+													   FSM_FORKNUM);
+				}
+				break;
+			case XLOG_HEAP_LOCK:
+				{
+					xl_heap_lock *xlrec = (xl_heap_lock *) record->main_data;
+
+					if (xlrec->flags & XLH_LOCK_ALL_FROZEN_CLEARED)
+						XLogPrefetcherAddImplicitBlock(prefetcher, record, 0,
+													   VISIBILITYMAP_FORKNUM);
+				}
+				break;
+		}
+	}
+	else if (rmid == RM_HEAP2_ID)
+	{
+		switch (info & XLOG_HEAP_OPMASK)
+		{
+			case XLOG_HEAP2_MULTI_INSERT:
+				{
+					xl_heap_multi_insert *xlrec =
+					(xl_heap_multi_insert *) record->main_data;
+
+					if (xlrec->flags & XLH_INSERT_ALL_VISIBLE_CLEARED)
+						XLogPrefetcherAddImplicitBlock(prefetcher, record, 0,
+													   VISIBILITYMAP_FORKNUM);
+					if (!(info & XLOG_HEAP_INIT_PAGE))
+						XLogPrefetcherAddImplicitBlock(prefetcher, record, 0,
+													   FSM_FORKNUM);
+				}
+				break;
+			case XLOG_HEAP2_LOCK_UPDATED:
+				{
+					xl_heap_lock_updated *xlrec =
+					(xl_heap_lock_updated *) record->main_data;
+
+					if (xlrec->flags & XLH_LOCK_ALL_FROZEN_CLEARED)
+						XLogPrefetcherAddImplicitBlock(prefetcher, record, 0,
+													   VISIBILITYMAP_FORKNUM);
+				}
+				break;
+		}
+	}
+	else if (rmid == RM_XACT_ID)
+	{
+		TransactionId xid = InvalidTransactionId;
+
+		switch (info & XLOG_XACT_OPMASK)
+		{
+			case XLOG_XACT_COMMIT:
+			case XLOG_XACT_COMMIT_PREPARED:
+				{
+					xl_xact_parsed_commit parsed;
+
+					ParseCommitRecord(record->header.xl_info,
+									  (xl_xact_commit *) record->main_data,
+									  &parsed);
+					xid = TransactionIdIsValid(parsed.twophase_xid) ?
+						parsed.twophase_xid : record->header.xl_xid;
+				}
+				break;
+			case XLOG_XACT_ABORT:
+			case XLOG_XACT_ABORT_PREPARED:
+				{
+					xl_xact_parsed_abort parsed;
+
+					ParseAbortRecord(record->header.xl_info,
+									 (xl_xact_abort *) record->main_data,
+									 &parsed);
+					xid = TransactionIdIsValid(parsed.twophase_xid) ?
+						parsed.twophase_xid : record->header.xl_xid;
+				}
+				break;
+		}
+
+		if (TransactionIdIsNormal(xid))
+			XLogPrefetcherAddImplicitSlruPage(prefetcher,
+											  XLOGPREFETCHER_PAGE_CLOG,
+											  CLOGPageForXid(xid));
+	}
+	else if (rmid == RM_MULTIXACT_ID)
+	{
+		if (info == XLOG_MULTIXACT_CREATE_ID)
+		{
+			xl_multixact_create *xlrec =
+			(xl_multixact_create *) record->main_data;
+			int			first_member_page;
+			int			last_member_page;
+
+			first_member_page = MultiXactMemberPageForOffset(xlrec->moff);
+			last_member_page =
+				MultiXactMemberPageForOffset(xlrec->moff + xlrec->nmembers - 1);
+
+			XLogPrefetcherAddImplicitSlruPage(prefetcher,
+											  XLOGPREFETCHER_PAGE_MULTIXACT_OFFSET,
+											  MultiXactOffsetPageForMulti(xlrec->mid));
+			XLogPrefetcherAddImplicitSlruPage(prefetcher,
+											  XLOGPREFETCHER_PAGE_MULTIXACT_MEMBER,
+											  first_member_page);
+			if (last_member_page != first_member_page)
+				XLogPrefetcherAddImplicitSlruPage(prefetcher,
+												  XLOGPREFETCHER_PAGE_MULTIXACT_MEMBER,
+												  last_member_page);
+		}
+	}
+}
+
+/*
+ * Consider prefetching one block of a relation fork, which replay of the
+ * record at 'lsn' will read.  If the block is already in the buffer pool and
+ * 'recent_buffer' is not NULL, the buffer is remembered there so that
+ * XLogReadBufferForRedo() can skip the buffer mapping table lookup.
+ */
+static LsnReadQueueNextStatus
+XLogPrefetcherPrefetchBlock(XLogPrefetcher *prefetcher, XLogRecPtr lsn,
+							RelFileNode rnode, ForkNumber forknum,
+							BlockNumber blkno, Buffer *recent_buffer)
+{
+	SMgrRelation reln;
+	PrefetchBufferResult result;
+
+	/*
+	 * Should we skip prefetching this block due to a filter?  Filters are
+	 * expressed in main fork block numbers, so any filter on the relation
+	 * suppresses its other forks entirely.
+	 */
+	if (XLogPrefetcherIsFiltered(prefetcher, rnode,
+								 forknum == MAIN_FORKNUM ? blkno : MaxBlockNumber))
+	{
+		XLogPrefetchIncrement(&SharedStats->skip_new);
+		return LRQ_NEXT_NO_IO;
+	}
+
+	/* There is no point in repeatedly prefetching the same block. */
+	for (int i = 0; i < XLOGPREFETCHER_SEQ_WINDOW_SIZE; ++i)
+	{
+		if (blkno == prefetcher->recent_block[i] &&
+			forknum == prefetcher->recent_forknum[i] &&
+			RelFileNodeEquals(rnode, prefetcher->recent_rnode[i]))
+		{
+			/*
+			 * XXX If we also remembered where it was, we could set
+			 * recent_buffer so that recovery could skip smgropen() and a
+			 * buffer table lookup.
+			 */
+			XLogPrefetchIncrement(&SharedStats->skip_rep);
+			return LRQ_NEXT_NO_IO;
+		}
+	}
+	prefetcher->recent_rnode[prefetcher->recent_idx] = rnode;
+	prefetcher->recent_forknum[prefetcher->recent_idx] = forknum;
+	prefetcher->recent_block[prefetcher->recent_idx] = blkno;
+	prefetcher->recent_idx =
+		(prefetcher->recent_idx + 1) % XLOGPREFETCHER_SEQ_WINDOW_SIZE;
+
+	/*
+	 * We could try to have a fast path for repeated references to the same
+	 * relation (with some scheme to handle invalidations safely), but for now
+	 * we'll call smgropen() every time.
+	 */
+	reln = smgropen(rnode, InvalidBackendId);
+
+	/*
+	 * If the relation file doesn't exist on disk, for example because we're
+	 * replaying after a crash and the file will be created and then unlinked
+	 * by WAL that hasn't been replayed yet, suppress further prefetching in
+	 * the relation until this record is replayed.  The visibility map and
+	 * free space map are created on demand, so their absence is no reason to
+	 * stop prefetching the main fork.
+	 */
+	if (!smgrexists(reln, forknum))
+	{
+		if (forknum == MAIN_FORKNUM)
+		{
+#ifdef XLOGPREFETCHER_DEBUG_LEVEL
+			elog(XLOGPREFETCHER_DEBUG_LEVEL,
+				 "suppressing all prefetch in relation %u/%u/%u until %X/%X is replayed, because the relation does not exist on disk",
+				 reln->smgr_rnode.node.spcNode,
+				 reln->smgr_rnode.node.dbNode,
+				 reln->smgr_rnode.node.relNode,
+				 LSN_FORMAT_ARGS(lsn));
+#endif
+			XLogPrefetcherAddFilter(prefetcher, rnode, 0, lsn);
+		}
+		XLogPrefetchIncrement(&SharedStats->skip_new);
+		return LRQ_NEXT_NO_IO;
+	}
+
+	/*
+	 * If the relation isn't big enough to contain the referenced block yet,
+	 * suppress prefetching of this block and higher until this record is
+	 * replayed.
+	 */
+	if (blkno >= smgrnblocks(reln, forknum))
+	{
+		if (forknum == MAIN_FORKNUM)
+		{
+#ifdef XLOGPREFETCHER_DEBUG_LEVEL
+			elog(XLOGPREFETCHER_DEBUG_LEVEL,
+				 "suppressing prefetch in relation %u/%u/%u from block %u until %X/%X is replayed, because the relation is too small",
+				 reln->smgr_rnode.node.spcNode,
+				 reln->smgr_rnode.node.dbNode,
+				 reln->smgr_rnode.node.relNode,
+				 blkno,
+				 LSN_FORMAT_ARGS(lsn));
+#endif
+			XLogPrefetcherAddFilter(prefetcher, rnode, blkno, lsn);
+		}
+		XLogPrefetchIncrement(&SharedStats->skip_new);
+		return LRQ_NEXT_NO_IO;
+	}
+
+	/* Try to initiate prefetching. */
+	result = PrefetchSharedBuffer(reln, forknum, blkno);
+	if (BufferIsValid(result.recent_buffer))
+	{
+		/* Cache hit, nothing to do. */
+		XLogPrefetchIncrement(&SharedStats->hit[forknum]);
+		if (recent_buffer)
+			*recent_buffer = result.recent_buffer;
+		return LRQ_NEXT_NO_IO;
+	}
+	else if (result.initiated_io)
+	{
+		/* Cache miss, I/O (presumably) started. */
+		XLogPrefetchIncrement(&SharedStats->prefetch[forknum]);
+		if (recent_buffer)
+			*recent_buffer = InvalidBuffer;
+		return LRQ_NEXT_IO;
+	}
+	else
+	{
+		/*
+		 * This shouldn't be possible, because we already determined that the
+		 * relation exists on disk and is big enough. Something is wrong with
+		 * the cache invalidation for smgrexists(), smgrnblocks(), or the file
+		 * was unlinked or truncated beneath our feet?
+		 */
+		elog(ERROR,
+			 "could not prefetch relation %u/%u/%u fork %d block %u",
+			 reln->smgr_rnode.node.spcNode,
+			 reln->smgr_rnode.node.dbNode,
+			 reln->smgr_rnode.node.relNode,
+			 forknum,
+			 blkno);
+	}
+}
+
+/*
+ * Consider prefetching an SLRU page that replay will read.
+ */
+static LsnReadQueueNextStatus
+XLogPrefetcherPrefetchSlruPage(XLogPrefetcher *prefetcher,
+							   XLogPrefetcherPageKind kind, int pageno)
+{
+	int			slru = kind - XLOGPREFETCHER_PAGE_CLOG;
+	bool		initiated_io;
+	bool		hit;
+
+	/* Runs of records usually touch the same page. */
+	if (prefetcher->recent_slru_page[slru] == pageno)
+	{
+		XLogPrefetchIncrement(&SharedStats->skip_rep);
+		return LRQ_NEXT_NO_IO;
+	}
+	prefetcher->recent_slru_page[slru] = pageno;
+
+	switch (kind)
+	{
+		case XLOGPREFETCHER_PAGE_CLOG:
+			initiated_io = PrefetchCLOGPage(pageno, &hit);
+			break;
+		case XLOGPREFETCHER_PAGE_MULTIXACT_OFFSET:
+			initiated_io = PrefetchMultiXactOffsetPage(pageno, &hit);
+			break;
+		case XLOGPREFETCHER_PAGE_MULTIXACT_MEMBER:
+			initiated_io = PrefetchMultiXactMemberPage(pageno, &hit);
+			break;
+		default:
+			elog(ERROR, "unexpected SLRU page kind %d", (int) kind);
+			pg_unreachable();
+	}
+
+	if (hit)
+	{
+		XLogPrefetchIncrement(&SharedStats->hit_slru);
+		return LRQ_NEXT_NO_IO;
+	}
+	else if (initiated_io)
+	{
+		XLogPrefetchIncrement(&SharedStats->prefetch_slru);
+		return LRQ_NEXT_IO;
+	}
+
+	/* The segment file doesn't exist yet; replay will create the page. */
+	XLogPrefetchIncrement(&SharedStats->skip_new);
+	return LRQ_NEXT_NO_IO;
+}
+
 /*
  * A callback that examines the next block reference in the WAL, and possibly
  * starts an IO so that a later read will be fast.
  *
  * Returns LRQ_NEXT_AGAIN if no more WAL data is available yet.
  *
- * Returns LRQ_NEXT_IO if the next block reference is for a main fork block
- * that isn't in the buffer pool, and the kernel has been asked to start
- * reading it to make a future read system call faster. An LSN is written to
- * *lsn, and the I/O will be considered to have completed once that LSN is
- * replayed.
+ * Returns LRQ_NEXT_IO if the next block reference, or the next page that
+ * replay will read implicitly, isn't in the buffer pool or SLRU buffers, and
+ * the kernel has been asked to start reading it to make a future read system
+ * call faster. An LSN is written to *lsn, and the I/O will be considered to
+ * have completed once that LSN is replayed.
  *
  * Returns LRQ_NO_IO if we examined the next block reference and found that it
  * was already in the buffer pool, or we decided for various reasons not to
@@ -470,7 +953,8 @@ XLogPrefetcherNextBlock(uintptr_t pgsr_private, XLogRecPtr *lsn)
 
 	/*
 	 * We keep track of the record and block we're up to between calls with
-	 * prefetcher->record and prefetcher->next_block_id.
+	 * prefetcher->record, prefetcher->next_block_id and
+	 * prefetcher->next_implicit.
 	 */
 	for (;;)
 	{
@@ -522,6 +1006,7 @@ XLogPrefetcherNextBlock(uintptr_t pgsr_private, XLogRecPtr *lsn)
 			/* We have a new record to process. */
 			prefetcher->record = record;
 			prefetcher->next_block_id = 0;
+			XLogPrefetcherComputeImplicitPages(prefetcher, record);
 		}
 		else
 		{
@@ -651,8 +1136,6 @@ XLogPrefetcherNextBlock(uintptr_t pgsr_private, XLogRecPtr *lsn)
 		{
 			int			block_id = prefetcher->next_block_id++;
 			DecodedBkpBlock *block = &record->blocks[block_id];
-			SMgrRelation reln;
-			PrefetchBufferResult result;
 
 			if (!block->in_use)
 				continue;
@@ -666,12 +1149,6 @@ XLogPrefetcherNextBlock(uintptr_t pgsr_private, XLogRecPtr *lsn)
 			 */
 			*lsn = record->lsn;
 
-			/* We don't try to prefetch anything but the main fork for now. */
-			if (block->forknum != MAIN_FORKNUM)
-			{
-				return LRQ_NEXT_NO_IO;
-			}
-
 			/*
 			 * If there is a full page image attached, we won't be reading the
 			 * page, so don't bother trying to prefetch.
@@ -689,117 +1166,27 @@ XLogPrefetcherNextBlock(uintptr_t pgsr_private, XLogRecPtr *lsn)
 				return LRQ_NEXT_NO_IO;
 			}
 
-			/* Should we skip prefetching this block due to a filter? */
-			if (XLogPrefetcherIsFiltered(prefetcher, block->rnode, block->blkno))
-			{
-				XLogPrefetchIncrement(&SharedStats->skip_new);
-				return LRQ_NEXT_NO_IO;
-			}
-
-			/* There is no point in repeatedly prefetching the same block. */
-			for (int i = 0; i < XLOGPREFETCHER_SEQ_WINDOW_SIZE; ++i)
-			{
-				if (block->blkno == prefetcher->recent_block[i] &&
-					RelFileNodeEquals(block->rnode, prefetcher->recent_rnode[i]))
-				{
-					/*
-					 * XXX If we also remembered where it was, we could set
-					 * recent_buffer so that recovery could skip smgropen()
-					 * and a buffer table lookup.
-					 */
-					XLogPrefetchIncrement(&SharedStats->skip_rep);
-					return LRQ_NEXT_NO_IO;
-				}
-			}
-			prefetcher->recent_rnode[prefetcher->recent_idx] = block->rnode;
-			prefetcher->recent_block[prefetcher->recent_idx] = block->blkno;
-			prefetcher->recent_idx =
-				(prefetcher->recent_idx + 1) % XLOGPREFETCHER_SEQ_WINDOW_SIZE;
-
-			/*
-			 * We could try to have a fast path for repeated references to the
-			 * same relation (with some scheme to handle invalidations
-			 * safely), but for now we'll call smgropen() every time.
-			 */
-			reln = smgropen(block->rnode, InvalidBackendId);
+			return XLogPrefetcherPrefetchBlock(prefetcher, record->lsn,
+											   block->rnode, block->forknum,
+											   block->blkno,
+											   &block->prefetch_buffer);
+		}
 
-			/*
-			 * If the relation file doesn't exist on disk, for example because
-			 * we're replaying after a crash and the file will be created and
-			 * then unlinked by WAL that hasn't been replayed yet, suppress
-			 * further prefetching in the relation until this record is
-			 * replayed.
-			 */
-			if (!smgrexists(reln, MAIN_FORKNUM))
-			{
-#ifdef XLOGPREFETCHER_DEBUG_LEVEL
-				elog(XLOGPREFETCHER_DEBUG_LEVEL,
-					 "suppressing all prefetch in relation %u/%u/%u until %X/%X is replayed, because the relation does not exist on disk",
-					 reln->smgr_rnode.node.spcNode,
-					 reln->smgr_rnode.node.dbNode,
-					 reln->smgr_rnode.node.relNode,
-					 LSN_FORMAT_ARGS(record->lsn));
-#endif
-				XLogPrefetcherAddFilter(prefetcher, block->rnode, 0,
-										record->lsn);
-				XLogPrefetchIncrement(&SharedStats->skip_new);
-				return LRQ_NEXT_NO_IO;
-			}
+		/* Then the pages that replay will read without a block reference. */
+		if (prefetcher->next_implicit < prefetcher->nimplicit)
+		{
+			XLogPrefetcherImplicitPage *page =
+			&prefetcher->implicit[prefetcher->next_implicit++];
 
-			/*
-			 * If the relation isn't big enough to contain the referenced
-			 * block yet, suppress prefetching of this block and higher until
-			 * this record is replayed.
-			 */
-			if (block->blkno >= smgrnblocks(reln, block->forknum))
-			{
-#ifdef XLOGPREFETCHER_DEBUG_LEVEL
-				elog(XLOGPREFETCHER_DEBUG_LEVEL,
-					 "suppressing prefetch in relation %u/%u/%u from block %u until %X/%X is replayed, because the relation is too small",
-					 reln->smgr_rnode.node.spcNode,
-					 reln->smgr_rnode.node.dbNode,
-					 reln->smgr_rnode.node.relNode,
-					 block->blkno,
-					 LSN_FORMAT_ARGS(record->lsn));
-#endif
-				XLogPrefetcherAddFilter(prefetcher, block->rnode, block->blkno,
-										record->lsn);
-				XLogPrefetchIncrement(&SharedStats->skip_new);
-				return LRQ_NEXT_NO_IO;
-			}
+			*lsn = record->lsn;
 
-			/* Try to initiate prefetching. */
-			result = PrefetchSharedBuffer(reln, block->forknum, block->blkno);
-			if (BufferIsValid(result.recent_buffer))
-			{
-				/* Cache hit, nothing to do. */
-				XLogPrefetchIncrement(&SharedStats->hit);
-				block->prefetch_buffer = result.recent_buffer;
-				return LRQ_NEXT_NO_IO;
-			}
-			else if (result.initiated_io)
-			{
-				/* Cache miss, I/O (presumably) started. */
-				XLogPrefetchIncrement(&SharedStats->prefetch);
-				block->prefetch_buffer = InvalidBuffer;
-				return LRQ_NEXT_IO;
-			}
+			if (page->kind == XLOGPREFETCHER_PAGE_BLOCK)
+				return XLogPrefetcherPrefetchBlock(prefetcher, record->lsn,
+												   page->rnode, page->forknum,
+												   page->blkno, NULL);
 			else
-			{
-				/*
-				 * This shouldn't be possible, because we already determined
-				 * that the relation exists on disk and is big enough.
-				 * Something is wrong with the cache invalidation for
-				 * smgrexists(), smgrnblocks(), or the file was unlinked or
-				 * truncated beneath our feet?
-				 */
-				elog(ERROR,
-					 "could not prefetch relation %u/%u/%u block %u",
-					 reln->smgr_rnode.node.spcNode,
-					 reln->smgr_rnode.node.dbNode,
-					 reln->smgr_rnode.node.relNode,
-					 block->blkno);
-			}
+				return XLogPrefetcherPrefetchSlruPage(prefetcher, page->kind,
+													  page->pageno);
 		}
 
 		/*
@@ -828,26 +1215,46 @@ XLogPrefetcherNextBlock(uintptr_t pgsr_private, XLogRecPtr *lsn)
 Datum
 pg_stat_get_recovery_prefetch(PG_FUNCTION_ARGS)
 {
-#define PG_STAT_GET_RECOVERY_PREFETCH_COLS 10
+#define PG_STAT_GET_RECOVERY_PREFETCH_COLS 18
 	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
 	Datum		values[PG_STAT_GET_RECOVERY_PREFETCH_COLS];
 	bool		nulls[PG_STAT_GET_RECOVERY_PREFETCH_COLS];
+	int64		prefetch[MAX_FORKNUM + 1];
+	int64		hit[MAX_FORKNUM + 1];
+	int64		prefetch_total = 0;
+	int64		hit_total = 0;
 
 	SetSingleFuncCall(fcinfo, 0);
 
 	for (int i = 0; i < PG_STAT_GET_RECOVERY_PREFETCH_COLS; ++i)
 		nulls[i] = false;
 
+	for (int i = 0; i <= MAX_FORKNUM; ++i)
+	{
+		prefetch[i] = pg_atomic_read_u64(&SharedStats->prefetch[i]);
+		hit[i] = pg_atomic_read_u64(&SharedStats->hit[i]);
+		prefetch_total += prefetch[i];
+		hit_total += hit[i];
+	}
+
 	values[0] = TimestampTzGetDatum(pg_atomic_read_u64(&SharedStats->reset_time));
-	values[1] = Int64GetDatum(pg_atomic_read_u64(&SharedStats->prefetch));
-	values[2] = Int64GetDatum(pg_atomic_read_u64(&SharedStats->hit));
-	values[3] = Int64GetDatum(pg_atomic_read_u64(&SharedStats->skip_init));
-	values[4] = Int64GetDatum(pg_atomic_read_u64(&SharedStats->skip_new));
-	values[5] = Int64GetDatum(pg_atomic_read_u64(&SharedStats->skip_fpw));
-	values[6] = Int64GetDatum(pg_atomic_read_u64(&SharedStats->skip_rep));
-	values[7] = Int32GetDatum(SharedStats->wal_distance);
-	values[8] = Int32GetDatum(SharedStats->block_distance);
-	values[9] = Int32GetDatum(SharedStats->io_depth);
+	values[1] = Int64GetDatum(prefetch_total);
+	values[2] = Int64GetDatum(hit_total);
+	values[3] = Int64GetDatum(prefetch[MAIN_FORKNUM]);
+	values[4] = Int64GetDatum(hit[MAIN_FORKNUM]);
+	values[5] = Int64GetDatum(prefetch[FSM_FORKNUM]);
+	values[6] = Int64GetDatum(hit[FSM_FORKNUM]);
+	values[7] = Int64GetDatum(prefetch[VISIBILITYMAP_FORKNUM]);
+	values[8] = Int64GetDatum(hit[VISIBILITYMAP_FORKNUM]);
+	values[9] = Int64GetDatum(pg_atomic_read_u64(&SharedStats->prefetch_slru));
+	values[10] = Int64GetDatum(pg_atomic_read_u64(&SharedStats->hit_slru));
+	values[11] = Int64GetDatum(pg_atomic_read_u64(&SharedStats->skip_init));
+	values[12] = Int64GetDatum(pg_atomic_read_u64(&SharedStats->skip_new));
+	values[13] = Int64GetDatum(pg_atomic_read_u64(&SharedStats->skip_fpw));
+	values[14] = Int64GetDatum(pg_atomic_read_u64(&SharedStats->skip_rep));
+	values[15] = Int32GetDatum(SharedStats->wal_distance);
+	values[16] = Int32GetDatum(SharedStats->block_distance);
+	values[17] = Int32GetDatum(SharedStats->io_depth);
 	tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
 
 	return (Datum) 0;
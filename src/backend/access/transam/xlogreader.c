@@ -53,6 +53,8 @@ static bool ValidXLogRecordHeader(XLogReaderState *state, XLogRecPtr RecPtr,
 static bool ValidXLogRecord(XLogReaderState *state, XLogRecord *record,
 							XLogRecPtr recptr);
 static void ResetDecoder(XLogReaderState *state);
+static void FreeDictionaries(XLogReaderState *state);
+static void *DictionaryAlloc(XLogReaderState *state, Size size);
 static void WALOpenSegmentInit(WALOpenSegment *seg, WALSegmentContext *segcxt,
 							   int segsize, const char *waldir);
 
@@ -65,6 +67,24 @@ static void WALOpenSegmentInit(WALOpenSegment *seg, WALSegmentContext *segcxt,
  */
 #define DEFAULT_DECODE_BUFFER_SIZE (64 * 1024)
 
+/*
+ * Number of WAL compression dictionaries remembered.  Dictionaries are only
+ * replaced at checkpoints, so this is plenty for any records that can be
+ * decoded ahead of the one being replayed.
+ */
+#define MAX_READER_DICTIONARIES	16
+
+/* A WAL compression dictionary seen in an XLOG_FPI_DICTIONARY record */
+typedef struct XLogReaderDictionary
+{
+	uint32		id;				/* 0 if the slot is unused */
+	uint32		len;
+	char	   *data;
+#ifdef USE_ZSTD
+	ZSTD_DDict *ddict;			/* created on first use */
+#endif
+} XLogReaderDictionary;
+
 /*
  * Construct a string in state->errormsg_buf explaining what's wrong with
  * the current record being read.
@@ -175,6 +195,8 @@ XLogReaderFree(XLogReaderState *state)
 	if (state->decode_buffer && state->free_decode_buffer)
 		pfree(state->decode_buffer);
 
+	FreeDictionaries(state);
+
 	pfree(state->errormsg_buf);
 	if (state->readRecordBuf)
 		pfree(state->readRecordBuf);
@@ -182,6 +204,135 @@ XLogReaderFree(XLogReaderState *state)
 	pfree(state);
 }
 
+/*
+ * Release the WAL compression dictionaries remembered by a reader.
+ */
+static void
+FreeDictionaries(XLogReaderState *state)
+{
+	if (state->dictionaries != NULL)
+	{
+		for (int i = 0; i < MAX_READER_DICTIONARIES; i++)
+		{
+			XLogReaderDictionary *dict = &state->dictionaries[i];
+
+			if (dict->data)
+				pfree(dict->data);
+#ifdef USE_ZSTD
+			if (dict->ddict)
+				ZSTD_freeDDict(dict->ddict);
+#endif
+		}
+		pfree(state->dictionaries);
+		state->dictionaries = NULL;
+	}
+
+#ifdef USE_ZSTD
+	if (state->zstd_dctx)
+		ZSTD_freeDCtx(state->zstd_dctx);
+	state->zstd_dctx = NULL;
+#endif
+}
+
+/*
+ * Allocate zeroed memory for dictionaries.  Records are decoded in whatever
+ * memory context the caller happens to be in, but dictionaries must live as
+ * long as the reader.  Returns NULL if out of memory.
+ */
+static void *
+DictionaryAlloc(XLogReaderState *state, Size size)
+{
+#ifndef FRONTEND
+	return MemoryContextAllocExtended(GetMemoryChunkContext(state), size,
+									  MCXT_ALLOC_NO_OOM | MCXT_ALLOC_ZERO);
+#else
+	return palloc_extended(size, MCXT_ALLOC_NO_OOM | MCXT_ALLOC_ZERO);
+#endif
+}
+
+/*
+ * Remember the WAL compression dictionary carried by an XLOG_FPI_DICTIONARY
+ * record, so that full-page images compressed with it can be restored.
+ * 'data' and 'len' are the record's main data.
+ *
+ * DecodeXLogRecord() calls this for every such record it decodes.  Returns
+ * false on failure, with an error message in state->errormsg_buf.
+ */
+bool
+XLogReaderRememberDictionary(XLogReaderState *state, const char *data,
+							 Size len)
+{
+	xl_fpi_dictionary xlrec;
+	XLogReaderDictionary *dict = NULL;
+	char	   *content;
+
+	if (len < SizeOfFPIDictionary)
+		goto bad;
+	memcpy(&xlrec, data, SizeOfFPIDictionary);
+	if (xlrec.dict_id == 0 || xlrec.dict_len != len - SizeOfFPIDictionary)
+		goto bad;
+	data += SizeOfFPIDictionary;
+
+	if (state->dictionaries == NULL)
+	{
+		state->dictionaries = (XLogReaderDictionary *)
+			DictionaryAlloc(state,
+							sizeof(XLogReaderDictionary) * MAX_READER_DICTIONARIES);
+		if (state->dictionaries == NULL)
+			goto oom;
+	}
+
+	/* Dictionaries are logged again after every checkpoint */
+	for (int i = 0; i < MAX_READER_DICTIONARIES; i++)
+	{
+		if (state->dictionaries[i].id == xlrec.dict_id)
+		{
+			dict = &state->dictionaries[i];
+			if (dict->len == xlrec.dict_len &&
+				memcmp(dict->data, data, xlrec.dict_len) == 0)
+				return true;
+			break;
+		}
+	}
+
+	if (dict == NULL)
+	{
+		dict = &state->dictionaries[state->next_dictionary];
+		state->next_dictionary =
+			(state->next_dictionary + 1) % MAX_READER_DICTIONARIES;
+	}
+
+	content = DictionaryAlloc(state, xlrec.dict_len);
+	if (content == NULL)
+		goto oom;
+	memcpy(content, data, xlrec.dict_len);
+
+	if (dict->data)
+		pfree(dict->data);
+#ifdef USE_ZSTD
+	if (dict->ddict)
+		ZSTD_freeDDict(dict->ddict);
+	dict->ddict = NULL;
+#endif
+	dict->id = xlrec.dict_id;
+	dict->len = xlrec.dict_len;
+	dict->data = content;
+
+	return true;
+
+bad:
+	report_invalid_record(state,
+						  "invalid WAL compression dictionary at %X/%X",
+						  LSN_FORMAT_ARGS(state->ReadRecPtr));
+	return false;
+
+oom:
+	report_invalid_record(state,
+						  "out of memory while remembering WAL compression dictionary at %X/%X",
+						  LSN_FORMAT_ARGS(state->ReadRecPtr));
+	return false;
+}
+
 /*
  * Allocate readRecordBuf to fit a record of at least the given length.
  * Returns true if successful, false if out of memory.
@@ -1787,6 +1938,10 @@ DecodeXLogRecord(XLogReaderState *state,
 				}
 				else
 					blk->hole_length = BLCKSZ - blk->bimg_len;
+				if (blk->bimg_info & BKPIMAGE_COMPRESS_ZSTD_DICT)
+					COPY_HEADER_FIELD(&blk->bimg_dict_id, sizeof(uint32));
+				else
+					blk->bimg_dict_id = 0;
 				datatotal += blk->bimg_len;
 
 				/*
@@ -1935,6 +2090,17 @@ DecodeXLogRecord(XLogReaderState *state,
 	Assert(DecodeXLogRecordRequiredSpace(record->xl_tot_len) >=
 		   decoded->size);
 
+	/*
+	 * Remember WAL compression dictionaries as soon as we see them, because
+	 * records decoded after this one may need them before this one is
+	 * consumed by the caller.
+	 */
+	if (record->xl_rmid == RM_XLOG_ID &&
+		(record->xl_info & ~XLR_INFO_MASK) == XLOG_FPI_DICTIONARY &&
+		!XLogReaderRememberDictionary(state, decoded->main_data,
+									  decoded->main_data_len))
+		goto err;
+
 	return true;
 
 shortdata_err:
@@ -2104,6 +2270,56 @@ RestoreBlockImage(XLogReaderState *record, uint8 block_id, char *page)
 								  "zstd",
 								  block_id);
 			return false;
+#endif
+		}
+		else if ((bkpb->bimg_info & BKPIMAGE_COMPRESS_ZSTD_DICT) != 0)
+		{
+#ifdef USE_ZSTD
+			XLogReaderDictionary *dict = NULL;
+			size_t		decomp_result;
+
+			for (int i = 0; record->dictionaries && i < MAX_READER_DICTIONARIES; i++)
+			{
+				if (record->dictionaries[i].id == bkpb->bimg_dict_id)
+				{
+					dict = &record->dictionaries[i];
+					break;
+				}
+			}
+			if (dict == NULL)
+			{
+				report_invalid_record(record, "could not restore image at %X/%X compressed with unknown dictionary %u, block %d",
+									  LSN_FORMAT_ARGS(record->ReadRecPtr),
+									  bkpb->bimg_dict_id,
+									  block_id);
+				return false;
+			}
+
+			if (dict->ddict == NULL)
+				dict->ddict = ZSTD_createDDict(dict->data, dict->len);
+			if (record->zstd_dctx == NULL)
+				record->zstd_dctx = ZSTD_createDCtx();
+			if (dict->ddict == NULL || record->zstd_dctx == NULL)
+			{
+				report_invalid_record(record, "out of memory while restoring image at %X/%X, block %d",
+									  LSN_FORMAT_ARGS(record->ReadRecPtr),
+									  block_id);
+				return false;
+			}
+
+			decomp_result = ZSTD_decompress_usingDDict(record->zstd_dctx,
+													   tmp.data,
+													   BLCKSZ - bkpb->hole_length,
+													   ptr, bkpb->bimg_len,
+													   dict->ddict);
+			if (ZSTD_isError(decomp_result))
+				decomp_success = false;
+#else
+			report_invalid_record(record, "could not restore image at %X/%X compressed with %s not supported by build, block %d",
+								  LSN_FORMAT_ARGS(record->ReadRecPtr),
+								  "zstd",
+								  block_id);
+			return false;
 #endif
 		}
 		else
@@ -36,6 +36,7 @@
 #include "access/xact.h"
 #include "access/xlog_internal.h"
 #include "access/xlogarchive.h"
+#include "access/xlogparallelredo.h"
 #include "access/xlogprefetcher.h"
 #include "access/xlogreader.h"
 #include "access/xlogrecovery.h"
@@ -1637,6 +1638,8 @@ PerformWalRecovery(void)
 
 		RmgrStartup();
 
+		ParallelRedoStartup();
+
 		ereport(LOG,
 				(errmsg("redo starts at %X/%X",
 						LSN_FORMAT_ARGS(xlogreader->ReadRecPtr))));
@@ -1739,6 +1742,9 @@ PerformWalRecovery(void)
 		 * end of main redo apply loop
 		 */
 
+		/* Let parallel redo workers finish replaying what we gave them */
+		ParallelRedoShutdown();
+
 		if (reachedRecoveryTarget)
 		{
 			if (!reachedConsistency)
@@ -1890,8 +1896,12 @@ ApplyWalRecord(XLogReaderState *xlogreader, XLogRecord *record, TimeLineID *repl
 	if (record->xl_rmid == RM_XLOG_ID)
 		xlogrecovery_redo(xlogreader, *replayTLI);
 
-	/* Now apply the WAL record itself */
-	GetRmgr(record->xl_rmid).rm_redo(xlogreader);
+	/*
+	 * Now apply the WAL record itself, unless a parallel redo worker will do
+	 * that for us.
+	 */
+	if (!ParallelRedoDispatch(xlogreader))
+		GetRmgr(record->xl_rmid).rm_redo(xlogreader);
 
 	/*
 	 * After redo, check whether the backup pages associated with the WAL
@@ -2085,6 +2095,9 @@ CheckRecoveryConsistency(void)
 	{
 		elog(DEBUG1, "end of backup reached");
 
+		/* Everything up to here must really have been replayed */
+		ParallelRedoWaitForWorkers();
+
 		/*
 		 * We have reached the end of base backup, as indicated by pg_control.
 		 * Update the control file accordingly.
@@ -2108,6 +2121,7 @@ CheckRecoveryConsistency(void)
 		 * Check to see if the XLOG sequence contained any unresolved
 		 * references to uninitialized pages.
 		 */
+		ParallelRedoCheckInvalidPages();
 		XLogCheckInvalidPages();
 
 		/*
@@ -2801,6 +2815,9 @@ recoveryPausesHere(bool endOfRecovery)
 	if (LocalPromoteIsTriggered)
 		return;
 
+	/* Let queries see everything replayed up to here while we're paused */
+	ParallelRedoWaitForWorkers();
+
 	if (endOfRecovery)
 		ereport(LOG,
 				(errmsg("pausing at the end of recovery"),
@@ -22,11 +22,13 @@
 #include "access/timeline.h"
 #include "access/xlogrecovery.h"
 #include "access/xlog_internal.h"
+#include "access/xlogparallelredo.h"
 #include "access/xlogprefetcher.h"
 #include "access/xlogutils.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "storage/fd.h"
+#include "storage/lock.h"
 #include "storage/smgr.h"
 #include "utils/guc.h"
 #include "utils/hsearch.h"
@@ -39,7 +41,8 @@ bool		ignore_invalid_pages = false;
 /*
  * Are we doing recovery from XLOG?
  *
- * This is only ever true in the startup process; it should be read as meaning
+ * This is only ever true in the startup process and in parallel redo workers
+ * (see xlogparallelredo.c); it should be read as meaning
  * "this process is replaying WAL records", rather than "the system is in
  * recovery mode".  It should be examined primarily by functions that need
  * to act differently when called from a WAL redo function (e.g., to skip WAL
@@ -239,6 +242,8 @@ XLogHaveInvalidPages(void)
 	if (invalid_page_tab != NULL &&
 		hash_get_num_entries(invalid_page_tab) > 0)
 		return true;
+	if (ParallelRedoHaveInvalidPages())
+		return true;
 	return false;
 }
 
@@ -477,6 +482,8 @@ XLogReadBufferExtended(RelFileNode rnode, ForkNumber forknum,
 	BlockNumber lastblock;
 	Buffer		buffer;
 	SMgrRelation smgr;
+	LOCKTAG		tag;
+	bool		extend_locked = false;
 
 	Assert(blkno != P_NEW);
 
@@ -504,6 +511,22 @@ XLogReadBufferExtended(RelFileNode rnode, ForkNumber forknum,
 
 	lastblock = smgrnblocks(smgr, forknum);
 
+	/*
+	 * With parallel redo, other processes may be extending the relation
+	 * concurrently, and our cached size may be out of date.  Take the
+	 * relation extension lock, the same way a fake relcache entry would, and
+	 * look again.
+	 */
+	if (blkno >= lastblock && ParallelRedoActive())
+	{
+		SET_LOCKTAG_RELATION_EXTEND(tag, rnode.dbNode, rnode.relNode);
+		(void) LockAcquire(&tag, ExclusiveLock, false, false);
+		extend_locked = true;
+
+		smgr->smgr_cached_nblocks[forknum] = InvalidBlockNumber;
+		lastblock = smgrnblocks(smgr, forknum);
+	}
+
 	if (blkno < lastblock)
 	{
 		/* page exists in file */
@@ -515,13 +538,22 @@ XLogReadBufferExtended(RelFileNode rnode, ForkNumber forknum,
 		/* hm, page doesn't exist in file */
 		if (mode == RBM_NORMAL)
 		{
+			if (extend_locked)
+				LockRelease(&tag, ExclusiveLock, false);
 			log_invalid_page(rnode, forknum, blkno, false);
 			return InvalidBuffer;
 		}
 		if (mode == RBM_NORMAL_NO_LOG)
+		{
+			if (extend_locked)
+				LockRelease(&tag, ExclusiveLock, false);
 			return InvalidBuffer;
+		}
 		/* OK to extend the file */
-		/* we do this in recovery only - no rel-extension lock needed */
+		/*
+		 * We do this in recovery only - no rel-extension lock needed, unless
+		 * parallel redo workers are running, in which case we took it above.
+		 */
 		Assert(InRecovery);
 		buffer = InvalidBuffer;
 		do
@@ -547,6 +579,9 @@ XLogReadBufferExtended(RelFileNode rnode, ForkNumber forknum,
 		}
 	}
 
+	if (extend_locked)
+		LockRelease(&tag, ExclusiveLock, false);
+
 recent_buffer_fast_path:
 	if (mode == RBM_NORMAL)
 	{
@@ -657,6 +692,7 @@ void
 XLogDropRelation(RelFileNode rnode, ForkNumber forknum)
 {
 	forget_invalid_pages(rnode, forknum, 0);
+	ParallelRedoForgetInvalidPages(rnode, forknum, 0);
 }
 
 /*
@@ -676,6 +712,7 @@ XLogDropDatabase(Oid dbid)
 	smgrcloseall();
 
 	forget_invalid_pages_db(dbid);
+	ParallelRedoForgetInvalidPagesDb(dbid);
 }
 
 /*
@@ -688,6 +725,7 @@ XLogTruncateRelation(RelFileNode rnode, ForkNumber forkNum,
 					 BlockNumber nblocks)
 {
 	forget_invalid_pages(rnode, forkNum, nblocks);
+	ParallelRedoForgetInvalidPages(rnode, forkNum, nblocks);
 }
 
 /*
@@ -35,6 +35,7 @@
 #include "replication/walsender_private.h"
 #include "storage/bufpage.h"
 #include "storage/checksum.h"
+#include "storage/doublewrite.h"
 #include "storage/dsm_impl.h"
 #include "storage/fd.h"
 #include "storage/ipc.h"
@@ -179,6 +180,12 @@ static const struct exclude_list_item excludeFiles[] =
 	 */
 	{RELCACHE_INIT_FILENAME, true},
 
+	/*
+	 * Skip the double-write buffer.  Backups always use full-page writes, and
+	 * the server recreates it on startup.
+	 */
+	{DOUBLE_WRITE_FILENAME, false},
+
 	/*
 	 * backup_label and tablespace_map should not exist in a running cluster
 	 * capable of doing an online backup, but exclude them just in case.
@@ -932,6 +932,14 @@ CREATE VIEW pg_stat_recovery_prefetch AS
             s.stats_reset,
             s.prefetch,
             s.hit,
+            s.prefetch_main,
+            s.hit_main,
+            s.prefetch_fsm,
+            s.hit_fsm,
+            s.prefetch_vm,
+            s.hit_vm,
+            s.prefetch_slru,
+            s.hit_slru,
             s.skip_init,
             s.skip_new,
             s.skip_fpw,
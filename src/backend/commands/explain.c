@@ -897,6 +897,9 @@ ExplainPrintJIT(ExplainState *es, int jit_flags, JitInstrumentation *ji)
 		es->indent++;
 
 		ExplainPropertyInteger("Functions", NULL, ji->created_functions, es);
+		if (ji->cached_functions > 0)
+			ExplainPropertyInteger("Cached Functions", NULL,
+								   ji->cached_functions, es);
 
 		ExplainIndentText(es);
 		appendStringInfo(es->str, "Options: %s %s, %s %s, %s %s, %s %s\n",
@@ -922,6 +925,9 @@ ExplainPrintJIT(ExplainState *es, int jit_flags, JitInstrumentation *ji)
 	else
 	{
 		ExplainPropertyInteger("Functions", NULL, ji->created_functions, es);
+		if (ji->cached_functions > 0)
+			ExplainPropertyInteger("Cached Functions", NULL,
+								   ji->cached_functions, es);
 
 		ExplainOpenGroup("Options", "Options", true, es);
 		ExplainPropertyBool("Inlining", jit_flags & PGJIT_INLINE, es);
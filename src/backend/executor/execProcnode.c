@@ -69,6 +69,17 @@
  *		ExecInitNode(), ExecProcNode() and ExecEndNode() dispatch
  *		their work to the appropriate node support routines which may
  *		in turn call these routines themselves on their subplans.
+ *
+ *	 BATCH MODE
+ *		Some node types can also return their tuples in batches of up to
+ *		executor_batch_size tuples via ExecProcNodeBatch().  A node that
+ *		supports this sets its ExecProcNodeBatch callback during
+ *		initialization; a parent that consumes its entire input anyway
+ *		(currently only Agg) may then fetch batches instead of calling
+ *		ExecProcNode() once per tuple.  This amortizes the per-tuple
+ *		dispatch and lets the child run its scan, qual and projection
+ *		loops back to back over the whole batch.  A node must keep
+ *		supporting plain ExecProcNode() calls as well.
  */
 #include "postgres.h"
 
@@ -121,8 +132,13 @@
 
 static TupleTableSlot *ExecProcNodeFirst(PlanState *node);
 static TupleTableSlot *ExecProcNodeInstr(PlanState *node);
+static TupleBatch *ExecProcNodeBatchFirst(PlanState *node);
+static TupleBatch *ExecProcNodeBatchInstr(PlanState *node);
 static bool ExecShutdownNode_walker(PlanState *node, void *context);
 
+/* GUC parameter: maximum number of tuples per batch, 0 disables batch mode */
+int			executor_batch_size = 0;
+
 
 /* ------------------------------------------------------------------------
  *		ExecInitNode
@@ -389,6 +405,8 @@ ExecInitNode(Plan *node, EState *estate, int eflags)
 	}
 
 	ExecSetExecProcNode(result, result->ExecProcNode);
+	if (result->ExecProcNodeBatch != NULL)
+		ExecSetExecProcNodeBatch(result, result->ExecProcNodeBatch);
 
 	/*
 	 * Initialize any initPlans present in this node.  The planner put them in
@@ -485,6 +503,58 @@ ExecProcNodeInstr(PlanState *node)
 }
 
 
+/*
+ * If a node wants to change its ExecProcNodeBatch function after
+ * ExecInitNode() has finished, it should do so with this function.  That
+ * way any wrapper functions can be reinstalled, without the node having to
+ * know how that works.
+ */
+void
+ExecSetExecProcNodeBatch(PlanState *node, ExecProcNodeBatchMtd function)
+{
+	/* See ExecSetExecProcNode() */
+	node->ExecProcNodeBatchReal = function;
+	node->ExecProcNodeBatch = ExecProcNodeBatchFirst;
+}
+
+
+/*
+ * ExecProcNodeBatch wrapper that performs some one-time checks, like
+ * ExecProcNodeFirst().
+ */
+static TupleBatch *
+ExecProcNodeBatchFirst(PlanState *node)
+{
+	check_stack_depth();
+
+	if (node->instrument)
+		node->ExecProcNodeBatch = ExecProcNodeBatchInstr;
+	else
+		node->ExecProcNodeBatch = node->ExecProcNodeBatchReal;
+
+	return node->ExecProcNodeBatch(node);
+}
+
+
+/*
+ * ExecProcNodeBatch wrapper that performs instrumentation calls, counting
+ * each tuple of the returned batch.
+ */
+static TupleBatch *
+ExecProcNodeBatchInstr(PlanState *node)
+{
+	TupleBatch *result;
+
+	InstrStartNode(node->instrument);
+
+	result = node->ExecProcNodeBatchReal(node);
+
+	InstrStopNode(node->instrument, result == NULL ? 0.0 : result->nvalid);
+
+	return result;
+}
+
+
 /* ----------------------------------------------------------------
  *		MultiExecProcNode
  *
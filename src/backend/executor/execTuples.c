@@ -63,6 +63,7 @@
 #include "catalog/pg_type.h"
 #include "funcapi.h"
 #include "nodes/nodeFuncs.h"
+#include "port/pg_bswap.h"
 #include "storage/bufmgr.h"
 #include "utils/builtins.h"
 #include "utils/expandeddatum.h"
@@ -907,6 +908,43 @@ tts_buffer_heap_store_tuple(TupleTableSlot *slot, HeapTuple tuple,
 	}
 }
 
+/*
+ * slot_expand_null_bitmap
+ *		Set isnull[attnum .. natts - 1] from a heap tuple's null bitmap.
+ *
+ * Whole bytes of the bitmap are expanded eight attributes at a time, with
+ * plain 64-bit arithmetic: the byte is replicated into every byte of a word,
+ * byte i keeps only bit i, and each byte is then reduced to 0 or 1.
+ */
+static inline void
+slot_expand_null_bitmap(bool *isnull, bits8 *bp, int attnum, int natts)
+{
+	StaticAssertStmt(sizeof(bool) == 1, "bool must be one byte");
+
+	/* one at a time up to a byte boundary of the bitmap */
+	for (; attnum < natts && (attnum & 7) != 0; attnum++)
+		isnull[attnum] = att_isnull(attnum, bp);
+
+	for (; attnum + 8 <= natts; attnum += 8)
+	{
+		uint64		bits;
+
+		bits = (uint64) bp[attnum >> 3] * UINT64CONST(0x0101010101010101);
+		bits &= UINT64CONST(0x8040201008040201);
+		bits = ((bits + UINT64CONST(0x7F7F7F7F7F7F7F7F)) &
+				UINT64CONST(0x8080808080808080)) >> 7;
+		/* a set bit means the attribute is not null */
+		bits ^= UINT64CONST(0x0101010101010101);
+#ifdef WORDS_BIGENDIAN
+		bits = pg_bswap64(bits);
+#endif
+		memcpy(&isnull[attnum], &bits, sizeof(bits));
+	}
+
+	for (; attnum < natts; attnum++)
+		isnull[attnum] = att_isnull(attnum, bp);
+}
+
 /*
  * slot_deform_heap_tuple
  *		Given a TupleTableSlot, extract data from the slot's physical tuple
@@ -935,6 +973,7 @@ slot_deform_heap_tuple(TupleTableSlot *slot, HeapTuple tuple, uint32 *offp,
 	uint32		off;			/* offset in tuple data */
 	bits8	   *bp = tup->t_bits;	/* ptr to null bitmap in tuple */
 	bool		slow;			/* can we use/set attcacheoff? */
+	int			nfixed;			/* # of attributes at known offsets */
 
 	/* We can only fetch as many attributes as the tuple has. */
 	natts = Min(HeapTupleHeaderGetNatts(tuple->t_data), natts);
@@ -959,20 +998,52 @@ slot_deform_heap_tuple(TupleTableSlot *slot, HeapTuple tuple, uint32 *offp,
 
 	tp = (char *) tup + tup->t_hoff;
 
+	/*
+	 * The leading fixed-width attributes are at precomputed offsets, as long
+	 * as none of them is null.  That's certain if the tuple has no nulls at
+	 * all, and for the ones declared NOT NULL.  Fetch those without any
+	 * per-attribute null check or alignment computation.
+	 */
+	if (unlikely(tupleDesc->tdfixedatts < 0))
+		TupleDescComputeFixedAtts(tupleDesc);
+	nfixed = hasnulls ? tupleDesc->tdnotnullatts : tupleDesc->tdfixedatts;
+	nfixed = Min(nfixed, natts);
+
+	if (attnum < nfixed)
+	{
+		Form_pg_attribute thisatt;
+
+		Assert(!slow);
+		do
+		{
+			thisatt = TupleDescAttr(tupleDesc, attnum);
+			values[attnum] = fetchatt(thisatt, tp + thisatt->attcacheoff);
+			isnull[attnum] = false;
+		} while (++attnum < nfixed);
+
+		off = thisatt->attcacheoff + thisatt->attlen;
+	}
+
+	/* Set the null flags of the remaining attributes in bulk */
+	if (attnum < natts)
+	{
+		if (hasnulls)
+			slot_expand_null_bitmap(isnull, bp, attnum, natts);
+		else
+			memset(isnull + attnum, 0, (natts - attnum) * sizeof(bool));
+	}
+
 	for (; attnum < natts; attnum++)
 	{
 		Form_pg_attribute thisatt = TupleDescAttr(tupleDesc, attnum);
 
-		if (hasnulls && att_isnull(attnum, bp))
+		if (isnull[attnum])
 		{
 			values[attnum] = (Datum) 0;
-			isnull[attnum] = true;
 			slow = true;		/* can't use attcacheoff anymore */
 			continue;
 		}
 
-		isnull[attnum] = false;
-
 		if (!slow && thisatt->attcacheoff >= 0)
 			off = thisatt->attcacheoff;
 		else if (thisatt->attlen == -1)
@@ -1835,6 +1906,33 @@ ExecInitExtraTupleSlot(EState *estate,
 	return ExecAllocTableSlot(&estate->es_tupleTable, tupledesc, tts_ops);
 }
 
+/* ----------------
+ *		ExecInitTupleBatch
+ *
+ * Return a newly created TupleBatch with room for nslots tuples, all held
+ * in slots of the given type.  The slots are registered in the estate's
+ * tuple table, so they are released at executor shutdown like any other.
+ * ----------------
+ */
+TupleBatch *
+ExecInitTupleBatch(EState *estate, int nslots, TupleDesc tupledesc,
+				   const TupleTableSlotOps *tts_ops)
+{
+	TupleBatch *batch;
+	int			i;
+
+	Assert(nslots > 0);
+
+	batch = palloc(sizeof(TupleBatch));
+	batch->nvalid = 0;
+	batch->maxslots = nslots;
+	batch->slots = palloc(nslots * sizeof(TupleTableSlot *));
+	for (i = 0; i < nslots; i++)
+		batch->slots[i] = ExecInitExtraTupleSlot(estate, tupledesc, tts_ops);
+
+	return batch;
+}
+
 /* ----------------
  *		ExecInitNullTupleSlot
  *
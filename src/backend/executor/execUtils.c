@@ -158,6 +158,7 @@ CreateExecutorState(void)
 
 	estate->es_jit_flags = 0;
 	estate->es_jit = NULL;
+	estate->es_jit_pending = NIL;
 
 	/*
 	 * Return the executor state structure
@@ -226,6 +226,21 @@
  *	  imposing a limit on the number of groups separately from the amount of
  *	  memory consumed.
  *
+ *	  Parallel HashAggregate
+ *
+ *	  A parallel-aware AGG_HASHED node with a single grouping set runs below
+ *	  a Gather, over a partial input plan.  Transition states live in
+ *	  backend-local memory, so instead of sharing a hash table, the
+ *	  participants share the work: each one first reads its share of the
+ *	  input and routes every tuple, by the high bits of its hash value, into
+ *	  one of a number of SharedTuplestores (see agg_fill_shared_partitions()).
+ *	  Once all participants are done with that, they claim whole partitions
+ *	  one at a time and aggregate each one in a private hash table exactly
+ *	  like a spilled batch, spilling it again locally if it does not fit in
+ *	  hash_mem.  All tuples of a group land in the same partition, so each
+ *	  group is finalized by exactly one participant, and no Finalize
+ *	  Aggregate step (nor any combine function) is needed above the Gather.
+ *
  *    Transition / Combine function invocation:
  *
  *    For performance reasons transition functions, including combine
@@ -265,6 +280,10 @@
 #include "optimizer/optimizer.h"
 #include "parser/parse_agg.h"
 #include "parser/parse_coerce.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "port/pg_bitutils.h"
+#include "storage/barrier.h"
 #include "utils/acl.h"
 #include "utils/builtins.h"
 #include "utils/datum.h"
@@ -273,6 +292,7 @@
 #include "utils/logtape.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
+#include "utils/sharedtuplestore.h"
 #include "utils/syscache.h"
 #include "utils/tuplesort.h"
 
@@ -314,6 +334,20 @@
  */
 #define HASHAGG_HLL_BIT_WIDTH 5
 
+/*
+ * Parallel HashAggregate creates at least this many shared partitions per
+ * participant, so that the partitions can be spread reasonably evenly even
+ * when all groups would fit in memory.  The upper limit is lower than for
+ * local spilling because every participant keeps a write buffer open for
+ * each shared partition: a chunk of four blocks in sharedtuplestore.c, plus
+ * the BufFile's own block.  Like local spill files, those buffers may take
+ * up at most 1/4 of hash_mem; partitions that turn out to be too large are
+ * spilled again locally.
+ */
+#define HASHAGG_PARALLEL_PARTITIONS_PER_PARTICIPANT 4
+#define HASHAGG_PARALLEL_MAX_PARTITIONS 256
+#define HASHAGG_PARALLEL_WRITE_BUFFER_SIZE (5 * BLCKSZ)
+
 /*
  * Estimate chunk overhead as a constant 16 bytes. XXX: should this be
  * improved?
@@ -353,10 +387,34 @@ typedef struct HashAggBatch
 	int			setno;			/* grouping set */
 	int			used_bits;		/* number of bits of hash already used */
 	LogicalTape *input_tape;	/* input partition tape */
+	SharedTuplestoreAccessor *input_sts;	/* or shared input partition */
 	int64		input_tuples;	/* number of tuples in this batch */
 	double		input_card;		/* estimated group cardinality */
 } HashAggBatch;
 
+/*
+ * Shared state for Parallel HashAggregate, followed in shared memory by
+ * npartitions SharedTuplestore objects (see ParallelHashAggPartition).
+ */
+typedef struct ParallelHashAggState
+{
+	Barrier		barrier;		/* PHA_PHASE_* */
+	pg_atomic_uint32 next_partition;	/* next partition to claim */
+	int			npartitions;	/* number of shared partitions */
+	int			partition_bits; /* log2(npartitions) */
+	int			nparticipants;	/* number of planned participants */
+	SharedFileSet fileset;		/* space for partition files */
+} ParallelHashAggState;
+
+/* Phases of ParallelHashAggState's barrier */
+#define PHA_PHASE_PARTITIONING		0
+#define PHA_PHASE_AGGREGATING		1
+
+#define ParallelHashAggPartition(pstate, i)								\
+	((SharedTuplestore *)												\
+	 ((char *) (pstate) + MAXALIGN(sizeof(ParallelHashAggState)) +		\
+	  (i) * MAXALIGN(sts_estimate((pstate)->nparticipants))))
+
 /* used to find referenced colnos */
 typedef struct FindColsContext
 {
@@ -419,6 +477,7 @@ static void initialize_hash_entry(AggState *aggstate,
 static void lookup_hash_entries(AggState *aggstate);
 static TupleTableSlot *agg_retrieve_direct(AggState *aggstate);
 static void agg_fill_hash_table(AggState *aggstate);
+static void agg_fill_shared_partitions(AggState *aggstate);
 static bool agg_refill_hash_table(AggState *aggstate);
 static TupleTableSlot *agg_retrieve_hash_table(AggState *aggstate);
 static TupleTableSlot *agg_retrieve_hash_table_in_memory(AggState *aggstate);
@@ -428,6 +487,7 @@ static void hash_agg_update_metrics(AggState *aggstate, bool from_tape,
 									int npartitions);
 static void hashagg_finish_initial_spills(AggState *aggstate);
 static void hashagg_reset_spill_state(AggState *aggstate);
+static HashAggBatch *hashagg_claim_shared_partition(AggState *aggstate);
 static HashAggBatch *hashagg_batch_new(LogicalTape *input_tape, int setno,
 									   int64 input_tuples, double input_card,
 									   int used_bits);
@@ -435,6 +495,8 @@ static MinimalTuple hashagg_batch_read(HashAggBatch *batch, uint32 *hashp);
 static void hashagg_spill_init(HashAggSpill *spill, LogicalTapeSet *lts,
 							   int used_bits, double input_groups,
 							   double hashentrysize);
+static TupleTableSlot *hashagg_spill_slot(AggState *aggstate,
+										   TupleTableSlot *inputslot);
 static Size hashagg_spill_tuple(AggState *aggstate, HashAggSpill *spill,
 								TupleTableSlot *slot, uint32 hash);
 static void hashagg_spill_finish(AggState *aggstate, HashAggSpill *spill,
@@ -559,6 +621,23 @@ fetch_input_tuple(AggState *aggstate)
 			return NULL;
 		slot = aggstate->sort_slot;
 	}
+	else if (outerPlanState(aggstate)->ExecProcNodeBatch != NULL)
+	{
+		/*
+		 * The outer plan can hand us its tuples in batches.  Usually we
+		 * consume our entire input anyway; if we stop early (a sorted Agg
+		 * below a LIMIT), the rest of the batch is simply never looked at.
+		 */
+		if (aggstate->input_batch == NULL ||
+			aggstate->input_batch_next >= aggstate->input_batch->nvalid)
+		{
+			aggstate->input_batch = ExecProcNodeBatch(outerPlanState(aggstate));
+			aggstate->input_batch_next = 0;
+			if (aggstate->input_batch == NULL)
+				return NULL;
+		}
+		slot = aggstate->input_batch->slots[aggstate->input_batch_next++];
+	}
 	else
 		slot = ExecProcNode(outerPlanState(aggstate));
 
@@ -2151,7 +2230,12 @@ ExecAgg(PlanState *pstate)
 		{
 			case AGG_HASHED:
 				if (!node->table_filled)
-					agg_fill_hash_table(node);
+				{
+					if (node->hash_pstate != NULL)
+						agg_fill_shared_partitions(node);
+					else
+						agg_fill_hash_table(node);
+				}
 				/* FALLTHROUGH */
 			case AGG_MIXED:
 				result = agg_retrieve_hash_table(node);
@@ -2560,6 +2644,74 @@ agg_fill_hash_table(AggState *aggstate)
 						   &aggstate->perhash[0].hashiter);
 }
 
+/*
+ * ExecAgg for Parallel HashAggregate: partition the input
+ *
+ * Route this participant's share of the input tuples into the shared
+ * partitions, then wait for the other participants to do the same.  The
+ * hash table is left empty; agg_refill_hash_table() fills it from the
+ * partitions claimed by this participant.
+ *
+ * A participant that shows up after partitioning is complete has no input
+ * left to read (the input is a partial plan whose other participants have
+ * exhausted it), so it goes straight to helping with aggregation.
+ */
+static void
+agg_fill_shared_partitions(AggState *aggstate)
+{
+	ParallelHashAggState *pstate = aggstate->hash_pstate;
+	AggStatePerHash perhash = &aggstate->perhash[0];
+	int			shift = 32 - pstate->partition_bits;
+
+	Assert(aggstate->num_hashes == 1);
+
+	if (BarrierAttach(&pstate->barrier) == PHA_PHASE_PARTITIONING)
+	{
+		for (;;)
+		{
+			TupleTableSlot *outerslot;
+			TupleTableSlot *spillslot;
+			MinimalTuple tuple;
+			uint32		hash;
+			bool		shouldFree;
+
+			outerslot = fetch_input_tuple(aggstate);
+			if (TupIsNull(outerslot))
+				break;
+
+			prepare_hash_slot(perhash, outerslot, perhash->hashslot);
+			hash = TupleHashTableHash(perhash->hashtable, perhash->hashslot);
+
+			spillslot = hashagg_spill_slot(aggstate, outerslot);
+			tuple = ExecFetchSlotMinimalTuple(spillslot, &shouldFree);
+			sts_puttuple(aggstate->hash_shared_parts[hash >> shift],
+						 &hash, tuple);
+			if (shouldFree)
+				pfree(tuple);
+
+			ResetExprContext(aggstate->tmpcontext);
+		}
+
+		for (int i = 0; i < pstate->npartitions; i++)
+			sts_end_write(aggstate->hash_shared_parts[i]);
+
+		BarrierArriveAndWait(&pstate->barrier, WAIT_EVENT_HASH_AGG_PARTITION);
+	}
+	BarrierDetach(&pstate->barrier);
+
+	/*
+	 * The input now lives in the shared partitions, which are consumed like
+	 * spilled batches; in particular the empty hash table cannot be reused
+	 * on rescan.
+	 */
+	aggstate->hash_ever_spilled = true;
+
+	aggstate->table_filled = true;
+	/* Initialize to walk the (empty) hash table */
+	select_current_set(aggstate, 0, true);
+	ResetTupleHashIterator(perhash->hashtable, &perhash->hashiter);
+}
+
 /*
  * If any data was spilled during hash aggregation, reset the hash table and
  * reprocess one batch of spilled data. After reprocessing a batch, the hash
@@ -2569,6 +2721,9 @@ agg_fill_hash_table(AggState *aggstate)
  * Should only be called after all in memory hash table entries have been
  * finalized and emitted.
  *
+ * In Parallel HashAggregate, local batches are processed before claiming the
+ * next shared partition, to keep the amount of local spill data small.
+ *
  * Return false when input is exhausted and there's no more work to be done;
  * otherwise return true.
  */
@@ -2581,13 +2736,21 @@ agg_refill_hash_table(AggState *aggstate)
 	LogicalTapeSet *tapeset = aggstate->hash_tapeset;
 	bool		spill_initialized = false;
 
-	if (aggstate->hash_batches == NIL)
+	if (aggstate->hash_batches != NIL)
+	{
+		/* hash_batches is a stack, with the top item at the end of the list */
+		batch = llast(aggstate->hash_batches);
+		aggstate->hash_batches = list_delete_last(aggstate->hash_batches);
+	}
+	else if (aggstate->hash_pstate != NULL)
+	{
+		batch = hashagg_claim_shared_partition(aggstate);
+		if (batch == NULL)
+			return false;
+	}
+	else
 		return false;
 
-	/* hash_batches is a stack, with the top item at the end of the list */
-	batch = llast(aggstate->hash_batches);
-	aggstate->hash_batches = list_delete_last(aggstate->hash_batches);
-
 	hash_agg_set_limits(aggstate->hashentrysize, batch->input_card,
 						batch->used_bits, &aggstate->hash_mem_limit,
 						&aggstate->hash_ngroups_limit, NULL);
@@ -2675,6 +2838,13 @@ agg_refill_hash_table(AggState *aggstate)
 				 * that we don't assign tapes that will never be used.
 				 */
 				spill_initialized = true;
+				if (tapeset == NULL)
+				{
+					/* first local spill of a shared partition */
+					Assert(batch->input_sts != NULL);
+					aggstate->hash_tapeset = LogicalTapeSetCreate(true, NULL, -1);
+					tapeset = aggstate->hash_tapeset;
+				}
 				hashagg_spill_init(&spill, tapeset, batch->used_bits,
 								   batch->input_card, aggstate->hashentrysize);
 			}
@@ -2691,7 +2861,10 @@ agg_refill_hash_table(AggState *aggstate)
 		ResetExprContext(aggstate->tmpcontext);
 	}
 
-	LogicalTapeClose(batch->input_tape);
+	if (batch->input_sts != NULL)
+		sts_end_parallel_scan(batch->input_sts);
+	else
+		LogicalTapeClose(batch->input_tape);
 
 	/* change back to phase 0 */
 	aggstate->current_phase = 0;
@@ -2897,6 +3070,38 @@ hashagg_spill_init(HashAggSpill *spill, LogicalTapeSet *tapeset, int used_bits,
 		initHyperLogLog(&spill->hll_card[i], HASHAGG_HLL_BIT_WIDTH);
 }
 
+/*
+ * hashagg_spill_slot
+ *
+ * Return a slot holding only the attributes of inputslot that we actually
+ * need, for writing to a spill file or shared partition.
+ */
+static TupleTableSlot *
+hashagg_spill_slot(AggState *aggstate, TupleTableSlot *inputslot)
+{
+	TupleTableSlot *spillslot;
+
+	if (aggstate->all_cols_needed)
+		return inputslot;
+
+	spillslot = aggstate->hash_spill_wslot;
+	slot_getsomeattrs(inputslot, aggstate->max_colno_needed);
+	ExecClearTuple(spillslot);
+	for (int i = 0; i < spillslot->tts_tupleDescriptor->natts; i++)
+	{
+		if (bms_is_member(i + 1, aggstate->colnos_needed))
+		{
+			spillslot->tts_values[i] = inputslot->tts_values[i];
+			spillslot->tts_isnull[i] = inputslot->tts_isnull[i];
+		}
+		else
+			spillslot->tts_isnull[i] = true;
+	}
+	ExecStoreVirtualTuple(spillslot);
+
+	return spillslot;
+}
+
 /*
  * hashagg_spill_tuple
  *
@@ -2917,25 +3122,7 @@ hashagg_spill_tuple(AggState *aggstate, HashAggSpill *spill,
 	Assert(spill->partitions != NULL);
 
 	/* spill only attributes that we actually need */
-	if (!aggstate->all_cols_needed)
-	{
-		spillslot = aggstate->hash_spill_wslot;
-		slot_getsomeattrs(inputslot, aggstate->max_colno_needed);
-		ExecClearTuple(spillslot);
-		for (int i = 0; i < spillslot->tts_tupleDescriptor->natts; i++)
-		{
-			if (bms_is_member(i + 1, aggstate->colnos_needed))
-			{
-				spillslot->tts_values[i] = inputslot->tts_values[i];
-				spillslot->tts_isnull[i] = inputslot->tts_isnull[i];
-			}
-			else
-				spillslot->tts_isnull[i] = true;
-		}
-		ExecStoreVirtualTuple(spillslot);
-	}
-	else
-		spillslot = inputslot;
+	spillslot = hashagg_spill_slot(aggstate, inputslot);
 
 	tuple = ExecFetchSlotMinimalTuple(spillslot, &shouldFree);
 
@@ -2984,6 +3171,41 @@ hashagg_batch_new(LogicalTape *input_tape, int setno,
 	return batch;
 }
 
+/*
+ * hashagg_claim_shared_partition
+ *
+ * Claim the next unprocessed shared partition of a Parallel HashAggregate,
+ * and return a batch to read it.  Return NULL if there are none left.
+ */
+static HashAggBatch *
+hashagg_claim_shared_partition(AggState *aggstate)
+{
+	ParallelHashAggState *pstate = aggstate->hash_pstate;
+	HashAggBatch *batch;
+	uint32		partno;
+
+	partno = pg_atomic_fetch_add_u32(&pstate->next_partition, 1);
+	if (partno >= pstate->npartitions)
+		return NULL;
+
+	/*
+	 * We don't know the number of tuples in the partition; assume the groups
+	 * are spread evenly over the partitions.
+	 */
+	batch = hashagg_batch_new(NULL, 0, 0,
+							  aggstate->perhash[0].aggnode->numGroups /
+							  pstate->npartitions,
+							  pstate->partition_bits);
+	batch->input_sts = aggstate->hash_shared_parts[partno];
+
+	/* nobody else claims this partition, so we'll read all of it */
+	sts_begin_parallel_scan(batch->input_sts);
+
+	aggstate->hash_batches_used++;
+
+	return batch;
+}
+
 /*
  * read_spilled_tuple
  * 		read the next tuple from a batch's tape.  Return NULL if no more.
@@ -2997,6 +3219,17 @@ hashagg_batch_read(HashAggBatch *batch, uint32 *hashp)
 	size_t		nread;
 	uint32		hash;
 
+	if (batch->input_sts != NULL)
+	{
+		/* the tuple belongs to the tuplestore, so copy it */
+		tuple = sts_parallel_scan_next(batch->input_sts, &hash);
+		if (tuple == NULL)
+			return NULL;
+		if (hashp != NULL)
+			*hashp = hash;
+		return heap_copy_minimal_tuple(tuple);
+	}
+
 	nread = LogicalTapeRead(tape, &hash, sizeof(uint32));
 	if (nread == 0)
 		return NULL;
@@ -4347,6 +4580,7 @@ ExecReScanAgg(AggState *node)
 	int			setno;
 
 	node->agg_done = false;
+	node->input_batch = NULL;
 
 	if (node->aggstrategy == AGG_HASHED)
 	{
@@ -4649,23 +4883,106 @@ AggRegisterCallback(FunctionCallInfo fcinfo,
  * ----------------------------------------------------------------
  */
 
+/*
+ * Does this node run as a Parallel HashAggregate when it has a DSM segment?
+ * The planner only marks hashed, single-grouping-set Aggs parallel-aware.
+ */
+static bool
+hashagg_is_parallel(AggState *node)
+{
+	return node->ss.ps.plan->parallel_aware &&
+		node->aggstrategy == AGG_HASHED &&
+		node->num_hashes == 1;
+}
+
+/*
+ * Choose the number of shared partitions for a Parallel HashAggregate: as
+ * many as the serial case would spill to, but enough to give every
+ * participant several partitions to work on, as long as the write buffers
+ * fit in 1/4 of hash_mem.  Must be a power of two.
+ */
+static int
+hashagg_parallel_num_partitions(AggState *node, int nparticipants)
+{
+	double		buffer_limit = get_hash_memory_limit() * 0.25;
+	int			npartitions;
+
+	npartitions = Max(node->hash_planned_partitions,
+					  nparticipants * HASHAGG_PARALLEL_PARTITIONS_PER_PARTICIPANT);
+	npartitions = Min(npartitions, HASHAGG_PARALLEL_MAX_PARTITIONS);
+	npartitions = pg_nextpower2_32(npartitions);
+
+	while (npartitions > HASHAGG_MIN_PARTITIONS &&
+		   npartitions * HASHAGG_PARALLEL_WRITE_BUFFER_SIZE > buffer_limit)
+		npartitions /= 2;
+
+	return npartitions;
+}
+
+static Size
+hashagg_parallel_state_size(int npartitions, int nparticipants)
+{
+	return add_size(MAXALIGN(sizeof(ParallelHashAggState)),
+					mul_size(npartitions,
+							 MAXALIGN(sts_estimate(nparticipants))));
+}
+
+/*
+ * Set up the shared partitions of a Parallel HashAggregate, from the leader.
+ */
+static void
+hashagg_parallel_initialize(AggState *node, ParallelHashAggState *pstate)
+{
+	node->hash_shared_parts =
+		palloc(sizeof(SharedTuplestoreAccessor *) * pstate->npartitions);
+
+	for (int i = 0; i < pstate->npartitions; i++)
+	{
+		char		name[MAXPGPATH];
+
+		snprintf(name, sizeof(name), "p%dof%d", i, pstate->npartitions);
+		node->hash_shared_parts[i] =
+			sts_initialize(ParallelHashAggPartition(pstate, i),
+						   pstate->nparticipants,
+						   ParallelWorkerNumber + 1,
+						   sizeof(uint32),
+						   SHARED_TUPLESTORE_SINGLE_PASS,
+						   &pstate->fileset,
+						   name);
+	}
+}
+
  /* ----------------------------------------------------------------
   *		ExecAggEstimate
   *
-  *		Estimate space required to propagate aggregate statistics.
+  *		Estimate space required to propagate aggregate statistics and,
+  *		for Parallel HashAggregate, to share the partitioned input.
   * ----------------------------------------------------------------
   */
 void
 ExecAggEstimate(AggState *node, ParallelContext *pcxt)
 {
-	Size		size;
+	Size		size = 0;
 
-	/* don't need this if not instrumenting or no workers */
-	if (!node->ss.ps.instrument || pcxt->nworkers == 0)
+	if (hashagg_is_parallel(node))
+	{
+		int			nparticipants = pcxt->nworkers + 1;
+
+		size = MAXALIGN(hashagg_parallel_state_size(hashagg_parallel_num_partitions(node, nparticipants),
+													nparticipants));
+	}
+
+	/* don't need instrumentation if not instrumenting or no workers */
+	if (node->ss.ps.instrument && pcxt->nworkers > 0)
+	{
+		size = add_size(size, mul_size(pcxt->nworkers,
+									   sizeof(AggregateInstrumentation)));
+		size = add_size(size, offsetof(SharedAggInfo, sinstrument));
+	}
+
+	if (size == 0)
 		return;
 
-	size = mul_size(pcxt->nworkers, sizeof(AggregateInstrumentation));
-	size = add_size(size, offsetof(SharedAggInfo, sinstrument));
 	shm_toc_estimate_chunk(&pcxt->estimator, size);
 	shm_toc_estimate_keys(&pcxt->estimator, 1);
 }
@@ -4673,39 +4990,129 @@ ExecAggEstimate(AggState *node, ParallelContext *pcxt)
 /* ----------------------------------------------------------------
  *		ExecAggInitializeDSM
  *
- *		Initialize DSM space for aggregate statistics.
+ *		Initialize DSM space for aggregate statistics and Parallel
+ *		HashAggregate.  Both live in one chunk, the shared state first.
  * ----------------------------------------------------------------
  */
 void
 ExecAggInitializeDSM(AggState *node, ParallelContext *pcxt)
 {
+	Size		pstate_size = 0;
 	Size		size;
+	char	   *chunk;
+	ParallelHashAggState *pstate = NULL;
 
-	/* don't need this if not instrumenting or no workers */
-	if (!node->ss.ps.instrument || pcxt->nworkers == 0)
+	if (hashagg_is_parallel(node))
+	{
+		int			nparticipants = pcxt->nworkers + 1;
+		int			npartitions = hashagg_parallel_num_partitions(node,
+																  nparticipants);
+
+		pstate_size = MAXALIGN(hashagg_parallel_state_size(npartitions,
+														   nparticipants));
+	}
+	size = pstate_size;
+
+	/* don't need instrumentation if not instrumenting or no workers */
+	if (node->ss.ps.instrument && pcxt->nworkers > 0)
+		size += offsetof(SharedAggInfo, sinstrument)
+			+ pcxt->nworkers * sizeof(AggregateInstrumentation);
+
+	if (size == 0)
 		return;
 
-	size = offsetof(SharedAggInfo, sinstrument)
-		+ pcxt->nworkers * sizeof(AggregateInstrumentation);
-	node->shared_info = shm_toc_allocate(pcxt->toc, size);
-	/* ensure any unfilled slots will contain zeroes */
-	memset(node->shared_info, 0, size);
-	node->shared_info->num_workers = pcxt->nworkers;
-	shm_toc_insert(pcxt->toc, node->ss.ps.plan->plan_node_id,
-				   node->shared_info);
+	chunk = shm_toc_allocate(pcxt->toc, size);
+
+	if (pstate_size > 0)
+	{
+		pstate = (ParallelHashAggState *) chunk;
+		pstate->nparticipants = pcxt->nworkers + 1;
+		pstate->npartitions =
+			hashagg_parallel_num_partitions(node, pstate->nparticipants);
+		pstate->partition_bits = my_log2(pstate->npartitions);
+		pg_atomic_init_u32(&pstate->next_partition, 0);
+		BarrierInit(&pstate->barrier, 0);
+
+		/* Set up the space we'll use for shared temporary files. */
+		SharedFileSetInit(&pstate->fileset, pcxt->seg);
+
+		hashagg_parallel_initialize(node, pstate);
+		node->hash_pstate = pstate;
+	}
+
+	if (size > pstate_size)
+	{
+		node->shared_info = (SharedAggInfo *) (chunk + pstate_size);
+		/* ensure any unfilled slots will contain zeroes */
+		memset(node->shared_info, 0, size - pstate_size);
+		node->shared_info->num_workers = pcxt->nworkers;
+	}
+
+	shm_toc_insert(pcxt->toc, node->ss.ps.plan->plan_node_id, chunk);
+}
+
+/* ----------------------------------------------------------------
+ *		ExecAggReInitializeDSM
+ *
+ *		Reset Parallel HashAggregate's shared state before beginning a
+ *		fresh scan.
+ * ----------------------------------------------------------------
+ */
+void
+ExecAggReInitializeDSM(AggState *node, ParallelContext *pcxt)
+{
+	ParallelHashAggState *pstate = node->hash_pstate;
+
+	if (pstate == NULL)
+		return;
+
+	/* Clear any shared partition files. */
+	SharedFileSetDeleteAll(&pstate->fileset);
+
+	pg_atomic_write_u32(&pstate->next_partition, 0);
+	BarrierInit(&pstate->barrier, 0);
+
+	hashagg_parallel_initialize(node, pstate);
 }
 
 /* ----------------------------------------------------------------
  *		ExecAggInitializeWorker
  *
- *		Attach worker to DSM space for aggregate statistics.
+ *		Attach worker to DSM space for aggregate statistics and Parallel
+ *		HashAggregate.
  * ----------------------------------------------------------------
  */
 void
 ExecAggInitializeWorker(AggState *node, ParallelWorkerContext *pwcxt)
 {
-	node->shared_info =
-		shm_toc_lookup(pwcxt->toc, node->ss.ps.plan->plan_node_id, true);
+	char	   *chunk;
+
+	chunk = shm_toc_lookup(pwcxt->toc, node->ss.ps.plan->plan_node_id, true);
+	if (chunk == NULL)
+		return;
+
+	if (hashagg_is_parallel(node))
+	{
+		ParallelHashAggState *pstate = (ParallelHashAggState *) chunk;
+
+		/* Attach to the space for shared temporary files. */
+		SharedFileSetAttach(&pstate->fileset, pwcxt->seg);
+
+		node->hash_shared_parts =
+			palloc(sizeof(SharedTuplestoreAccessor *) * pstate->npartitions);
+		for (int i = 0; i < pstate->npartitions; i++)
+			node->hash_shared_parts[i] =
+				sts_attach(ParallelHashAggPartition(pstate, i),
+						   ParallelWorkerNumber + 1,
+						   &pstate->fileset);
+		node->hash_pstate = pstate;
+
+		chunk += MAXALIGN(hashagg_parallel_state_size(pstate->npartitions,
+													  pstate->nparticipants));
+	}
+
+	if (node->ss.ps.instrument)
+		node->shared_info = (SharedAggInfo *) chunk;
 }
 
 /* ----------------------------------------------------------------
@@ -221,6 +221,22 @@ BitmapHeapNext(BitmapHeapScanState *node)
 										 tbmres->blockno,
 										 &node->vmbuffer));
 
+			/*
+			 * Tell the table AM how many of the following pages are also in
+			 * the bitmap, so that it can read them together with this one.
+			 * Once we've reported a run, there's no need to look again until
+			 * we're past it.
+			 */
+			if (!pstate)
+			{
+				if (node->readahead_pages > 0)
+					node->readahead_pages--;
+				else if (!skip_fetch)
+					tbmres->nahead = node->readahead_pages =
+						tbm_iterate_consecutive(tbmiterator,
+												io_combine_limit - 1);
+			}
+
 			if (skip_fetch)
 			{
 				/* can't be lossy in the skip_fetch case */
@@ -626,6 +642,7 @@ ExecReScanBitmapHeapScan(BitmapHeapScanState *node)
 	node->tbmres = NULL;
 	node->prefetch_iterator = NULL;
 	node->initialized = false;
+	node->readahead_pages = 0;
 	node->shared_tbmiterator = NULL;
 	node->shared_prefetch_iterator = NULL;
 	node->vmbuffer = InvalidBuffer;
@@ -738,6 +755,7 @@ ExecInitBitmapHeapScan(BitmapHeapScan *node, EState *estate, int eflags)
 	scanstate->prefetch_target = 0;
 	scanstate->pscan_len = 0;
 	scanstate->initialized = false;
+	scanstate->readahead_pages = 0;
 	scanstate->shared_tbmiterator = NULL;
 	scanstate->shared_prefetch_iterator = NULL;
 	scanstate->pstate = NULL;
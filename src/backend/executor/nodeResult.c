@@ -139,6 +139,77 @@ ExecResult(PlanState *pstate)
 	return NULL;
 }
 
+/* ----------------------------------------------------------------
+ *		ExecResultBatch(node)
+ *
+ *		Batch mode version of ExecResult, used when the outer plan
+ *		supports batch mode.  Each tuple of the outer plan's batch is
+ *		projected into the corresponding slot of our own batch.
+ * ----------------------------------------------------------------
+ */
+static TupleBatch *
+ExecResultBatch(PlanState *pstate)
+{
+	ResultState *node = castNode(ResultState, pstate);
+	ExprContext *econtext = node->ps.ps_ExprContext;
+	ProjectionInfo *projInfo = node->ps.ps_ProjInfo;
+	TupleBatch *outerBatch;
+	TupleBatch *batch;
+	int			i;
+
+	CHECK_FOR_INTERRUPTS();
+
+	/*
+	 * check constant qualifications like (2 > 1), if not already done
+	 */
+	if (node->rs_checkqual)
+	{
+		bool		qualResult = ExecQual(node->resconstantqual, econtext);
+
+		node->rs_checkqual = false;
+		if (!qualResult)
+			node->rs_done = true;
+	}
+
+	if (node->rs_done)
+		return NULL;
+
+	/*
+	 * Reset per-tuple memory context to free any expression evaluation
+	 * storage allocated for the previous batch.
+	 */
+	ResetExprContext(econtext);
+
+	outerBatch = ExecProcNodeBatch(outerPlanState(node));
+	if (outerBatch == NULL)
+		return NULL;
+
+	/* make our batch as large as the outer plan's on first use */
+	if (node->rs_batch == NULL)
+	{
+		EState	   *estate = node->ps.state;
+		MemoryContext oldcontext;
+
+		oldcontext = MemoryContextSwitchTo(estate->es_query_cxt);
+		node->rs_batch =
+			ExecInitTupleBatch(estate, outerBatch->maxslots,
+							   node->ps.ps_ResultTupleSlot->tts_tupleDescriptor,
+							   node->ps.ps_ResultTupleSlot->tts_ops);
+		MemoryContextSwitchTo(oldcontext);
+	}
+	batch = node->rs_batch;
+	Assert(outerBatch->nvalid <= batch->maxslots);
+
+	for (i = 0; i < outerBatch->nvalid; i++)
+	{
+		econtext->ecxt_outertuple = outerBatch->slots[i];
+		ExecProjectInto(projInfo, batch->slots[i]);
+	}
+	batch->nvalid = outerBatch->nvalid;
+
+	return batch;
+}
+
 /* ----------------------------------------------------------------
  *		ExecResultMarkPos
  * ----------------------------------------------------------------
@@ -214,6 +285,11 @@ ExecInitResult(Result *node, EState *estate, int eflags)
 	 */
 	Assert(innerPlan(node) == NULL);
 
+	/* we can pass batches through if our outer plan produces them */
+	if (outerPlanState(resstate) != NULL &&
+		outerPlanState(resstate)->ExecProcNodeBatch != NULL)
+		resstate->ps.ExecProcNodeBatch = ExecResultBatch;
+
 	/*
 	 * Initialize result slot, type and projection.
 	 */
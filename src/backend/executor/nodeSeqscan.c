@@ -15,6 +15,7 @@
 /*
  * INTERFACE ROUTINES
  *		ExecSeqScan				sequentially scans a relation.
+ *		ExecSeqScanBatch		same, returning a batch of tuples at a time.
  *		ExecSeqNext				retrieve next tuple in sequential order.
  *		ExecInitSeqScan			creates and initializes a seqscan node.
  *		ExecEndSeqScan			releases any storage allocated.
@@ -31,9 +32,21 @@
 #include "access/tableam.h"
 #include "executor/execdebug.h"
 #include "executor/nodeSeqscan.h"
+#include "miscadmin.h"
 #include "utils/rel.h"
 
+/*
+ * Maximum number of distinct buffers the scan slots of one batch may keep
+ * pinned.  Large scans read through a ring of BAS_BULKREAD buffers (256kB,
+ * i.e. 32 buffers by default), and a buffer that is still pinned can't be
+ * reused from the ring; so a batch ends early when it reaches this many
+ * pages, however few tuples each of them holds, to leave most of the ring
+ * free.
+ */
+#define SEQSCAN_BATCH_MAX_PAGES		8
+
 static TupleTableSlot *SeqNext(SeqScanState *node);
+static void SeqScanInitBatch(SeqScanState *node);
 
 /* ----------------------------------------------------------------
  *						Scan Support
@@ -114,6 +127,208 @@ ExecSeqScan(PlanState *pstate)
 					(ExecScanRecheckMtd) SeqRecheck);
 }
 
+/*
+ * SeqScanInitBatch -- set up the slots used in batch mode
+ *
+ * This is done on the first call of ExecSeqScanBatch rather than in
+ * ExecInitSeqScan, so that scans whose parent never asks for batches don't
+ * pay for the slots.
+ */
+static void
+SeqScanInitBatch(SeqScanState *node)
+{
+	EState	   *estate = node->ss.ps.state;
+	MemoryContext oldcontext;
+	TupleBatch *scanbatch;
+
+	oldcontext = MemoryContextSwitchTo(estate->es_query_cxt);
+
+	/*
+	 * The scan reads into slots of the scan tuple type.  Without a
+	 * projection those slots are handed to the parent as they are;
+	 * otherwise each qualifying tuple is projected into a slot of the
+	 * result type.
+	 */
+	scanbatch = ExecInitTupleBatch(estate, node->ss_BatchSize,
+								   node->ss.ss_ScanTupleSlot->tts_tupleDescriptor,
+								   node->ss.ss_ScanTupleSlot->tts_ops);
+	node->ss_BatchScanSlots = scanbatch->slots;
+
+	if (node->ss.ps.ps_ProjInfo == NULL)
+		node->ss_Batch = scanbatch;
+	else
+		node->ss_Batch =
+			ExecInitTupleBatch(estate, node->ss_BatchSize,
+							   node->ss.ps.ps_ResultTupleSlot->tts_tupleDescriptor,
+							   node->ss.ps.ps_ResultTupleSlot->tts_ops);
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/* ----------------------------------------------------------------
+ *		ExecSeqScanBatch(node)
+ *
+ *		Scans the relation sequentially and returns the next batch of
+ *		qualifying tuples.  Unlike ExecScan, this first reads a full batch
+ *		of tuples from the table, and then checks the qual and computes
+ *		the projection for all of them in separate passes.  Expression
+ *		evaluation memory is therefore only reset once per batch.
+ *
+ *		A batch holds at most ss_BatchSize tuples, read from at most
+ *		SEQSCAN_BATCH_MAX_PAGES pages.  The expressions themselves are
+ *		still evaluated one tuple at a time.
+ * ----------------------------------------------------------------
+ */
+static TupleBatch *
+ExecSeqScanBatch(PlanState *pstate)
+{
+	SeqScanState *node = castNode(SeqScanState, pstate);
+	EState	   *estate = node->ss.ps.state;
+	ExprState  *qual = node->ss.ps.qual;
+	ProjectionInfo *projInfo = node->ss.ps.ps_ProjInfo;
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+	TableScanDesc scandesc;
+	TupleTableSlot **scanslots;
+	TupleBatch *batch;
+
+	if (node->ss_Batch == NULL)
+		SeqScanInitBatch(node);
+	batch = node->ss_Batch;
+	scanslots = node->ss_BatchScanSlots;
+
+	/*
+	 * The table AM restarts the scan if asked for another tuple after it
+	 * has reported the end, so remember that we got there.
+	 */
+	if (node->ss_BatchDone)
+		return NULL;
+
+	scandesc = node->ss.ss_currentScanDesc;
+	if (scandesc == NULL)
+	{
+		/* as in SeqNext */
+		scandesc = table_beginscan(node->ss.ss_currentRelation,
+								   estate->es_snapshot,
+								   0, NULL);
+		node->ss.ss_currentScanDesc = scandesc;
+	}
+
+	for (;;)
+	{
+		int			ntuples = 0;
+		int			nvalid = 0;
+		int			npages = 0;
+		Buffer		lastbuf = InvalidBuffer;
+		int			i;
+
+		/*
+		 * Free expression evaluation storage allocated for the previous
+		 * batch, which the parent is done with by now.
+		 */
+		ResetExprContext(econtext);
+
+		/* read the next batch of tuples from the table */
+		while (ntuples < node->ss_BatchSize)
+		{
+			CHECK_FOR_INTERRUPTS();
+
+			if (!table_scan_getnextslot(scandesc, estate->es_direction,
+										scanslots[ntuples]))
+			{
+				node->ss_BatchDone = true;
+				break;
+			}
+			ntuples++;
+
+			/*
+			 * The slot may point at tuple storage that the table AM reuses
+			 * for the next tuple; heapam stores its scan's rs_ctup.  Each
+			 * slot of the batch needs a tuple of its own.  For a tuple in a
+			 * buffer, copying the HeapTupleData into the slot's tupdata is
+			 * enough, as in tts_buffer_heap_copyslot(); the tuple itself
+			 * stays in the buffer, which the slot keeps pinned.
+			 */
+			if (TTS_IS_BUFFERTUPLE(scanslots[ntuples - 1]))
+			{
+				BufferHeapTupleTableSlot *bslot;
+
+				bslot = (BufferHeapTupleTableSlot *) scanslots[ntuples - 1];
+				if (!TTS_SHOULDFREE(&bslot->base.base) &&
+					bslot->base.tuple != &bslot->base.tupdata)
+				{
+					memcpy(&bslot->base.tupdata, bslot->base.tuple,
+						   sizeof(HeapTupleData));
+					bslot->base.tuple = &bslot->base.tupdata;
+				}
+
+				/* stop at the page limit; see SEQSCAN_BATCH_MAX_PAGES */
+				if (bslot->buffer != lastbuf)
+				{
+					lastbuf = bslot->buffer;
+					if (++npages >= SEQSCAN_BATCH_MAX_PAGES)
+						break;
+				}
+			}
+			else
+				ExecMaterializeSlot(scanslots[ntuples - 1]);
+		}
+
+		/*
+		 * Release the pins held by slots left over from a longer previous
+		 * batch.  The slots in use always form a prefix of the array.
+		 */
+		for (i = ntuples; i < node->ss_BatchSize && !TTS_EMPTY(scanslots[i]); i++)
+			ExecClearTuple(scanslots[i]);
+
+		/*
+		 * Check the qual, moving the slots of qualifying tuples to the front
+		 * of the array.
+		 */
+		if (qual == NULL)
+			nvalid = ntuples;
+		else
+		{
+			for (i = 0; i < ntuples; i++)
+			{
+				TupleTableSlot *slot = scanslots[i];
+
+				econtext->ecxt_scantuple = slot;
+				if (!ExecQual(qual, econtext))
+				{
+					InstrCountFiltered1(node, 1);
+					continue;
+				}
+
+				if (i != nvalid)
+				{
+					scanslots[i] = scanslots[nvalid];
+					scanslots[nvalid] = slot;
+				}
+				nvalid++;
+			}
+		}
+
+		if (nvalid > 0)
+		{
+			if (projInfo)
+			{
+				for (i = 0; i < nvalid; i++)
+				{
+					econtext->ecxt_scantuple = scanslots[i];
+					ExecProjectInto(projInfo, batch->slots[i]);
+				}
+			}
+
+			batch->nvalid = nvalid;
+			return batch;
+		}
+
+		/* no tuple of this batch qualified; read another unless at end */
+		if (node->ss_BatchDone)
+			return NULL;
+	}
+}
+
 
 /* ----------------------------------------------------------------
  *		ExecInitSeqScan
@@ -171,6 +386,16 @@ ExecInitSeqScan(SeqScan *node, EState *estate, int eflags)
 	scanstate->ss.ps.qual =
 		ExecInitQual(node->scan.plan.qual, (PlanState *) scanstate);
 
+	/*
+	 * Offer batch mode if enabled.  EvalPlanQual rechecks go through
+	 * ExecScanFetch, so they always use the tuple-at-a-time path.
+	 */
+	if (executor_batch_size > 0 && estate->es_epq_active == NULL)
+	{
+		scanstate->ss_BatchSize = executor_batch_size;
+		scanstate->ss.ps.ExecProcNodeBatch = ExecSeqScanBatch;
+	}
+
 	return scanstate;
 }
 
@@ -201,6 +426,11 @@ ExecEndSeqScan(SeqScanState *node)
 	if (node->ss.ps.ps_ResultTupleSlot)
 		ExecClearTuple(node->ss.ps.ps_ResultTupleSlot);
 	ExecClearTuple(node->ss.ss_ScanTupleSlot);
+	if (node->ss_BatchScanSlots)
+	{
+		for (int i = 0; i < node->ss_BatchSize; i++)
+			ExecClearTuple(node->ss_BatchScanSlots[i]);
+	}
 
 	/*
 	 * close heap scan
@@ -231,6 +461,8 @@ ExecReScanSeqScan(SeqScanState *node)
 		table_rescan(scan,		/* scan desc */
 					 NULL);		/* new scan keys */
 
+	node->ss_BatchDone = false;
+
 	ExecScanReScan((ScanState *) node);
 }
 
@@ -26,6 +26,7 @@
 #include "jit/jit.h"
 #include "miscadmin.h"
 #include "utils/fmgrprotos.h"
+#include "utils/memutils.h"
 #include "utils/resowner_private.h"
 
 /* GUCs */
@@ -36,6 +37,8 @@ bool		jit_dump_bitcode = false;
 bool		jit_expressions = true;
 bool		jit_profiling_support = false;
 bool		jit_tuple_deforming = true;
+int			jit_cache_entries = 0;
+int			jit_warmup_evaluations = 0;
 double		jit_above_cost = 100000;
 double		jit_inline_above_cost = 500000;
 double		jit_optimize_above_cost = 500000;
@@ -45,8 +48,23 @@ static bool provider_successfully_loaded = false;
 static bool provider_failed_loading = false;
 
 
+/*
+ * State of an expression that is evaluated by the interpreter until it has
+ * been evaluated often enough to be worth JIT compiling.
+ */
+typedef struct JitWarmupState
+{
+	ExprStateEvalFunc interpfunc;	/* interpreted evaluation */
+	int			remaining;		/* evaluations left before compiling */
+	bool		checked;		/* has CheckExprStillValid() been done? */
+	bool		pending;		/* in EState's es_jit_pending list? */
+} JitWarmupState;
+
 static bool provider_init(void);
 static bool file_exists(const char *name);
+static Datum jit_warmup_expr(ExprState *state, ExprContext *econtext,
+							 bool *isNull);
+static void jit_warmup_compile(ExprState *state);
 
 
 /*
@@ -173,10 +191,127 @@ jit_compile_expr(struct ExprState *state)
 		return false;
 
 	/* this also takes !jit_enabled into account */
-	if (provider_init())
-		return provider.compile_expr(state);
+	if (!provider_init())
+		return false;
 
-	return false;
+	/*
+	 * If requested, start out with interpreted execution, and only compile
+	 * once the expression turns out to be evaluated often.  That way queries
+	 * finishing quickly don't have to wait for compilation at all.
+	 */
+	if (jit_warmup_evaluations > 0)
+	{
+		EState	   *estate = state->parent->state;
+		JitWarmupState *warmup;
+
+		ExecReadyInterpretedExpr(state);
+
+		/*
+		 * The interpreter checks the expression's validity on the first
+		 * call, and then switches to the function stored in
+		 * evalfunc_private.  Do the check ourselves instead, so that calls
+		 * keep going through jit_warmup_expr().
+		 */
+		Assert(state->evalfunc == ExecInterpExprStillValid);
+
+		warmup = palloc(sizeof(JitWarmupState));
+		warmup->interpfunc = (ExprStateEvalFunc) state->evalfunc_private;
+		warmup->remaining = jit_warmup_evaluations;
+		warmup->checked = false;
+
+		/*
+		 * Remember the expression, so that it can be compiled together with
+		 * the plan's other expressions.  Only do that for expressions that
+		 * live as long as the EState, which is almost all of them.
+		 */
+		warmup->pending = GetMemoryChunkContext(state) == estate->es_query_cxt;
+		if (warmup->pending)
+		{
+			MemoryContext oldcontext;
+
+			oldcontext = MemoryContextSwitchTo(estate->es_query_cxt);
+			estate->es_jit_pending = lappend(estate->es_jit_pending, state);
+			MemoryContextSwitchTo(oldcontext);
+		}
+
+		state->evalfunc = jit_warmup_expr;
+		state->evalfunc_private = warmup;
+
+		return true;
+	}
+
+	return provider.compile_expr(state);
+}
+
+/*
+ * Evaluate an expression in the interpreter, until it has been evaluated
+ * jit_warmup_evaluations times.  Then compile it, which replaces the
+ * ExprState's evalfunc, and continue with the compiled code.
+ *
+ * Once one expression of a plan turns out to be hot, the others are likely
+ * to be, too.  Compile all of the plan's pending expressions at that point,
+ * so that the provider can emit them together rather than one by one.
+ */
+static Datum
+jit_warmup_expr(ExprState *state, ExprContext *econtext, bool *isNull)
+{
+	JitWarmupState *warmup = (JitWarmupState *) state->evalfunc_private;
+	EState	   *estate = state->parent->state;
+
+	if (!warmup->checked)
+	{
+		CheckExprStillValid(state, econtext);
+		warmup->checked = true;
+	}
+
+	if (--warmup->remaining > 0)
+		return warmup->interpfunc(state, econtext, isNull);
+
+	if (!warmup->pending)
+		jit_warmup_compile(state);
+	else
+	{
+		List	   *pending = estate->es_jit_pending;
+		ListCell   *lc;
+
+		estate->es_jit_pending = NIL;
+		foreach(lc, pending)
+			jit_warmup_compile((ExprState *) lfirst(lc));
+		list_free(pending);
+	}
+
+	return state->evalfunc(state, econtext, isNull);
+}
+
+/*
+ * Compile an expression that is still being warmed up in the interpreter.
+ * If that's not possible, keep interpreting it, without counting further.
+ */
+static void
+jit_warmup_compile(ExprState *state)
+{
+	JitWarmupState *warmup = (JitWarmupState *) state->evalfunc_private;
+	MemoryContext oldcontext;
+
+	/*
+	 * Expressions are usually evaluated in a short-lived memory context, but
+	 * whatever the provider allocates has to live as long as the expression.
+	 */
+	oldcontext = MemoryContextSwitchTo(GetMemoryChunkContext(state));
+
+	/* JIT may have been disabled since execution started */
+	if (!provider_init() || !provider.compile_expr(state))
+	{
+		if (warmup->checked)
+			state->evalfunc = warmup->interpfunc;
+		else
+			state->evalfunc = ExecInterpExprStillValid;
+		state->evalfunc_private = (void *) warmup->interpfunc;
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	pfree(warmup);
 }
 
 /* Aggregate JIT instrumentation information */
@@ -184,6 +319,7 @@ void
 InstrJitAgg(JitInstrumentation *dst, JitInstrumentation *add)
 {
 	dst->created_functions += add->created_functions;
+	dst->cached_functions += add->cached_functions;
 	INSTR_TIME_ADD(dst->generation_counter, add->generation_counter);
 	INSTR_TIME_ADD(dst->inlining_counter, add->inlining_counter);
 	INSTR_TIME_ADD(dst->optimization_counter, add->optimization_counter);
@@ -18,6 +18,7 @@
 #include <llvm-c/BitWriter.h>
 #include <llvm-c/Core.h>
 #include <llvm-c/ExecutionEngine.h>
+#include <llvm-c/Linker.h>
 #if LLVM_VERSION_MAJOR > 11
 #include <llvm-c/Orc.h>
 #include <llvm-c/OrcEE.h>
@@ -34,11 +35,14 @@
 #include <llvm-c/Transforms/Utils.h>
 #endif
 
+#include "common/hashfn.h"
 #include "jit/llvmjit.h"
 #include "jit/llvmjit_emit.h"
+#include "lib/ilist.h"
 #include "miscadmin.h"
 #include "portability/instr_time.h"
 #include "storage/ipc.h"
+#include "utils/hsearch.h"
 #include "utils/memutils.h"
 #include "utils/resowner_private.h"
 
@@ -54,6 +58,55 @@ typedef struct LLVMJitHandle
 #endif
 } LLVMJitHandle;
 
+/*
+ * Code emitted for the per-backend code cache.  All cache misses of a
+ * context are emitted together, so the code can be shared by several
+ * entries.
+ */
+typedef struct LLVMJitCacheCode
+{
+	LLVMJitHandle *handle;		/* emitted code */
+	int			nentries;		/* number of cache entries using it */
+} LLVMJitCacheCode;
+
+/*
+ * Entry in the per-backend cache of emitted code.
+ *
+ * When jit_cache_entries is > 0, expressions are generated without embedding
+ * any instance specific addresses (see llvmjit_expr.c), each into a module of
+ * its own.  The IR of such a module, with the defined functions renamed
+ * according to their position, thus completely describes the expression's
+ * steps, and the tuple descriptors any deforming code was generated for.  It
+ * is used as the key of the cache, so a later query compiling a structurally
+ * identical expression can reuse the emitted code, without paying for
+ * optimization and emission again.
+ *
+ * That isn't free: every expression's IR has to be printed and hashed, and
+ * compared in full on a hit.  On a miss, the expression's module is linked
+ * into the context's pending module, and emitted with it when the first of
+ * its expressions is evaluated.  Until then the entry has no code, and only
+ * the context that created it can use it.
+ *
+ * Entries are pinned by the contexts using their code. Unpinned entries are
+ * evicted in least recently used order once there are more than
+ * jit_cache_entries of them.
+ */
+typedef struct LLVMJitCacheEntry
+{
+	uint64		hash;			/* hash of ir and flags, hash key */
+	char	   *ir;				/* IR of the module, with canonical names */
+	Size		irlen;			/* strlen(ir) */
+	int			flags;			/* PGJIT_* flags the code was emitted with */
+	int			funcno;			/* position of function in the module */
+	int			nfuncs;			/* number of functions in the module */
+	char	   *funcname;		/* name of the function in the emitted code */
+	void	   *addr;			/* its address, NULL until emitted */
+	LLVMJitContext *owner;		/* context to emit the code, until emitted */
+	LLVMJitCacheCode *code;		/* emitted code, NULL until emitted */
+	int			refcount;		/* number of pins by contexts */
+	dlist_node	lru_node;		/* position in llvm_cache_lru */
+} LLVMJitCacheEntry;
+
 
 /* types & functions commonly needed for JITing */
 LLVMTypeRef TypeSizeT;
@@ -96,6 +149,9 @@ static const char *llvm_triple = NULL;
 static const char *llvm_layout = NULL;
 
 
+static HTAB *llvm_cache = NULL;
+static dlist_head llvm_cache_lru = DLIST_STATIC_INIT(llvm_cache_lru);
+
 static LLVMTargetRef llvm_targetref;
 #if LLVM_VERSION_MAJOR > 11
 static LLVMOrcThreadSafeContextRef llvm_ts_context;
@@ -108,6 +164,10 @@ static LLVMOrcJITStackRef llvm_opt3_orc;
 
 
 static void llvm_release_context(JitContext *context);
+static void llvm_release_handle(LLVMJitHandle *jit_handle);
+static void llvm_cache_evict(int maxentries);
+static void llvm_cache_remove(LLVMJitCacheEntry *entry);
+static void llvm_cache_emitted(LLVMJitContext *context);
 static void llvm_session_initialize(void);
 static void llvm_shutdown(int code, Datum arg);
 static void llvm_compile_module(LLVMJitContext *context);
@@ -156,6 +216,7 @@ llvm_create_context(int jitFlags)
 	context = MemoryContextAllocZero(TopMemoryContext,
 									 sizeof(LLVMJitContext));
 	context->base.flags = jitFlags;
+	context->use_cache = jit_cache_entries > 0;
 
 	/* ensure cleanup */
 	context->base.resowner = CurrentResourceOwner;
@@ -188,39 +249,76 @@ llvm_release_context(JitContext *context)
 		LLVMDisposeModule(llvm_context->module);
 		llvm_context->module = NULL;
 	}
+	if (llvm_context->pending_module)
+	{
+		LLVMDisposeModule(llvm_context->pending_module);
+		llvm_context->pending_module = NULL;
+	}
 
 	foreach(lc, llvm_context->handles)
 	{
 		LLVMJitHandle *jit_handle = (LLVMJitHandle *) lfirst(lc);
 
+		llvm_release_handle(jit_handle);
+	}
+	list_free(llvm_context->handles);
+	llvm_context->handles = NIL;
+
+	/* unpin cached code, and evict what's now beyond the cache's size */
+	foreach(lc, llvm_context->cache_entries)
+	{
+		LLVMJitCacheEntry *entry = (LLVMJitCacheEntry *) lfirst(lc);
+
+		Assert(entry->refcount > 0);
+		entry->refcount--;
+	}
+	list_free(llvm_context->cache_entries);
+	llvm_context->cache_entries = NIL;
+
+	/* entries whose code was never emitted are useless to anybody else */
+	foreach(lc, llvm_context->cache_pending)
+	{
+		LLVMJitCacheEntry *entry = (LLVMJitCacheEntry *) lfirst(lc);
+
+		Assert(entry->refcount == 0 && entry->owner == llvm_context);
+		llvm_cache_remove(entry);
+	}
+	list_free(llvm_context->cache_pending);
+	llvm_context->cache_pending = NIL;
+
+	llvm_cache_evict(jit_cache_entries);
+}
+
+/*
+ * Remove the code of one emitted module.
+ */
+static void
+llvm_release_handle(LLVMJitHandle *jit_handle)
+{
 #if LLVM_VERSION_MAJOR > 11
-		{
-			LLVMOrcExecutionSessionRef ee;
-			LLVMOrcSymbolStringPoolRef sp;
-
-			LLVMOrcResourceTrackerRemove(jit_handle->resource_tracker);
-			LLVMOrcReleaseResourceTracker(jit_handle->resource_tracker);
-
-			/*
-			 * Without triggering cleanup of the string pool, we'd leak
-			 * memory. It'd be sufficient to do this far less often, but in
-			 * experiments the required time was small enough to just always
-			 * do it.
-			 */
-			ee = LLVMOrcLLJITGetExecutionSession(jit_handle->lljit);
-			sp = LLVMOrcExecutionSessionGetSymbolStringPool(ee);
-			LLVMOrcSymbolStringPoolClearDeadEntries(sp);
-		}
+	{
+		LLVMOrcExecutionSessionRef ee;
+		LLVMOrcSymbolStringPoolRef sp;
+
+		LLVMOrcResourceTrackerRemove(jit_handle->resource_tracker);
+		LLVMOrcReleaseResourceTracker(jit_handle->resource_tracker);
+
+		/*
+		 * Without triggering cleanup of the string pool, we'd leak memory.
+		 * It'd be sufficient to do this far less often, but in experiments
+		 * the required time was small enough to just always do it.
+		 */
+		ee = LLVMOrcLLJITGetExecutionSession(jit_handle->lljit);
+		sp = LLVMOrcExecutionSessionGetSymbolStringPool(ee);
+		LLVMOrcSymbolStringPoolClearDeadEntries(sp);
+	}
 #else							/* LLVM_VERSION_MAJOR > 11 */
-		{
-			LLVMOrcRemoveModule(jit_handle->stack, jit_handle->orc_handle);
-		}
+	{
+		LLVMOrcRemoveModule(jit_handle->stack, jit_handle->orc_handle);
+	}
 #endif							/* LLVM_VERSION_MAJOR > 11 */
 
-		pfree(jit_handle);
-	}
-	list_free(llvm_context->handles);
-	llvm_context->handles = NIL;
+	pfree(jit_handle);
 }
 
 /*
@@ -275,10 +373,7 @@ llvm_expand_funcname(struct LLVMJitContext *context, const char *basename)
 void *
 llvm_get_function(LLVMJitContext *context, const char *funcname)
 {
-#if LLVM_VERSION_MAJOR > 11 || \
-	defined(HAVE_DECL_LLVMORCGETSYMBOLADDRESSIN) && HAVE_DECL_LLVMORCGETSYMBOLADDRESSIN
 	ListCell   *lc;
-#endif
 
 	llvm_assert_in_fatal_section();
 
@@ -291,6 +386,15 @@ llvm_get_function(LLVMJitContext *context, const char *funcname)
 		llvm_compile_module(context);
 	}
 
+	/* code emitted for the code cache is owned by it, look there first */
+	foreach(lc, context->cache_entries)
+	{
+		LLVMJitCacheEntry *entry = (LLVMJitCacheEntry *) lfirst(lc);
+
+		if (entry->addr != NULL && strcmp(entry->funcname, funcname) == 0)
+			return entry->addr;
+	}
+
 	/*
 	 * ORC's symbol table is of *unmangled* symbols. Therefore we don't need
 	 * to mangle here.
@@ -367,6 +471,260 @@ llvm_get_function(LLVMJitContext *context, const char *funcname)
 	return NULL;
 }
 
+/*
+ * Look up the code generated for one expression in the per-backend code
+ * cache.  The pending module has to contain just that code, and *funcname
+ * is its entry point.
+ *
+ * If a module with identical IR is in the cache, the pending module is
+ * discarded, and the cached code is used instead: its address is returned,
+ * or, if it hasn't been emitted yet, NULL, with *funcname set to the name to
+ * pass to llvm_get_function().  Otherwise the module is added to the code
+ * to be emitted for the context's cache misses, a new cache entry is
+ * created for it, and NULL is returned.  Either way the cache entry stays
+ * pinned until the context is released.
+ */
+void *
+llvm_compile_cached_module(LLVMJitContext *context, const char **funcname)
+{
+	LLVMModuleRef mod = context->module;
+	LLVMValueRef func;
+	List	   *names = NIL;
+	int			nfuncs = 0;
+	int			funcno = -1;
+	char	   *ir;
+	Size		irlen;
+	uint64		hash;
+	LLVMJitCacheEntry *entry;
+	bool		found;
+	MemoryContext oldcontext;
+	ListCell   *lc;
+
+	llvm_assert_in_fatal_section();
+	Assert(context->use_cache && mod != NULL);
+
+	if (llvm_cache == NULL)
+	{
+		HASHCTL		ctl;
+
+		ctl.keysize = sizeof(uint64);
+		ctl.entrysize = sizeof(LLVMJitCacheEntry);
+		llvm_cache = hash_create("LLVM JIT code cache", 64, &ctl,
+								 HASH_ELEM | HASH_BLOBS);
+	}
+
+	/*
+	 * The names of defined functions are unique to the module generation.
+	 * Replace them with names depending only on their position, so
+	 * structurally identical modules print the same IR.
+	 */
+	for (func = LLVMGetFirstFunction(mod);
+		 func != NULL;
+		 func = LLVMGetNextFunction(func))
+	{
+		char	   *name;
+
+		if (LLVMIsDeclaration(func))
+			continue;
+
+		name = pstrdup(LLVMGetValueName(func));
+		if (strcmp(name, *funcname) == 0)
+			funcno = nfuncs;
+		names = lappend(names, name);
+
+		name = psprintf("pgjit.cached.%d", nfuncs++);
+		LLVMSetValueName(func, name);
+		pfree(name);
+	}
+	Assert(funcno >= 0);
+
+	ir = LLVMPrintModuleToString(mod);
+	irlen = strlen(ir);
+	hash = hash_bytes_extended((const unsigned char *) ir, irlen,
+							   context->base.flags);
+
+	entry = hash_search(llvm_cache, &hash, HASH_FIND, NULL);
+	if (entry != NULL &&
+		entry->flags == context->base.flags &&
+		entry->funcno == funcno &&
+		entry->irlen == irlen &&
+		memcmp(entry->ir, ir, irlen) == 0 &&
+		(entry->addr != NULL || entry->owner == context))
+	{
+		/* reuse the cached code, the new module isn't needed anymore */
+		LLVMDisposeMessage(ir);
+		list_free_deep(names);
+		LLVMDisposeModule(mod);
+		context->module = context->pending_module;
+		context->pending_module = NULL;
+		context->compiled = context->module == NULL;
+		context->base.instr.cached_functions += nfuncs;
+
+		entry->refcount++;
+		dlist_move_head(&llvm_cache_lru, &entry->lru_node);
+
+		oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+		context->cache_entries = lappend(context->cache_entries, entry);
+		MemoryContextSwitchTo(oldcontext);
+
+		*funcname = entry->funcname;
+		return entry->addr;
+	}
+
+	/* restore the unique names */
+	func = LLVMGetFirstFunction(mod);
+	foreach(lc, names)
+	{
+		while (LLVMIsDeclaration(func))
+			func = LLVMGetNextFunction(func);
+		LLVMSetValueName(func, lfirst(lc));
+		func = LLVMGetNextFunction(func);
+	}
+	list_free_deep(names);
+
+	/*
+	 * On a hash collision, which is very unlikely, or if another context has
+	 * yet to emit the same code, leave the existing entry alone.  Emit the
+	 * module right away and keep the code with the context.
+	 */
+	if (entry != NULL)
+	{
+		List	   *pending = context->cache_pending;
+		void	   *addr;
+
+		LLVMDisposeMessage(ir);
+
+		context->cache_pending = NIL;
+		llvm_compile_module(context);
+		addr = llvm_get_function(context, *funcname);
+		context->cache_pending = pending;
+
+		context->module = context->pending_module;
+		context->pending_module = NULL;
+		context->compiled = context->module == NULL;
+
+		return addr;
+	}
+
+	/* add the module to the code to be emitted for our cache misses */
+	if (context->pending_module != NULL)
+	{
+		if (LLVMLinkModules2(context->pending_module, mod))
+			elog(ERROR, "failed to link module for JIT code cache");
+		context->module = context->pending_module;
+		context->pending_module = NULL;
+	}
+	context->compiled = false;
+
+	/* make room first, so the new entry isn't evicted right away */
+	llvm_cache_evict(jit_cache_entries - 1);
+
+	entry = hash_search(llvm_cache, &hash, HASH_ENTER, &found);
+	Assert(!found);
+	entry->ir = MemoryContextStrdup(TopMemoryContext, ir);
+	entry->irlen = irlen;
+	entry->flags = context->base.flags;
+	entry->funcno = funcno;
+	entry->nfuncs = nfuncs;
+	entry->funcname = MemoryContextStrdup(TopMemoryContext, *funcname);
+	entry->addr = NULL;
+	entry->owner = context;
+	entry->code = NULL;
+	entry->refcount = 1;
+	dlist_push_head(&llvm_cache_lru, &entry->lru_node);
+	LLVMDisposeMessage(ir);
+
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+	context->cache_entries = lappend(context->cache_entries, entry);
+	context->cache_pending = lappend(context->cache_pending, entry);
+	MemoryContextSwitchTo(oldcontext);
+
+	return NULL;
+}
+
+/*
+ * The code for the context's cache misses has just been emitted, as the
+ * last of its handles.  Hand it over to the cache entries.
+ */
+static void
+llvm_cache_emitted(LLVMJitContext *context)
+{
+	LLVMJitCacheCode *code;
+	ListCell   *lc;
+
+	code = MemoryContextAlloc(TopMemoryContext, sizeof(LLVMJitCacheCode));
+	code->handle = (LLVMJitHandle *) llast(context->handles);
+	code->nentries = 0;
+
+	foreach(lc, context->cache_pending)
+	{
+		LLVMJitCacheEntry *entry = (LLVMJitCacheEntry *) lfirst(lc);
+
+		Assert(entry->owner == context && entry->addr == NULL);
+		entry->addr = llvm_get_function(context, entry->funcname);
+		entry->owner = NULL;
+		entry->code = code;
+		code->nentries++;
+	}
+	list_free(context->cache_pending);
+	context->cache_pending = NIL;
+
+	/* the code is now owned by the cache entries, not the context */
+	context->handles = list_delete_last(context->handles);
+}
+
+/*
+ * Evict unpinned entries from the code cache, least recently used first,
+ * until there are at most maxentries left.
+ */
+static void
+llvm_cache_evict(int maxentries)
+{
+	dlist_node *node;
+
+	if (llvm_cache == NULL || dlist_is_empty(&llvm_cache_lru))
+		return;
+
+	node = dlist_tail_node(&llvm_cache_lru);
+	while (hash_get_num_entries(llvm_cache) > Max(maxentries, 0))
+	{
+		LLVMJitCacheEntry *entry = dlist_container(LLVMJitCacheEntry,
+												   lru_node, node);
+		dlist_node *prev = NULL;
+
+		if (dlist_has_prev(&llvm_cache_lru, node))
+			prev = dlist_prev_node(&llvm_cache_lru, node);
+
+		if (entry->refcount == 0)
+			llvm_cache_remove(entry);
+
+		if (prev == NULL)
+			break;
+		node = prev;
+	}
+}
+
+/*
+ * Remove an unpinned entry from the code cache, and release its code once no
+ * other entry uses it.
+ */
+static void
+llvm_cache_remove(LLVMJitCacheEntry *entry)
+{
+	Assert(entry->refcount == 0);
+
+	if (entry->code != NULL && --entry->code->nentries == 0)
+	{
+		llvm_release_handle(entry->code->handle);
+		pfree(entry->code);
+	}
+
+	dlist_delete(&entry->lru_node);
+	pfree(entry->ir);
+	pfree(entry->funcname);
+	hash_search(llvm_cache, &entry->hash, HASH_REMOVE, NULL);
+}
+
 /*
  * Return type of a variable in llvmjit_types.c. This is useful to keep types
  * in sync between plain C and JIT related code.
@@ -767,6 +1125,9 @@ llvm_compile_module(LLVMJitContext *context)
 	context->handles = lappend(context->handles, handle);
 	MemoryContextSwitchTo(oldcontext);
 
+	if (context->cache_pending != NIL)
+		llvm_cache_emitted(context);
+
 	ereport(DEBUG1,
 			(errmsg_internal("time to inline: %.3fs, opt: %.3fs, emit: %.3fs",
 							 INSTR_TIME_GET_DOUBLE(context->base.instr.inlining_counter),
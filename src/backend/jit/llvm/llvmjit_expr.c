@@ -49,24 +49,47 @@ typedef struct CompiledExprState
 {
 	LLVMJitContext *context;
 	const char *funcname;
+	ExprStateEvalFunc func;		/* already known address, if any */
 } CompiledExprState;
 
+/*
+ * Values specific to one instance of an expression, like the addresses of
+ * its steps and of their fcinfo structs.  Normally these are embedded into the
+ * generated code as constants.  When the code is to be shared through the
+ * per-backend code cache (see llvm_compile_cached_module()), they are instead
+ * collected here and loaded at runtime from ExprState->jit_consts, so that
+ * the generated IR only depends on the structure of the expression.
+ */
+typedef struct ExprJitConsts
+{
+	bool		relocatable;	/* load values at runtime? */
+	LLVMValueRef v_consts;		/* ExprState->jit_consts, loaded on entry */
+	int			nconsts;
+	int			maxconsts;
+	Datum	   *consts;
+} ExprJitConsts;
+
 
 static Datum ExecRunCompiledExpr(ExprState *state, ExprContext *econtext, bool *isNull);
 
+static LLVMValueRef l_expr_datum(LLVMBuilderRef b, ExprJitConsts *jc,
+								 Datum value);
+static LLVMValueRef l_expr_ptr(LLVMBuilderRef b, ExprJitConsts *jc,
+							   void *ptr, LLVMTypeRef type);
 static LLVMValueRef BuildV1Call(LLVMJitContext *context, LLVMBuilderRef b,
-								LLVMModuleRef mod, FunctionCallInfo fcinfo,
+								LLVMModuleRef mod, ExprJitConsts *jc,
+								FunctionCallInfo fcinfo,
 								LLVMValueRef *v_fcinfo_isnull);
 static LLVMValueRef build_EvalXFuncInt(LLVMBuilderRef b, LLVMModuleRef mod,
 									   const char *funcname,
 									   LLVMValueRef v_state,
-									   ExprEvalStep *op,
+									   LLVMValueRef v_op,
 									   int natts, LLVMValueRef *v_args);
 static LLVMValueRef create_LifetimeEnd(LLVMModuleRef mod);
 
 /* macro making it easier to call ExecEval* functions */
-#define build_EvalXFunc(b, mod, funcname, v_state, op, ...) \
-	build_EvalXFuncInt(b, mod, funcname, v_state, op, \
+#define build_EvalXFunc(b, mod, funcname, v_state, v_op, ...) \
+	build_EvalXFuncInt(b, mod, funcname, v_state, v_op, \
 					   lengthof(((LLVMValueRef[]){__VA_ARGS__})), \
 					   ((LLVMValueRef[]){__VA_ARGS__}))
 
@@ -120,6 +143,9 @@ llvm_compile_expr(ExprState *state)
 	LLVMValueRef v_aggvalues;
 	LLVMValueRef v_aggnulls;
 
+	/* instance specific values */
+	ExprJitConsts jc = {0};
+
 	instr_time	starttime;
 	instr_time	endtime;
 
@@ -142,6 +168,19 @@ llvm_compile_expr(ExprState *state)
 
 	INSTR_TIME_SET_CURRENT(starttime);
 
+	/*
+	 * Code that may be cached is generated in a module of its own, so that
+	 * its IR describes just this expression.  Code of earlier expressions
+	 * that hasn't been emitted yet is set aside meanwhile.
+	 */
+	if (context->use_cache)
+	{
+		Assert(context->pending_module == NULL);
+		context->pending_module = context->module;
+		context->module = NULL;
+	}
+	jc.relocatable = context->use_cache;
+
 	mod = llvm_mutable_module(context);
 
 	b = LLVMCreateBuilder();
@@ -222,6 +261,12 @@ llvm_compile_expr(ExprState *state)
 								   FIELDNO_EXPRCONTEXT_AGGNULLS,
 								   "v.econtext.aggnulls");
 
+	/* instance specific values, if not embedded as constants */
+	if (jc.relocatable)
+		jc.v_consts = l_load_struct_gep(b, v_state,
+										FIELDNO_EXPRSTATE_JIT_CONSTS,
+										"v.state.jit_consts");
+
 	/* allocate blocks for each op upfront, so we can do jumps easily */
 	opblocks = palloc(sizeof(LLVMBasicBlockRef) * state->steps_len);
 	for (int opno = 0; opno < state->steps_len; opno++)
@@ -234,6 +279,7 @@ llvm_compile_expr(ExprState *state)
 	{
 		ExprEvalStep *op;
 		ExprEvalOp	opcode;
+		LLVMValueRef v_op;
 		LLVMValueRef v_resvaluep;
 		LLVMValueRef v_resnullp;
 
@@ -242,8 +288,9 @@ llvm_compile_expr(ExprState *state)
 		op = &state->steps[opno];
 		opcode = ExecEvalStepOp(state, op);
 
-		v_resvaluep = l_ptr_const(op->resvalue, l_ptr(TypeSizeT));
-		v_resnullp = l_ptr_const(op->resnull, l_ptr(TypeStorageBool));
+		v_op = l_expr_ptr(b, &jc, op, l_ptr(StructExprEvalStep));
+		v_resvaluep = l_expr_ptr(b, &jc, op->resvalue, l_ptr(TypeSizeT));
+		v_resnullp = l_expr_ptr(b, &jc, op->resnull, l_ptr(TypeStorageBool));
 
 		switch (opcode)
 		{
@@ -396,7 +443,7 @@ llvm_compile_expr(ExprState *state)
 						v_slot = v_scanslot;
 
 					build_EvalXFunc(b, mod, "ExecEvalSysVar",
-									v_state, op, v_econtext, v_slot);
+									v_state, v_op, v_econtext, v_slot);
 
 					LLVMBuildBr(b, opblocks[opno + 1]);
 					break;
@@ -404,7 +451,7 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_WHOLEROW:
 				build_EvalXFunc(b, mod, "ExecEvalWholeRowVar",
-								v_state, op, v_econtext);
+								v_state, v_op, v_econtext);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
@@ -522,7 +569,7 @@ llvm_compile_expr(ExprState *state)
 					LLVMValueRef v_constvalue,
 								v_constnull;
 
-					v_constvalue = l_sizet_const(op->d.constval.value);
+					v_constvalue = l_expr_datum(b, &jc, op->d.constval.value);
 					v_constnull = l_sbool_const(op->d.constval.isnull);
 
 					LLVMBuildStore(b, v_constvalue, v_resvaluep);
@@ -557,7 +604,8 @@ llvm_compile_expr(ExprState *state)
 							elog(ERROR, "argumentless strict functions are pointless");
 
 						v_fcinfo =
-							l_ptr_const(fcinfo, l_ptr(StructFunctionCallInfoData));
+							l_expr_ptr(b, &jc, fcinfo,
+									   l_ptr(StructFunctionCallInfoData));
 
 						/*
 						 * set resnull to true, if the function is actually
@@ -607,7 +655,7 @@ llvm_compile_expr(ExprState *state)
 						LLVMPositionBuilderAtEnd(b, b_nonull);
 					}
 
-					v_retval = BuildV1Call(context, b, mod, fcinfo,
+					v_retval = BuildV1Call(context, b, mod, &jc, fcinfo,
 										   &v_fcinfo_isnull);
 					LLVMBuildStore(b, v_retval, v_resvaluep);
 					LLVMBuildStore(b, v_fcinfo_isnull, v_resnullp);
@@ -618,14 +666,14 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_FUNCEXPR_FUSAGE:
 				build_EvalXFunc(b, mod, "ExecEvalFuncExprFusage",
-								v_state, op, v_econtext);
+								v_state, v_op, v_econtext);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
 
 			case EEOP_FUNCEXPR_STRICT_FUSAGE:
 				build_EvalXFunc(b, mod, "ExecEvalFuncExprStrictFusage",
-								v_state, op, v_econtext);
+								v_state, v_op, v_econtext);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
@@ -659,8 +707,8 @@ llvm_compile_expr(ExprState *state)
 					b_boolcont = l_bb_before_v(opblocks[opno + 1],
 											   "b.%d.boolcont", opno);
 
-					v_boolanynullp = l_ptr_const(op->d.boolexpr.anynull,
-												 l_ptr(TypeStorageBool));
+					v_boolanynullp = l_expr_ptr(b, &jc, op->d.boolexpr.anynull,
+												l_ptr(TypeStorageBool));
 
 					if (opcode == EEOP_BOOL_AND_STEP_FIRST)
 						LLVMBuildStore(b, l_sbool_const(0), v_boolanynullp);
@@ -756,8 +804,8 @@ llvm_compile_expr(ExprState *state)
 					b_boolcont = l_bb_before_v(opblocks[opno + 1],
 											   "b.%d.boolcont", opno);
 
-					v_boolanynullp = l_ptr_const(op->d.boolexpr.anynull,
-												 l_ptr(TypeStorageBool));
+					v_boolanynullp = l_expr_ptr(b, &jc, op->d.boolexpr.anynull,
+												l_ptr(TypeStorageBool));
 
 					if (opcode == EEOP_BOOL_OR_STEP_FIRST)
 						LLVMBuildStore(b, l_sbool_const(0), v_boolanynullp);
@@ -986,13 +1034,13 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_NULLTEST_ROWISNULL:
 				build_EvalXFunc(b, mod, "ExecEvalRowNull",
-								v_state, op, v_econtext);
+								v_state, v_op, v_econtext);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
 			case EEOP_NULLTEST_ROWISNOTNULL:
 				build_EvalXFunc(b, mod, "ExecEvalRowNotNull",
-								v_state, op, v_econtext);
+								v_state, v_op, v_econtext);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
@@ -1063,13 +1111,13 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_PARAM_EXEC:
 				build_EvalXFunc(b, mod, "ExecEvalParamExec",
-								v_state, op, v_econtext);
+								v_state, v_op, v_econtext);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
 			case EEOP_PARAM_EXTERN:
 				build_EvalXFunc(b, mod, "ExecEvalParamExtern",
-								v_state, op, v_econtext);
+								v_state, v_op, v_econtext);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
@@ -1080,11 +1128,11 @@ llvm_compile_expr(ExprState *state)
 					LLVMValueRef v_params[3];
 
 					v_functype = llvm_pg_var_func_type("TypeExecEvalSubroutine");
-					v_func = l_ptr_const(op->d.cparam.paramfunc,
-										 LLVMPointerType(v_functype, 0));
+					v_func = l_expr_ptr(b, &jc, op->d.cparam.paramfunc,
+										LLVMPointerType(v_functype, 0));
 
 					v_params[0] = v_state;
-					v_params[1] = l_ptr_const(op, l_ptr(StructExprEvalStep));
+					v_params[1] = v_op;
 					v_params[2] = v_econtext;
 					LLVMBuildCall(b,
 								  v_func,
@@ -1103,11 +1151,11 @@ llvm_compile_expr(ExprState *state)
 					LLVMValueRef v_ret;
 
 					v_functype = llvm_pg_var_func_type("TypeExecEvalBoolSubroutine");
-					v_func = l_ptr_const(op->d.sbsref_subscript.subscriptfunc,
-										 LLVMPointerType(v_functype, 0));
+					v_func = l_expr_ptr(b, &jc, op->d.sbsref_subscript.subscriptfunc,
+										LLVMPointerType(v_functype, 0));
 
 					v_params[0] = v_state;
-					v_params[1] = l_ptr_const(op, l_ptr(StructExprEvalStep));
+					v_params[1] = v_op;
 					v_params[2] = v_econtext;
 					v_ret = LLVMBuildCall(b,
 										  v_func,
@@ -1131,11 +1179,11 @@ llvm_compile_expr(ExprState *state)
 					LLVMValueRef v_params[3];
 
 					v_functype = llvm_pg_var_func_type("TypeExecEvalSubroutine");
-					v_func = l_ptr_const(op->d.sbsref.subscriptfunc,
-										 LLVMPointerType(v_functype, 0));
+					v_func = l_expr_ptr(b, &jc, op->d.sbsref.subscriptfunc,
+										LLVMPointerType(v_functype, 0));
 
 					v_params[0] = v_state;
-					v_params[1] = l_ptr_const(op, l_ptr(StructExprEvalStep));
+					v_params[1] = v_op;
 					v_params[2] = v_econtext;
 					LLVMBuildCall(b,
 								  v_func,
@@ -1160,10 +1208,10 @@ llvm_compile_expr(ExprState *state)
 					b_notavail = l_bb_before_v(opblocks[opno + 1],
 											   "op.%d.notavail", opno);
 
-					v_casevaluep = l_ptr_const(op->d.casetest.value,
-											   l_ptr(TypeSizeT));
-					v_casenullp = l_ptr_const(op->d.casetest.isnull,
-											  l_ptr(TypeStorageBool));
+					v_casevaluep = l_expr_ptr(b, &jc, op->d.casetest.value,
+											  l_ptr(TypeSizeT));
+					v_casenullp = l_expr_ptr(b, &jc, op->d.casetest.isnull,
+											 l_ptr(TypeStorageBool));
 
 					v_casevaluenull =
 						LLVMBuildICmp(b, LLVMIntEQ,
@@ -1208,8 +1256,8 @@ llvm_compile_expr(ExprState *state)
 					b_notnull = l_bb_before_v(opblocks[opno + 1],
 											  "op.%d.readonly.notnull", opno);
 
-					v_nullp = l_ptr_const(op->d.make_readonly.isnull,
-										  l_ptr(TypeStorageBool));
+					v_nullp = l_expr_ptr(b, &jc, op->d.make_readonly.isnull,
+										 l_ptr(TypeStorageBool));
 
 					v_null = LLVMBuildLoad(b, v_nullp, "");
 
@@ -1225,8 +1273,8 @@ llvm_compile_expr(ExprState *state)
 					/* if value is not null, convert to RO datum */
 					LLVMPositionBuilderAtEnd(b, b_notnull);
 
-					v_valuep = l_ptr_const(op->d.make_readonly.value,
-										   l_ptr(TypeSizeT));
+					v_valuep = l_expr_ptr(b, &jc, op->d.make_readonly.value,
+										  l_ptr(TypeSizeT));
 
 					v_value = LLVMBuildLoad(b, v_valuep, "");
 
@@ -1276,8 +1324,10 @@ llvm_compile_expr(ExprState *state)
 
 					v_fn_out = llvm_function_reference(context, b, mod, fcinfo_out);
 					v_fn_in = llvm_function_reference(context, b, mod, fcinfo_in);
-					v_fcinfo_out = l_ptr_const(fcinfo_out, l_ptr(StructFunctionCallInfoData));
-					v_fcinfo_in = l_ptr_const(fcinfo_in, l_ptr(StructFunctionCallInfoData));
+					v_fcinfo_out = l_expr_ptr(b, &jc, fcinfo_out,
+											  l_ptr(StructFunctionCallInfoData));
+					v_fcinfo_in = l_expr_ptr(b, &jc, fcinfo_in,
+											 l_ptr(StructFunctionCallInfoData));
 
 					v_fcinfo_in_isnullp =
 						LLVMBuildStructGEP(b, v_fcinfo_in,
@@ -1399,7 +1449,8 @@ llvm_compile_expr(ExprState *state)
 					b_bothargnull = l_bb_before_v(opblocks[opno + 1], "op.%d.bothargnull", opno);
 					b_anyargnull = l_bb_before_v(opblocks[opno + 1], "op.%d.anyargnull", opno);
 
-					v_fcinfo = l_ptr_const(fcinfo, l_ptr(StructFunctionCallInfoData));
+					v_fcinfo = l_expr_ptr(b, &jc, fcinfo,
+										  l_ptr(StructFunctionCallInfoData));
 
 					/* load args[0|1].isnull for both arguments */
 					v_argnull0 = l_funcnull(b, v_fcinfo, 0);
@@ -1450,7 +1501,7 @@ llvm_compile_expr(ExprState *state)
 					/* neither argument is null: compare */
 					LLVMPositionBuilderAtEnd(b, b_noargnull);
 
-					v_result = BuildV1Call(context, b, mod, fcinfo,
+					v_result = BuildV1Call(context, b, mod, &jc, fcinfo,
 										   &v_fcinfo_isnull);
 
 					if (opcode == EEOP_DISTINCT)
@@ -1494,7 +1545,8 @@ llvm_compile_expr(ExprState *state)
 					b_argsequal = l_bb_before_v(opblocks[opno + 1],
 												"b.%d.argsequal", opno);
 
-					v_fcinfo = l_ptr_const(fcinfo, l_ptr(StructFunctionCallInfoData));
+					v_fcinfo = l_expr_ptr(b, &jc, fcinfo,
+										  l_ptr(StructFunctionCallInfoData));
 
 					/* if either argument is NULL they can't be equal */
 					v_argnull0 = l_funcnull(b, v_fcinfo, 0);
@@ -1520,7 +1572,7 @@ llvm_compile_expr(ExprState *state)
 					/* build block to invoke function and check result */
 					LLVMPositionBuilderAtEnd(b, b_nonull);
 
-					v_retval = BuildV1Call(context, b, mod, fcinfo, &v_fcinfo_isnull);
+					v_retval = BuildV1Call(context, b, mod, &jc, fcinfo, &v_fcinfo_isnull);
 
 					/*
 					 * If result not null, and arguments are equal return null
@@ -1551,37 +1603,37 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_SQLVALUEFUNCTION:
 				build_EvalXFunc(b, mod, "ExecEvalSQLValueFunction",
-								v_state, op);
+								v_state, v_op);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
 			case EEOP_CURRENTOFEXPR:
 				build_EvalXFunc(b, mod, "ExecEvalCurrentOfExpr",
-								v_state, op);
+								v_state, v_op);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
 			case EEOP_NEXTVALUEEXPR:
 				build_EvalXFunc(b, mod, "ExecEvalNextValueExpr",
-								v_state, op);
+								v_state, v_op);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
 			case EEOP_ARRAYEXPR:
 				build_EvalXFunc(b, mod, "ExecEvalArrayExpr",
-								v_state, op);
+								v_state, v_op);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
 			case EEOP_ARRAYCOERCE:
 				build_EvalXFunc(b, mod, "ExecEvalArrayCoerce",
-								v_state, op, v_econtext);
+								v_state, v_op, v_econtext);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
 			case EEOP_ROW:
 				build_EvalXFunc(b, mod, "ExecEvalRow",
-								v_state, op);
+								v_state, v_op);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
@@ -1615,8 +1667,8 @@ llvm_compile_expr(ExprState *state)
 						LLVMValueRef v_argnull1;
 						LLVMValueRef v_anyargisnull;
 
-						v_fcinfo = l_ptr_const(fcinfo,
-											   l_ptr(StructFunctionCallInfoData));
+						v_fcinfo = l_expr_ptr(b, &jc, fcinfo,
+											  l_ptr(StructFunctionCallInfoData));
 
 						v_argnull0 = l_funcnull(b, v_fcinfo, 0);
 						v_argnull1 = l_funcnull(b, v_fcinfo, 1);
@@ -1644,7 +1696,7 @@ llvm_compile_expr(ExprState *state)
 					LLVMPositionBuilderAtEnd(b, b_compare);
 
 					/* call function */
-					v_retval = BuildV1Call(context, b, mod, fcinfo,
+					v_retval = BuildV1Call(context, b, mod, &jc, fcinfo,
 										   &v_fcinfo_isnull);
 					LLVMBuildStore(b, v_retval, v_resvaluep);
 
@@ -1736,25 +1788,25 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_MINMAX:
 				build_EvalXFunc(b, mod, "ExecEvalMinMax",
-								v_state, op);
+								v_state, v_op);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
 			case EEOP_FIELDSELECT:
 				build_EvalXFunc(b, mod, "ExecEvalFieldSelect",
-								v_state, op, v_econtext);
+								v_state, v_op, v_econtext);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
 			case EEOP_FIELDSTORE_DEFORM:
 				build_EvalXFunc(b, mod, "ExecEvalFieldStoreDeForm",
-								v_state, op, v_econtext);
+								v_state, v_op, v_econtext);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
 			case EEOP_FIELDSTORE_FORM:
 				build_EvalXFunc(b, mod, "ExecEvalFieldStoreForm",
-								v_state, op, v_econtext);
+								v_state, v_op, v_econtext);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
@@ -1773,10 +1825,10 @@ llvm_compile_expr(ExprState *state)
 					b_notavail = l_bb_before_v(opblocks[opno + 1],
 											   "op.%d.notavail", opno);
 
-					v_casevaluep = l_ptr_const(op->d.casetest.value,
-											   l_ptr(TypeSizeT));
-					v_casenullp = l_ptr_const(op->d.casetest.isnull,
-											  l_ptr(TypeStorageBool));
+					v_casevaluep = l_expr_ptr(b, &jc, op->d.casetest.value,
+											  l_ptr(TypeSizeT));
+					v_casenullp = l_expr_ptr(b, &jc, op->d.casetest.isnull,
+											 l_ptr(TypeStorageBool));
 
 					v_casevaluenull =
 						LLVMBuildICmp(b, LLVMIntEQ,
@@ -1814,37 +1866,37 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_DOMAIN_NOTNULL:
 				build_EvalXFunc(b, mod, "ExecEvalConstraintNotNull",
-								v_state, op);
+								v_state, v_op);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
 			case EEOP_DOMAIN_CHECK:
 				build_EvalXFunc(b, mod, "ExecEvalConstraintCheck",
-								v_state, op);
+								v_state, v_op);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
 			case EEOP_CONVERT_ROWTYPE:
 				build_EvalXFunc(b, mod, "ExecEvalConvertRowtype",
-								v_state, op, v_econtext);
+								v_state, v_op, v_econtext);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
 			case EEOP_SCALARARRAYOP:
 				build_EvalXFunc(b, mod, "ExecEvalScalarArrayOp",
-								v_state, op);
+								v_state, v_op);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
 			case EEOP_HASHED_SCALARARRAYOP:
 				build_EvalXFunc(b, mod, "ExecEvalHashedScalarArrayOp",
-								v_state, op, v_econtext);
+								v_state, v_op, v_econtext);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
 			case EEOP_XMLEXPR:
 				build_EvalXFunc(b, mod, "ExecEvalXmlExpr",
-								v_state, op);
+								v_state, v_op);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
@@ -1870,7 +1922,7 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_GROUPING_FUNC:
 				build_EvalXFunc(b, mod, "ExecEvalGroupingFunc",
-								v_state, op);
+								v_state, v_op);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
@@ -1887,8 +1939,8 @@ llvm_compile_expr(ExprState *state)
 					 * up in ExecInitWindowAgg() after initializing the
 					 * expression). So load it from memory each time round.
 					 */
-					v_wfuncnop = l_ptr_const(&wfunc->wfuncno,
-											 l_ptr(LLVMInt32Type()));
+					v_wfuncnop = l_expr_ptr(b, &jc, &wfunc->wfuncno,
+											l_ptr(LLVMInt32Type()));
 					v_wfuncno = LLVMBuildLoad(b, v_wfuncnop, "v_wfuncno");
 
 					/* load window func value / null */
@@ -1906,7 +1958,7 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_SUBPLAN:
 				build_EvalXFunc(b, mod, "ExecEvalSubPlan",
-								v_state, op, v_econtext);
+								v_state, v_op, v_econtext);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
@@ -1930,8 +1982,8 @@ llvm_compile_expr(ExprState *state)
 						b_deserialize = l_bb_before_v(opblocks[opno + 1],
 													  "op.%d.deserialize", opno);
 
-						v_fcinfo = l_ptr_const(fcinfo,
-											   l_ptr(StructFunctionCallInfoData));
+						v_fcinfo = l_expr_ptr(b, &jc, fcinfo,
+											  l_ptr(StructFunctionCallInfoData));
 						v_argnull0 = l_funcnull(b, v_fcinfo, 0);
 
 						LLVMBuildCondBr(b,
@@ -1949,10 +2001,10 @@ llvm_compile_expr(ExprState *state)
 					fcinfo = op->d.agg_deserialize.fcinfo_data;
 
 					v_tmpcontext =
-						l_ptr_const(aggstate->tmpcontext->ecxt_per_tuple_memory,
-									l_ptr(StructMemoryContextData));
+						l_expr_ptr(b, &jc, aggstate->tmpcontext->ecxt_per_tuple_memory,
+								   l_ptr(StructMemoryContextData));
 					v_oldcontext = l_mcxt_switch(mod, b, v_tmpcontext);
-					v_retval = BuildV1Call(context, b, mod, fcinfo,
+					v_retval = BuildV1Call(context, b, mod, &jc, fcinfo,
 										   &v_fcinfo_isnull);
 					l_mcxt_switch(mod, b, v_oldcontext);
 
@@ -1978,8 +2030,10 @@ llvm_compile_expr(ExprState *state)
 					Assert(nargs > 0);
 
 					jumpnull = op->d.agg_strict_input_check.jumpnull;
-					v_argsp = l_ptr_const(args, l_ptr(StructNullableDatum));
-					v_nullsp = l_ptr_const(nulls, l_ptr(TypeStorageBool));
+					v_argsp = l_expr_ptr(b, &jc, args,
+										 l_ptr(StructNullableDatum));
+					v_nullsp = l_expr_ptr(b, &jc, nulls,
+										  l_ptr(TypeStorageBool));
 
 					/* create blocks for checking args */
 					b_checknulls = palloc(sizeof(LLVMBasicBlockRef *) * nargs);
@@ -2110,8 +2164,8 @@ llvm_compile_expr(ExprState *state)
 
 					v_aggstatep =
 						LLVMBuildBitCast(b, v_parent, l_ptr(StructAggState), "");
-					v_pertransp = l_ptr_const(pertrans,
-											  l_ptr(StructAggStatePerTransData));
+					v_pertransp = l_expr_ptr(b, &jc, pertrans,
+											 l_ptr(StructAggStatePerTransData));
 
 					/*
 					 * pergroup = &aggstate->all_pergroups
@@ -2159,8 +2213,8 @@ llvm_compile_expr(ExprState *state)
 
 							LLVMPositionBuilderAtEnd(b, b_init);
 
-							v_aggcontext = l_ptr_const(op->d.agg_trans.aggcontext,
-													   l_ptr(StructExprContext));
+							v_aggcontext = l_expr_ptr(b, &jc, op->d.agg_trans.aggcontext,
+													  l_ptr(StructExprContext));
 
 							params[0] = v_aggstatep;
 							params[1] = v_pertransp;
@@ -2203,10 +2257,10 @@ llvm_compile_expr(ExprState *state)
 					}
 
 
-					v_fcinfo = l_ptr_const(fcinfo,
-										   l_ptr(StructFunctionCallInfoData));
-					v_aggcontext = l_ptr_const(op->d.agg_trans.aggcontext,
-											   l_ptr(StructExprContext));
+					v_fcinfo = l_expr_ptr(b, &jc, fcinfo,
+										  l_ptr(StructFunctionCallInfoData));
+					v_aggcontext = l_expr_ptr(b, &jc, op->d.agg_trans.aggcontext,
+											  l_ptr(StructExprContext));
 
 					v_current_setp =
 						LLVMBuildStructGEP(b,
@@ -2232,8 +2286,8 @@ llvm_compile_expr(ExprState *state)
 
 					/* invoke transition function in per-tuple context */
 					v_tmpcontext =
-						l_ptr_const(aggstate->tmpcontext->ecxt_per_tuple_memory,
-									l_ptr(StructMemoryContextData));
+						l_expr_ptr(b, &jc, aggstate->tmpcontext->ecxt_per_tuple_memory,
+								   l_ptr(StructMemoryContextData));
 					v_oldcontext = l_mcxt_switch(mod, b, v_tmpcontext);
 
 					/* store transvalue in fcinfo->args[0] */
@@ -2254,7 +2308,7 @@ llvm_compile_expr(ExprState *state)
 								   l_funcnullp(b, v_fcinfo, 0));
 
 					/* and invoke transition function */
-					v_retval = BuildV1Call(context, b, mod, fcinfo,
+					v_retval = BuildV1Call(context, b, mod, &jc, fcinfo,
 										   &v_fcinfo_isnull);
 
 					/*
@@ -2337,13 +2391,13 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_AGG_ORDERED_TRANS_DATUM:
 				build_EvalXFunc(b, mod, "ExecEvalAggOrderedTransDatum",
-								v_state, op, v_econtext);
+								v_state, v_op, v_econtext);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
 			case EEOP_AGG_ORDERED_TRANS_TUPLE:
 				build_EvalXFunc(b, mod, "ExecEvalAggOrderedTransTuple",
-								v_state, op, v_econtext);
+								v_state, v_op, v_econtext);
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
@@ -2355,11 +2409,20 @@ llvm_compile_expr(ExprState *state)
 
 	LLVMDisposeBuilder(b);
 
+	INSTR_TIME_SET_CURRENT(endtime);
+	INSTR_TIME_ACCUM_DIFF(context->base.instr.generation_counter,
+						  endtime, starttime);
+
 	/*
 	 * Don't immediately emit function, instead do so the first time the
 	 * expression is actually evaluated. That allows to emit a lot of
 	 * functions together, avoiding a lot of repeated llvm and memory
 	 * remapping overhead.
+	 *
+	 * Code that may be cached is looked up in the cache right away.  On a
+	 * hit, the cached code is used, and is either emitted already or
+	 * pending in this context.  On a miss, the code is added to the pending
+	 * module as usual.
 	 */
 	{
 
@@ -2368,16 +2431,19 @@ llvm_compile_expr(ExprState *state)
 		cstate->context = context;
 		cstate->funcname = funcname;
 
+		if (jc.relocatable)
+		{
+			state->jit_consts = jc.consts;
+			cstate->func = (ExprStateEvalFunc)
+				llvm_compile_cached_module(context, &cstate->funcname);
+		}
+
 		state->evalfunc = ExecRunCompiledExpr;
 		state->evalfunc_private = cstate;
 	}
 
 	llvm_leave_fatal_on_oom();
 
-	INSTR_TIME_SET_CURRENT(endtime);
-	INSTR_TIME_ACCUM_DIFF(context->base.instr.generation_counter,
-						  endtime, starttime);
-
 	return true;
 }
 
@@ -2397,10 +2463,15 @@ ExecRunCompiledExpr(ExprState *state, ExprContext *econtext, bool *isNull)
 
 	CheckExprStillValid(state, econtext);
 
-	llvm_enter_fatal_on_oom();
-	func = (ExprStateEvalFunc) llvm_get_function(cstate->context,
-												 cstate->funcname);
-	llvm_leave_fatal_on_oom();
+	if (cstate->func)
+		func = cstate->func;
+	else
+	{
+		llvm_enter_fatal_on_oom();
+		func = (ExprStateEvalFunc) llvm_get_function(cstate->context,
+													 cstate->funcname);
+		llvm_leave_fatal_on_oom();
+	}
 	Assert(func);
 
 	/* remove indirection via this function for future calls */
@@ -2409,9 +2480,51 @@ ExecRunCompiledExpr(ExprState *state, ExprContext *econtext, bool *isNull)
 	return func(state, econtext, isNull);
 }
 
+/*
+ * Return the value of an instance specific Datum, either as a constant or, if
+ * generating relocatable code, loaded from ExprState->jit_consts.
+ */
+static LLVMValueRef
+l_expr_datum(LLVMBuilderRef b, ExprJitConsts *jc, Datum value)
+{
+	if (!jc->relocatable)
+		return l_sizet_const(value);
+
+	if (jc->nconsts >= jc->maxconsts)
+	{
+		if (jc->maxconsts == 0)
+		{
+			jc->maxconsts = 16;
+			jc->consts = palloc(sizeof(Datum) * jc->maxconsts);
+		}
+		else
+		{
+			jc->maxconsts *= 2;
+			jc->consts = repalloc(jc->consts, sizeof(Datum) * jc->maxconsts);
+		}
+	}
+	jc->consts[jc->nconsts] = value;
+
+	return l_load_gep1(b, jc->v_consts, l_int32_const(jc->nconsts++), "");
+}
+
+/*
+ * Like l_expr_datum(), but for an instance specific pointer of type type.
+ */
+static LLVMValueRef
+l_expr_ptr(LLVMBuilderRef b, ExprJitConsts *jc, void *ptr, LLVMTypeRef type)
+{
+	if (!jc->relocatable)
+		return l_ptr_const(ptr, type);
+
+	return LLVMBuildIntToPtr(b, l_expr_datum(b, jc, PointerGetDatum(ptr)),
+							 type, "");
+}
+
 static LLVMValueRef
 BuildV1Call(LLVMJitContext *context, LLVMBuilderRef b,
-			LLVMModuleRef mod, FunctionCallInfo fcinfo,
+			LLVMModuleRef mod, ExprJitConsts *jc,
+			FunctionCallInfo fcinfo,
 			LLVMValueRef *v_fcinfo_isnull)
 {
 	LLVMValueRef v_fn;
@@ -2421,7 +2534,7 @@ BuildV1Call(LLVMJitContext *context, LLVMBuilderRef b,
 
 	v_fn = llvm_function_reference(context, b, mod, fcinfo);
 
-	v_fcinfo = l_ptr_const(fcinfo, l_ptr(StructFunctionCallInfoData));
+	v_fcinfo = l_expr_ptr(b, jc, fcinfo, l_ptr(StructFunctionCallInfoData));
 	v_fcinfo_isnullp = LLVMBuildStructGEP(b, v_fcinfo,
 										  FIELDNO_FUNCTIONCALLINFODATA_ISNULL,
 										  "v_fcinfo_isnull");
@@ -2441,11 +2554,16 @@ BuildV1Call(LLVMJitContext *context, LLVMBuilderRef b,
 		LLVMValueRef params[2];
 
 		params[0] = l_int64_const(sizeof(NullableDatum) * fcinfo->nargs);
-		params[1] = l_ptr_const(fcinfo->args, l_ptr(LLVMInt8Type()));
+		params[1] = LLVMBuildBitCast(b,
+									 LLVMBuildStructGEP(b, v_fcinfo,
+														FIELDNO_FUNCTIONCALLINFODATA_ARGS,
+														""),
+									 l_ptr(LLVMInt8Type()), "");
 		LLVMBuildCall(b, v_lifetime, params, lengthof(params), "");
 
 		params[0] = l_int64_const(sizeof(fcinfo->isnull));
-		params[1] = l_ptr_const(&fcinfo->isnull, l_ptr(LLVMInt8Type()));
+		params[1] = LLVMBuildBitCast(b, v_fcinfo_isnullp,
+									 l_ptr(LLVMInt8Type()), "");
 		LLVMBuildCall(b, v_lifetime, params, lengthof(params), "");
 	}
 
@@ -2457,7 +2575,7 @@ BuildV1Call(LLVMJitContext *context, LLVMBuilderRef b,
  */
 static LLVMValueRef
 build_EvalXFuncInt(LLVMBuilderRef b, LLVMModuleRef mod, const char *funcname,
-				   LLVMValueRef v_state, ExprEvalStep *op,
+				   LLVMValueRef v_state, LLVMValueRef v_op,
 				   int nargs, LLVMValueRef *v_args)
 {
 	LLVMValueRef v_fn = llvm_pg_func(mod, funcname);
@@ -2473,7 +2591,7 @@ build_EvalXFuncInt(LLVMBuilderRef b, LLVMModuleRef mod, const char *funcname,
 	params = palloc(sizeof(LLVMValueRef) * (2 + nargs));
 
 	params[argno++] = v_state;
-	params[argno++] = l_ptr_const(op, l_ptr(StructExprEvalStep));
+	params[argno++] = v_op;
 
 	for (int i = 0; i < nargs; i++)
 		params[argno++] = v_args[i];
@@ -44,6 +44,7 @@
 #include "common/hashfn.h"
 #include "nodes/bitmapset.h"
 #include "nodes/tidbitmap.h"
+#include "storage/bufmgr.h"
 #include "storage/lwlock.h"
 #include "utils/dsa.h"
 
@@ -954,6 +955,29 @@ tbm_advance_schunkbit(PagetableEntry *chunk, int *schunkbitp)
 	*schunkbitp = schunkbit;
 }
 
+/*
+ * tbm_chunk_nahead - count the lossy pages immediately following the one at
+ * schunkbit in a chunk, that is, the pages tbm_iterate() will return next
+ */
+static inline int
+tbm_chunk_nahead(PagetableEntry *chunk, int schunkbit)
+{
+	int			nahead = 0;
+
+	while (nahead < MAX_IO_COMBINE_LIMIT - 1 &&
+		   ++schunkbit < PAGES_PER_CHUNK)
+	{
+		int			wordnum = WORDNUM(schunkbit);
+		int			bitnum = BITNUM(schunkbit);
+
+		if ((chunk->words[wordnum] & ((bitmapword) 1 << bitnum)) == 0)
+			break;
+		nahead++;
+	}
+
+	return nahead;
+}
+
 /*
  * tbm_iterate - scan through next page of a TIDBitmap
  *
@@ -1011,6 +1035,7 @@ tbm_iterate(TBMIterator *iterator)
 			output->blockno = chunk_blockno;
 			output->ntuples = -1;
 			output->recheck = true;
+			output->nahead = tbm_chunk_nahead(chunk, iterator->schunkbit);
 			iterator->schunkbit++;
 			return output;
 		}
@@ -1032,6 +1057,15 @@ tbm_iterate(TBMIterator *iterator)
 		output->blockno = page->blockno;
 		output->ntuples = ntuples;
 		output->recheck = page->recheck;
+
+		/* count the exact pages following this one without a gap */
+		output->nahead = 0;
+		while (output->nahead < MAX_IO_COMBINE_LIMIT - 1 &&
+			   iterator->spageptr + 1 + output->nahead < tbm->npages &&
+			   tbm->spages[iterator->spageptr + 1 + output->nahead]->blockno ==
+			   page->blockno + 1 + output->nahead)
+			output->nahead++;
+
 		iterator->spageptr++;
 		return output;
 	}
@@ -1040,6 +1074,76 @@ tbm_iterate(TBMIterator *iterator)
 	return NULL;
 }
 
+/*
+ *	tbm_iterate_consecutive - count upcoming consecutive pages
+ *
+ * Returns how many of the pages that the following tbm_iterate() calls will
+ * return are numbered consecutively after the page it returned last, up to
+ * a maximum of max.  The iterator's position is not changed.
+ */
+int
+tbm_iterate_consecutive(TBMIterator *iterator, int max)
+{
+	TIDBitmap  *tbm = iterator->tbm;
+	int			spageptr = iterator->spageptr;
+	int			schunkptr = iterator->schunkptr;
+	int			schunkbit = iterator->schunkbit;
+	BlockNumber expected = iterator->output.blockno + 1;
+	int			n = 0;
+
+	Assert(tbm->iterating == TBM_ITERATING_PRIVATE);
+
+	while (n < max)
+	{
+		BlockNumber next = InvalidBlockNumber;
+
+		/* Same logic as tbm_iterate(), minus extracting the tuples */
+		while (schunkptr < tbm->nchunks)
+		{
+			PagetableEntry *chunk = tbm->schunks[schunkptr];
+			int			bit = schunkbit;
+
+			tbm_advance_schunkbit(chunk, &bit);
+			if (bit < PAGES_PER_CHUNK)
+			{
+				schunkbit = bit;
+				break;
+			}
+			schunkptr++;
+			schunkbit = 0;
+		}
+
+		if (schunkptr < tbm->nchunks)
+		{
+			BlockNumber chunk_blockno;
+
+			chunk_blockno = tbm->schunks[schunkptr]->blockno + schunkbit;
+			if (spageptr >= tbm->npages ||
+				chunk_blockno < tbm->spages[spageptr]->blockno)
+			{
+				next = chunk_blockno;
+				schunkbit++;
+			}
+		}
+
+		if (next == InvalidBlockNumber && spageptr < tbm->npages)
+		{
+			if (tbm->status == TBM_ONE_PAGE)
+				next = tbm->entry1.blockno;
+			else
+				next = tbm->spages[spageptr]->blockno;
+			spageptr++;
+		}
+
+		if (next != expected)
+			break;
+		n++;
+		expected++;
+	}
+
+	return n;
+}
+
 /*
  *	tbm_shared_iterate - scan through next page of a TIDBitmap
  *
@@ -1104,6 +1208,7 @@ tbm_shared_iterate(TBMSharedIterator *iterator)
 			output->blockno = chunk_blockno;
 			output->ntuples = -1;
 			output->recheck = true;
+			output->nahead = 0;
 			istate->schunkbit++;
 
 			LWLockRelease(&istate->lock);
@@ -1121,6 +1226,7 @@ tbm_shared_iterate(TBMSharedIterator *iterator)
 		output->blockno = page->blockno;
 		output->ntuples = ntuples;
 		output->recheck = page->recheck;
+		output->nahead = 0;
 		istate->spageptr++;
 
 		LWLockRelease(&istate->lock);
@@ -150,6 +150,7 @@ bool		enable_partitionwise_join = false;
 bool		enable_partitionwise_aggregate = false;
 bool		enable_parallel_append = true;
 bool		enable_parallel_hash = true;
+bool		enable_parallel_hashagg = false;
 bool		enable_partition_pruning = true;
 bool		enable_async_append = true;
 
@@ -2789,6 +2790,48 @@ cost_agg(Path *path, PlannerInfo *root,
 	path->total_cost = total_cost;
 }
 
+/*
+ * cost_parallel_hashagg
+ *		Determines and returns the cost of performing a Parallel HashAggregate
+ *		plan node, including the cost of its (partial) input.
+ *
+ * Each participant writes its share of the input to shared partition files
+ * and reads back a share of those files, and then aggregates about its share
+ * of the groups as an ordinary hashed Agg would.  numGroups is the total
+ * number of groups; input_tuples is per participant, and so is the resulting
+ * row count.
+ */
+void
+cost_parallel_hashagg(Path *path, PlannerInfo *root,
+					  const AggClauseCosts *aggcosts,
+					  int numGroupCols, double numGroups,
+					  List *quals,
+					  Cost input_startup_cost, Cost input_total_cost,
+					  double input_tuples, double input_width)
+{
+	double		parallel_divisor = get_parallel_divisor(path);
+	double		pages;
+	Cost		partition_cost;
+
+	cost_agg(path, root, AGG_HASHED, aggcosts,
+			 numGroupCols, clamp_row_est(numGroups / parallel_divisor),
+			 quals,
+			 input_startup_cost, input_total_cost,
+			 input_tuples, input_width);
+
+	/*
+	 * Charge for writing every input tuple to a partition and reading it
+	 * back, like one level of hash aggregation spilling; all of it happens
+	 * before the first group can be returned.
+	 */
+	pages = relation_byte_size(input_tuples, input_width) / BLCKSZ;
+	partition_cost = pages * (random_page_cost + seq_page_cost);
+	partition_cost += input_tuples * 2.0 * cpu_tuple_cost;
+
+	path->startup_cost += partition_cost;
+	path->total_cost += partition_cost;
+}
+
 /*
  * cost_windowagg
  *		Determines and returns the cost of performing a WindowAgg plan node,
@@ -6503,6 +6503,29 @@ add_paths_to_grouping_rel(PlannerInfo *root, RelOptInfo *input_rel,
 									 havingQual,
 									 agg_costs,
 									 dNumGroups));
+
+			/*
+			 * Also consider a Parallel HashAgg over the cheapest partial
+			 * input path.  Its output is fully aggregated, so it goes into
+			 * the partial pathlist, to be gathered below.  Unlike partial
+			 * aggregation this doesn't need combine functions, and it doesn't
+			 * make every worker build a hash table of (nearly) all groups.
+			 */
+			if (enable_parallel_hashagg && grouped_rel->consider_parallel &&
+				input_rel->partial_pathlist != NIL)
+			{
+				Path	   *partial_path = linitial(input_rel->partial_pathlist);
+
+				add_partial_path(grouped_rel, (Path *)
+								 create_parallel_hashagg_path(root,
+															  grouped_rel,
+															  partial_path,
+															  grouped_rel->reltarget,
+															  parse->groupClause,
+															  havingQual,
+															  agg_costs,
+															  dNumGroups));
+			}
 		}
 
 		/*
@@ -3144,6 +3144,64 @@ create_agg_path(PlannerInfo *root,
 	return pathnode;
 }
 
+/*
+ * create_parallel_hashagg_path
+ *	  Creates a pathnode that represents a Parallel HashAggregate.
+ *
+ * The subpath must be a partial path.  The participants repartition the
+ * input by hash value and then each aggregate whole partitions, so the result
+ * is a partial path whose rows are fully aggregated groups, which needs only
+ * a Gather on top.
+ *
+ * 'numGroups' is the estimated total number of groups.
+ */
+AggPath *
+create_parallel_hashagg_path(PlannerInfo *root,
+							 RelOptInfo *rel,
+							 Path *subpath,
+							 PathTarget *target,
+							 List *groupClause,
+							 List *qual,
+							 const AggClauseCosts *aggcosts,
+							 double numGroups)
+{
+	AggPath    *pathnode = makeNode(AggPath);
+
+
+	pathnode->path.pathtype = T_Agg;
+	pathnode->path.parent = rel;
+	pathnode->path.pathtarget = target;
+	/* For now, assume we are above any joins, so no parameterization */
+	pathnode->path.param_info = NULL;
+	pathnode->path.parallel_aware = true;
+	pathnode->path.parallel_safe = rel->consider_parallel &&
+		subpath->parallel_safe;
+	pathnode->path.parallel_workers = subpath->parallel_workers;
+	pathnode->path.pathkeys = NIL;	/* output is unordered */
+	pathnode->subpath = subpath;
+
+	pathnode->aggstrategy = AGG_HASHED;
+	pathnode->aggsplit = AGGSPLIT_SIMPLE;
+	pathnode->numGroups = numGroups;
+	pathnode->transitionSpace = aggcosts ? aggcosts->transitionSpace : 0;
+	pathnode->groupClause = groupClause;
+	pathnode->qual = qual;
+
+	cost_parallel_hashagg(&pathnode->path, root,
+						  aggcosts,
+						  list_length(groupClause), numGroups,
+						  qual,
+						  subpath->startup_cost, subpath->total_cost,
+						  subpath->rows, subpath->pathtarget->width);
+
+	/* add tlist eval cost for each output row */
+	pathnode->path.startup_cost += target->cost.startup;
+	pathnode->path.total_cost += target->cost.startup +
+		target->cost.per_tuple * pathnode->path.rows;
+
+	return pathnode;
+}
+
 /*
  * create_groupingsets_path
  *	  Creates a pathnode that represents performing GROUPING SETS aggregation
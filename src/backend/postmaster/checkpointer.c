@@ -732,7 +732,11 @@ CheckpointWriteDelay(int flags, double progress)
 		 * That resulted in more frequent wakeups if not much work to do.
 		 * Checkpointer and bgwriter are no longer related so take the Big
 		 * Sleep.
+		 *
+		 * Don't leave any asynchronous writes in flight while we sleep, or
+		 * backends waiting for those buffers would have to sleep with us.
 		 */
+		CompleteAsyncBufferWrites();
 		WaitLatch(MyLatch, WL_LATCH_SET | WL_EXIT_ON_PM_DEATH | WL_TIMEOUT,
 				  100,
 				  WAIT_EVENT_CHECKPOINT_WRITE_DELAY);
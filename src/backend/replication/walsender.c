@@ -920,6 +920,7 @@ logical_read_xlog_page(XLogReaderState *state, XLogRecPtr targetPagePtr, int req
 {
 	XLogRecPtr	flushptr;
 	int			count;
+	Size		rbytes;
 	WALReadError errinfo;
 	XLogSegNo	segno;
 	TimeLineID	currTLI = GetWALInsertionTimeLine();
@@ -948,11 +949,18 @@ logical_read_xlog_page(XLogReaderState *state, XLogRecPtr targetPagePtr, int req
 	else
 		count = flushptr - targetPagePtr;	/* part of the page available */
 
-	/* now actually read the data, we know it's there */
+	/*
+	 * Now actually read the data, we know it's there.  Recent WAL is usually
+	 * still in the WAL buffers, so try those first.
+	 */
+	rbytes = WALReadFromBuffers(cur_page, targetPagePtr, count, state->currTLI);
+	if (rbytes == count)
+		return count;
+
 	if (!WALRead(state,
-				 cur_page,
-				 targetPagePtr,
-				 XLOG_BLCKSZ,
+				 cur_page + rbytes,
+				 targetPagePtr + rbytes,
+				 XLOG_BLCKSZ - rbytes,
 				 state->seg.ws_tli, /* Pass the current TLI because only
 									 * WalSndSegmentOpen controls whether new
 									 * TLI is needed. */
@@ -2740,6 +2748,7 @@ XLogSendPhysical(void)
 	XLogRecPtr	startptr;
 	XLogRecPtr	endptr;
 	Size		nbytes;
+	Size		rbytes;
 	XLogSegNo	segno;
 	WALReadError errinfo;
 
@@ -2952,46 +2961,53 @@ XLogSendPhysical(void)
 
 	/*
 	 * Read the log directly into the output buffer to avoid extra memcpy
-	 * calls.
+	 * calls.  Unless we're far behind, the WAL is still in the WAL buffers,
+	 * so try those first and read only the rest from the files.
 	 */
 	enlargeStringInfo(&output_message, nbytes);
 
+	rbytes = WALReadFromBuffers(&output_message.data[output_message.len],
+								startptr, nbytes, sendTimeLine);
+	if (rbytes < nbytes)
+	{
 retry:
-	if (!WALRead(xlogreader,
-				 &output_message.data[output_message.len],
-				 startptr,
-				 nbytes,
-				 xlogreader->seg.ws_tli,	/* Pass the current TLI because
-											 * only WalSndSegmentOpen controls
-											 * whether new TLI is needed. */
-				 &errinfo))
-		WALReadRaiseError(&errinfo);
+		if (!WALRead(xlogreader,
+					 &output_message.data[output_message.len + rbytes],
+					 startptr + rbytes,
+					 nbytes - rbytes,
+					 xlogreader->seg.ws_tli,	/* Pass the current TLI because
+												 * only WalSndSegmentOpen
+												 * controls whether new TLI is
+												 * needed. */
+					 &errinfo))
+			WALReadRaiseError(&errinfo);
+
+		/* See logical_read_xlog_page(). */
+		XLByteToSeg(startptr + rbytes, segno, xlogreader->segcxt.ws_segsize);
+		CheckXLogRemoved(segno, xlogreader->seg.ws_tli);
 
-	/* See logical_read_xlog_page(). */
-	XLByteToSeg(startptr, segno, xlogreader->segcxt.ws_segsize);
-	CheckXLogRemoved(segno, xlogreader->seg.ws_tli);
-
-	/*
-	 * During recovery, the currently-open WAL file might be replaced with the
-	 * file of the same name retrieved from archive. So we always need to
-	 * check what we read was valid after reading into the buffer. If it's
-	 * invalid, we try to open and read the file again.
-	 */
-	if (am_cascading_walsender)
-	{
-		WalSnd	   *walsnd = MyWalSnd;
-		bool		reload;
+		/*
+		 * During recovery, the currently-open WAL file might be replaced with
+		 * the file of the same name retrieved from archive. So we always need
+		 * to check what we read was valid after reading into the buffer. If
+		 * it's invalid, we try to open and read the file again.
+		 */
+		if (am_cascading_walsender)
+		{
+			WalSnd	   *walsnd = MyWalSnd;
+			bool		reload;
 
-		SpinLockAcquire(&walsnd->mutex);
-		reload = walsnd->needreload;
-		walsnd->needreload = false;
-		SpinLockRelease(&walsnd->mutex);
+			SpinLockAcquire(&walsnd->mutex);
+			reload = walsnd->needreload;
+			walsnd->needreload = false;
+			SpinLockRelease(&walsnd->mutex);
 
-		if (reload && xlogreader->seg.ws_file >= 0)
-		{
-			wal_segment_close(xlogreader);
+			if (reload && xlogreader->seg.ws_file >= 0)
+			{
+				wal_segment_close(xlogreader);
 
-			goto retry;
+				goto retry;
+			}
 		}
 	}
 
@@ -0,0 +1,929 @@
+/*-------------------------------------------------------------------------
+ *
+ * aio.c
+ *	  Asynchronous I/O for relation data files.
+ *
+ * This module lets the buffer manager keep several vectored reads and
+ * writes in flight at once, instead of stalling on each one.  Handles are
+ * strictly backend-private: only the backend that started an I/O can wait
+ * for it, so callers must not leave I/O in flight while doing anything that
+ * might wait for another backend.
+ *
+ * Three methods are supported:
+ *
+ * sync		 The I/O is performed with pg_preadv()/pg_pwritev() when it is
+ *			 started.  This works everywhere and is the default.
+ *
+ * worker	 The I/O is queued in shared memory for one of io_workers I/O
+ *			 worker processes, which reopens the file by name and performs
+ *			 it synchronously.  This works everywhere, but only for I/O on
+ *			 shared memory, i.e. shared buffers; other I/O, and I/O started
+ *			 while the queue is full or no worker is running, is performed
+ *			 synchronously by the backend itself.
+ *
+ * io_uring	 The I/O is submitted to a per-backend io_uring instance, which
+ *			 is created the first time it's needed.  We talk to the kernel
+ *			 directly rather than through liburing, since all we need is
+ *			 READV/WRITEV submission and completion reaping.  If the kernel
+ *			 refuses to create a ring (too old, or disabled by policy), we
+ *			 complain once and fall back to synchronous I/O.
+ *
+ * Portions Copyright (c) 1996-2022, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/storage/aio/aio.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <unistd.h>
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "postmaster/bgworker.h"
+#include "storage/aio.h"
+#include "storage/condition_variable.h"
+#include "storage/fd.h"
+#include "storage/ipc.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "tcop/tcopprot.h"
+#include "utils/memutils.h"
+
+/* GUC variables */
+int			io_method = DEFAULT_IO_METHOD;
+int			io_max_concurrency = 64;
+int			io_workers = 3;
+
+/* Number of requests that can be queued for the I/O workers at once */
+#define IO_WORKER_QUEUE_SIZE	64
+
+typedef enum IoWorkerRequestState
+{
+	IOWR_FREE,					/* not in use */
+	IOWR_QUEUED,				/* waiting for a worker */
+	IOWR_RUNNING,				/* being performed by a worker */
+	IOWR_DONE					/* finished, result is valid */
+} IoWorkerRequestState;
+
+/*
+ * An I/O queued for the I/O workers.  The state is protected by the mutex in
+ * IoWorkerCtlData; the rest belongs to the backend that queued the request
+ * until a worker takes it, and to that worker until it's done.
+ */
+typedef struct IoWorkerRequest
+{
+	IoWorkerRequestState state;
+	ConditionVariable cv;		/* broadcast when the request is done */
+	bool		is_write;
+	char		path[MAXPGPATH];	/* file name, relative to DataDir */
+	int			flags;			/* flags to open it with */
+	off_t		offset;
+	int			iovcnt;
+	struct iovec iov[PG_IOV_MAX];	/* all point into shared memory */
+	uint32		wait_event_info;
+
+	ssize_t		result;
+	int			error;
+} IoWorkerRequest;
+
+typedef struct IoWorkerCtlData
+{
+	slock_t		mutex;			/* protects the fields below */
+	int			nworkers;		/* number of workers taking requests */
+	int			nfree;			/* number of entries in freelist */
+	uint32		queue_head;		/* next entry of queue to take */
+	uint32		queue_tail;		/* next entry of queue to fill */
+	int			freelist[IO_WORKER_QUEUE_SIZE];
+	int			queue[IO_WORKER_QUEUE_SIZE];
+
+	ConditionVariable queue_cv; /* signaled when a request is queued */
+
+	IoWorkerRequest requests[IO_WORKER_QUEUE_SIZE];
+} IoWorkerCtlData;
+
+static IoWorkerCtlData *IoWorkerCtl = NULL;
+
+/* Backend-private pool of handles, allocated on first use */
+static PgAioHandle *AioHandles = NULL;
+static int	NumAioHandles = 0;
+static int	NumAioInflight = 0;
+
+#ifdef USE_IO_URING
+
+typedef struct PgIoUring
+{
+	int			fd;
+	unsigned	sq_entries;
+
+	/* mmap'd submission queue ring */
+	void	   *sq_ring;
+	size_t		sq_ring_size;
+	unsigned   *sq_head;
+	unsigned   *sq_tail;
+	unsigned   *sq_mask;
+	unsigned   *sq_array;
+	struct io_uring_sqe *sqes;
+	size_t		sqes_size;
+
+	/* mmap'd completion queue ring; may be the same mapping as sq_ring */
+	void	   *cq_ring;
+	size_t		cq_ring_size;
+	unsigned   *cq_head;
+	unsigned   *cq_tail;
+	unsigned   *cq_mask;
+	struct io_uring_cqe *cqes;
+} PgIoUring;
+
+static PgIoUring *AioRing = NULL;
+static bool AioRingFailed = false;
+
+static bool pgaio_uring_init(void);
+static bool pgaio_uring_submit(PgAioHandle *ioh);
+static int	pgaio_uring_reap(void);
+static void pgaio_uring_wait_one(int elevel);
+#endif							/* USE_IO_URING */
+
+static bool pgaio_worker_submit(PgAioHandle *ioh, const char *path,
+								int flags);
+static bool pgaio_worker_collect(PgAioHandle *ioh);
+static int	IoWorkerDequeue(void);
+static void IoWorkerPerform(IoWorkerRequest *req);
+static void IoWorkerShutdown(int code, Datum arg);
+
+static void pgaio_init(void);
+static void pgaio_start(PgAioHandle *ioh, bool is_write, int fd,
+						const char *path, int flags,
+						const struct iovec *iov, int iovcnt, off_t offset,
+						uint32 wait_event_info);
+static void pgaio_shmem_exit(int code, Datum arg);
+
+
+/*
+ * Allocate the handle pool.
+ */
+static void
+pgaio_init(void)
+{
+	NumAioHandles = io_max_concurrency;
+	AioHandles = MemoryContextAllocZero(TopMemoryContext,
+										sizeof(PgAioHandle) * NumAioHandles);
+	for (int i = 0; i < NumAioHandles; i++)
+		AioHandles[i].state = PGAIO_HS_IDLE;
+
+	/* make sure the kernel is done with our memory before we exit */
+	on_shmem_exit(pgaio_shmem_exit, 0);
+}
+
+/*
+ * Get an idle handle.
+ *
+ * Callers are expected to bound their own use of handles; running out is a
+ * bug, not a condition to wait for, since only we could make progress.
+ */
+PgAioHandle *
+pgaio_io_acquire(void)
+{
+	if (AioHandles == NULL)
+		pgaio_init();
+
+	for (int i = 0; i < NumAioHandles; i++)
+	{
+		PgAioHandle *ioh = &AioHandles[i];
+
+		if (ioh->state == PGAIO_HS_IDLE)
+		{
+			ioh->state = PGAIO_HS_ACQUIRED;
+			ioh->worker_req = -1;
+			ioh->result = 0;
+			ioh->error = 0;
+			return ioh;
+		}
+	}
+
+	elog(ERROR, "out of asynchronous I/O handles");
+	return NULL;				/* keep compiler quiet */
+}
+
+/*
+ * Start reading into the buffers described by iov, at the given offset of
+ * the file with kernel descriptor fd.  The file's name and the flags it was
+ * opened with are needed for I/O workers to open it themselves.
+ */
+void
+pgaio_io_start_readv(PgAioHandle *ioh, int fd, const char *path, int flags,
+					 const struct iovec *iov, int iovcnt, off_t offset,
+					 uint32 wait_event_info)
+{
+	pgaio_start(ioh, false, fd, path, flags, iov, iovcnt, offset,
+				wait_event_info);
+}
+
+/*
+ * Start writing the buffers described by iov, at the given offset of the
+ * file with kernel descriptor fd.  path and flags are as above.
+ */
+void
+pgaio_io_start_writev(PgAioHandle *ioh, int fd, const char *path, int flags,
+					  const struct iovec *iov, int iovcnt, off_t offset,
+					  uint32 wait_event_info)
+{
+	pgaio_start(ioh, true, fd, path, flags, iov, iovcnt, offset,
+				wait_event_info);
+}
+
+static void
+pgaio_start(PgAioHandle *ioh, bool is_write, int fd, const char *path,
+			int flags, const struct iovec *iov, int iovcnt, off_t offset,
+			uint32 wait_event_info)
+{
+	Assert(ioh->state == PGAIO_HS_ACQUIRED);
+	Assert(iovcnt > 0 && iovcnt <= PG_IOV_MAX);
+
+	ioh->is_write = is_write;
+	ioh->fd = fd;
+	ioh->offset = offset;
+	ioh->iovcnt = iovcnt;
+	memcpy(ioh->iov, iov, sizeof(struct iovec) * iovcnt);
+	ioh->wait_event_info = wait_event_info;
+
+	if (io_method == IOMETHOD_WORKER && pgaio_worker_submit(ioh, path, flags))
+	{
+		ioh->state = PGAIO_HS_INFLIGHT;
+		NumAioInflight++;
+		return;
+	}
+
+#ifdef USE_IO_URING
+	if (io_method == IOMETHOD_IO_URING && pgaio_uring_init() &&
+		pgaio_uring_submit(ioh))
+	{
+		ioh->state = PGAIO_HS_INFLIGHT;
+		NumAioInflight++;
+		return;
+	}
+#endif
+
+	/* Synchronous fallback: just do it now */
+	pgstat_report_wait_start(wait_event_info);
+	do
+	{
+		errno = 0;
+		if (is_write)
+			ioh->result = pg_pwritev(fd, ioh->iov, iovcnt, offset);
+		else
+			ioh->result = pg_preadv(fd, ioh->iov, iovcnt, offset);
+	} while (ioh->result < 0 && errno == EINTR);
+	pgstat_report_wait_end();
+
+	ioh->error = ioh->result < 0 ? errno : 0;
+	ioh->state = PGAIO_HS_DONE;
+}
+
+/*
+ * Has the I/O finished?  Never blocks.
+ */
+bool
+pgaio_io_poll(PgAioHandle *ioh)
+{
+	Assert(ioh->state == PGAIO_HS_INFLIGHT || ioh->state == PGAIO_HS_DONE);
+
+	if (ioh->state == PGAIO_HS_INFLIGHT && ioh->worker_req >= 0)
+		pgaio_worker_collect(ioh);
+
+#ifdef USE_IO_URING
+	if (ioh->state == PGAIO_HS_INFLIGHT)
+		pgaio_uring_reap();
+#endif
+
+	return ioh->state == PGAIO_HS_DONE;
+}
+
+/*
+ * Wait for the I/O to finish, and return its result: the number of bytes
+ * transferred, or -1 with errno set.  Like the plain system calls, this may
+ * report a short transfer, which the caller has to deal with.
+ */
+ssize_t
+pgaio_io_wait(PgAioHandle *ioh)
+{
+	Assert(ioh->state == PGAIO_HS_INFLIGHT || ioh->state == PGAIO_HS_DONE);
+
+	if (ioh->state == PGAIO_HS_INFLIGHT && ioh->worker_req >= 0)
+	{
+		ConditionVariable *cv = &IoWorkerCtl->requests[ioh->worker_req].cv;
+
+		while (!pgaio_worker_collect(ioh))
+			ConditionVariableSleep(cv, ioh->wait_event_info);
+		ConditionVariableCancelSleep();
+	}
+
+#ifdef USE_IO_URING
+	if (ioh->state == PGAIO_HS_INFLIGHT)
+	{
+		pgstat_report_wait_start(ioh->wait_event_info);
+		while (ioh->state == PGAIO_HS_INFLIGHT)
+		{
+			if (pgaio_uring_reap() == 0)
+				pgaio_uring_wait_one(ERROR);
+		}
+		pgstat_report_wait_end();
+	}
+#endif
+
+	Assert(ioh->state == PGAIO_HS_DONE);
+
+	errno = ioh->error;
+	return ioh->result;
+}
+
+/*
+ * Give back a handle.  Its I/O, if any was started, must have completed.
+ */
+void
+pgaio_io_release(PgAioHandle *ioh)
+{
+	Assert(ioh->state == PGAIO_HS_ACQUIRED || ioh->state == PGAIO_HS_DONE);
+
+	ioh->state = PGAIO_HS_IDLE;
+}
+
+/*
+ * Number of I/Os started and not yet known to be complete.
+ */
+int
+pgaio_io_inflight_count(void)
+{
+	return NumAioInflight;
+}
+
+/*
+ * Clean up after an error: wait for the kernel to finish with all I/O we
+ * have in flight, so that the memory involved can safely be reused, and
+ * forget about all handles.  Whoever started the I/O is responsible for
+ * cleaning up its own state, e.g. AbortBufferIO() for shared buffers.
+ */
+void
+pgaio_at_error(void)
+{
+	if (AioHandles == NULL)
+		return;
+
+	/*
+	 * Requests queued for the I/O workers are performed even if we don't
+	 * wait for them, so wait.  We may be exiting, or cleaning up after an
+	 * error with interrupts held, so just poll; I/O workers never fail to
+	 * complete a request they have taken, and the last one to exit performs
+	 * those left in the queue.
+	 */
+	for (int i = 0; i < NumAioHandles; i++)
+	{
+		PgAioHandle *ioh = &AioHandles[i];
+
+		if (ioh->state == PGAIO_HS_INFLIGHT && ioh->worker_req >= 0)
+		{
+			while (!pgaio_worker_collect(ioh))
+				pg_usleep(1000L);
+		}
+	}
+
+#ifdef USE_IO_URING
+
+	/*
+	 * If we can't wait here, the kernel might still write into buffers that
+	 * we're about to mark as not being read, so there's no way to continue.
+	 */
+	while (NumAioInflight > 0)
+	{
+		if (pgaio_uring_reap() == 0)
+			pgaio_uring_wait_one(PANIC);
+	}
+#endif
+
+	Assert(NumAioInflight == 0);
+	for (int i = 0; i < NumAioHandles; i++)
+		AioHandles[i].state = PGAIO_HS_IDLE;
+}
+
+static void
+pgaio_shmem_exit(int code, Datum arg)
+{
+	pgaio_at_error();
+}
+
+/*
+ * Report shared-memory space needed by AioShmemInit.
+ */
+Size
+AioShmemSize(void)
+{
+	if (io_method != IOMETHOD_WORKER)
+		return 0;
+
+	return sizeof(IoWorkerCtlData);
+}
+
+/*
+ * Allocate and initialize the I/O worker queue, if io_method = worker.
+ */
+void
+AioShmemInit(void)
+{
+	bool		found;
+
+	if (io_method != IOMETHOD_WORKER)
+		return;
+
+	IoWorkerCtl = (IoWorkerCtlData *)
+		ShmemInitStruct("I/O Worker Ctl", AioShmemSize(), &found);
+
+	if (!found)
+	{
+		SpinLockInit(&IoWorkerCtl->mutex);
+		IoWorkerCtl->nworkers = 0;
+		IoWorkerCtl->nfree = IO_WORKER_QUEUE_SIZE;
+		IoWorkerCtl->queue_head = 0;
+		IoWorkerCtl->queue_tail = 0;
+		ConditionVariableInit(&IoWorkerCtl->queue_cv);
+		for (int i = 0; i < IO_WORKER_QUEUE_SIZE; i++)
+		{
+			IoWorkerCtl->freelist[i] = i;
+			IoWorkerCtl->requests[i].state = IOWR_FREE;
+			ConditionVariableInit(&IoWorkerCtl->requests[i].cv);
+		}
+	}
+}
+
+/*
+ * Register the I/O workers, if io_method = worker.  Called by the postmaster
+ * at startup.
+ */
+void
+IoWorkerRegister(void)
+{
+	BackgroundWorker bgw;
+
+	if (io_method != IOMETHOD_WORKER)
+		return;
+
+	for (int i = 0; i < io_workers; i++)
+	{
+		memset(&bgw, 0, sizeof(bgw));
+		bgw.bgw_flags = BGWORKER_SHMEM_ACCESS;
+		bgw.bgw_start_time = BgWorkerStart_PostmasterStart;
+		snprintf(bgw.bgw_library_name, BGW_MAXLEN, "postgres");
+		snprintf(bgw.bgw_function_name, BGW_MAXLEN, "IoWorkerMain");
+		snprintf(bgw.bgw_name, BGW_MAXLEN, "io worker %d", i);
+		snprintf(bgw.bgw_type, BGW_MAXLEN, "io worker");
+		bgw.bgw_restart_time = 5;
+		bgw.bgw_notify_pid = 0;
+		bgw.bgw_main_arg = Int32GetDatum(i);
+
+		RegisterBackgroundWorker(&bgw);
+	}
+}
+
+/*
+ * Hand the I/O described by ioh to the I/O workers.  Returns false if that's
+ * not possible, in which case the caller should do it synchronously.
+ */
+static bool
+pgaio_worker_submit(PgAioHandle *ioh, const char *path, int flags)
+{
+	IoWorkerRequest *req;
+	int			idx;
+
+	/* The worker can only reach our memory if it's shared. */
+	for (int i = 0; i < ioh->iovcnt; i++)
+	{
+		char	   *base = (char *) ioh->iov[i].iov_base;
+
+		if (!ShmemAddrIsValid(base) ||
+			!ShmemAddrIsValid(base + ioh->iov[i].iov_len - 1))
+			return false;
+	}
+
+	if (strlen(path) >= MAXPGPATH)
+		return false;
+
+	SpinLockAcquire(&IoWorkerCtl->mutex);
+	if (IoWorkerCtl->nworkers == 0 || IoWorkerCtl->nfree == 0)
+	{
+		SpinLockRelease(&IoWorkerCtl->mutex);
+		return false;
+	}
+	idx = IoWorkerCtl->freelist[--IoWorkerCtl->nfree];
+	SpinLockRelease(&IoWorkerCtl->mutex);
+
+	req = &IoWorkerCtl->requests[idx];
+	Assert(req->state == IOWR_FREE);
+	req->is_write = ioh->is_write;
+	strlcpy(req->path, path, MAXPGPATH);
+	req->flags = flags;
+	req->offset = ioh->offset;
+	req->iovcnt = ioh->iovcnt;
+	memcpy(req->iov, ioh->iov, sizeof(struct iovec) * ioh->iovcnt);
+	req->wait_event_info = ioh->wait_event_info;
+
+	/*
+	 * The last worker may have exited in the meantime, after performing the
+	 * requests that were queued then.  Nobody would take ours.
+	 */
+	SpinLockAcquire(&IoWorkerCtl->mutex);
+	if (IoWorkerCtl->nworkers == 0)
+	{
+		IoWorkerCtl->freelist[IoWorkerCtl->nfree++] = idx;
+		SpinLockRelease(&IoWorkerCtl->mutex);
+		return false;
+	}
+	req->state = IOWR_QUEUED;
+	IoWorkerCtl->queue[IoWorkerCtl->queue_tail++ % IO_WORKER_QUEUE_SIZE] = idx;
+	SpinLockRelease(&IoWorkerCtl->mutex);
+
+	ConditionVariableSignal(&IoWorkerCtl->queue_cv);
+
+	ioh->worker_req = idx;
+	return true;
+}
+
+/*
+ * If the I/O worker is done with the request of ioh, collect its result and
+ * give the request back.  Never blocks.  Returns true if the I/O is done.
+ */
+static bool
+pgaio_worker_collect(PgAioHandle *ioh)
+{
+	IoWorkerRequest *req = &IoWorkerCtl->requests[ioh->worker_req];
+
+	SpinLockAcquire(&IoWorkerCtl->mutex);
+	if (req->state != IOWR_DONE)
+	{
+		SpinLockRelease(&IoWorkerCtl->mutex);
+		return false;
+	}
+	req->state = IOWR_FREE;
+	IoWorkerCtl->freelist[IoWorkerCtl->nfree++] = ioh->worker_req;
+	ioh->result = req->result;
+	ioh->error = req->error;
+	SpinLockRelease(&IoWorkerCtl->mutex);
+
+	ioh->worker_req = -1;
+	ioh->state = PGAIO_HS_DONE;
+	NumAioInflight--;
+
+	return true;
+}
+
+/*
+ * Take the oldest queued request, if any.  Returns its index, or -1.
+ */
+static int
+IoWorkerDequeue(void)
+{
+	int			idx = -1;
+
+	SpinLockAcquire(&IoWorkerCtl->mutex);
+	if (IoWorkerCtl->queue_head != IoWorkerCtl->queue_tail)
+	{
+		idx = IoWorkerCtl->queue[IoWorkerCtl->queue_head++ %
+								 IO_WORKER_QUEUE_SIZE];
+		IoWorkerCtl->requests[idx].state = IOWR_RUNNING;
+	}
+	SpinLockRelease(&IoWorkerCtl->mutex);
+
+	return idx;
+}
+
+/*
+ * Perform a request and wake up its backend.
+ *
+ * This must not throw an error, since the backend would wait forever, so
+ * failures are just reported back.  The file is opened for each request
+ * rather than kept open, which could mean writing to a file that has since
+ * been unlinked and recreated with the same name.
+ */
+static void
+IoWorkerPerform(IoWorkerRequest *req)
+{
+	ssize_t		result;
+	int			error = 0;
+	int			fd;
+
+	pgstat_report_wait_start(req->wait_event_info);
+	fd = BasicOpenFile(req->path, req->flags);
+	if (fd < 0)
+	{
+		result = -1;
+		error = errno;
+	}
+	else
+	{
+		do
+		{
+			errno = 0;
+			if (req->is_write)
+				result = pg_pwritev(fd, req->iov, req->iovcnt, req->offset);
+			else
+				result = pg_preadv(fd, req->iov, req->iovcnt, req->offset);
+		} while (result < 0 && errno == EINTR);
+		if (result < 0)
+			error = errno;
+		close(fd);
+	}
+	pgstat_report_wait_end();
+
+	SpinLockAcquire(&IoWorkerCtl->mutex);
+	req->result = result;
+	req->error = error;
+	req->state = IOWR_DONE;
+	SpinLockRelease(&IoWorkerCtl->mutex);
+
+	ConditionVariableBroadcast(&req->cv);
+}
+
+/*
+ * Stop taking requests.  The last worker to exit performs the requests left
+ * in the queue, since their backends are waiting for them.
+ */
+static void
+IoWorkerShutdown(int code, Datum arg)
+{
+	bool		last;
+	int			idx;
+
+	SpinLockAcquire(&IoWorkerCtl->mutex);
+	last = (--IoWorkerCtl->nworkers == 0);
+	SpinLockRelease(&IoWorkerCtl->mutex);
+
+	if (last)
+	{
+		while ((idx = IoWorkerDequeue()) >= 0)
+			IoWorkerPerform(&IoWorkerCtl->requests[idx]);
+	}
+}
+
+/*
+ * Main entry point for I/O worker processes.
+ *
+ * We only check for interrupts while waiting for a request, so that we never
+ * exit while performing one.
+ */
+void
+IoWorkerMain(Datum main_arg)
+{
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	SpinLockAcquire(&IoWorkerCtl->mutex);
+	IoWorkerCtl->nworkers++;
+	SpinLockRelease(&IoWorkerCtl->mutex);
+	on_shmem_exit(IoWorkerShutdown, 0);
+
+	for (;;)
+	{
+		int			idx;
+
+		idx = IoWorkerDequeue();
+		if (idx < 0)
+		{
+			ConditionVariableSleep(&IoWorkerCtl->queue_cv,
+								   WAIT_EVENT_IO_WORKER_MAIN);
+			continue;
+		}
+		ConditionVariableCancelSleep();
+
+		IoWorkerPerform(&IoWorkerCtl->requests[idx]);
+	}
+}
+
+#ifdef USE_IO_URING
+
+static inline int
+pgaio_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+				  unsigned flags)
+{
+	return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+						 flags, NULL, 0);
+}
+
+/*
+ * Set up this backend's ring, if we haven't already.  Returns false if
+ * io_uring can't be used, in which case the caller should do synchronous I/O.
+ */
+static bool
+pgaio_uring_init(void)
+{
+	struct io_uring_params p;
+	PgIoUring  *ring;
+	int			fd;
+
+	if (AioRing != NULL)
+		return true;
+	if (AioRingFailed)
+		return false;
+
+	memset(&p, 0, sizeof(p));
+	fd = (int) syscall(__NR_io_uring_setup, (unsigned) NumAioHandles, &p);
+	if (fd < 0)
+	{
+		AioRingFailed = true;
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not set up io_uring, falling back to synchronous I/O: %m")));
+		return false;
+	}
+
+	ring = MemoryContextAllocZero(TopMemoryContext, sizeof(PgIoUring));
+	ring->fd = fd;
+	ring->sq_entries = p.sq_entries;
+	ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		ring->sq_ring_size = ring->cq_ring_size =
+			Max(ring->sq_ring_size, ring->cq_ring_size);
+
+	ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+						 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ring == MAP_FAILED)
+		goto fail;
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		ring->cq_ring = ring->sq_ring;
+	else
+	{
+		ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+							 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (ring->cq_ring == MAP_FAILED)
+		{
+			munmap(ring->sq_ring, ring->sq_ring_size);
+			goto fail;
+		}
+	}
+
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+					  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+	{
+		if (ring->cq_ring != ring->sq_ring)
+			munmap(ring->cq_ring, ring->cq_ring_size);
+		munmap(ring->sq_ring, ring->sq_ring_size);
+		goto fail;
+	}
+
+	ring->sq_head = (unsigned *) ((char *) ring->sq_ring + p.sq_off.head);
+	ring->sq_tail = (unsigned *) ((char *) ring->sq_ring + p.sq_off.tail);
+	ring->sq_mask = (unsigned *) ((char *) ring->sq_ring + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned *) ((char *) ring->sq_ring + p.sq_off.array);
+	ring->cq_head = (unsigned *) ((char *) ring->cq_ring + p.cq_off.head);
+	ring->cq_tail = (unsigned *) ((char *) ring->cq_ring + p.cq_off.tail);
+	ring->cq_mask = (unsigned *) ((char *) ring->cq_ring + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *) ((char *) ring->cq_ring + p.cq_off.cqes);
+
+	AioRing = ring;
+	return true;
+
+fail:
+	AioRingFailed = true;
+	ereport(LOG,
+			(errcode_for_file_access(),
+			 errmsg("could not map io_uring rings, falling back to synchronous I/O: %m")));
+	close(fd);
+	pfree(ring);
+	return false;
+}
+
+/*
+ * Queue one READV/WRITEV and tell the kernel about it right away.  We don't
+ * batch submissions, because the caller's file descriptor is only
+ * guaranteed to stay open until fd.c next decides to recycle it.
+ *
+ * Returns false if the kernel didn't accept it, e.g. for lack of memory, in
+ * which case the caller should do the I/O synchronously instead.
+ */
+static bool
+pgaio_uring_submit(PgAioHandle *ioh)
+{
+	PgIoUring  *ring = AioRing;
+	struct io_uring_sqe *sqe;
+	unsigned	tail;
+	unsigned	idx;
+	int			rc;
+
+	tail = *ring->sq_tail;
+	idx = tail & *ring->sq_mask;
+	sqe = &ring->sqes[idx];
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = ioh->is_write ? IORING_OP_WRITEV : IORING_OP_READV;
+	sqe->fd = ioh->fd;
+	sqe->off = (uint64) ioh->offset;
+	sqe->addr = (uint64) (uintptr_t) ioh->iov;
+	sqe->len = (uint32) ioh->iovcnt;
+	sqe->user_data = (uint64) (uintptr_t) ioh;
+
+	ring->sq_array[idx] = idx;
+
+	/* the kernel must see the sqe contents before the new tail */
+	pg_write_barrier();
+	*ring->sq_tail = tail + 1;
+	pg_memory_barrier();
+
+	for (;;)
+	{
+		rc = pgaio_uring_enter(ring->fd, 1, 0, 0);
+		if (rc >= 0 || (errno != EINTR && errno != EAGAIN))
+			break;
+	}
+
+	if (rc < 0)
+	{
+		/*
+		 * The kernel only consumes entries in io_uring_enter(), and it
+		 * reports failure only if it consumed none, so we can take ours
+		 * back.
+		 */
+		*ring->sq_tail = tail;
+
+		elog(DEBUG1, "could not submit I/O to io_uring, performing it synchronously: %m");
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Process all available completions without waiting.  Returns the number of
+ * completions processed.
+ */
+static int
+pgaio_uring_reap(void)
+{
+	PgIoUring  *ring = AioRing;
+	unsigned	head;
+	unsigned	tail;
+	int			n = 0;
+
+	head = *ring->cq_head;
+	tail = *ring->cq_tail;
+	/* read the cqes only after reading the tail the kernel published */
+	pg_read_barrier();
+
+	while (head != tail)
+	{
+		struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+		PgAioHandle *ioh = (PgAioHandle *) (uintptr_t) cqe->user_data;
+
+		Assert(ioh->state == PGAIO_HS_INFLIGHT);
+		if (cqe->res < 0)
+		{
+			ioh->result = -1;
+			ioh->error = -cqe->res;
+		}
+		else
+		{
+			ioh->result = cqe->res;
+			ioh->error = 0;
+		}
+		ioh->state = PGAIO_HS_DONE;
+		NumAioInflight--;
+
+		head++;
+		n++;
+	}
+
+	/* let the kernel reuse the slots */
+	pg_memory_barrier();
+	*ring->cq_head = head;
+
+	return n;
+}
+
+/*
+ * Sleep until at least one completion is available.  Failures other than
+ * interruptions are reported at elevel.
+ */
+static void
+pgaio_uring_wait_one(int elevel)
+{
+	int			rc;
+
+	Assert(NumAioInflight > 0);
+
+	rc = pgaio_uring_enter(AioRing->fd, 0, 1, IORING_ENTER_GETEVENTS);
+	if (rc < 0 && errno != EINTR && errno != EAGAIN)
+		ereport(elevel,
+				(errcode_for_file_access(),
+				 errmsg("could not wait for io_uring completion: %m")));
+}
+
+#endif							/* USE_IO_URING */
@@ -23,6 +23,7 @@ char	   *BufferBlocks;
 ConditionVariableMinimallyPadded *BufferIOCVArray;
 WritebackContext BackendWritebackContext;
 CkptSortItem *CkptBufferIds;
+char	   *CkptWritePages;
 
 
 /*
@@ -70,7 +71,8 @@ InitBufferPool(void)
 	bool		foundBufs,
 				foundDescs,
 				foundIOCV,
-				foundBufCkpt;
+				foundBufCkpt,
+				foundCkptPages;
 
 	/* Align descriptors to a cacheline boundary. */
 	BufferDescriptors = (BufferDescPadded *)
@@ -78,9 +80,12 @@ InitBufferPool(void)
 						NBuffers * sizeof(BufferDescPadded),
 						&foundDescs);
 
+	/* Align buffer pool on IO page size boundary, for direct I/O. */
 	BufferBlocks = (char *)
-		ShmemInitStruct("Buffer Blocks",
-						NBuffers * (Size) BLCKSZ, &foundBufs);
+		TYPEALIGN(PG_IO_ALIGN_SIZE,
+				  ShmemInitStruct("Buffer Blocks",
+								  NBuffers * (Size) BLCKSZ + PG_IO_ALIGN_SIZE,
+								  &foundBufs));
 
 	/* Align condition variables to cacheline boundary. */
 	BufferIOCVArray = (ConditionVariableMinimallyPadded *)
@@ -99,52 +104,78 @@ InitBufferPool(void)
 		ShmemInitStruct("Checkpoint BufferIds",
 						NBuffers * sizeof(CkptSortItem), &foundBufCkpt);
 
-	if (foundDescs || foundBufs || foundIOCV || foundBufCkpt)
+	/*
+	 * Likewise the pages the checkpointer copies buffers to while writing
+	 * them.  Being in shared memory also lets I/O workers write them.
+	 */
+	CkptWritePages = (char *)
+		TYPEALIGN(PG_IO_ALIGN_SIZE,
+				  ShmemInitStruct("Checkpoint Write Pages",
+								  MAX_IO_COMBINE_LIMIT * (Size) BLCKSZ +
+								  PG_IO_ALIGN_SIZE,
+								  &foundCkptPages));
+
+	if (foundDescs || foundBufs || foundIOCV || foundBufCkpt ||
+		foundCkptPages)
 	{
 		/* should find all of these, or none of them */
-		Assert(foundDescs && foundBufs && foundIOCV && foundBufCkpt);
+		Assert(foundDescs && foundBufs && foundIOCV && foundBufCkpt &&
+			   foundCkptPages);
 		/* note: this path is only taken in EXEC_BACKEND case */
 	}
 	else
 	{
-		int			i;
-
 		/*
-		 * Initialize all the buffer headers.
+		 * The buffer headers are initialized lazily, by InitBufferDescriptor()
+		 * when freelist.c first hands each buffer out, so that starting up
+		 * with a huge shared_buffers doesn't have to touch every descriptor.
+		 * Until then, a buffer's header is all zeroes, as the shared memory
+		 * segment is zero-filled when created; that reads as an unpinned,
+		 * unused buffer with no valid tag, which is all that code scanning
+		 * the whole buffer array needs to see.
+		 *
+		 * Where atomics are emulated, an all-zeroes pg_atomic_uint32 isn't
+		 * valid, so the state words at least have to be set up now.
 		 */
-		for (i = 0; i < NBuffers; i++)
-		{
-			BufferDesc *buf = GetBufferDescriptor(i);
+#ifdef PG_HAVE_ATOMIC_U32_SIMULATION
+		for (int i = 0; i < NBuffers; i++)
+			pg_atomic_init_u32(&GetBufferDescriptor(i)->state, 0);
+#endif
+	}
 
-			CLEAR_BUFFERTAG(buf->tag);
+	/* Init other shared buffer-management stuff */
+	StrategyInitialize(!foundDescs);
 
-			pg_atomic_init_u32(&buf->state, 0);
-			buf->wait_backend_pgprocno = INVALID_PGPROCNO;
+	/* Initialize per-backend file flush context */
+	WritebackContextInit(&BackendWritebackContext,
+						 &backend_flush_after);
+}
 
-			buf->buf_id = i;
+/*
+ * InitBufferDescriptor -- set up a buffer header before its first use
+ *
+ * Called by freelist.c on a buffer that has never been handed out before.
+ * Nobody else can be using the buffer yet, but other processes scanning the
+ * buffer array may lock its header at any moment, so we leave the state
+ * word alone; it is already zero.
+ */
+void
+InitBufferDescriptor(int buf_id)
+{
+	BufferDesc *buf = GetBufferDescriptor(buf_id);
 
-			/*
-			 * Initially link all the buffers together as unused. Subsequent
-			 * management of this list is done by freelist.c.
-			 */
-			buf->freeNext = i + 1;
+	Assert((pg_atomic_read_u32(&buf->state) & ~BM_LOCKED) == 0);
 
-			LWLockInitialize(BufferDescriptorGetContentLock(buf),
-							 LWTRANCHE_BUFFER_CONTENT);
+	buf->wait_backend_pgprocno = INVALID_PGPROCNO;
 
-			ConditionVariableInit(BufferDescriptorGetIOCV(buf));
-		}
+	buf->buf_id = buf_id;
 
-		/* Correct last entry of linked list */
-		GetBufferDescriptor(NBuffers - 1)->freeNext = FREENEXT_END_OF_LIST;
-	}
+	buf->freeNext = FREENEXT_NOT_IN_LIST;
 
-	/* Init other shared buffer-management stuff */
-	StrategyInitialize(!foundDescs);
+	LWLockInitialize(BufferDescriptorGetContentLock(buf),
+					 LWTRANCHE_BUFFER_CONTENT);
 
-	/* Initialize per-backend file flush context */
-	WritebackContextInit(&BackendWritebackContext,
-						 &backend_flush_after);
+	ConditionVariableInit(BufferDescriptorGetIOCV(buf));
 }
 
 /*
@@ -163,7 +194,8 @@ BufferShmemSize(void)
 	/* to allow aligning buffer descriptors */
 	size = add_size(size, PG_CACHE_LINE_SIZE);
 
-	/* size of data pages */
+	/* size of data pages, plus alignment padding */
+	size = add_size(size, PG_IO_ALIGN_SIZE);
 	size = add_size(size, mul_size(NBuffers, BLCKSZ));
 
 	/* size of stuff controlled by freelist.c */
@@ -178,5 +210,9 @@ BufferShmemSize(void)
 	/* size of checkpoint sort array in bufmgr.c */
 	size = add_size(size, mul_size(NBuffers, sizeof(CkptSortItem)));
 
+	/* size of checkpoint write pages, plus alignment padding */
+	size = add_size(size, PG_IO_ALIGN_SIZE);
+	size = add_size(size, mul_size(MAX_IO_COMBINE_LIMIT, BLCKSZ));
+
 	return size;
 }
@@ -9,6 +9,12 @@
  * in most cases the caller needs to adjust the buffer header contents
  * before the lock is released (see notes in README).
  *
+ * The exception is BufTableLookupUnlocked(), which consults a lock-free
+ * open-addressing table that shadows the main hashtable.  It is only a
+ * hint: it may miss entries that exist, and may return buffers that no
+ * longer hold the page, so callers must validate its answer against the
+ * buffer header and fall back to a locked lookup.
+ *
  *
  * Portions Copyright (c) 1996-2022, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -21,6 +27,8 @@
  */
 #include "postgres.h"
 
+#include "port/atomics.h"
+#include "port/pg_bitutils.h"
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
 
@@ -33,6 +41,44 @@ typedef struct
 
 static HTAB *SharedBufHash;
 
+/*
+ * The lock-free lookup table.  Each slot is a 64-bit word holding the tag's
+ * hash code in the upper half and buf_id + 1 in the lower half, so readers
+ * can load a slot with a single atomic read.  An entry lives within
+ * LOOKUP_MAX_PROBES slots of the position its hash code selects; if no free
+ * slot is found there, the mapping is simply left out of this table.
+ *
+ * Deleted entries are replaced by tombstones, which later insertions may
+ * reuse.  Slots never go back to empty, so a reader may stop probing at
+ * the first empty slot.
+ */
+#define LOOKUP_MAX_PROBES	16
+#define LOOKUP_EMPTY		UINT64CONST(0)
+#define LOOKUP_TOMBSTONE	PG_UINT64_MAX
+
+static pg_atomic_uint64 *LookupSlots;
+static uint64 LookupMask;
+
+static uint64 LookupTableSize(int size);
+static void LookupInsert(uint32 hashcode, int buf_id);
+static void LookupDelete(uint32 hashcode, int buf_id);
+
+/*
+ * Number of slots in the lock-free lookup table: enough to keep it at most
+ * half full.
+ */
+static uint64
+LookupTableSize(int size)
+{
+	return pg_nextpower2_64((uint64) size * 2);
+}
+
+static inline uint64
+LookupMakeEntry(uint32 hashcode, int buf_id)
+{
+	return ((uint64) hashcode << 32) | (uint64) (buf_id + 1);
+}
+
 
 /*
  * Estimate space needed for mapping hashtable
@@ -41,7 +87,8 @@ static HTAB *SharedBufHash;
 Size
 BufTableShmemSize(int size)
 {
-	return hash_estimate_size(size, sizeof(BufferLookupEnt));
+	return add_size(hash_estimate_size(size, sizeof(BufferLookupEnt)),
+					mul_size(LookupTableSize(size), sizeof(pg_atomic_uint64)));
 }
 
 /*
@@ -52,6 +99,8 @@ void
 InitBufTable(int size)
 {
 	HASHCTL		info;
+	uint64		nslots;
+	bool		found;
 
 	/* assume no locking is needed yet */
 
@@ -64,6 +113,20 @@ InitBufTable(int size)
 								  size, size,
 								  &info,
 								  HASH_ELEM | HASH_BLOBS | HASH_PARTITION);
+
+	/* and the lock-free table shadowing it */
+	nslots = LookupTableSize(size);
+	LookupSlots = (pg_atomic_uint64 *)
+		ShmemInitStruct("Shared Buffer Lock-Free Lookup Table",
+						mul_size(nslots, sizeof(pg_atomic_uint64)),
+						&found);
+	LookupMask = nslots - 1;
+
+	if (!found)
+	{
+		for (uint64 i = 0; i < nslots; i++)
+			pg_atomic_init_u64(&LookupSlots[i], LOOKUP_EMPTY);
+	}
 }
 
 /*
@@ -105,6 +168,115 @@ BufTableLookup(BufferTag *tagPtr, uint32 hashcode)
 	return result->id;
 }
 
+/*
+ * BufTableLookupUnlocked
+ *		Lookup the given BufferTag without any lock; return buffer ID, or -1
+ *		if not found
+ *
+ * The answer is only a hint.  -1 doesn't mean the page isn't in the buffer
+ * pool, and a buffer ID that is returned might have been reassigned to
+ * another page by the time the caller looks at it.  So a caller must pin
+ * the buffer and then recheck its tag, and must fall back to
+ * BufTableLookup() under the mapping lock if that fails or if -1 is
+ * returned.
+ *
+ * No lock is required.
+ */
+int
+BufTableLookupUnlocked(BufferTag *tagPtr, uint32 hashcode)
+{
+	for (int i = 0; i < LOOKUP_MAX_PROBES; i++)
+	{
+		uint64		ent;
+		int			buf_id;
+		BufferDesc *buf;
+
+		ent = pg_atomic_read_u64(&LookupSlots[(hashcode + i) & LookupMask]);
+		if (ent == LOOKUP_EMPTY)
+			break;
+		if (ent == LOOKUP_TOMBSTONE || (uint32) (ent >> 32) != hashcode)
+			continue;
+
+		/*
+		 * The hash code matches.  Check the buffer's tag to weed out
+		 * collisions.  The tag can change under us, so this is only a
+		 * best-effort check, which the caller will repeat once it has the
+		 * buffer pinned.
+		 */
+		buf_id = (int) (uint32) ent - 1;
+		Assert(buf_id >= 0 && buf_id < NBuffers);
+		buf = GetBufferDescriptor(buf_id);
+		if (BUFFERTAGS_EQUAL(buf->tag, *tagPtr))
+			return buf_id;
+	}
+
+	return -1;
+}
+
+/*
+ * LookupInsert
+ *		Add an entry for the given hash code and buffer ID to the lock-free
+ *		lookup table, if there's room for it
+ *
+ * Caller must hold exclusive lock on BufMappingLock for the hash code's
+ * partition.  Insertions for other partitions can run concurrently, so
+ * slots are claimed with compare-and-swap.
+ */
+static void
+LookupInsert(uint32 hashcode, int buf_id)
+{
+	uint64		newent = LookupMakeEntry(hashcode, buf_id);
+
+	for (int i = 0; i < LOOKUP_MAX_PROBES; i++)
+	{
+		pg_atomic_uint64 *slot = &LookupSlots[(hashcode + i) & LookupMask];
+		uint64		ent = pg_atomic_read_u64(slot);
+
+		while (ent == LOOKUP_EMPTY || ent == LOOKUP_TOMBSTONE)
+		{
+			/* on failure, ent is updated and we recheck it */
+			if (pg_atomic_compare_exchange_u64(slot, &ent, newent))
+				return;
+		}
+	}
+
+	/*
+	 * No room.  Leave the mapping out; lookups will find it in the main
+	 * hashtable instead.
+	 */
+}
+
+/*
+ * LookupDelete
+ *		Remove an entry for the given hash code and buffer ID from the
+ *		lock-free lookup table, if there is one
+ *
+ * Caller must hold exclusive lock on BufMappingLock for the hash code's
+ * partition.
+ *
+ * Two mappings with the same hash code and buffer ID can exist briefly,
+ * while BufferAlloc() renames a buffer.  Their entries are identical, so it
+ * doesn't matter which one we remove; either way the table never has more
+ * entries than there are mappings.
+ */
+static void
+LookupDelete(uint32 hashcode, int buf_id)
+{
+	uint64		oldent = LookupMakeEntry(hashcode, buf_id);
+
+	for (int i = 0; i < LOOKUP_MAX_PROBES; i++)
+	{
+		pg_atomic_uint64 *slot = &LookupSlots[(hashcode + i) & LookupMask];
+		uint64		ent = pg_atomic_read_u64(slot);
+
+		if (ent == LOOKUP_EMPTY)
+			break;
+		if (ent == oldent &&
+			pg_atomic_compare_exchange_u64(slot, &ent, LOOKUP_TOMBSTONE))
+			return;
+	}
+}
+
 /*
  * BufTableInsert
  *		Insert a hashtable entry for given tag and buffer ID,
@@ -136,17 +308,20 @@ BufTableInsert(BufferTag *tagPtr, uint32 hashcode, int buf_id)
 
 	result->id = buf_id;
 
+	LookupInsert(hashcode, buf_id);
+
 	return -1;
 }
 
 /*
  * BufTableDelete
- *		Delete the hashtable entry for given tag (which must exist)
+ *		Delete the hashtable entry for given tag (which must exist), which
+ *		maps it to the given buffer ID
  *
  * Caller must hold exclusive lock on BufMappingLock for tag's partition
  */
 void
-BufTableDelete(BufferTag *tagPtr, uint32 hashcode)
+BufTableDelete(BufferTag *tagPtr, uint32 hashcode, int buf_id)
 {
 	BufferLookupEnt *result;
 
@@ -159,4 +334,6 @@ BufTableDelete(BufferTag *tagPtr, uint32 hashcode)
 
 	if (!result)				/* shouldn't happen */
 		elog(ERROR, "shared buffer hash table corrupted");
+
+	LookupDelete(hashcode, buf_id);
 }
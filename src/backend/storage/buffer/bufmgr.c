@@ -45,13 +45,17 @@
 #include "pg_trace.h"
 #include "pgstat.h"
 #include "postmaster/bgwriter.h"
+#include "storage/aio.h"
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
+#include "storage/doublewrite.h"
+#include "storage/fd.h"
 #include "storage/ipc.h"
 #include "storage/proc.h"
 #include "storage/smgr.h"
 #include "storage/standby.h"
 #include "utils/memdebug.h"
+#include "utils/memutils.h"
 #include "utils/ps_status.h"
 #include "utils/rel.h"
 #include "utils/resowner_private.h"
@@ -151,6 +155,12 @@ int			effective_io_concurrency = 0;
  */
 int			maintenance_io_concurrency = 0;
 
+/*
+ * Maximum number of consecutive blocks that ReadBufferRange() transfers with
+ * a single vectored read.
+ */
+int			io_combine_limit = DEFAULT_IO_COMBINE_LIMIT;
+
 /*
  * GUC variables about triggering kernel writeback for buffers written; OS
  * dependent defaults are set via the GUC mechanism.
@@ -159,9 +169,77 @@ int			checkpoint_flush_after = 0;
 int			bgwriter_flush_after = 0;
 int			backend_flush_after = 0;
 
-/* local state for StartBufferIO and related functions */
-static BufferDesc *InProgressBuf = NULL;
-static bool IsForInput;
+/*
+ * local state for StartBufferIO and related functions
+ *
+ * A backend may have I/O in progress on a whole run of buffers being read by
+ * ReadBufferRange(), plus one buffer being written out to make room for the
+ * next member of that run.
+ */
+#define MAX_IN_PROGRESS_BUFS (MAX_IO_COMBINE_LIMIT + 1)
+static BufferDesc *InProgressBufs[MAX_IN_PROGRESS_BUFS];
+static bool InProgressIsForInput[MAX_IN_PROGRESS_BUFS];
+static int	NumInProgressBufs = 0;
+
+/*
+ * A read started by ReadBufferRange(), covering nbufs consecutive blocks.
+ */
+typedef struct InflightRead
+{
+	PgAioHandle *ioh;
+	BlockNumber firstBlock;
+	BufferDesc **bufs;
+	int			nbufs;
+} InflightRead;
+
+/*
+ * A checkpoint write started by SyncBufferRun(), covering nbufs buffers that
+ * hold consecutive blocks of one relation fork.  The pages are written from
+ * private copies, so the content locks needn't be held while the write is in
+ * flight; we do hold a pin and BM_IO_IN_PROGRESS on each of the buffers.
+ *
+ * The entry just past the last in-flight write is where the next one is
+ * assembled.  Page copies come from a small pool of I/O-aligned pages.
+ * dw_seq is the first double-write buffer slot used by the write, or 0.
+ */
+typedef struct InflightWrite
+{
+	PgAioHandle *ioh;
+	uint64		dw_seq;
+	int			nbufs;
+	BufferDesc *bufs[MAX_IO_COMBINE_LIMIT];
+	char	   *pages[MAX_IO_COMBINE_LIMIT];
+} InflightWrite;
+
+#define MAX_INFLIGHT_WRITES MAX_IO_COMBINE_LIMIT
+#define MAX_INFLIGHT_WRITE_PAGES MAX_IO_COMBINE_LIMIT
+static InflightWrite InflightWrites[MAX_INFLIGHT_WRITES + 1];
+static int	NumInflightWrites = 0;
+static char *InflightWritePages = NULL;
+static char *FreeInflightWritePages[MAX_INFLIGHT_WRITE_PAGES];
+static int	NumFreeInflightWritePages = 0;
+static WritebackContext *InflightWritesContext = NULL;
+
+/*
+ * Single-buffer writes of the bgwriter, and of backends evicting a dirty
+ * victim, when the double-write buffer is enabled.  They are collected into
+ * a batch so that their copies in the double-write buffer are written and
+ * fsync'd together, instead of paying for an fsync per page.  As with
+ * InflightWrites, the pages are written from private copies, and we hold a
+ * pin and BM_IO_IN_PROGRESS on each buffer until the batch has been written.
+ * flush_lsn is the highest LSN of any permanent page in the batch.
+ */
+typedef struct WriteBatch
+{
+	int			nbufs;
+	XLogRecPtr	flush_lsn;
+	WritebackContext *wb_context;
+	BufferDesc *bufs[MAX_IO_COMBINE_LIMIT];
+	char	   *pages[MAX_IO_COMBINE_LIMIT];
+} WriteBatch;
+
+static WriteBatch PendingWriteBatch;
+static char *WriteBatchPages = NULL;
 
 /* local state for LockBufferForCleanup */
 static BufferDesc *PinCountWaitBuf = NULL;
@@ -463,15 +541,38 @@ static Buffer ReadBuffer_common(SMgrRelation reln, char relpersistence,
 								ForkNumber forkNum, BlockNumber blockNum,
 								ReadBufferMode mode, BufferAccessStrategy strategy,
 								bool *hit);
+static int	ReadBufferRunStart(SMgrRelation smgr, ForkNumber forkNum,
+							   BlockNumber firstBlock, BufferDesc **run,
+							   int nrun, InflightRead *pending, int npending);
+static void ReadBufferRunComplete(SMgrRelation smgr, ForkNumber forkNum,
+								  InflightRead *pr);
 static bool PinBuffer(BufferDesc *buf, BufferAccessStrategy strategy);
 static void PinBuffer_Locked(BufferDesc *buf);
+static BufferDesc *PinBufferUnlocked(BufferTag *tag, uint32 hashcode,
+									 BufferAccessStrategy strategy,
+									 bool *valid);
 static void UnpinBuffer(BufferDesc *buf, bool fixOwner);
 static void BufferSync(int flags);
 static uint32 WaitBufHdrUnlocked(BufferDesc *buf);
 static int	SyncOneBuffer(int buf_id, bool skip_recently_used,
 						  WritebackContext *wb_context);
+static int	SyncBufferRun(CkptSortItem *items, int nitems,
+						  WritebackContext *wb_context);
+static void StartInflightWrite(SMgrRelation reln, XLogRecPtr flush_lsn);
+static void ResetInflightWritePages(void);
+static bool WriteBatchAdd(BufferDesc *buf, WritebackContext *wb_context,
+						  bool wait);
+static void WriteBatchAddNeighbors(BufferDesc *victim,
+								   WritebackContext *wb_context);
+static void WriteBatchFlush(void);
+static bool BgBufferSyncPartition(int partition, int maxpages,
+								  WritebackContext *wb_context,
+								  int *num_written_out);
+static void CompleteInflightWrites(int nkeep);
 static void WaitIO(BufferDesc *buf);
 static bool StartBufferIO(BufferDesc *buf, bool forInput);
+static bool StartBufferIOExt(BufferDesc *buf, bool forInput, bool nowait,
+							 bool *busy);
 static void TerminateBufferIO(BufferDesc *buf, bool clear_dirty,
 							  uint32 set_flag_bits);
 static void shared_buffer_write_error_callback(void *arg);
@@ -522,10 +623,17 @@ PrefetchSharedBuffer(SMgrRelation smgr_reln,
 	newHash = BufTableHashCode(&newTag);
 	newPartitionLock = BufMappingPartitionLock(newHash);
 
-	/* see if the block is in the buffer pool already */
-	LWLockAcquire(newPartitionLock, LW_SHARED);
-	buf_id = BufTableLookup(&newTag, newHash);
-	LWLockRelease(newPartitionLock);
+	/*
+	 * See if the block is in the buffer pool already.  The answer is only a
+	 * hint either way, so try the lock-free lookup first.
+	 */
+	buf_id = BufTableLookupUnlocked(&newTag, newHash);
+	if (buf_id < 0)
+	{
+		LWLockAcquire(newPartitionLock, LW_SHARED);
+		buf_id = BufTableLookup(&newTag, newHash);
+		LWLockRelease(newPartitionLock);
+	}
 
 	/* If not in buffers, initiate prefetch */
 	if (buf_id < 0)
@@ -809,6 +917,287 @@ ReadBufferWithoutRelcache(RelFileNode rnode, ForkNumber forkNum,
 							 mode, strategy, &hit);
 }
 
+/*
+ * ReadBufferRange -- pin a run of consecutive blocks of a relation
+ *
+ * This is equivalent to calling ReadBufferExtended() in RBM_NORMAL mode for
+ * each of the nblocks blocks starting at firstBlock, storing the pinned
+ * buffers in buffers[0 .. nblocks-1].  The difference is that blocks which
+ * are not already in shared buffers are read with one vectored read per run
+ * of up to io_combine_limit neighbouring blocks, rather than one read system
+ * call per block.
+ *
+ * The caller must make sure all the blocks exist, and is responsible for
+ * releasing all of the pins.
+ *
+ * The reads of all runs are started before we wait for any of them, so with
+ * io_method = io_uring or worker they proceed concurrently; with io_method =
+ * sync they are performed one after the other.  Either way, all of them are
+ * complete when we return, so the I/O never overlaps with the caller's
+ * processing of the pages.  Callers that know which blocks they'll need next make up for
+ * that by asking for more of them at once: heap scans, bitmap heap scans and
+ * VACUUM's scan of the heap.
+ */
+void
+ReadBufferRange(Relation reln, ForkNumber forkNum, BlockNumber firstBlock,
+				int nblocks, Buffer *buffers, BufferAccessStrategy strategy)
+{
+	SMgrRelation smgr;
+	char		relpersistence = reln->rd_rel->relpersistence;
+	BufferDesc *missed[MAX_IO_COMBINE_LIMIT];
+	int			nmissed = 0;
+	int			runstart = 0;
+	InflightRead pending[MAX_IO_COMBINE_LIMIT];
+	int			npending = 0;
+	int			i;
+
+	Assert(nblocks > 0 && nblocks <= MAX_IO_COMBINE_LIMIT);
+	Assert(firstBlock != P_NEW);
+
+	/* See ReadBufferExtended() */
+	if (RELATION_IS_OTHER_TEMP(reln))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("cannot access temporary tables of other sessions")));
+
+	smgr = RelationGetSmgr(reln);
+
+	/* Local buffers aren't worth the trouble; read them one at a time */
+	if (SmgrIsTemp(smgr) || nblocks == 1)
+	{
+		for (i = 0; i < nblocks; i++)
+			buffers[i] = ReadBufferExtended(reln, forkNum, firstBlock + i,
+											RBM_NORMAL, strategy);
+		return;
+	}
+
+	for (i = 0; i < nblocks; i++)
+	{
+		BlockNumber blockNum = firstBlock + i;
+		BufferDesc *bufHdr;
+		bool		found;
+
+		/* Make sure we will have room to remember the buffer pin */
+		ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+
+		TRACE_POSTGRESQL_BUFFER_READ_START(forkNum, blockNum,
+										   smgr->smgr_rnode.node.spcNode,
+										   smgr->smgr_rnode.node.dbNode,
+										   smgr->smgr_rnode.node.relNode,
+										   smgr->smgr_rnode.backend,
+										   false);
+
+		pgstat_count_buffer_read(reln);
+		bufHdr = BufferAlloc(smgr, relpersistence, forkNum, blockNum,
+							 strategy, &found);
+		buffers[i] = BufferDescriptorGetBuffer(bufHdr);
+
+		if (!found)
+		{
+			/* I/O is now in progress; add it to the current run */
+			pgBufferUsage.shared_blks_read++;
+			missed[nmissed++] = bufHdr;
+			if (nmissed - runstart >= io_combine_limit)
+			{
+				npending = ReadBufferRunStart(smgr, forkNum,
+											  blockNum - (nmissed - runstart) + 1,
+											  &missed[runstart],
+											  nmissed - runstart,
+											  pending, npending);
+				runstart = nmissed;
+			}
+			continue;
+		}
+
+		/* a hit ends the current run, so start reading what we have */
+		if (nmissed > runstart)
+		{
+			npending = ReadBufferRunStart(smgr, forkNum,
+										  blockNum - (nmissed - runstart),
+										  &missed[runstart],
+										  nmissed - runstart,
+										  pending, npending);
+			runstart = nmissed;
+		}
+
+		pgstat_count_buffer_hit(reln);
+		pgBufferUsage.shared_blks_hit++;
+		VacuumPageHit++;
+		if (VacuumCostActive)
+			VacuumCostBalance += VacuumCostPageHit;
+
+		TRACE_POSTGRESQL_BUFFER_READ_DONE(forkNum, blockNum,
+										  smgr->smgr_rnode.node.spcNode,
+										  smgr->smgr_rnode.node.dbNode,
+										  smgr->smgr_rnode.node.relNode,
+										  smgr->smgr_rnode.backend,
+										  false,
+										  true);
+	}
+
+	if (nmissed > runstart)
+		npending = ReadBufferRunStart(smgr, forkNum,
+									  firstBlock + nblocks - (nmissed - runstart),
+									  &missed[runstart],
+									  nmissed - runstart,
+									  pending, npending);
+
+	/*
+	 * Now wait for all the reads.  We must not return with any of them still
+	 * in flight: other backends wanting those pages would have to wait for
+	 * us, and only we can complete the I/O.
+	 */
+	for (i = 0; i < npending; i++)
+		ReadBufferRunComplete(smgr, forkNum, &pending[i]);
+}
+
+/*
+ * ReadBufferRunStart -- subroutine for ReadBufferRange
+ *
+ * Start reading the nrun consecutive blocks starting at firstBlock into the
+ * given buffers, on which we hold pins and have input I/O in progress.  The
+ * storage manager may need more than one I/O to cover the run; each one is
+ * appended to pending[], and the new number of entries is returned.
+ *
+ * With io_method = sync the reads have actually finished by the time we
+ * return, but the caller can't tell the difference.
+ */
+static int
+ReadBufferRunStart(SMgrRelation smgr, ForkNumber forkNum,
+				   BlockNumber firstBlock, BufferDesc **run, int nrun,
+				   InflightRead *pending, int npending)
+{
+	char	   *pages[MAX_IO_COMBINE_LIMIT];
+	int			i;
+
+	for (i = 0; i < nrun; i++)
+	{
+		Assert(run[i]->tag.blockNum == firstBlock + i);
+		pages[i] = (char *) BufHdrGetBlock(run[i]);
+	}
+
+	i = 0;
+	while (i < nrun)
+	{
+		InflightRead *pr;
+		instr_time	io_start,
+					io_time;
+
+		/* if we're out of handles, finish what we've started first */
+		if (npending >= io_max_concurrency)
+		{
+			for (int j = 0; j < npending; j++)
+				ReadBufferRunComplete(smgr, forkNum, &pending[j]);
+			npending = 0;
+		}
+
+		pr = &pending[npending++];
+		pr->firstBlock = firstBlock + i;
+		pr->bufs = &run[i];
+		pr->ioh = pgaio_io_acquire();
+
+		if (track_io_timing)
+			INSTR_TIME_SET_CURRENT(io_start);
+
+		pr->nbufs = smgrstartreadv(smgr, forkNum, pr->firstBlock, &pages[i],
+								   nrun - i, pr->ioh);
+
+		if (track_io_timing)
+		{
+			INSTR_TIME_SET_CURRENT(io_time);
+			INSTR_TIME_SUBTRACT(io_time, io_start);
+			pgstat_count_buffer_read_time(INSTR_TIME_GET_MICROSEC(io_time));
+			INSTR_TIME_ADD(pgBufferUsage.blk_read_time, io_time);
+		}
+
+		i += pr->nbufs;
+	}
+
+	return npending;
+}
+
+/*
+ * ReadBufferRunComplete -- subroutine for ReadBufferRange
+ *
+ * Wait for a read started by ReadBufferRunStart(), verify the pages, and
+ * mark the buffers valid.
+ */
+static void
+ReadBufferRunComplete(SMgrRelation smgr, ForkNumber forkNum, InflightRead *pr)
+{
+	char	   *pages[MAX_IO_COMBINE_LIMIT];
+	instr_time	io_start,
+				io_time;
+	ssize_t		nbytes;
+	int			i;
+
+	for (i = 0; i < pr->nbufs; i++)
+		pages[i] = (char *) BufHdrGetBlock(pr->bufs[i]);
+
+	if (track_io_timing)
+		INSTR_TIME_SET_CURRENT(io_start);
+
+	nbytes = pgaio_io_wait(pr->ioh);
+	pgaio_io_release(pr->ioh);
+
+	/*
+	 * If the read failed or came up short, just do it over synchronously.
+	 * smgrreadv() knows how to deal with partial reads, and how to report
+	 * errors or zero-fill pages beyond EOF as appropriate.
+	 */
+	if (nbytes != (ssize_t) BLCKSZ * pr->nbufs)
+		smgrreadv(smgr, forkNum, pr->firstBlock, pages, pr->nbufs);
+
+	if (track_io_timing)
+	{
+		INSTR_TIME_SET_CURRENT(io_time);
+		INSTR_TIME_SUBTRACT(io_time, io_start);
+		pgstat_count_buffer_read_time(INSTR_TIME_GET_MICROSEC(io_time));
+		INSTR_TIME_ADD(pgBufferUsage.blk_read_time, io_time);
+	}
+
+	for (i = 0; i < pr->nbufs; i++)
+	{
+		BlockNumber blockNum = pr->firstBlock + i;
+
+		/* check for garbage data, as in ReadBuffer_common() */
+		if (!PageIsVerifiedExtended((Page) pages[i], blockNum,
+									PIV_LOG_WARNING | PIV_REPORT_STAT))
+		{
+			if (zero_damaged_pages)
+			{
+				ereport(WARNING,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("invalid page in block %u of relation %s; zeroing out page",
+								blockNum,
+								relpath(smgr->smgr_rnode, forkNum))));
+				MemSet(pages[i], 0, BLCKSZ);
+			}
+			else
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("invalid page in block %u of relation %s",
+								blockNum,
+								relpath(smgr->smgr_rnode, forkNum))));
+		}
+
+		/* Set BM_VALID, terminate IO, and wake up any waiters */
+		TerminateBufferIO(pr->bufs[i], false, BM_VALID);
+
+		VacuumPageMiss++;
+		if (VacuumCostActive)
+			VacuumCostBalance += VacuumCostPageMiss;
+
+		TRACE_POSTGRESQL_BUFFER_READ_DONE(forkNum, blockNum,
+										  smgr->smgr_rnode.node.spcNode,
+										  smgr->smgr_rnode.node.dbNode,
+										  smgr->smgr_rnode.node.relNode,
+										  smgr->smgr_rnode.backend,
+										  false,
+										  false);
+	}
+}
+
 
 /*
  * ReadBuffer_common -- common logic for all ReadBuffer variants
@@ -1096,6 +1485,44 @@ ReadBuffer_common(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	return BufferDescriptorGetBuffer(bufHdr);
 }
 
+/*
+ * PinBufferUnlocked -- find and pin a shared buffer without the mapping lock
+ *
+ * Looks up the tag in the lock-free lookup table, and if that finds a
+ * candidate buffer, pins it and checks that it really holds the page.
+ * Returns the pinned buffer, with *valid set as PinBuffer() would, or NULL
+ * if the caller has to look the page up under the mapping lock instead.
+ *
+ * Once we hold a pin, nobody can change the buffer's tag, so the recheck
+ * can be done without the header lock.  The unlocked lookup already checked
+ * the tag, so we pin the wrong buffer only if it was renamed in the short
+ * window between that check and our pin.  Such a stray pin is dropped at
+ * once; anyone who needed the buffer unpinned meanwhile just retries, as
+ * with any other short-lived pin.
+ */
+static BufferDesc *
+PinBufferUnlocked(BufferTag *tag, uint32 hashcode,
+				  BufferAccessStrategy strategy, bool *valid)
+{
+	int			buf_id;
+	BufferDesc *buf;
+	uint32		buf_state;
+
+	buf_id = BufTableLookupUnlocked(tag, hashcode);
+	if (buf_id < 0)
+		return NULL;
+
+	buf = GetBufferDescriptor(buf_id);
+	*valid = PinBuffer(buf, strategy);
+
+	buf_state = pg_atomic_read_u32(&buf->state);
+	if ((buf_state & BM_TAG_VALID) && BUFFERTAGS_EQUAL(buf->tag, *tag))
+		return buf;
+
+	UnpinBuffer(buf, true);
+	return NULL;
+}
+
 /*
  * BufferAlloc -- subroutine for ReadBuffer.  Handles lookup of a shared
  *		buffer.  If no buffer exists already, selects a replacement
@@ -1140,23 +1567,34 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	newHash = BufTableHashCode(&newTag);
 	newPartitionLock = BufMappingPartitionLock(newHash);
 
-	/* see if the block is in the buffer pool already */
-	LWLockAcquire(newPartitionLock, LW_SHARED);
-	buf_id = BufTableLookup(&newTag, newHash);
-	if (buf_id >= 0)
+	/*
+	 * See if the block is in the buffer pool already.  Usually it is, and we
+	 * can find and pin it without taking the mapping lock at all.  If that
+	 * doesn't work out, look it up again under the lock.
+	 */
+	buf = PinBufferUnlocked(&newTag, newHash, strategy, &valid);
+	if (buf == NULL)
 	{
-		/*
-		 * Found it.  Now, pin the buffer so no one can steal it from the
-		 * buffer pool, and check to see if the correct data has been loaded
-		 * into the buffer.
-		 */
-		buf = GetBufferDescriptor(buf_id);
+		LWLockAcquire(newPartitionLock, LW_SHARED);
+		buf_id = BufTableLookup(&newTag, newHash);
+		if (buf_id >= 0)
+		{
+			/*
+			 * Found it.  Now, pin the buffer so no one can steal it from the
+			 * buffer pool, and check to see if the correct data has been
+			 * loaded into the buffer.
+			 */
+			buf = GetBufferDescriptor(buf_id);
 
-		valid = PinBuffer(buf, strategy);
+			valid = PinBuffer(buf, strategy);
+		}
 
 		/* Can release the mapping lock as soon as we've pinned it */
 		LWLockRelease(newPartitionLock);
+	}
 
+	if (buf != NULL)
+	{
 		*foundPtr = true;
 
 		if (!valid)
@@ -1183,10 +1621,8 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 
 	/*
 	 * Didn't find it in the buffer pool.  We'll have to initialize a new
-	 * buffer.  Remember to unlock the mapping lock while doing the work.
+	 * buffer.
 	 */
-	LWLockRelease(newPartitionLock);
-
 	/* Loop here in case we have to try another victim buffer */
 	for (;;)
 	{
@@ -1269,11 +1705,29 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 														  smgr->smgr_rnode.node.dbNode,
 														  smgr->smgr_rnode.node.relNode);
 
-				FlushBuffer(buf, NULL);
-				LWLockRelease(BufferDescriptorGetContentLock(buf));
+				if ((oldFlags & BM_PERMANENT) && DoubleWriteEnabled())
+				{
+					/*
+					 * Write the victim together with the dirty buffers the
+					 * clock hand is about to reach, so that they share one
+					 * fsync of the double-write buffer.  The batch takes a
+					 * pin of its own on the victim.
+					 */
+					ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+					PinBuffer(buf, NULL);
+					WriteBatchAdd(buf, &BackendWritebackContext, true);
+					WriteBatchAddNeighbors(buf, &BackendWritebackContext);
+					WriteBatchFlush();
+					LWLockRelease(BufferDescriptorGetContentLock(buf));
+				}
+				else
+				{
+					FlushBuffer(buf, NULL);
+					LWLockRelease(BufferDescriptorGetContentLock(buf));
 
-				ScheduleBufferTagForWriteback(&BackendWritebackContext,
-											  &buf->tag);
+					ScheduleBufferTagForWriteback(&BackendWritebackContext,
+												  &buf->tag);
+				}
 
 				TRACE_POSTGRESQL_BUFFER_WRITE_DIRTY_DONE(forkNum, blockNum,
 														 smgr->smgr_rnode.node.spcNode,
@@ -1409,7 +1863,7 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 			break;
 
 		UnlockBufHdr(buf, buf_state);
-		BufTableDelete(&newTag, newHash);
+		BufTableDelete(&newTag, newHash, buf->buf_id);
 		if (oldPartitionLock != NULL &&
 			oldPartitionLock != newPartitionLock)
 			LWLockRelease(oldPartitionLock);
@@ -1443,7 +1897,7 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 
 	if (oldPartitionLock != NULL)
 	{
-		BufTableDelete(&oldTag, oldHash);
+		BufTableDelete(&oldTag, oldHash, buf->buf_id);
 		if (oldPartitionLock != newPartitionLock)
 			LWLockRelease(oldPartitionLock);
 	}
@@ -1557,7 +2011,7 @@ retry:
 	 * Remove the buffer from the lookup hashtable, if it was in there.
 	 */
 	if (oldFlags & BM_TAG_VALID)
-		BufTableDelete(&oldTag, oldHash);
+		BufTableDelete(&oldTag, oldHash, buf->buf_id);
 
 	/*
 	 * Done with mapping lock.
@@ -2136,46 +2590,49 @@ BufferSync(int flags)
 	num_written = 0;
 	while (!binaryheap_empty(ts_heap))
 	{
-		BufferDesc *bufHdr = NULL;
 		CkptTsStatus *ts_stat = (CkptTsStatus *)
 		DatumGetPointer(binaryheap_first(ts_heap));
+		CkptSortItem *item = &CkptBufferIds[ts_stat->index];
+		int			nitems = 1;
+		int			nwritten;
 
-		buf_id = CkptBufferIds[ts_stat->index].buf_id;
-		Assert(buf_id != -1);
+		Assert(item->buf_id != -1);
 
-		bufHdr = GetBufferDescriptor(buf_id);
+		/*
+		 * Thanks to the sort order, buffers holding consecutive blocks of the
+		 * same relation fork are next to each other.  Gather up to
+		 * io_combine_limit of them, so they can be written out together.
+		 * Whether each one still needs writing is checked by SyncBufferRun.
+		 */
+		while (nitems < io_combine_limit &&
+			   ts_stat->num_scanned + nitems < ts_stat->num_to_scan &&
+			   item[nitems].relNode == item[0].relNode &&
+			   item[nitems].forkNum == item[0].forkNum &&
+			   item[nitems].blockNum == item[0].blockNum + nitems)
+			nitems++;
 
-		num_processed++;
+		num_processed += nitems;
+
+		nwritten = SyncBufferRun(item, nitems, &wb_context);
 
 		/*
-		 * We don't need to acquire the lock here, because we're only looking
-		 * at a single bit. It's possible that someone else writes the buffer
-		 * and clears the flag right after we check, but that doesn't matter
-		 * since SyncOneBuffer will then do nothing.  However, there is a
-		 * further race condition: it's conceivable that between the time we
-		 * examine the bit here and the time SyncOneBuffer acquires the lock,
-		 * someone else not only wrote the buffer but replaced it with another
-		 * page and dirtied it.  In that improbable case, SyncOneBuffer will
-		 * write the buffer though we didn't need to.  It doesn't seem worth
-		 * guarding against this, though.
+		 * With asynchronous I/O, keep several writes in flight at once.
+		 * Otherwise the write has already been done, so finish it off right
+		 * away.
 		 */
-		if (pg_atomic_read_u32(&bufHdr->state) & BM_CHECKPOINT_NEEDED)
-		{
-			if (SyncOneBuffer(buf_id, false, &wb_context) & BUF_WRITTEN)
-			{
-				TRACE_POSTGRESQL_BUFFER_SYNC_WRITTEN(buf_id);
-				PendingCheckpointerStats.buf_written_checkpoints++;
-				num_written++;
-			}
-		}
+		if (io_method == IOMETHOD_SYNC)
+			CompleteInflightWrites(0);
+
+		PendingCheckpointerStats.buf_written_checkpoints += nwritten;
+		num_written += nwritten;
 
 		/*
 		 * Measure progress independent of actually having to flush the buffer
 		 * - otherwise writing become unbalanced.
 		 */
-		ts_stat->progress += ts_stat->progress_slice;
-		ts_stat->num_scanned++;
-		ts_stat->index++;
+		ts_stat->progress += ts_stat->progress_slice * nitems;
+		ts_stat->num_scanned += nitems;
+		ts_stat->index += nitems;
 
 		/* Have all the buffers from the tablespace been processed? */
 		if (ts_stat->num_scanned == ts_stat->num_to_scan)
@@ -2196,7 +2653,8 @@ BufferSync(int flags)
 		CheckpointWriteDelay(flags, (double) num_processed / num_to_scan);
 	}
 
-	/* issue all pending flushes */
+	/* finish any asynchronous writes, then issue all pending flushes */
+	CompleteInflightWrites(0);
 	IssuePendingWritebacks(&wb_context);
 
 	pfree(per_ts_stat);
@@ -2212,11 +2670,36 @@ BufferSync(int flags)
 	TRACE_POSTGRESQL_BUFFER_SYNC_DONE(NBuffers, num_written, num_to_scan);
 }
 
+/*
+ * Information the bgwriter saves between calls for each clock sweep
+ * partition, so we can determine the strategy point's advance rate and avoid
+ * scanning already-cleaned buffers.  Buffer positions are relative to the
+ * start of the partition.
+ */
+typedef struct BgWriterPartitionState
+{
+	bool		saved_info_valid;
+	int			prev_strategy_buf_id;
+	uint32		prev_strategy_passes;
+	int			next_to_clean;
+	uint32		next_passes;
+
+	/* Moving averages of allocation rate and clean-buffer density */
+	float		smoothed_alloc;
+	float		smoothed_density;
+} BgWriterPartitionState;
+
+static BgWriterPartitionState *BgWriterPartitions = NULL;
+
 /*
  * BgBufferSync -- Write out some dirty buffers in the pool.
  *
  * This is called periodically by the background writer process.
  *
+ * The clock sweep runs separately in each of freelist.c's partitions, so we
+ * run the LRU scan separately for each of them too, splitting the
+ * bgwriter_lru_maxpages budget between them.
+ *
  * Returns true if it's appropriate for the bgwriter process to go into
  * low-power hibernation mode.  (This happens if the strategy clock sweep
  * has been "lapped" and no buffer allocations have occurred recently,
@@ -2226,24 +2709,69 @@ BufferSync(int flags)
 bool
 BgBufferSync(WritebackContext *wb_context)
 {
-	/* info obtained from freelist.c */
-	int			strategy_buf_id;
-	uint32		strategy_passes;
-	uint32		recent_alloc;
+	static int	first_partition = 0;
+	int			nparts = StrategyNumPartitions();
+	int			pages_left = bgwriter_lru_maxpages;
+	bool		hit_maxpages = false;
+	bool		hibernate = true;
+
+	if (BgWriterPartitions == NULL)
+	{
+		BgWriterPartitions = (BgWriterPartitionState *)
+			MemoryContextAllocZero(TopMemoryContext,
+								   nparts * sizeof(BgWriterPartitionState));
+		for (int i = 0; i < nparts; i++)
+			BgWriterPartitions[i].smoothed_density = 10.0;
+	}
 
 	/*
-	 * Information saved between calls so we can determine the strategy
-	 * point's advance rate and avoid scanning already-cleaned buffers.
+	 * Rotate the partition we start with, so that a small maxpages budget
+	 * doesn't always favor the same partitions.
 	 */
-	static bool saved_info_valid = false;
-	static int	prev_strategy_buf_id;
-	static uint32 prev_strategy_passes;
-	static int	next_to_clean;
-	static uint32 next_passes;
+	for (int i = 0; i < nparts; i++)
+	{
+		int			partition = (first_partition + i) % nparts;
+		int			maxpages;
+		int			num_written;
 
-	/* Moving averages of allocation rate and clean-buffer density */
-	static float smoothed_alloc = 0;
-	static float smoothed_density = 10.0;
+		/* give each remaining partition a fair share of what's left */
+		maxpages = (pages_left + (nparts - i) - 1) / (nparts - i);
+
+		if (!BgBufferSyncPartition(partition, maxpages, wb_context,
+								   &num_written))
+			hibernate = false;
+
+		if (maxpages > 0 && num_written >= maxpages)
+			hit_maxpages = true;
+		pages_left -= num_written;
+	}
+	first_partition = (first_partition + 1) % nparts;
+
+	if (hit_maxpages)
+		PendingBgWriterStats.maxwritten_clean++;
+
+	return hibernate;
+}
+
+/*
+ * BgBufferSyncPartition -- LRU scan of one clock sweep partition
+ *
+ * Writes at most maxpages buffers, and returns the number written in
+ * *num_written_out.  Returns true if this partition would let the bgwriter
+ * hibernate.
+ */
+static bool
+BgBufferSyncPartition(int partition, int maxpages,
+					  WritebackContext *wb_context, int *num_written_out)
+{
+	BgWriterPartitionState *state = &BgWriterPartitions[partition];
+
+	/* info obtained from freelist.c */
+	int			first_buffer;
+	int			num_buffers;
+	int			strategy_buf_id;
+	uint32		strategy_passes;
+	uint32		recent_alloc;
 
 	/* Potentially these could be tunables, but for now, not */
 	float		smoothing_samples = 16;
@@ -2267,11 +2795,15 @@ BgBufferSync(WritebackContext *wb_context)
 	long		new_strategy_delta;
 	uint32		new_recent_alloc;
 
+	*num_written_out = 0;
+
 	/*
-	 * Find out where the freelist clock sweep currently is, and how many
-	 * buffer allocations have happened since our last call.
+	 * Find out where the partition's clock sweep currently is, and how many
+	 * buffer allocations have happened in it since our last call.
 	 */
-	strategy_buf_id = StrategySyncStart(&strategy_passes, &recent_alloc);
+	StrategyPartitionRange(partition, &first_buffer, &num_buffers);
+	strategy_buf_id = StrategySyncStart(partition, &strategy_passes,
+										&recent_alloc) - first_buffer;
 
 	/* Report buffer alloc counts to pgstat */
 	PendingBgWriterStats.buf_alloc += recent_alloc;
@@ -2283,7 +2815,7 @@ BgBufferSync(WritebackContext *wb_context)
 	 */
 	if (bgwriter_lru_maxpages <= 0)
 	{
-		saved_info_valid = false;
+		state->saved_info_valid = false;
 		return true;
 	}
 
@@ -2295,34 +2827,34 @@ BgBufferSync(WritebackContext *wb_context)
 	 * weird-looking coding of xxx_passes comparisons are to avoid bogus
 	 * behavior when the passes counts wrap around.
 	 */
-	if (saved_info_valid)
+	if (state->saved_info_valid)
 	{
-		int32		passes_delta = strategy_passes - prev_strategy_passes;
+		int32		passes_delta = strategy_passes - state->prev_strategy_passes;
 
-		strategy_delta = strategy_buf_id - prev_strategy_buf_id;
-		strategy_delta += (long) passes_delta * NBuffers;
+		strategy_delta = strategy_buf_id - state->prev_strategy_buf_id;
+		strategy_delta += (long) passes_delta * num_buffers;
 
 		Assert(strategy_delta >= 0);
 
-		if ((int32) (next_passes - strategy_passes) > 0)
+		if ((int32) (state->next_passes - strategy_passes) > 0)
 		{
 			/* we're one pass ahead of the strategy point */
-			bufs_to_lap = strategy_buf_id - next_to_clean;
+			bufs_to_lap = strategy_buf_id - state->next_to_clean;
 #ifdef BGW_DEBUG
-			elog(DEBUG2, "bgwriter ahead: bgw %u-%u strategy %u-%u delta=%ld lap=%d",
-				 next_passes, next_to_clean,
+			elog(DEBUG2, "bgwriter ahead: partition %d bgw %u-%u strategy %u-%u delta=%ld lap=%d",
+				 partition, state->next_passes, state->next_to_clean,
 				 strategy_passes, strategy_buf_id,
 				 strategy_delta, bufs_to_lap);
 #endif
 		}
-		else if (next_passes == strategy_passes &&
-				 next_to_clean >= strategy_buf_id)
+		else if (state->next_passes == strategy_passes &&
+				 state->next_to_clean >= strategy_buf_id)
 		{
 			/* on same pass, but ahead or at least not behind */
-			bufs_to_lap = NBuffers - (next_to_clean - strategy_buf_id);
+			bufs_to_lap = num_buffers - (state->next_to_clean - strategy_buf_id);
 #ifdef BGW_DEBUG
-			elog(DEBUG2, "bgwriter ahead: bgw %u-%u strategy %u-%u delta=%ld lap=%d",
-				 next_passes, next_to_clean,
+			elog(DEBUG2, "bgwriter ahead: partition %d bgw %u-%u strategy %u-%u delta=%ld lap=%d",
+				 partition, state->next_passes, state->next_to_clean,
 				 strategy_passes, strategy_buf_id,
 				 strategy_delta, bufs_to_lap);
 #endif
@@ -2334,14 +2866,14 @@ BgBufferSync(WritebackContext *wb_context)
 			 * cleaning from there.
 			 */
 #ifdef BGW_DEBUG
-			elog(DEBUG2, "bgwriter behind: bgw %u-%u strategy %u-%u delta=%ld",
-				 next_passes, next_to_clean,
+			elog(DEBUG2, "bgwriter behind: partition %d bgw %u-%u strategy %u-%u delta=%ld",
+				 partition, state->next_passes, state->next_to_clean,
 				 strategy_passes, strategy_buf_id,
 				 strategy_delta);
 #endif
-			next_to_clean = strategy_buf_id;
-			next_passes = strategy_passes;
-			bufs_to_lap = NBuffers;
+			state->next_to_clean = strategy_buf_id;
+			state->next_passes = strategy_passes;
+			bufs_to_lap = num_buffers;
 		}
 	}
 	else
@@ -2351,239 +2883,887 @@ BgBufferSync(WritebackContext *wb_context)
 		 * start at the strategy point.
 		 */
 #ifdef BGW_DEBUG
-		elog(DEBUG2, "bgwriter initializing: strategy %u-%u",
-			 strategy_passes, strategy_buf_id);
+		elog(DEBUG2, "bgwriter initializing: partition %d strategy %u-%u",
+			 partition, strategy_passes, strategy_buf_id);
 #endif
 		strategy_delta = 0;
-		next_to_clean = strategy_buf_id;
-		next_passes = strategy_passes;
-		bufs_to_lap = NBuffers;
+		state->next_to_clean = strategy_buf_id;
+		state->next_passes = strategy_passes;
+		bufs_to_lap = num_buffers;
+	}
+
+	/* Update saved info for next time */
+	state->prev_strategy_buf_id = strategy_buf_id;
+	state->prev_strategy_passes = strategy_passes;
+	state->saved_info_valid = true;
+
+	/*
+	 * Compute how many buffers had to be scanned for each new allocation, ie,
+	 * 1/density of reusable buffers, and track a moving average of that.
+	 *
+	 * If the strategy point didn't move, we don't update the density estimate
+	 */
+	if (strategy_delta > 0 && recent_alloc > 0)
+	{
+		scans_per_alloc = (float) strategy_delta / (float) recent_alloc;
+		state->smoothed_density += (scans_per_alloc - state->smoothed_density) /
+			smoothing_samples;
+	}
+
+	/*
+	 * Estimate how many reusable buffers there are between the current
+	 * strategy point and where we've scanned ahead to, based on the smoothed
+	 * density estimate.
+	 */
+	bufs_ahead = num_buffers - bufs_to_lap;
+	reusable_buffers_est = (float) bufs_ahead / state->smoothed_density;
+
+	/*
+	 * Track a moving average of recent buffer allocations.  Here, rather than
+	 * a true average we want a fast-attack, slow-decline behavior: we
+	 * immediately follow any increase.
+	 */
+	if (state->smoothed_alloc <= (float) recent_alloc)
+		state->smoothed_alloc = recent_alloc;
+	else
+		state->smoothed_alloc += ((float) recent_alloc - state->smoothed_alloc) /
+			smoothing_samples;
+
+	/* Scale the estimate by a GUC to allow more aggressive tuning. */
+	upcoming_alloc_est = (int) (state->smoothed_alloc * bgwriter_lru_multiplier);
+
+	/*
+	 * If recent_alloc remains at zero for many cycles, smoothed_alloc will
+	 * eventually underflow to zero, and the underflows produce annoying
+	 * kernel warnings on some platforms.  Once upcoming_alloc_est has gone to
+	 * zero, there's no point in tracking smaller and smaller values of
+	 * smoothed_alloc, so just reset it to exactly zero to avoid this
+	 * syndrome.  It will pop back up as soon as recent_alloc increases.
+	 */
+	if (upcoming_alloc_est == 0)
+		state->smoothed_alloc = 0;
+
+	/*
+	 * Even in cases where there's been little or no buffer allocation
+	 * activity, we want to make a small amount of progress through the buffer
+	 * cache so that as many reusable buffers as possible are clean after an
+	 * idle period.
+	 *
+	 * (scan_whole_pool_milliseconds / BgWriterDelay) computes how many times
+	 * the BGW will be called during the scan_whole_pool time; slice the
+	 * partition into that many sections.
+	 */
+	min_scan_buffers = (int) (num_buffers / (scan_whole_pool_milliseconds / BgWriterDelay));
+
+	if (upcoming_alloc_est < (min_scan_buffers + reusable_buffers_est))
+	{
+#ifdef BGW_DEBUG
+		elog(DEBUG2, "bgwriter: alloc_est=%d too small, using min=%d + reusable_est=%d",
+			 upcoming_alloc_est, min_scan_buffers, reusable_buffers_est);
+#endif
+		upcoming_alloc_est = min_scan_buffers + reusable_buffers_est;
+	}
+
+	/*
+	 * Now write out dirty reusable buffers, working forward from the
+	 * next_to_clean point, until we have lapped the strategy scan, or cleaned
+	 * enough buffers to match our estimate of the next cycle's allocation
+	 * requirements, or hit this partition's share of bgwriter_lru_maxpages.
+	 */
+
+	num_to_scan = bufs_to_lap;
+	num_written = 0;
+	reusable_buffers = reusable_buffers_est;
+
+	/* Execute the LRU scan */
+	while (num_to_scan > 0 && reusable_buffers < upcoming_alloc_est &&
+		   num_written < maxpages)
+	{
+		int			sync_state;
+
+		/*
+		 * Make sure we can handle the pin inside SyncOneBuffer.  The pins of
+		 * batched writes pile up until the batch is written.
+		 */
+		ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+
+		sync_state = SyncOneBuffer(first_buffer + state->next_to_clean,
+								   true, wb_context);
+
+		if (++state->next_to_clean >= num_buffers)
+		{
+			state->next_to_clean = 0;
+			state->next_passes++;
+		}
+		num_to_scan--;
+
+		if (sync_state & BUF_WRITTEN)
+		{
+			reusable_buffers++;
+			num_written++;
+		}
+		else if (sync_state & BUF_REUSABLE)
+			reusable_buffers++;
+	}
+
+	WriteBatchFlush();
+
+	PendingBgWriterStats.buf_written_clean += num_written;
+	*num_written_out = num_written;
+
+#ifdef BGW_DEBUG
+	elog(DEBUG1, "bgwriter: partition %d recent_alloc=%u smoothed=%.2f delta=%ld ahead=%d density=%.2f reusable_est=%d upcoming_est=%d scanned=%d wrote=%d reusable=%d",
+		 partition, recent_alloc, state->smoothed_alloc, strategy_delta,
+		 bufs_ahead, state->smoothed_density, reusable_buffers_est,
+		 upcoming_alloc_est,
+		 bufs_to_lap - num_to_scan,
+		 num_written,
+		 reusable_buffers - reusable_buffers_est);
+#endif
+
+	/*
+	 * Consider the above scan as being like a new allocation scan.
+	 * Characterize its density and update the smoothed one based on it. This
+	 * effectively halves the moving average period in cases where both the
+	 * strategy and the background writer are doing some useful scanning,
+	 * which is helpful because a long memory isn't as desirable on the
+	 * density estimates.
+	 */
+	new_strategy_delta = bufs_to_lap - num_to_scan;
+	new_recent_alloc = reusable_buffers - reusable_buffers_est;
+	if (new_strategy_delta > 0 && new_recent_alloc > 0)
+	{
+		scans_per_alloc = (float) new_strategy_delta / (float) new_recent_alloc;
+		state->smoothed_density += (scans_per_alloc - state->smoothed_density) /
+			smoothing_samples;
+
+#ifdef BGW_DEBUG
+		elog(DEBUG2, "bgwriter: cleaner density alloc=%u scan=%ld density=%.2f new smoothed=%.2f",
+			 new_recent_alloc, new_strategy_delta,
+			 scans_per_alloc, state->smoothed_density);
+#endif
+	}
+
+	/* Return true if OK to hibernate */
+	return (bufs_to_lap == 0 && recent_alloc == 0);
+}
+
+/*
+ * SyncOneBuffer -- process a single buffer during syncing.
+ *
+ * If skip_recently_used is true, we don't write currently-pinned buffers, nor
+ * buffers marked recently used, as these are not replacement candidates.
+ *
+ * Returns a bitmask containing the following flag bits:
+ *	BUF_WRITTEN: we wrote the buffer.
+ *	BUF_REUSABLE: buffer is available for replacement, ie, it has
+ *		pin count 0 and usage count 0.
+ *
+ * (BUF_WRITTEN could be set in error if FlushBuffer finds the buffer clean
+ * after locking it, but we don't care all that much.)
+ *
+ * Note: caller must have done ResourceOwnerEnlargeBuffers.
+ */
+static int
+SyncOneBuffer(int buf_id, bool skip_recently_used, WritebackContext *wb_context)
+{
+	BufferDesc *bufHdr = GetBufferDescriptor(buf_id);
+	int			result = 0;
+	uint32		buf_state;
+	BufferTag	tag;
+
+	ReservePrivateRefCountEntry();
+
+	/*
+	 * Check whether buffer needs writing.
+	 *
+	 * We can make this check without taking the buffer content lock so long
+	 * as we mark pages dirty in access methods *before* logging changes with
+	 * XLogInsert(): if someone marks the buffer dirty just after our check we
+	 * don't worry because our checkpoint.redo points before log record for
+	 * upcoming changes and so we are not required to write such dirty buffer.
+	 */
+	buf_state = LockBufHdr(bufHdr);
+
+	if (BUF_STATE_GET_REFCOUNT(buf_state) == 0 &&
+		BUF_STATE_GET_USAGECOUNT(buf_state) == 0)
+	{
+		result |= BUF_REUSABLE;
+	}
+	else if (skip_recently_used)
+	{
+		/* Caller told us not to write recently-used buffers */
+		UnlockBufHdr(bufHdr, buf_state);
+		return result;
+	}
+
+	if (!(buf_state & BM_VALID) || !(buf_state & BM_DIRTY))
+	{
+		/* It's clean, so nothing to do */
+		UnlockBufHdr(bufHdr, buf_state);
+		return result;
+	}
+
+	/*
+	 * Pin it, share-lock it, write it.  (FlushBuffer will do nothing if the
+	 * buffer is clean by the time we've locked it.)
+	 */
+	PinBuffer_Locked(bufHdr);
+
+	/*
+	 * With the double-write buffer, add the buffer to the pending batch
+	 * instead; it's written by WriteBatchFlush() once the batch is full, or
+	 * at the end of the bgwriter's scan.  Others may be waiting for the
+	 * buffers already in the batch, so write those out before sleeping on a
+	 * content lock.
+	 */
+	if ((buf_state & BM_PERMANENT) && DoubleWriteEnabled())
+	{
+		if (!LWLockConditionalAcquire(BufferDescriptorGetContentLock(bufHdr),
+									  LW_SHARED))
+		{
+			WriteBatchFlush();
+			LWLockAcquire(BufferDescriptorGetContentLock(bufHdr), LW_SHARED);
+		}
+		WriteBatchAdd(bufHdr, wb_context, true);
+		LWLockRelease(BufferDescriptorGetContentLock(bufHdr));
+
+		return result | BUF_WRITTEN;
+	}
+
+	LWLockAcquire(BufferDescriptorGetContentLock(bufHdr), LW_SHARED);
+
+	FlushBuffer(bufHdr, NULL);
+
+	LWLockRelease(BufferDescriptorGetContentLock(bufHdr));
+
+	tag = bufHdr->tag;
+
+	UnpinBuffer(bufHdr, true);
+
+	ScheduleBufferTagForWriteback(wb_context, &tag);
+
+	return result | BUF_WRITTEN;
+}
+
+/*
+ * SyncBufferRun -- write out checkpoint buffers holding consecutive blocks of
+ * one relation fork, combining them into as few writes as possible.
+ *
+ * items[] are entries of CkptBufferIds, for consecutive block numbers.  Each
+ * buffer is written only if it still holds that block and is still marked
+ * BM_CHECKPOINT_NEEDED; buffers that don't qualify split the run.  The writes
+ * are completed later by CompleteInflightWrites(), which also takes care of
+ * the pins and of scheduling writeback in wb_context.  Returns the number of
+ * buffers whose write was started.
+ *
+ * While writes are in flight, other backends may end up waiting for us to
+ * finish them, so we must not block on anything they might hold.  Hence we
+ * only try-lock the content locks here, and WaitIO() finishes our own writes
+ * before sleeping on someone else's.  Any partially assembled write is
+ * started before we block.
+ */
+static int
+SyncBufferRun(CkptSortItem *items, int nitems, WritebackContext *wb_context)
+{
+	InflightWrite *iw = NULL;
+	SMgrRelation reln = NULL;
+	XLogRecPtr	flush_lsn = InvalidXLogRecPtr;
+	int			nwritten = 0;
+
+	Assert(nitems > 0 && nitems <= MAX_IO_COMBINE_LIMIT);
+
+	if (InflightWritePages == NULL)
+		ResetInflightWritePages();
+	InflightWritesContext = wb_context;
+
+	for (int i = 0; i < nitems; i++)
+	{
+		CkptSortItem *item = &items[i];
+		BufferDesc *bufHdr = GetBufferDescriptor(item->buf_id);
+		XLogRecPtr	recptr;
+		uint32		buf_state;
+		char	   *page;
+		bool		busy;
+
+		/* make room for one more write, and one more page */
+		if (iw == NULL &&
+			NumInflightWrites >= Min(io_max_concurrency, MAX_INFLIGHT_WRITES))
+			CompleteInflightWrites(NumInflightWrites / 2);
+		if (NumFreeInflightWritePages == 0)
+		{
+			if (iw != NULL)
+			{
+				StartInflightWrite(reln, flush_lsn);
+				iw = NULL;
+				i--;
+				continue;
+			}
+			CompleteInflightWrites(NumInflightWrites / 2);
+		}
+		Assert(NumFreeInflightWritePages > 0);
+
+		ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+		ReservePrivateRefCountEntry();
+
+		/*
+		 * Check that the buffer still holds the block we expect and needs to
+		 * be written for this checkpoint.  Someone else may have written it
+		 * out meanwhile, and possibly even replaced it with another page.
+		 * The sort items don't record the database, so make sure that all
+		 * members of a write belong to the same one.
+		 */
+		buf_state = LockBufHdr(bufHdr);
+		if (!(buf_state & BM_VALID) ||
+			!(buf_state & BM_DIRTY) ||
+			!(buf_state & BM_CHECKPOINT_NEEDED) ||
+			bufHdr->tag.rnode.spcNode != item->tsId ||
+			bufHdr->tag.rnode.relNode != item->relNode ||
+			bufHdr->tag.forkNum != item->forkNum ||
+			bufHdr->tag.blockNum != item->blockNum ||
+			(iw != NULL &&
+			 bufHdr->tag.rnode.dbNode != iw->bufs[0]->tag.rnode.dbNode))
+		{
+			UnlockBufHdr(bufHdr, buf_state);
+			if (iw != NULL)
+			{
+				StartInflightWrite(reln, flush_lsn);
+				iw = NULL;
+			}
+			continue;
+		}
+
+		/* don't wait for someone else's I/O while we hold some ourselves */
+		if (iw != NULL && (buf_state & BM_IO_IN_PROGRESS))
+		{
+			UnlockBufHdr(bufHdr, buf_state);
+			StartInflightWrite(reln, flush_lsn);
+			iw = NULL;
+			i--;
+			continue;
+		}
+		PinBuffer_Locked(bufHdr);
+
+		if (!LWLockConditionalAcquire(BufferDescriptorGetContentLock(bufHdr),
+									  LW_SHARED))
+		{
+			if (iw != NULL)
+			{
+				UnpinBuffer(bufHdr, true);
+				StartInflightWrite(reln, flush_lsn);
+				iw = NULL;
+				i--;
+				continue;
+			}
+			CompleteInflightWrites(0);
+			LWLockAcquire(BufferDescriptorGetContentLock(bufHdr), LW_SHARED);
+		}
+
+		/*
+		 * Someone may have started I/O on the buffer since we checked above.
+		 * Waiting for it would go through WaitIO(), which completes all of
+		 * our writes in flight, including the one being assembled in iw; so
+		 * if we have one, start it and come back without waiting.
+		 */
+		if (!StartBufferIOExt(bufHdr, false, iw != NULL, &busy))
+		{
+			LWLockRelease(BufferDescriptorGetContentLock(bufHdr));
+			UnpinBuffer(bufHdr, true);
+			if (iw != NULL)
+			{
+				StartInflightWrite(reln, flush_lsn);
+				iw = NULL;
+				if (busy)
+					i--;
+			}
+			continue;
+		}
+
+		if (iw == NULL)
+		{
+			iw = &InflightWrites[NumInflightWrites];
+			iw->nbufs = 0;
+			reln = smgropen(bufHdr->tag.rnode, InvalidBackendId);
+			flush_lsn = InvalidXLogRecPtr;
+		}
+
+		TRACE_POSTGRESQL_BUFFER_FLUSH_START(bufHdr->tag.forkNum,
+											bufHdr->tag.blockNum,
+											reln->smgr_rnode.node.spcNode,
+											reln->smgr_rnode.node.dbNode,
+											reln->smgr_rnode.node.relNode);
+
+		/* See FlushBuffer() */
+		buf_state = LockBufHdr(bufHdr);
+		recptr = BufferGetLSN(bufHdr);
+		buf_state &= ~BM_JUST_DIRTIED;
+		UnlockBufHdr(bufHdr, buf_state);
+
+		if ((buf_state & BM_PERMANENT) && recptr > flush_lsn)
+			flush_lsn = recptr;
+
+		/*
+		 * Copy the page, so that we can let go of the content lock right
+		 * away.  Anyone who modifies the page from now on will set
+		 * BM_JUST_DIRTIED, so the buffer won't be marked clean when the write
+		 * completes.
+		 */
+		page = FreeInflightWritePages[--NumFreeInflightWritePages];
+		memcpy(page, BufHdrGetBlock(bufHdr), BLCKSZ);
+		LWLockRelease(BufferDescriptorGetContentLock(bufHdr));
+
+		iw->bufs[iw->nbufs] = bufHdr;
+		iw->pages[iw->nbufs] = page;
+		iw->nbufs++;
+		nwritten++;
+
+		TRACE_POSTGRESQL_BUFFER_SYNC_WRITTEN(item->buf_id);
+	}
+
+	if (iw != NULL)
+		StartInflightWrite(reln, flush_lsn);
+
+	return nwritten;
+}
+
+/*
+ * StartInflightWrite -- start the write assembled by SyncBufferRun() in
+ * InflightWrites[NumInflightWrites].
+ *
+ * WAL is flushed up to flush_lsn first, the highest LSN of any permanent page
+ * in the write, and permanent pages are copied to the double-write buffer if
+ * it's enabled.  If the storage manager can't cover the whole run with one
+ * write, because it crosses a segment boundary, the rest becomes a write of
+ * its own.
+ */
+static void
+StartInflightWrite(SMgrRelation reln, XLogRecPtr flush_lsn)
+{
+	InflightWrite *iw = &InflightWrites[NumInflightWrites];
+
+	Assert(iw->nbufs > 0);
+
+	if (!XLogRecPtrIsInvalid(flush_lsn))
+		XLogFlush(flush_lsn);
+
+	for (int i = 0; i < iw->nbufs; i++)
+		PageSetChecksumInplace((Page) iw->pages[i], iw->bufs[i]->tag.blockNum);
+
+	iw->dw_seq = 0;
+	if ((pg_atomic_read_u32(&iw->bufs[0]->state) & BM_PERMANENT) &&
+		DoubleWriteEnabled())
+	{
+		BufferTag	tags[MAX_IO_COMBINE_LIMIT];
+
+		/*
+		 * If the double-write buffer is full, our own writes in flight may be
+		 * what it's waiting for.  Finish them before waiting for room.
+		 */
+		if (!DoubleWriteReserve(iw->nbufs, &iw->dw_seq, NumInflightWrites > 0))
+		{
+			InflightWrite pending = *iw;
+
+			CompleteInflightWrites(0);
+			iw = &InflightWrites[0];
+			*iw = pending;
+			DoubleWriteReserve(iw->nbufs, &iw->dw_seq, false);
+		}
+
+		for (int i = 0; i < iw->nbufs; i++)
+			tags[i] = iw->bufs[i]->tag;
+		DoubleWriteWrite(iw->dw_seq, tags, iw->pages, iw->nbufs);
+	}
+
+	for (;;)
+	{
+		InflightWrite rest;
+		BlockNumber nblocks;
+
+		iw->ioh = pgaio_io_acquire();
+		NumInflightWrites++;
+		nblocks = smgrstartwritev(reln, iw->bufs[0]->tag.forkNum,
+								  iw->bufs[0]->tag.blockNum,
+								  iw->pages, iw->nbufs, false, iw->ioh);
+		if (nblocks == iw->nbufs)
+			break;
+
+		rest.nbufs = iw->nbufs - nblocks;
+		rest.dw_seq = iw->dw_seq == 0 ? 0 : iw->dw_seq + nblocks;
+		memcpy(rest.bufs, &iw->bufs[nblocks], sizeof(BufferDesc *) * rest.nbufs);
+		memcpy(rest.pages, &iw->pages[nblocks], sizeof(char *) * rest.nbufs);
+		iw->nbufs = nblocks;
+
+		if (NumInflightWrites >= Min(io_max_concurrency, MAX_INFLIGHT_WRITES))
+			CompleteInflightWrites(NumInflightWrites / 2);
+
+		iw = &InflightWrites[NumInflightWrites];
+		iw->dw_seq = rest.dw_seq;
+		iw->nbufs = rest.nbufs;
+		memcpy(iw->bufs, rest.bufs, sizeof(BufferDesc *) * rest.nbufs);
+		memcpy(iw->pages, rest.pages, sizeof(char *) * rest.nbufs);
+	}
+}
+
+/*
+ * CompleteInflightWrites -- wait for asynchronous checkpoint writes started
+ * by SyncBufferRun(), oldest first, until at most nkeep remain.
+ */
+static void
+CompleteInflightWrites(int nkeep)
+{
+	int			ndone;
+
+	Assert(nkeep >= 0);
+	if (NumInflightWrites <= nkeep)
+		return;
+	ndone = NumInflightWrites - nkeep;
+
+	for (int i = 0; i < ndone; i++)
+	{
+		InflightWrite *iw = &InflightWrites[i];
+		ErrorContextCallback errcallback;
+		instr_time	io_start,
+					io_time;
+		ssize_t		nbytes;
+
+		errcallback.callback = shared_buffer_write_error_callback;
+		errcallback.arg = (void *) iw->bufs[0];
+		errcallback.previous = error_context_stack;
+		error_context_stack = &errcallback;
+
+		if (track_io_timing)
+			INSTR_TIME_SET_CURRENT(io_start);
+
+		nbytes = pgaio_io_wait(iw->ioh);
+		pgaio_io_release(iw->ioh);
+
+		/* redo a failed or short write synchronously, to report it properly */
+		if (nbytes != (ssize_t) iw->nbufs * BLCKSZ)
+		{
+			for (int j = 0; j < iw->nbufs; j++)
+			{
+				BufferDesc *buf = iw->bufs[j];
+
+				errcallback.arg = (void *) buf;
+				smgrwrite(smgropen(buf->tag.rnode, InvalidBackendId),
+						  buf->tag.forkNum, buf->tag.blockNum, iw->pages[j],
+						  false);
+			}
+		}
+
+		if (track_io_timing)
+		{
+			INSTR_TIME_SET_CURRENT(io_time);
+			INSTR_TIME_SUBTRACT(io_time, io_start);
+			pgstat_count_buffer_write_time(INSTR_TIME_GET_MICROSEC(io_time));
+			INSTR_TIME_ADD(pgBufferUsage.blk_write_time, io_time);
+		}
+
+		pgBufferUsage.shared_blks_written += iw->nbufs;
+
+		error_context_stack = errcallback.previous;
+
+		if (iw->dw_seq != 0)
+			DoubleWriteDone(iw->dw_seq, iw->nbufs);
+
+		for (int j = 0; j < iw->nbufs; j++)
+		{
+			BufferDesc *buf = iw->bufs[j];
+			BufferTag	tag;
+
+			TerminateBufferIO(buf, true, 0);
+
+			TRACE_POSTGRESQL_BUFFER_FLUSH_DONE(buf->tag.forkNum,
+											   buf->tag.blockNum,
+											   buf->tag.rnode.spcNode,
+											   buf->tag.rnode.dbNode,
+											   buf->tag.rnode.relNode);
+
+			/*
+			 * The writeback context merges adjacent blocks, so the whole run
+			 * ends up in a single flush request.
+			 */
+			tag = buf->tag;
+			UnpinBuffer(buf, true);
+			ScheduleBufferTagForWriteback(InflightWritesContext, &tag);
+
+			FreeInflightWritePages[NumFreeInflightWritePages++] = iw->pages[j];
+		}
 	}
 
-	/* Update saved info for next time */
-	prev_strategy_buf_id = strategy_buf_id;
-	prev_strategy_passes = strategy_passes;
-	saved_info_valid = true;
+	/* keep the survivors at the front */
+	memmove(&InflightWrites[0], &InflightWrites[ndone],
+			sizeof(InflightWrite) * nkeep);
+	NumInflightWrites = nkeep;
+}
 
+/*
+ * ResetInflightWritePages -- allocate the page copies for asynchronous
+ * checkpoint writes if we haven't yet, and mark them all unused.
+ */
+static void
+ResetInflightWritePages(void)
+{
 	/*
-	 * Compute how many buffers had to be scanned for each new allocation, ie,
-	 * 1/density of reusable buffers, and track a moving average of that.
-	 *
-	 * If the strategy point didn't move, we don't update the density estimate
+	 * Checkpoints are performed by the checkpointer, or a standalone backend,
+	 * which have pages in shared memory for this; see InitBufferPool().
 	 */
-	if (strategy_delta > 0 && recent_alloc > 0)
+	if (InflightWritePages == NULL)
 	{
-		scans_per_alloc = (float) strategy_delta / (float) recent_alloc;
-		smoothed_density += (scans_per_alloc - smoothed_density) /
-			smoothing_samples;
+		if (AmCheckpointerProcess() || !IsUnderPostmaster)
+			InflightWritePages = CkptWritePages;
+		else
+			InflightWritePages = (char *)
+				TYPEALIGN(PG_IO_ALIGN_SIZE,
+						  MemoryContextAlloc(TopMemoryContext,
+											 MAX_INFLIGHT_WRITE_PAGES * BLCKSZ +
+											 PG_IO_ALIGN_SIZE));
 	}
 
-	/*
-	 * Estimate how many reusable buffers there are between the current
-	 * strategy point and where we've scanned ahead to, based on the smoothed
-	 * density estimate.
-	 */
-	bufs_ahead = NBuffers - bufs_to_lap;
-	reusable_buffers_est = (float) bufs_ahead / smoothed_density;
+	for (int i = 0; i < MAX_INFLIGHT_WRITE_PAGES; i++)
+		FreeInflightWritePages[i] = InflightWritePages + i * BLCKSZ;
+	NumFreeInflightWritePages = MAX_INFLIGHT_WRITE_PAGES;
+}
 
-	/*
-	 * Track a moving average of recent buffer allocations.  Here, rather than
-	 * a true average we want a fast-attack, slow-decline behavior: we
-	 * immediately follow any increase.
-	 */
-	if (smoothed_alloc <= (float) recent_alloc)
-		smoothed_alloc = recent_alloc;
-	else
-		smoothed_alloc += ((float) recent_alloc - smoothed_alloc) /
-			smoothing_samples;
+/*
+ * CompleteAsyncBufferWrites -- wait for all asynchronous checkpoint writes.
+ *
+ * The checkpointer calls this before napping between writes, so that other
+ * backends don't have to wait for its writes all through the nap.
+ */
+void
+CompleteAsyncBufferWrites(void)
+{
+	CompleteInflightWrites(0);
+}
 
-	/* Scale the estimate by a GUC to allow more aggressive tuning. */
-	upcoming_alloc_est = (int) (smoothed_alloc * bgwriter_lru_multiplier);
+/*
+ * WriteBatchAdd -- add a buffer to the pending write batch.
+ *
+ * The caller must hold a share lock on the buffer's contents and a pin,
+ * which the batch takes over.  The page is copied, so the content lock can
+ * be released right away.  The buffer is skipped if it's no longer dirty,
+ * or, unless 'wait', if someone else's I/O is in progress on it.  Returns
+ * true if the buffer was added.
+ */
+static bool
+WriteBatchAdd(BufferDesc *buf, WritebackContext *wb_context, bool wait)
+{
+	WriteBatch *wb = &PendingWriteBatch;
+	XLogRecPtr	recptr;
+	uint32		buf_state;
+	bool		started;
+	bool		busy;
 
-	/*
-	 * If recent_alloc remains at zero for many cycles, smoothed_alloc will
-	 * eventually underflow to zero, and the underflows produce annoying
-	 * kernel warnings on some platforms.  Once upcoming_alloc_est has gone to
-	 * zero, there's no point in tracking smaller and smaller values of
-	 * smoothed_alloc, so just reset it to exactly zero to avoid this
-	 * syndrome.  It will pop back up as soon as recent_alloc increases.
-	 */
-	if (upcoming_alloc_est == 0)
-		smoothed_alloc = 0;
+	if (WriteBatchPages == NULL)
+	{
+		WriteBatchPages = (char *)
+			TYPEALIGN(PG_IO_ALIGN_SIZE,
+					  MemoryContextAlloc(TopMemoryContext,
+										 MAX_IO_COMBINE_LIMIT * BLCKSZ +
+										 PG_IO_ALIGN_SIZE));
+		for (int i = 0; i < MAX_IO_COMBINE_LIMIT; i++)
+			wb->pages[i] = WriteBatchPages + i * BLCKSZ;
+	}
 
 	/*
-	 * Even in cases where there's been little or no buffer allocation
-	 * activity, we want to make a small amount of progress through the buffer
-	 * cache so that as many reusable buffers as possible are clean after an
-	 * idle period.
-	 *
-	 * (scan_whole_pool_milliseconds / BgWriterDelay) computes how many times
-	 * the BGW will be called during the scan_whole_pool time; slice the
-	 * buffer pool into that many sections.
+	 * Keep the batch within io_combine_limit, and leave room for I/O this
+	 * process may already have in progress, e.g. in ReadBufferRange().
 	 */
-	min_scan_buffers = (int) (NBuffers / (scan_whole_pool_milliseconds / BgWriterDelay));
+	if (wb->nbufs >= io_combine_limit ||
+		NumInProgressBufs >= MAX_IN_PROGRESS_BUFS)
+		WriteBatchFlush();
 
-	if (upcoming_alloc_est < (min_scan_buffers + reusable_buffers_est))
+	/* WaitIO() would write out the batch; don't wait if we needn't */
+	started = StartBufferIOExt(buf, false, wb->nbufs > 0, &busy);
+	if (!started && busy && wait)
 	{
-#ifdef BGW_DEBUG
-		elog(DEBUG2, "bgwriter: alloc_est=%d too small, using min=%d + reusable_est=%d",
-			 upcoming_alloc_est, min_scan_buffers, reusable_buffers_est);
-#endif
-		upcoming_alloc_est = min_scan_buffers + reusable_buffers_est;
+		WriteBatchFlush();
+		started = StartBufferIO(buf, false);
+	}
+	if (!started)
+	{
+		UnpinBuffer(buf, true);
+		return false;
 	}
 
-	/*
-	 * Now write out dirty reusable buffers, working forward from the
-	 * next_to_clean point, until we have lapped the strategy scan, or cleaned
-	 * enough buffers to match our estimate of the next cycle's allocation
-	 * requirements, or hit the bgwriter_lru_maxpages limit.
-	 */
+	/* See FlushBuffer() */
+	buf_state = LockBufHdr(buf);
+	recptr = BufferGetLSN(buf);
+	buf_state &= ~BM_JUST_DIRTIED;
+	UnlockBufHdr(buf, buf_state);
 
-	/* Make sure we can handle the pin inside SyncOneBuffer */
-	ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+	if ((buf_state & BM_PERMANENT) && recptr > wb->flush_lsn)
+		wb->flush_lsn = recptr;
 
-	num_to_scan = bufs_to_lap;
-	num_written = 0;
-	reusable_buffers = reusable_buffers_est;
+	memcpy(wb->pages[wb->nbufs], BufHdrGetBlock(buf), BLCKSZ);
+	wb->bufs[wb->nbufs] = buf;
+	wb->nbufs++;
+	wb->wb_context = wb_context;
 
-	/* Execute the LRU scan */
-	while (num_to_scan > 0 && reusable_buffers < upcoming_alloc_est)
+	return true;
+}
+
+/*
+ * WriteBatchAddNeighbors -- add the buffers following a backend's eviction
+ * victim to the write batch, if they are likely to be evicted soon too.
+ *
+ * The clock hand has just passed the victim, so the buffers right after it
+ * are the next ones it will consider.  Writing those that are unpinned, not
+ * recently used and dirty along with the victim saves the backends that
+ * would evict them an fsync of the double-write buffer each.  As we may be
+ * holding other content locks, we only try-lock theirs, and we skip pages
+ * that would need a WAL flush.
+ */
+static void
+WriteBatchAddNeighbors(BufferDesc *victim, WritebackContext *wb_context)
+{
+	int			last = Min(NBuffers, victim->buf_id + 1 + 2 * io_combine_limit);
+
+	for (int buf_id = victim->buf_id + 1;
+		 buf_id < last && PendingWriteBatch.nbufs < io_combine_limit &&
+		 NumInProgressBufs < MAX_IN_PROGRESS_BUFS;
+		 buf_id++)
 	{
-		int			sync_state = SyncOneBuffer(next_to_clean, true,
-											   wb_context);
+		BufferDesc *bufHdr = GetBufferDescriptor(buf_id);
+		uint32		buf_state;
+		XLogRecPtr	lsn;
+
+		ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+		ReservePrivateRefCountEntry();
 
-		if (++next_to_clean >= NBuffers)
+		buf_state = LockBufHdr(bufHdr);
+		if (BUF_STATE_GET_REFCOUNT(buf_state) != 0 ||
+			BUF_STATE_GET_USAGECOUNT(buf_state) != 0 ||
+			(buf_state & (BM_VALID | BM_DIRTY | BM_PERMANENT | BM_IO_IN_PROGRESS)) !=
+			(BM_VALID | BM_DIRTY | BM_PERMANENT))
 		{
-			next_to_clean = 0;
-			next_passes++;
+			UnlockBufHdr(bufHdr, buf_state);
+			continue;
 		}
-		num_to_scan--;
+		lsn = BufferGetLSN(bufHdr);
+		PinBuffer_Locked(bufHdr);
 
-		if (sync_state & BUF_WRITTEN)
+		if (XLogNeedsFlush(lsn) ||
+			!LWLockConditionalAcquire(BufferDescriptorGetContentLock(bufHdr),
+									  LW_SHARED))
 		{
-			reusable_buffers++;
-			if (++num_written >= bgwriter_lru_maxpages)
-			{
-				PendingBgWriterStats.maxwritten_clean++;
-				break;
-			}
+			UnpinBuffer(bufHdr, true);
+			continue;
 		}
-		else if (sync_state & BUF_REUSABLE)
-			reusable_buffers++;
-	}
-
-	PendingBgWriterStats.buf_written_clean += num_written;
-
-#ifdef BGW_DEBUG
-	elog(DEBUG1, "bgwriter: recent_alloc=%u smoothed=%.2f delta=%ld ahead=%d density=%.2f reusable_est=%d upcoming_est=%d scanned=%d wrote=%d reusable=%d",
-		 recent_alloc, smoothed_alloc, strategy_delta, bufs_ahead,
-		 smoothed_density, reusable_buffers_est, upcoming_alloc_est,
-		 bufs_to_lap - num_to_scan,
-		 num_written,
-		 reusable_buffers - reusable_buffers_est);
-#endif
-
-	/*
-	 * Consider the above scan as being like a new allocation scan.
-	 * Characterize its density and update the smoothed one based on it. This
-	 * effectively halves the moving average period in cases where both the
-	 * strategy and the background writer are doing some useful scanning,
-	 * which is helpful because a long memory isn't as desirable on the
-	 * density estimates.
-	 */
-	new_strategy_delta = bufs_to_lap - num_to_scan;
-	new_recent_alloc = reusable_buffers - reusable_buffers_est;
-	if (new_strategy_delta > 0 && new_recent_alloc > 0)
-	{
-		scans_per_alloc = (float) new_strategy_delta / (float) new_recent_alloc;
-		smoothed_density += (scans_per_alloc - smoothed_density) /
-			smoothing_samples;
-
-#ifdef BGW_DEBUG
-		elog(DEBUG2, "bgwriter: cleaner density alloc=%u scan=%ld density=%.2f new smoothed=%.2f",
-			 new_recent_alloc, new_strategy_delta,
-			 scans_per_alloc, smoothed_density);
-#endif
+		WriteBatchAdd(bufHdr, wb_context, false);
+		LWLockRelease(BufferDescriptorGetContentLock(bufHdr));
 	}
-
-	/* Return true if OK to hibernate */
-	return (bufs_to_lap == 0 && recent_alloc == 0);
 }
 
 /*
- * SyncOneBuffer -- process a single buffer during syncing.
- *
- * If skip_recently_used is true, we don't write currently-pinned buffers, nor
- * buffers marked recently used, as these are not replacement candidates.
- *
- * Returns a bitmask containing the following flag bits:
- *	BUF_WRITTEN: we wrote the buffer.
- *	BUF_REUSABLE: buffer is available for replacement, ie, it has
- *		pin count 0 and usage count 0.
- *
- * (BUF_WRITTEN could be set in error if FlushBuffer finds the buffer clean
- * after locking it, but we don't care all that much.)
+ * WriteBatchFlush -- write out the pending write batch.
  *
- * Note: caller must have done ResourceOwnerEnlargeBuffers.
+ * WAL is flushed first, then the copies of permanent pages go to the
+ * double-write buffer with a single fsync, and then each page is written to
+ * its data file.
  */
-static int
-SyncOneBuffer(int buf_id, bool skip_recently_used, WritebackContext *wb_context)
+static void
+WriteBatchFlush(void)
 {
-	BufferDesc *bufHdr = GetBufferDescriptor(buf_id);
-	int			result = 0;
-	uint32		buf_state;
-	BufferTag	tag;
+	WriteBatch *wb = &PendingWriteBatch;
+	BufferTag	tags[MAX_IO_COMBINE_LIMIT];
+	char	   *dw_pages[MAX_IO_COMBINE_LIMIT];
+	int			ndw = 0;
+	uint64		dw_seq = 0;
+	ErrorContextCallback errcallback;
 
-	ReservePrivateRefCountEntry();
+	if (wb->nbufs == 0)
+		return;
 
-	/*
-	 * Check whether buffer needs writing.
-	 *
-	 * We can make this check without taking the buffer content lock so long
-	 * as we mark pages dirty in access methods *before* logging changes with
-	 * XLogInsert(): if someone marks the buffer dirty just after our check we
-	 * don't worry because our checkpoint.redo points before log record for
-	 * upcoming changes and so we are not required to write such dirty buffer.
-	 */
-	buf_state = LockBufHdr(bufHdr);
+	if (!XLogRecPtrIsInvalid(wb->flush_lsn))
+		XLogFlush(wb->flush_lsn);
 
-	if (BUF_STATE_GET_REFCOUNT(buf_state) == 0 &&
-		BUF_STATE_GET_USAGECOUNT(buf_state) == 0)
+	for (int i = 0; i < wb->nbufs; i++)
 	{
-		result |= BUF_REUSABLE;
+		BufferDesc *buf = wb->bufs[i];
+
+		PageSetChecksumInplace((Page) wb->pages[i], buf->tag.blockNum);
+		if ((pg_atomic_read_u32(&buf->state) & BM_PERMANENT) &&
+			DoubleWriteEnabled())
+		{
+			tags[ndw] = buf->tag;
+			dw_pages[ndw] = wb->pages[i];
+			ndw++;
+		}
 	}
-	else if (skip_recently_used)
+
+	if (ndw > 0)
 	{
-		/* Caller told us not to write recently-used buffers */
-		UnlockBufHdr(bufHdr, buf_state);
-		return result;
+		/* see StartInflightWrite() */
+		if (!DoubleWriteReserve(ndw, &dw_seq, NumInflightWrites > 0))
+		{
+			CompleteInflightWrites(0);
+			DoubleWriteReserve(ndw, &dw_seq, false);
+		}
+		DoubleWriteWrite(dw_seq, tags, dw_pages, ndw);
 	}
 
-	if (!(buf_state & BM_VALID) || !(buf_state & BM_DIRTY))
+	errcallback.callback = shared_buffer_write_error_callback;
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	for (int i = 0; i < wb->nbufs; i++)
 	{
-		/* It's clean, so nothing to do */
-		UnlockBufHdr(bufHdr, buf_state);
-		return result;
+		BufferDesc *buf = wb->bufs[i];
+		instr_time	io_start,
+					io_time;
+
+		errcallback.arg = (void *) buf;
+
+		TRACE_POSTGRESQL_BUFFER_FLUSH_START(buf->tag.forkNum,
+											buf->tag.blockNum,
+											buf->tag.rnode.spcNode,
+											buf->tag.rnode.dbNode,
+											buf->tag.rnode.relNode);
+
+		if (track_io_timing)
+			INSTR_TIME_SET_CURRENT(io_start);
+
+		smgrwrite(smgropen(buf->tag.rnode, InvalidBackendId),
+				  buf->tag.forkNum, buf->tag.blockNum, wb->pages[i], false);
+
+		if (track_io_timing)
+		{
+			INSTR_TIME_SET_CURRENT(io_time);
+			INSTR_TIME_SUBTRACT(io_time, io_start);
+			pgstat_count_buffer_write_time(INSTR_TIME_GET_MICROSEC(io_time));
+			INSTR_TIME_ADD(pgBufferUsage.blk_write_time, io_time);
+		}
+
+		pgBufferUsage.shared_blks_written++;
 	}
 
-	/*
-	 * Pin it, share-lock it, write it.  (FlushBuffer will do nothing if the
-	 * buffer is clean by the time we've locked it.)
-	 */
-	PinBuffer_Locked(bufHdr);
-	LWLockAcquire(BufferDescriptorGetContentLock(bufHdr), LW_SHARED);
+	error_context_stack = errcallback.previous;
 
-	FlushBuffer(bufHdr, NULL);
+	if (dw_seq != 0)
+		DoubleWriteDone(dw_seq, ndw);
 
-	LWLockRelease(BufferDescriptorGetContentLock(bufHdr));
+	for (int i = 0; i < wb->nbufs; i++)
+	{
+		BufferDesc *buf = wb->bufs[i];
+		BufferTag	tag;
 
-	tag = bufHdr->tag;
+		TerminateBufferIO(buf, true, 0);
 
-	UnpinBuffer(bufHdr, true);
+		TRACE_POSTGRESQL_BUFFER_FLUSH_DONE(buf->tag.forkNum,
+										   buf->tag.blockNum,
+										   buf->tag.rnode.spcNode,
+										   buf->tag.rnode.dbNode,
+										   buf->tag.rnode.relNode);
 
-	ScheduleBufferTagForWriteback(wb_context, &tag);
+		tag = buf->tag;
+		UnpinBuffer(buf, true);
+		ScheduleBufferTagForWriteback(wb->wb_context, &tag);
+	}
 
-	return result | BUF_WRITTEN;
+	wb->nbufs = 0;
+	wb->flush_lsn = InvalidXLogRecPtr;
 }
 
 /*
@@ -2831,6 +4011,7 @@ FlushBuffer(BufferDesc *buf, SMgrRelation reln)
 	Block		bufBlock;
 	char	   *bufToWrite;
 	uint32		buf_state;
+	uint64		dw_seq = 0;
 
 	/*
 	 * Try to start an I/O operation.  If StartBufferIO returns false, then
@@ -2902,6 +4083,30 @@ FlushBuffer(BufferDesc *buf, SMgrRelation reln)
 	 */
 	bufToWrite = PageSetChecksumCopy((Page) bufBlock, buf->tag.blockNum);
 
+	/*
+	 * Put a copy of a permanent page in the double-write buffer first, if
+	 * enabled.  The copy written there must match the CRC computed for it,
+	 * so we need a private copy even without checksums.
+	 */
+	if ((buf_state & BM_PERMANENT) && DoubleWriteEnabled())
+	{
+		static PGIOAlignedBlock pageCopy;
+
+		if (bufToWrite == (char *) bufBlock)
+		{
+			memcpy(pageCopy.data, bufBlock, BLCKSZ);
+			bufToWrite = pageCopy.data;
+		}
+
+		/* see StartInflightWrite() */
+		if (!DoubleWriteReserve(1, &dw_seq, NumInflightWrites > 0))
+		{
+			CompleteInflightWrites(0);
+			DoubleWriteReserve(1, &dw_seq, false);
+		}
+		DoubleWriteWrite(dw_seq, &buf->tag, &bufToWrite, 1);
+	}
+
 	if (track_io_timing)
 		INSTR_TIME_SET_CURRENT(io_start);
 
@@ -2914,6 +4119,9 @@ FlushBuffer(BufferDesc *buf, SMgrRelation reln)
 			  bufToWrite,
 			  false);
 
+	if (dw_seq != 0)
+		DoubleWriteDone(dw_seq, 1);
+
 	if (track_io_timing)
 	{
 		INSTR_TIME_SET_CURRENT(io_time);
@@ -3713,7 +4921,7 @@ RelationCopyStorageUsingBuffer(RelFileNode srcnode,
 	bool		use_wal;
 	BlockNumber nblocks;
 	BlockNumber blkno;
-	PGAlignedBlock buf;
+	PGIOAlignedBlock buf;
 	BufferAccessStrategy bstrategy_src;
 	BufferAccessStrategy bstrategy_dst;
 
@@ -4499,8 +5707,15 @@ IsBufferCleanupOK(Buffer buffer)
 /*
  *	Functions for buffer I/O handling
  *
- *	Note: We assume that nested buffer I/O never occurs.
- *	i.e at most one BM_IO_IN_PROGRESS bit is set per proc.
+ *	Note: A process normally has I/O in progress on at most one buffer at a
+ *	time.  The exception is ReadBufferRange(), which starts input I/O on a
+ *	run of consecutive blocks before reading them in one go.  It acquires
+ *	the buffers in ascending block order and never waits for I/O on a lower
+ *	numbered block while holding I/O on a higher one, so two such processes
+ *	cannot deadlock on each other.  The checkpointer may also have several
+ *	asynchronous writes in progress; see SyncBufferRun().  With the
+ *	double-write buffer, the bgwriter and evicting backends batch their
+ *	writes; see WriteBatchAdd().
  *
  *	Also note that these are used only for shared buffers, not local ones.
  */
@@ -4513,6 +5728,13 @@ WaitIO(BufferDesc *buf)
 {
 	ConditionVariable *cv = BufferDescriptorGetIOCV(buf);
 
+	/*
+	 * Whoever is doing the I/O might in turn be waiting for one of our
+	 * asynchronous or batched writes, so finish those first.
+	 */
+	CompleteInflightWrites(0);
+	WriteBatchFlush();
+
 	ConditionVariablePrepareToSleep(cv);
 	for (;;)
 	{
@@ -4553,10 +5775,24 @@ WaitIO(BufferDesc *buf)
  */
 static bool
 StartBufferIO(BufferDesc *buf, bool forInput)
+{
+	return StartBufferIOExt(buf, forInput, false, NULL);
+}
+
+/*
+ * StartBufferIOExt: like StartBufferIO, but if nowait is true and someone
+ * else's I/O is in progress, return false with *busy set instead of waiting
+ * for it.  *busy is set to false in every other case.
+ */
+static bool
+StartBufferIOExt(BufferDesc *buf, bool forInput, bool nowait, bool *busy)
 {
 	uint32		buf_state;
 
-	Assert(!InProgressBuf);
+	Assert(NumInProgressBufs < MAX_IN_PROGRESS_BUFS);
+
+	if (busy)
+		*busy = false;
 
 	for (;;)
 	{
@@ -4565,6 +5801,11 @@ StartBufferIO(BufferDesc *buf, bool forInput)
 		if (!(buf_state & BM_IO_IN_PROGRESS))
 			break;
 		UnlockBufHdr(buf, buf_state);
+		if (nowait)
+		{
+			*busy = true;
+			return false;
+		}
 		WaitIO(buf);
 	}
 
@@ -4580,8 +5821,9 @@ StartBufferIO(BufferDesc *buf, bool forInput)
 	buf_state |= BM_IO_IN_PROGRESS;
 	UnlockBufHdr(buf, buf_state);
 
-	InProgressBuf = buf;
-	IsForInput = forInput;
+	InProgressBufs[NumInProgressBufs] = buf;
+	InProgressIsForInput[NumInProgressBufs] = forInput;
+	NumInProgressBufs++;
 
 	return true;
 }
@@ -4606,8 +5848,14 @@ static void
 TerminateBufferIO(BufferDesc *buf, bool clear_dirty, uint32 set_flag_bits)
 {
 	uint32		buf_state;
+	int			i;
 
-	Assert(buf == InProgressBuf);
+	for (i = NumInProgressBufs - 1; i >= 0; i--)
+	{
+		if (InProgressBufs[i] == buf)
+			break;
+	}
+	Assert(i >= 0);
 
 	buf_state = LockBufHdr(buf);
 
@@ -4620,13 +5868,16 @@ TerminateBufferIO(BufferDesc *buf, bool clear_dirty, uint32 set_flag_bits)
 	buf_state |= set_flag_bits;
 	UnlockBufHdr(buf, buf_state);
 
-	InProgressBuf = NULL;
+	/* forget it, keeping the array dense */
+	NumInProgressBufs--;
+	InProgressBufs[i] = InProgressBufs[NumInProgressBufs];
+	InProgressIsForInput[i] = InProgressIsForInput[NumInProgressBufs];
 
 	ConditionVariableBroadcast(BufferDescriptorGetIOCV(buf));
 }
 
 /*
- * AbortBufferIO: Clean up any active buffer I/O after an error.
+ * AbortBufferIO: Clean up all active buffer I/O after an error.
  *
  *	All LWLocks we might have held have been released,
  *	but we haven't yet released buffer pins, so the buffer is still pinned.
@@ -4637,15 +5888,27 @@ TerminateBufferIO(BufferDesc *buf, bool clear_dirty, uint32 set_flag_bits)
 void
 AbortBufferIO(void)
 {
-	BufferDesc *buf = InProgressBuf;
-
-	if (buf)
+	/*
+	 * Make sure the kernel is done with any asynchronous I/O before we forget
+	 * about it.  The pins on buffers being written asynchronously are left for
+	 * the resource owner to release.
+	 */
+	pgaio_at_error();
+	NumInflightWrites = 0;
+	if (InflightWritePages != NULL)
+		ResetInflightWritePages();
+	PendingWriteBatch.nbufs = 0;
+	PendingWriteBatch.flush_lsn = InvalidXLogRecPtr;
+	DoubleWriteAbort();
+
+	while (NumInProgressBufs > 0)
 	{
+		BufferDesc *buf = InProgressBufs[NumInProgressBufs - 1];
 		uint32		buf_state;
 
 		buf_state = LockBufHdr(buf);
 		Assert(buf_state & BM_IO_IN_PROGRESS);
-		if (IsForInput)
+		if (InProgressIsForInput[NumInProgressBufs - 1])
 		{
 			Assert(!(buf_state & BM_DIRTY));
 
@@ -4896,6 +6159,10 @@ ScheduleBufferTagForWriteback(WritebackContext *context, BufferTag *tag)
 {
 	PendingWriteback *pending;
 
+	/* With direct I/O, the data is never in the kernel's cache to begin with */
+	if (io_direct_flags & IO_DIRECT_DATA)
+		return;
+
 	/*
 	 * Add buffer to the pending writeback array, unless writeback control is
 	 * disabled.
@@ -0,0 +1,926 @@
+/*-------------------------------------------------------------------------
+ *
+ * doublewrite.c
+ *	  Double-write buffer protecting data-file writes against torn pages.
+ *
+ * A page write that is interrupted by a crash can leave the block half old
+ * and half new on disk.  Normally WAL protects against that with a full-page
+ * image of each page the first time it's modified after a checkpoint, which
+ * can be a large fraction of the WAL volume.  With double_write_buffers set,
+ * every write of a permanent page from shared buffers is first written to a
+ * ring of slots in the file DOUBLE_WRITE_FILENAME and made durable there.
+ * After a crash, any page whose data-file copy might be torn is restored
+ * from its slot before WAL replay begins, so full-page writes are switched
+ * off (see UpdateFullPageWrites()).
+ *
+ * The file starts with a header block, followed by a packed array of slot
+ * headers and then the page slots themselves.  Writes are numbered with a
+ * sequence that never goes backwards, and write number seq uses slot
+ * (seq % nslots).  Each slot header records the sequence number, the buffer
+ * tag and a CRC covering the header and page, so a torn write into the
+ * double-write buffer itself is recognized and ignored; in that case the
+ * data-file write hadn't started yet.
+ *
+ * A slot can be reused once the data-file write it protects is durable.
+ * Slots below retired_upto are known to be, and the header block records
+ * that horizon.  Checkpoints advance it, since they fsync everything that
+ * was written before them; a writer that finds the ring full advances it by
+ * itself, by fsyncing the data files written through the oldest half of the
+ * ring.
+ *
+ * The double-write copies are written with ordinary buffered writes, and
+ * concurrent writers share the fsync of the file: whoever gets
+ * DoubleWriteFlushLock syncs on behalf of everyone who wrote before the
+ * fsync started.
+ *
+ * Portions Copyright (c) 1996-2022, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/storage/buffer/doublewrite.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "port/pg_crc32c.h"
+#include "storage/bufpage.h"
+#include "storage/condition_variable.h"
+#include "storage/doublewrite.h"
+#include "storage/fd.h"
+#include "storage/ipc.h"
+#include "storage/md.h"
+#include "storage/shmem.h"
+#include "storage/sync.h"
+#include "utils/memutils.h"
+
+#define DOUBLE_WRITE_MAGIC		0x44574231	/* "DWB1" */
+
+/* Header block at the start of the file */
+typedef struct DoubleWriteFileHeader
+{
+	uint32		magic;
+	int32		nslots;
+	uint64		retired_upto;	/* slots with lower seq are stale */
+	pg_crc32c	crc;			/* CRC of the above */
+} DoubleWriteFileHeader;
+
+/* Per-slot header, stored in a packed array after the header block */
+typedef struct DoubleWriteSlotHeader
+{
+	uint64		seq;
+	BufferTag	tag;
+	pg_crc32c	crc;			/* CRC of the above and the page */
+} DoubleWriteSlotHeader;
+
+/* A valid slot found by DoubleWriteRecover() */
+typedef struct DoubleWriteCopy
+{
+	BufferTag	tag;
+	uint64		seq;
+	int			slot;
+} DoubleWriteCopy;
+
+/* Number of blocks taken up by the slot headers */
+#define DW_SLOT_HEADER_BLOCKS(nslots) \
+	(((nslots) * sizeof(DoubleWriteSlotHeader) + BLCKSZ - 1) / BLCKSZ)
+#define DW_SLOT_HEADER_OFFSET(slot) \
+	((off_t) BLCKSZ + (off_t) (slot) * sizeof(DoubleWriteSlotHeader))
+#define DW_PAGE_OFFSET(nslots, slot) \
+	((off_t) (1 + DW_SLOT_HEADER_BLOCKS(nslots) + (slot)) * BLCKSZ)
+
+/* Shared state of one slot */
+typedef struct DoubleWriteSlot
+{
+	/* seq of the last write through this slot that has finished */
+	pg_atomic_uint64 done_seq;
+	/* data-file block written; set before done_seq */
+	BufferTag	tag;
+} DoubleWriteSlot;
+
+typedef struct DoubleWriteCtlData
+{
+	int			nslots;
+	bool		enabled;		/* set up by the startup process */
+
+	pg_atomic_uint64 next_seq;	/* next seq to hand out */
+	pg_atomic_uint64 retired_upto;	/* all writes below are durable */
+
+	/* fsyncs of the file started and finished; see DoubleWriteSync() */
+	pg_atomic_uint64 fsync_started;
+	pg_atomic_uint64 fsync_done;
+
+	/* someone is sleeping on done_cv, waiting for writes to finish */
+	pg_atomic_uint32 retire_waiting;
+	ConditionVariable done_cv;
+
+	DoubleWriteSlot slots[FLEXIBLE_ARRAY_MEMBER];
+} DoubleWriteCtlData;
+
+/* GUC variable */
+int			double_write_buffers = 0;
+
+static DoubleWriteCtlData *DoubleWriteCtl = NULL;
+
+/* This process's descriptor of the file, opened on first use */
+static File DoubleWriteFile = -1;
+
+/*
+ * Ranges of sequence numbers this process has reserved, but not finished
+ * writing through yet.  Error recovery marks them as done.
+ */
+#define MAX_PENDING_RANGES		64
+
+typedef struct PendingRange
+{
+	uint64		seq;
+	int			n;
+} PendingRange;
+
+static PendingRange PendingRanges[MAX_PENDING_RANGES];
+static int	NumPendingRanges = 0;
+static bool DoubleWriteExitRegistered = false;
+
+/* Scratch space for DoubleWriteRetire() */
+static FileTag *RetireFileTags = NULL;
+
+static int	DoubleWriteNumSlots(void);
+static void DoubleWriteOpenFile(void);
+static void DoubleWriteWriteFile(char *buffer, int amount, off_t offset);
+static void DoubleWriteSync(void);
+static void DoubleWriteWriteHeader(uint64 retired_upto);
+static void DoubleWriteRetire(uint64 target);
+static uint64 DoubleWriteRecover(bool restore);
+static void DoubleWriteCreateFile(uint64 seq);
+static void DoubleWriteAtExit(int code, Datum arg);
+static int	copy_cmp(const void *a, const void *b);
+static int	filetag_cmp(const void *a, const void *b);
+
+/*
+ * Number of slots in the ring.  Enough are always provided for two of the
+ * largest writes bufmgr.c issues, so that retiring half the ring always
+ * makes room.
+ */
+static int
+DoubleWriteNumSlots(void)
+{
+	if (double_write_buffers == 0)
+		return 0;
+	return Max(double_write_buffers, 2 * MAX_IO_COMBINE_LIMIT);
+}
+
+/*
+ * Report shared memory space needed by DoubleWriteShmemInit
+ */
+Size
+DoubleWriteShmemSize(void)
+{
+	return add_size(offsetof(DoubleWriteCtlData, slots),
+					mul_size(DoubleWriteNumSlots(), sizeof(DoubleWriteSlot)));
+}
+
+/*
+ * Initialize shared memory for the double-write buffer
+ */
+void
+DoubleWriteShmemInit(void)
+{
+	bool		found;
+
+	DoubleWriteCtl = (DoubleWriteCtlData *)
+		ShmemInitStruct("Double Write Buffer", DoubleWriteShmemSize(), &found);
+
+	if (!found)
+	{
+		DoubleWriteCtl->nslots = DoubleWriteNumSlots();
+		DoubleWriteCtl->enabled = false;
+		pg_atomic_init_u64(&DoubleWriteCtl->next_seq, 1);
+		pg_atomic_init_u64(&DoubleWriteCtl->retired_upto, 1);
+		pg_atomic_init_u64(&DoubleWriteCtl->fsync_started, 0);
+		pg_atomic_init_u64(&DoubleWriteCtl->fsync_done, 0);
+		pg_atomic_init_u32(&DoubleWriteCtl->retire_waiting, 0);
+		ConditionVariableInit(&DoubleWriteCtl->done_cv);
+
+		for (int i = 0; i < DoubleWriteCtl->nslots; i++)
+		{
+			pg_atomic_init_u64(&DoubleWriteCtl->slots[i].done_seq, 0);
+			CLEAR_BUFFERTAG(DoubleWriteCtl->slots[i].tag);
+		}
+	}
+}
+
+/*
+ * DoubleWriteEnabled -- must writes of permanent pages go through the
+ * double-write buffer?
+ */
+bool
+DoubleWriteEnabled(void)
+{
+	return DoubleWriteCtl != NULL && DoubleWriteCtl->enabled;
+}
+
+/*
+ * DoubleWriteStartup -- set up the double-write buffer at startup.
+ *
+ * Called by the startup process before WAL recovery begins.  After a crash,
+ * pages that may have been torn are restored from the old file first.  The
+ * file is then recreated empty, or removed if double_write_buffers is 0.
+ */
+void
+DoubleWriteStartup(bool didCrash)
+{
+	uint64		seq;
+	struct stat st;
+
+	Assert(!DoubleWriteCtl->enabled);
+
+	seq = DoubleWriteRecover(didCrash);
+
+	if (DoubleWriteCtl->nslots == 0)
+	{
+		if (stat(DOUBLE_WRITE_FILENAME, &st) == 0)
+			durable_unlink(DOUBLE_WRITE_FILENAME, ERROR);
+		return;
+	}
+
+	/*
+	 * Keep the sequence going from where the old file left off, so that its
+	 * slots look stale even if recreating the file doesn't become durable.
+	 */
+	seq = Max(seq, 1);
+	DoubleWriteCreateFile(seq);
+
+	pg_atomic_write_u64(&DoubleWriteCtl->next_seq, seq);
+	pg_atomic_write_u64(&DoubleWriteCtl->retired_upto, seq);
+	DoubleWriteCtl->enabled = true;
+}
+
+/*
+ * DoubleWriteRecover -- scan the double-write buffer left behind by the
+ * previous run of the server, and restore torn pages from it if 'restore'.
+ *
+ * For each block, only the copy from the latest write is considered.  The
+ * data file is overwritten with it unless it's identical, or the data file
+ * holds a valid page with a newer LSN; the block might have been rewritten
+ * by other means since, e.g. after the relation was dropped and its
+ * relfilenode reused.
+ *
+ * Returns a sequence number higher than any found in the file.
+ */
+static uint64
+DoubleWriteRecover(bool restore)
+{
+	int			fd;
+	DoubleWriteFileHeader header;
+	pg_crc32c	crc;
+	DoubleWriteSlotHeader *slots;
+	int			nslots;
+	int			nvalid = 0;
+	int			nrestored = 0;
+	DoubleWriteCopy *copies;
+	ssize_t		nread;
+	uint64		result;
+	PGIOAlignedBlock page;
+	PGIOAlignedBlock current;
+
+	fd = OpenTransientFile(DOUBLE_WRITE_FILENAME, O_RDONLY | PG_BINARY);
+	if (fd < 0)
+	{
+		if (errno == ENOENT)
+			return 0;
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m",
+						DOUBLE_WRITE_FILENAME)));
+	}
+
+	pgstat_report_wait_start(WAIT_EVENT_DOUBLE_WRITE_READ);
+	if (pg_pread(fd, &header, sizeof(header), 0) != sizeof(header))
+		memset(&header, 0, sizeof(header));
+	pgstat_report_wait_end();
+
+	INIT_CRC32C(crc);
+	COMP_CRC32C(crc, &header, offsetof(DoubleWriteFileHeader, crc));
+	FIN_CRC32C(crc);
+	if (header.magic != DOUBLE_WRITE_MAGIC || !EQ_CRC32C(crc, header.crc) ||
+		header.nslots <= 0)
+	{
+		CloseTransientFile(fd);
+		if (restore)
+			ereport(WARNING,
+					(errmsg("ignoring double-write buffer file \"%s\" with invalid header",
+							DOUBLE_WRITE_FILENAME)));
+		return 0;
+	}
+
+	result = header.retired_upto;
+	nslots = header.nslots;
+	slots = palloc0(nslots * sizeof(DoubleWriteSlotHeader));
+
+	/* A short read just leaves the missing slots zeroed, i.e. unused */
+	pgstat_report_wait_start(WAIT_EVENT_DOUBLE_WRITE_READ);
+	nread = pg_pread(fd, slots, nslots * sizeof(DoubleWriteSlotHeader),
+					 DW_SLOT_HEADER_OFFSET(0));
+	pgstat_report_wait_end();
+	if (nread < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read file \"%s\": %m",
+						DOUBLE_WRITE_FILENAME)));
+
+	/*
+	 * Weed out stale and torn slots, and slots not at the position their
+	 * sequence number calls for.  Zapping the seq makes them be skipped from
+	 * here on.
+	 */
+	for (int i = 0; i < nslots; i++)
+	{
+		DoubleWriteSlotHeader *slot = &slots[i];
+
+		if (slot->seq < header.retired_upto || slot->seq % nslots != i)
+		{
+			slot->seq = 0;
+			continue;
+		}
+
+		pgstat_report_wait_start(WAIT_EVENT_DOUBLE_WRITE_READ);
+		nread = pg_pread(fd, page.data, BLCKSZ, DW_PAGE_OFFSET(nslots, i));
+		pgstat_report_wait_end();
+		if (nread != BLCKSZ)
+		{
+			slot->seq = 0;
+			continue;
+		}
+
+		INIT_CRC32C(crc);
+		COMP_CRC32C(crc, slot, offsetof(DoubleWriteSlotHeader, crc));
+		COMP_CRC32C(crc, page.data, BLCKSZ);
+		FIN_CRC32C(crc);
+		if (!EQ_CRC32C(crc, slot->crc))
+		{
+			slot->seq = 0;
+			continue;
+		}
+
+		result = Max(result, slot->seq + 1);
+		nvalid++;
+	}
+
+	if (!restore || nvalid == 0)
+	{
+		pfree(slots);
+		CloseTransientFile(fd);
+		return result;
+	}
+
+	/* Sort the valid copies by block, latest first */
+	copies = palloc(nvalid * sizeof(DoubleWriteCopy));
+	nvalid = 0;
+	for (int i = 0; i < nslots; i++)
+	{
+		if (slots[i].seq == 0)
+			continue;
+		copies[nvalid].tag = slots[i].tag;
+		copies[nvalid].seq = slots[i].seq;
+		copies[nvalid].slot = i;
+		nvalid++;
+	}
+	qsort(copies, nvalid, sizeof(DoubleWriteCopy), copy_cmp);
+
+	for (int i = 0; i < nvalid; i++)
+	{
+		BufferTag  *tag = &copies[i].tag;
+		SMgrRelation reln;
+
+		if (i > 0 && BUFFERTAGS_EQUAL(copies[i - 1].tag, *tag))
+			continue;
+
+		reln = smgropen(tag->rnode, InvalidBackendId);
+		if (tag->forkNum < 0 || tag->forkNum > MAX_FORKNUM ||
+			!smgrexists(reln, tag->forkNum) ||
+			tag->blockNum >= smgrnblocks(reln, tag->forkNum))
+			continue;
+
+		pgstat_report_wait_start(WAIT_EVENT_DOUBLE_WRITE_READ);
+		nread = pg_pread(fd, page.data, BLCKSZ,
+						 DW_PAGE_OFFSET(nslots, copies[i].slot));
+		pgstat_report_wait_end();
+		if (nread != BLCKSZ)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read file \"%s\": %m",
+							DOUBLE_WRITE_FILENAME)));
+
+		smgrread(reln, tag->forkNum, tag->blockNum, current.data);
+		if (memcmp(page.data, current.data, BLCKSZ) == 0)
+			continue;
+		if (PageIsVerifiedExtended((Page) current.data, tag->blockNum, 0) &&
+			PageGetLSN((Page) current.data) > PageGetLSN((Page) page.data))
+			continue;
+
+		ereport(DEBUG1,
+				(errmsg_internal("restoring block %u of relation %u/%u/%u fork %d from double-write buffer",
+								 tag->blockNum, tag->rnode.spcNode,
+								 tag->rnode.dbNode, tag->rnode.relNode,
+								 tag->forkNum)));
+		smgrwrite(reln, tag->forkNum, tag->blockNum, page.data, true);
+		smgrimmedsync(reln, tag->forkNum);
+		nrestored++;
+	}
+
+	if (nrestored > 0)
+		ereport(LOG,
+				(errmsg_plural("restored %d page from double-write buffer",
+							   "restored %d pages from double-write buffer",
+							   nrestored, nrestored)));
+
+	pfree(copies);
+	pfree(slots);
+	CloseTransientFile(fd);
+
+	return result;
+}
+
+static int
+copy_cmp(const void *a, const void *b)
+{
+	const DoubleWriteCopy *ca = (const DoubleWriteCopy *) a;
+	const DoubleWriteCopy *cb = (const DoubleWriteCopy *) b;
+	int			r = memcmp(&ca->tag, &cb->tag, sizeof(BufferTag));
+
+	if (r != 0)
+		return r;
+	if (ca->seq != cb->seq)
+		return ca->seq > cb->seq ? -1 : 1;
+	return 0;
+}
+
+/*
+ * DoubleWriteCreateFile -- create an empty double-write buffer file, whose
+ * slots are all stale, and make it durable.
+ *
+ * The file is written out in full up front so that later fsyncs of it don't
+ * have to update the file size.
+ */
+static void
+DoubleWriteCreateFile(uint64 seq)
+{
+	int			nslots = DoubleWriteCtl->nslots;
+	int			nblocks = 1 + DW_SLOT_HEADER_BLOCKS(nslots) + nslots;
+	PGAlignedBlock block;
+	DoubleWriteFileHeader *header = (DoubleWriteFileHeader *) block.data;
+	int			fd;
+
+	fd = OpenTransientFile(DOUBLE_WRITE_FILENAME,
+						   O_RDWR | O_CREAT | O_TRUNC | PG_BINARY);
+	if (fd < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not create file \"%s\": %m",
+						DOUBLE_WRITE_FILENAME)));
+
+	for (int i = nblocks - 1; i >= 0; i--)
+	{
+		memset(block.data, 0, BLCKSZ);
+		if (i == 0)
+		{
+			header->magic = DOUBLE_WRITE_MAGIC;
+			header->nslots = nslots;
+			header->retired_upto = seq;
+			INIT_CRC32C(header->crc);
+			COMP_CRC32C(header->crc, header,
+						offsetof(DoubleWriteFileHeader, crc));
+			FIN_CRC32C(header->crc);
+		}
+
+		errno = 0;
+		pgstat_report_wait_start(WAIT_EVENT_DOUBLE_WRITE_WRITE);
+		if (pg_pwrite(fd, block.data, BLCKSZ, (off_t) i * BLCKSZ) != BLCKSZ)
+		{
+			/* if write didn't set errno, assume problem is no disk space */
+			if (errno == 0)
+				errno = ENOSPC;
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not write to file \"%s\": %m",
+							DOUBLE_WRITE_FILENAME)));
+		}
+		pgstat_report_wait_end();
+	}
+
+	pgstat_report_wait_start(WAIT_EVENT_DOUBLE_WRITE_SYNC);
+	if (pg_fsync(fd) != 0)
+		ereport(data_sync_elevel(ERROR),
+				(errcode_for_file_access(),
+				 errmsg("could not fsync file \"%s\": %m",
+						DOUBLE_WRITE_FILENAME)));
+	pgstat_report_wait_end();
+
+	if (CloseTransientFile(fd) != 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not close file \"%s\": %m",
+						DOUBLE_WRITE_FILENAME)));
+
+	fsync_fname(".", true);
+}
+
+/*
+ * DoubleWriteReserve -- reserve n consecutive slots for a write.
+ *
+ * On success, *seq is set to the sequence number of the first one.  If the
+ * ring is full, the oldest slots are retired first, which involves waiting
+ * for the writes through them to finish; if 'nowait', we return false
+ * instead.  A caller that has reserved slots it hasn't finished writing
+ * through must not wait, or it might wait for itself.
+ */
+bool
+DoubleWriteReserve(int n, uint64 *seq, bool nowait)
+{
+	int			nslots = DoubleWriteCtl->nslots;
+
+	Assert(DoubleWriteCtl->enabled);
+	Assert(n > 0 && n <= MAX_IO_COMBINE_LIMIT);
+
+	if (!DoubleWriteExitRegistered)
+	{
+		on_shmem_exit(DoubleWriteAtExit, 0);
+		DoubleWriteExitRegistered = true;
+	}
+	if (NumPendingRanges >= MAX_PENDING_RANGES)
+		elog(ERROR, "too many pending double-write buffer writes");
+
+	for (;;)
+	{
+		uint64		cur = pg_atomic_read_u64(&DoubleWriteCtl->next_seq);
+
+		while (cur + n <= pg_atomic_read_u64(&DoubleWriteCtl->retired_upto) + nslots)
+		{
+			if (pg_atomic_compare_exchange_u64(&DoubleWriteCtl->next_seq,
+											   &cur, cur + n))
+			{
+				PendingRanges[NumPendingRanges].seq = cur;
+				PendingRanges[NumPendingRanges].n = n;
+				NumPendingRanges++;
+				*seq = cur;
+				return true;
+			}
+		}
+
+		if (nowait)
+			return false;
+		Assert(NumPendingRanges == 0);
+		DoubleWriteRetire(cur + n - nslots);
+	}
+}
+
+/*
+ * DoubleWriteWrite -- write copies of n pages through the slots starting at
+ * seq, and make them durable.
+ *
+ * The caller must write the pages to the data files only after this, and
+ * then call DoubleWriteDone().
+ */
+void
+DoubleWriteWrite(uint64 seq, const BufferTag *tags, char **pages, int n)
+{
+	int			nslots = DoubleWriteCtl->nslots;
+	DoubleWriteSlotHeader headers[MAX_IO_COMBINE_LIMIT];
+	int			i = 0;
+
+	Assert(n > 0 && n <= MAX_IO_COMBINE_LIMIT);
+
+	DoubleWriteOpenFile();
+
+	while (i < n)
+	{
+		int			slot = (seq + i) % nslots;
+		int			nrun = Min(n - i, nslots - slot);
+
+		for (int j = i; j < i + nrun; j++)
+		{
+			DoubleWriteSlotHeader *header = &headers[j];
+
+			memset(header, 0, sizeof(DoubleWriteSlotHeader));
+			header->seq = seq + j;
+			header->tag = tags[j];
+			INIT_CRC32C(header->crc);
+			COMP_CRC32C(header->crc, header,
+						offsetof(DoubleWriteSlotHeader, crc));
+			COMP_CRC32C(header->crc, pages[j], BLCKSZ);
+			FIN_CRC32C(header->crc);
+
+			DoubleWriteCtl->slots[slot + j - i].tag = tags[j];
+		}
+
+		DoubleWriteWriteFile((char *) &headers[i],
+							 nrun * sizeof(DoubleWriteSlotHeader),
+							 DW_SLOT_HEADER_OFFSET(slot));
+		for (int j = i; j < i + nrun; j++)
+			DoubleWriteWriteFile(pages[j], BLCKSZ,
+								 DW_PAGE_OFFSET(nslots, slot + j - i));
+
+		i += nrun;
+	}
+
+	DoubleWriteSync();
+}
+
+/*
+ * DoubleWriteDone -- report that the data-file writes of n pages through
+ * the slots starting at seq have finished.
+ *
+ * Also used for the first part of a range reserved by DoubleWriteReserve(),
+ * if the data-file write was split.
+ */
+void
+DoubleWriteDone(uint64 seq, int n)
+{
+	int			nslots = DoubleWriteCtl->nslots;
+
+	/* make the slot tags visible before done_seq */
+	pg_write_barrier();
+
+	for (int i = 0; i < n; i++)
+		pg_atomic_write_u64(&DoubleWriteCtl->slots[(seq + i) % nslots].done_seq,
+							seq + i);
+
+	pg_memory_barrier();
+	if (pg_atomic_read_u32(&DoubleWriteCtl->retire_waiting) != 0)
+		ConditionVariableBroadcast(&DoubleWriteCtl->done_cv);
+
+	for (int i = 0; i < NumPendingRanges; i++)
+	{
+		PendingRange *range = &PendingRanges[i];
+
+		if (range->seq != seq)
+			continue;
+		Assert(n <= range->n);
+		range->seq += n;
+		range->n -= n;
+		if (range->n == 0)
+			PendingRanges[i] = PendingRanges[--NumPendingRanges];
+		break;
+	}
+}
+
+/*
+ * DoubleWriteAbort -- mark any slots this process has reserved, but not
+ * finished writing through, as done.
+ *
+ * Called during error recovery, after asynchronous writes have been waited
+ * for.  Whatever the data-file write got to, the slot is retired only after
+ * fsyncing the file, which is all that's needed; and if the double-write
+ * copy itself didn't make it to disk, neither did the data-file write.
+ */
+void
+DoubleWriteAbort(void)
+{
+	while (NumPendingRanges > 0)
+	{
+		PendingRange *range = &PendingRanges[NumPendingRanges - 1];
+
+		DoubleWriteDone(range->seq, range->n);
+	}
+}
+
+static void
+DoubleWriteAtExit(int code, Datum arg)
+{
+	DoubleWriteAbort();
+}
+
+/*
+ * DoubleWriteCheckpointHorizon -- return a sequence number below which all
+ * writes have finished.
+ *
+ * The checkpointer calls this before processing sync requests.  Once it has
+ * fsync'd the files, DoubleWriteCheckpointDone() retires the slots.
+ */
+uint64
+DoubleWriteCheckpointHorizon(void)
+{
+	int			nslots;
+	uint64		next_seq;
+	uint64		seq;
+
+	if (!DoubleWriteEnabled())
+		return 0;
+
+	nslots = DoubleWriteCtl->nslots;
+	next_seq = pg_atomic_read_u64(&DoubleWriteCtl->next_seq);
+	seq = pg_atomic_read_u64(&DoubleWriteCtl->retired_upto);
+
+	while (seq < next_seq &&
+		   pg_atomic_read_u64(&DoubleWriteCtl->slots[seq % nslots].done_seq) == seq)
+		seq++;
+
+	return seq;
+}
+
+/*
+ * DoubleWriteCheckpointDone -- retire the slots below the horizon returned
+ * by DoubleWriteCheckpointHorizon(), after a checkpoint's fsyncs.
+ */
+void
+DoubleWriteCheckpointDone(uint64 horizon)
+{
+	if (!DoubleWriteEnabled())
+		return;
+
+	LWLockAcquire(DoubleWriteRetireLock, LW_EXCLUSIVE);
+	if (horizon > pg_atomic_read_u64(&DoubleWriteCtl->retired_upto))
+	{
+		DoubleWriteWriteHeader(horizon);
+		pg_atomic_write_u64(&DoubleWriteCtl->retired_upto, horizon);
+	}
+	LWLockRelease(DoubleWriteRetireLock);
+}
+
+/*
+ * DoubleWriteRetire -- make slots reusable, by waiting for the writes
+ * through them to finish and fsyncing the data files written.
+ *
+ * At least the slots below target are retired, and for good measure half
+ * the ring, so that this doesn't happen on every write.
+ */
+static void
+DoubleWriteRetire(uint64 target)
+{
+	int			nslots = DoubleWriteCtl->nslots;
+	uint64		retired;
+	uint64		upto;
+	int			ntags = 0;
+
+	if (RetireFileTags == NULL)
+		RetireFileTags = MemoryContextAlloc(TopMemoryContext,
+											nslots * sizeof(FileTag));
+
+	LWLockAcquire(DoubleWriteRetireLock, LW_EXCLUSIVE);
+
+	retired = pg_atomic_read_u64(&DoubleWriteCtl->retired_upto);
+	if (retired >= target)
+	{
+		/* someone else did it while we waited for the lock */
+		LWLockRelease(DoubleWriteRetireLock);
+		return;
+	}
+	upto = Max(target, retired + nslots / 2);
+	upto = Min(upto, pg_atomic_read_u64(&DoubleWriteCtl->next_seq));
+
+	for (uint64 seq = retired; seq < upto; seq++)
+	{
+		DoubleWriteSlot *slot = &DoubleWriteCtl->slots[seq % nslots];
+		FileTag    *ftag = &RetireFileTags[ntags++];
+
+		if (pg_atomic_read_u64(&slot->done_seq) != seq)
+		{
+			ConditionVariablePrepareToSleep(&DoubleWriteCtl->done_cv);
+			pg_atomic_write_u32(&DoubleWriteCtl->retire_waiting, 1);
+			pg_memory_barrier();
+			while (pg_atomic_read_u64(&slot->done_seq) != seq)
+				ConditionVariableSleep(&DoubleWriteCtl->done_cv,
+									   WAIT_EVENT_DOUBLE_WRITE_SLOT_DONE);
+			ConditionVariableCancelSleep();
+			pg_atomic_write_u32(&DoubleWriteCtl->retire_waiting, 0);
+		}
+		pg_read_barrier();
+
+		memset(ftag, 0, sizeof(FileTag));
+		ftag->handler = SYNC_HANDLER_MD;
+		ftag->rnode = slot->tag.rnode;
+		ftag->forknum = slot->tag.forkNum;
+		ftag->segno = slot->tag.blockNum / ((BlockNumber) RELSEG_SIZE);
+	}
+
+	/*
+	 * Fsync each data-file segment once.  A file that's gone has been
+	 * dropped, and won't be read after a crash either.
+	 */
+	qsort(RetireFileTags, ntags, sizeof(FileTag), filetag_cmp);
+	for (int i = 0; i < ntags; i++)
+	{
+		char		path[MAXPGPATH];
+
+		if (i > 0 && filetag_cmp(&RetireFileTags[i - 1], &RetireFileTags[i]) == 0)
+			continue;
+
+		if (mdsyncfiletag(&RetireFileTags[i], path) < 0 &&
+			!FILE_POSSIBLY_DELETED(errno))
+			ereport(data_sync_elevel(ERROR),
+					(errcode_for_file_access(),
+					 errmsg("could not fsync file \"%s\": %m", path)));
+	}
+
+	DoubleWriteWriteHeader(upto);
+	pg_atomic_write_u64(&DoubleWriteCtl->retired_upto, upto);
+
+	LWLockRelease(DoubleWriteRetireLock);
+}
+
+static int
+filetag_cmp(const void *a, const void *b)
+{
+	return memcmp(a, b, sizeof(FileTag));
+}
+
+/*
+ * Record a new retirement horizon in the header block.  Caller must hold
+ * DoubleWriteRetireLock.
+ */
+static void
+DoubleWriteWriteHeader(uint64 retired_upto)
+{
+	DoubleWriteFileHeader header;
+
+	Assert(LWLockHeldByMeInMode(DoubleWriteRetireLock, LW_EXCLUSIVE));
+
+	memset(&header, 0, sizeof(header));
+	header.magic = DOUBLE_WRITE_MAGIC;
+	header.nslots = DoubleWriteCtl->nslots;
+	header.retired_upto = retired_upto;
+	INIT_CRC32C(header.crc);
+	COMP_CRC32C(header.crc, &header, offsetof(DoubleWriteFileHeader, crc));
+	FIN_CRC32C(header.crc);
+
+	DoubleWriteOpenFile();
+	DoubleWriteWriteFile((char *) &header, sizeof(header), 0);
+	DoubleWriteSync();
+}
+
+static void
+DoubleWriteOpenFile(void)
+{
+	if (DoubleWriteFile >= 0)
+		return;
+
+	DoubleWriteFile = PathNameOpenFile(DOUBLE_WRITE_FILENAME, O_RDWR | PG_BINARY);
+	if (DoubleWriteFile < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m",
+						DOUBLE_WRITE_FILENAME)));
+}
+
+static void
+DoubleWriteWriteFile(char *buffer, int amount, off_t offset)
+{
+	int			nbytes;
+
+	nbytes = FileWrite(DoubleWriteFile, buffer, amount, offset,
+					   WAIT_EVENT_DOUBLE_WRITE_WRITE);
+	if (nbytes != amount)
+	{
+		if (nbytes < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not write to file \"%s\": %m",
+							DOUBLE_WRITE_FILENAME)));
+		ereport(ERROR,
+				(errcode(ERRCODE_DISK_FULL),
+				 errmsg("could not write to file \"%s\": wrote only %d of %d bytes",
+						DOUBLE_WRITE_FILENAME, nbytes, amount),
+				 errhint("Check free disk space.")));
+	}
+}
+
+/*
+ * DoubleWriteSync -- make sure everything this process has written to the
+ * file is durable.
+ *
+ * Any fsync that starts after our writes will do.  If one is in progress,
+ * we wait for it and check again; often a later writer will have covered
+ * us in the meantime.
+ */
+static void
+DoubleWriteSync(void)
+{
+	uint64		needed = pg_atomic_read_u64(&DoubleWriteCtl->fsync_started) + 1;
+
+	while (pg_atomic_read_u64(&DoubleWriteCtl->fsync_done) < needed)
+	{
+		if (!LWLockAcquireOrWait(DoubleWriteFlushLock, LW_EXCLUSIVE))
+			continue;
+
+		if (pg_atomic_read_u64(&DoubleWriteCtl->fsync_done) < needed)
+		{
+			uint64		started;
+
+			started = pg_atomic_add_fetch_u64(&DoubleWriteCtl->fsync_started, 1);
+			if (FileSync(DoubleWriteFile, WAIT_EVENT_DOUBLE_WRITE_SYNC) < 0)
+				ereport(data_sync_elevel(ERROR),
+						(errcode_for_file_access(),
+						 errmsg("could not fsync file \"%s\": %m",
+								DOUBLE_WRITE_FILENAME)));
+			pg_atomic_write_u64(&DoubleWriteCtl->fsync_done, started);
+		}
+		LWLockRelease(DoubleWriteFlushLock);
+	}
+}
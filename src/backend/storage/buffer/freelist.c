@@ -24,20 +24,75 @@
 
 
 /*
- * The shared freelist control information.
+ * The clock sweep is split into partitions, each covering a contiguous range
+ * of buffers with its own clock hand, so that backends running the sweep
+ * concurrently don't all bounce the same cache line.  Each backend starts in
+ * a "home" partition and moves on to the others ("steals") when it cannot
+ * find a cheap victim there, i.e. one within CLOCK_SWEEP_STEAL_TICKS ticks of
+ * the hand.  A backend that had to steal adopts the partition it stole from
+ * as its new home, so that a backend's working set can spread over the whole
+ * buffer pool rather than being confined to one partition.
+ *
+ * Each partition is padded to a cache line to avoid false sharing.
+ */
+#define MAX_CLOCK_SWEEP_PARTITIONS		64
+
+/*
+ * Don't create partitions smaller than this many buffers when choosing the
+ * number automatically; a sweep over a tiny partition would evict pages
+ * much more eagerly than one over the whole pool.
  */
+#define MIN_CLOCK_SWEEP_PARTITION_SIZE	16384
+
+/*
+ * How far the clock hand of a partition may advance for one allocation
+ * before we try the next partition instead.  Only once no partition has a
+ * victim that cheap do we run the unbounded sweep.
+ */
+#define CLOCK_SWEEP_STEAL_TICKS			1024
+
 typedef struct
 {
-	/* Spinlock: protects the values below */
-	slock_t		buffer_strategy_lock;
+	/* Spinlock: protects completePasses */
+	slock_t		clock_sweep_lock;
+
+	/* Range of buffers covered by this partition; constant after init */
+	int			firstBuffer;
+	int			numBuffers;
 
 	/*
-	 * Clock sweep hand: index of next buffer to consider grabbing. Note that
-	 * this isn't a concrete buffer - we only ever increase the value. So, to
-	 * get an actual buffer, it needs to be used modulo NBuffers.
+	 * Clock sweep hand: index, relative to firstBuffer, of next buffer to
+	 * consider grabbing. Note that this isn't a concrete buffer - we only
+	 * ever increase the value. So, to get an actual buffer, it needs to be
+	 * used modulo numBuffers.
 	 */
 	pg_atomic_uint32 nextVictimBuffer;
 
+	/*
+	 * Statistics.  These counters should be wide enough that they can't
+	 * overflow during a single bgwriter cycle.
+	 */
+	uint32		completePasses; /* Complete cycles of the clock sweep */
+	pg_atomic_uint32 numBufferAllocs;	/* Buffers allocated since last reset */
+} ClockSweepPartition;
+
+typedef union ClockSweepPartitionPadded
+{
+	ClockSweepPartition part;
+	char		pad[PG_CACHE_LINE_SIZE];
+} ClockSweepPartitionPadded;
+
+StaticAssertDecl(sizeof(ClockSweepPartition) <= PG_CACHE_LINE_SIZE,
+				 "ClockSweepPartition must fit in a cache line");
+
+/*
+ * The shared freelist control information.
+ */
+typedef struct
+{
+	/* Spinlock: protects the values below */
+	slock_t		buffer_strategy_lock;
+
 	int			firstFreeBuffer;	/* Head of list of unused buffers */
 	int			lastFreeBuffer; /* Tail of list of unused buffers */
 
@@ -47,21 +102,34 @@ typedef struct
 	 */
 
 	/*
-	 * Statistics.  These counters should be wide enough that they can't
-	 * overflow during a single bgwriter cycle.
+	 * Buffers from nextUnusedBuffer up have never been handed out, and their
+	 * headers have not been initialized yet (see InitBufferPool).  They are
+	 * used up before the clock sweep starts, which must not run until
+	 * numUninitializedBuffers, counting those handed out but not yet
+	 * initialized too, drops to zero.
 	 */
-	uint32		completePasses; /* Complete cycles of the clock sweep */
-	pg_atomic_uint32 numBufferAllocs;	/* Buffers allocated since last reset */
+	int			nextUnusedBuffer;
+	pg_atomic_uint32 numUninitializedBuffers;
 
 	/*
 	 * Bgworker process to be notified upon activity or -1 if none. See
 	 * StrategyNotifyBgWriter.
 	 */
 	int			bgwprocno;
+
+	/* Number of clock sweep partitions; constant after init */
+	int			numPartitions;
 } BufferStrategyControl;
 
+/* GUC variable */
+int			clock_sweep_partitions = -1;
+
 /* Pointers to shared state */
 static BufferStrategyControl *StrategyControl = NULL;
+static ClockSweepPartitionPadded *ClockSweepPartitions = NULL;
+
+/* This backend's home clock sweep partition */
+static int	MyClockSweepPartition = -1;
 
 /*
  * Private (non-shared) state for managing a ring of shared buffers to re-use.
@@ -98,19 +166,24 @@ typedef struct BufferAccessStrategyData
 
 
 /* Prototypes for internal functions */
+static int	ClockSweepComputePartitions(void);
 static BufferDesc *GetBufferFromRing(BufferAccessStrategy strategy,
 									 uint32 *buf_state);
 static void AddBufferToRing(BufferAccessStrategy strategy,
 							BufferDesc *buf);
+static BufferDesc *ClockSweepPartitionGetBuffer(ClockSweepPartition *part,
+												BufferAccessStrategy strategy,
+												uint32 *buf_state,
+												int maxTicks);
 
 /*
  * ClockSweepTick - Helper routine for StrategyGetBuffer()
  *
- * Move the clock hand one buffer ahead of its current position and return the
- * id of the buffer now under the hand.
+ * Move the given partition's clock hand one buffer ahead of its current
+ * position and return the id of the buffer now under the hand.
  */
 static inline uint32
-ClockSweepTick(void)
+ClockSweepTick(ClockSweepPartition *part)
 {
 	uint32		victim;
 
@@ -120,14 +193,14 @@ ClockSweepTick(void)
 	 * apparent order.
 	 */
 	victim =
-		pg_atomic_fetch_add_u32(&StrategyControl->nextVictimBuffer, 1);
+		pg_atomic_fetch_add_u32(&part->nextVictimBuffer, 1);
 
-	if (victim >= NBuffers)
+	if (victim >= part->numBuffers)
 	{
 		uint32		originalVictim = victim;
 
 		/* always wrap what we look up in BufferDescriptors */
-		victim = victim % NBuffers;
+		victim = victim % part->numBuffers;
 
 		/*
 		 * If we're the one that just caused a wraparound, force
@@ -153,19 +226,62 @@ ClockSweepTick(void)
 				 * could lead to an overflow of nextVictimBuffers, but that's
 				 * highly unlikely and wouldn't be particularly harmful.
 				 */
-				SpinLockAcquire(&StrategyControl->buffer_strategy_lock);
+				SpinLockAcquire(&part->clock_sweep_lock);
 
-				wrapped = expected % NBuffers;
+				wrapped = expected % part->numBuffers;
 
-				success = pg_atomic_compare_exchange_u32(&StrategyControl->nextVictimBuffer,
+				success = pg_atomic_compare_exchange_u32(&part->nextVictimBuffer,
 														 &expected, wrapped);
 				if (success)
-					StrategyControl->completePasses++;
-				SpinLockRelease(&StrategyControl->buffer_strategy_lock);
+					part->completePasses++;
+				SpinLockRelease(&part->clock_sweep_lock);
 			}
 		}
 	}
-	return victim;
+	return part->firstBuffer + victim;
+}
+
+/*
+ * ClockSweepHomePartition -- choose this backend's home partition
+ *
+ * Backends are initially spread over the partitions by their PGPROC number.
+ * StrategyGetBuffer() moves a backend's home elsewhere when it steals from
+ * another partition.  Processes without a PGPROC (which shouldn't normally
+ * get here) start in the first partition.
+ */
+static inline int
+ClockSweepHomePartition(void)
+{
+	if (unlikely(MyClockSweepPartition < 0))
+	{
+		if (MyProc != NULL)
+			MyClockSweepPartition = MyProc->pgprocno %
+				StrategyControl->numPartitions;
+		else
+			MyClockSweepPartition = 0;
+	}
+	return MyClockSweepPartition;
+}
+
+/*
+ * ClockSweepComputePartitions -- decide how many clock sweep partitions to use
+ *
+ * clock_sweep_partitions = -1 picks a number based on the size of the buffer
+ * pool.  Either way, we never let a partition get very small.
+ */
+static int
+ClockSweepComputePartitions(void)
+{
+	int			nparts;
+
+	if (clock_sweep_partitions >= 0)
+		nparts = clock_sweep_partitions;
+	else
+		nparts = NBuffers / MIN_CLOCK_SWEEP_PARTITION_SIZE;
+
+	nparts = Min(nparts, NBuffers / 16);
+	nparts = Min(nparts, MAX_CLOCK_SWEEP_PARTITIONS);
+	return Max(nparts, 1);
 }
 
 /*
@@ -179,7 +295,8 @@ ClockSweepTick(void)
 bool
 have_free_buffer(void)
 {
-	if (StrategyControl->firstFreeBuffer >= 0)
+	if (StrategyControl->firstFreeBuffer >= 0 ||
+		StrategyControl->nextUnusedBuffer < NBuffers)
 		return true;
 	else
 		return false;
@@ -202,7 +319,8 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 {
 	BufferDesc *buf;
 	int			bgwprocno;
-	int			trycounter;
+	int			home;
+	int			i;
 	uint32		local_buf_state;	/* to avoid repeated (de-)referencing */
 
 	/*
@@ -243,11 +361,13 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 	}
 
 	/*
-	 * We count buffer allocation requests so that the bgwriter can estimate
-	 * the rate of buffer consumption.  Note that buffers recycled by a
-	 * strategy object are intentionally not counted here.
+	 * We count buffer allocations so that the bgwriter can estimate the rate
+	 * of buffer consumption in each partition.  Buffers taken from the
+	 * freelist are charged to our home partition, those found by the clock
+	 * sweep to the partition they were found in.  Note that buffers recycled
+	 * by a strategy object are intentionally not counted.
 	 */
-	pg_atomic_fetch_add_u32(&StrategyControl->numBufferAllocs, 1);
+	home = ClockSweepHomePartition();
 
 	/*
 	 * First check, without acquiring the lock, whether there's buffers in the
@@ -302,6 +422,7 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 			if (BUF_STATE_GET_REFCOUNT(local_buf_state) == 0
 				&& BUF_STATE_GET_USAGECOUNT(local_buf_state) == 0)
 			{
+				pg_atomic_fetch_add_u32(&ClockSweepPartitions[home].part.numBufferAllocs, 1);
 				if (strategy != NULL)
 					AddBufferToRing(strategy, buf);
 				*buf_state = local_buf_state;
@@ -311,11 +432,126 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 		}
 	}
 
-	/* Nothing on the freelist, so run the "clock sweep" algorithm */
-	trycounter = NBuffers;
+	/*
+	 * Next, use a buffer that has never been used before, if any are left.
+	 * We have to initialize its header first.  As nobody else knows about
+	 * the buffer yet, it's bound to be usable.
+	 */
+	if (StrategyControl->nextUnusedBuffer < NBuffers)
+	{
+		int			buf_id = -1;
+
+		SpinLockAcquire(&StrategyControl->buffer_strategy_lock);
+		if (StrategyControl->nextUnusedBuffer < NBuffers)
+			buf_id = StrategyControl->nextUnusedBuffer++;
+		SpinLockRelease(&StrategyControl->buffer_strategy_lock);
+
+		if (buf_id >= 0)
+		{
+			InitBufferDescriptor(buf_id);
+			pg_atomic_fetch_sub_u32(&StrategyControl->numUninitializedBuffers, 1);
+
+			buf = GetBufferDescriptor(buf_id);
+			local_buf_state = LockBufHdr(buf);
+			Assert(BUF_STATE_GET_REFCOUNT(local_buf_state) == 0 &&
+				   BUF_STATE_GET_USAGECOUNT(local_buf_state) == 0);
+
+			pg_atomic_fetch_add_u32(&ClockSweepPartitions[home].part.numBufferAllocs, 1);
+			if (strategy != NULL)
+				AddBufferToRing(strategy, buf);
+			*buf_state = local_buf_state;
+			return buf;
+		}
+	}
+
+	/*
+	 * The clock sweep mustn't come across a buffer whose header is still
+	 * being initialized.  Once all buffers have been handed out once, that
+	 * can only be the case for a moment, so just wait it out.
+	 */
+	if (unlikely(pg_atomic_read_u32(&StrategyControl->numUninitializedBuffers) > 0))
+	{
+		SpinDelayStatus delayStatus;
+
+		init_local_spin_delay(&delayStatus);
+		while (pg_atomic_read_u32(&StrategyControl->numUninitializedBuffers) > 0)
+			perform_spin_delay(&delayStatus);
+		finish_spin_delay(&delayStatus);
+	}
+
+	/*
+	 * Nothing on the freelist, so run the "clock sweep" algorithm, starting
+	 * with our home partition.  If the home partition has no victim within
+	 * CLOCK_SWEEP_STEAL_TICKS of its hand, steal from the next one, and so
+	 * on.  If we find a victim elsewhere, make that partition our new home:
+	 * it evidently holds colder buffers than the old one.
+	 */
+	for (i = 0; i < StrategyControl->numPartitions; i++)
+	{
+		int			partno = (home + i) % StrategyControl->numPartitions;
+
+		buf = ClockSweepPartitionGetBuffer(&ClockSweepPartitions[partno].part,
+										   strategy, buf_state,
+										   CLOCK_SWEEP_STEAL_TICKS);
+		if (buf != NULL)
+		{
+			MyClockSweepPartition = partno;
+			return buf;
+		}
+	}
+
+	/*
+	 * No partition has a cheap victim.  Run the unbounded sweep, which keeps
+	 * decrementing usage counts until it finds a victim, over each partition
+	 * in turn.  It only moves on when every buffer in a partition is pinned;
+	 * only when all partitions have been tried do we give up.
+	 */
+	for (i = 0; i < StrategyControl->numPartitions; i++)
+	{
+		ClockSweepPartition *part;
+
+		part = &ClockSweepPartitions[(home + i) % StrategyControl->numPartitions].part;
+
+		buf = ClockSweepPartitionGetBuffer(part, strategy, buf_state, 0);
+		if (buf != NULL)
+			return buf;
+	}
+
+	/*
+	 * We've scanned all the buffers without making any state changes, so all
+	 * the buffers are pinned (or were when we looked at them).  We could hope
+	 * that someone will free one eventually, but it's probably better to fail
+	 * than to risk getting stuck in an infinite loop.
+	 */
+	elog(ERROR, "no unpinned buffers available");
+	return NULL;				/* keep compiler quiet */
+}
+
+/*
+ * ClockSweepPartitionGetBuffer -- run the clock sweep over one partition
+ *
+ * Returns a usable buffer with its header spinlock held, or NULL if a full
+ * lap of the partition found every buffer pinned.  If maxTicks > 0, also
+ * give up (returning NULL) once the hand has been advanced that many times.
+ */
+static BufferDesc *
+ClockSweepPartitionGetBuffer(ClockSweepPartition *part,
+							 BufferAccessStrategy strategy,
+							 uint32 *buf_state,
+							 int maxTicks)
+{
+	BufferDesc *buf;
+	int			trycounter;
+	int			ticks = 0;
+	uint32		local_buf_state;	/* to avoid repeated (de-)referencing */
+
+	trycounter = part->numBuffers;
 	for (;;)
 	{
-		buf = GetBufferDescriptor(ClockSweepTick());
+		if (maxTicks > 0 && ticks++ >= maxTicks)
+			return NULL;
+
+		buf = GetBufferDescriptor(ClockSweepTick(part));
 
 		/*
 		 * If the buffer is pinned or has a nonzero usage_count, we cannot use
@@ -329,11 +565,12 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 			{
 				local_buf_state -= BUF_USAGECOUNT_ONE;
 
-				trycounter = NBuffers;
+				trycounter = part->numBuffers;
 			}
 			else
 			{
 				/* Found a usable buffer */
+				pg_atomic_fetch_add_u32(&part->numBufferAllocs, 1);
 				if (strategy != NULL)
 					AddBufferToRing(strategy, buf);
 				*buf_state = local_buf_state;
@@ -342,15 +579,9 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 		}
 		else if (--trycounter == 0)
 		{
-			/*
-			 * We've scanned all the buffers without making any state changes,
-			 * so all the buffers are pinned (or were when we looked at them).
-			 * We could hope that someone will free one eventually, but it's
-			 * probably better to fail than to risk getting stuck in an
-			 * infinite loop.
-			 */
+			/* Every buffer in this partition is pinned */
 			UnlockBufHdr(buf, local_buf_state);
-			elog(ERROR, "no unpinned buffers available");
+			return NULL;
 		}
 		UnlockBufHdr(buf, local_buf_state);
 	}
@@ -380,45 +611,74 @@ StrategyFreeBuffer(BufferDesc *buf)
 }
 
 /*
- * StrategySyncStart -- tell BufferSync where to start syncing
+ * StrategySyncStart -- tell BgBufferSync where to start syncing
  *
- * The result is the buffer index of the best buffer to sync first.
- * BufferSync() will proceed circularly around the buffer array from there.
+ * The result is the buffer index of the best buffer of the given clock sweep
+ * partition to sync first.  BgBufferSync() will proceed circularly around
+ * the partition's buffers from there.
  *
- * In addition, we return the completed-pass count (which is effectively
- * the higher-order bits of nextVictimBuffer) and the count of recent buffer
- * allocs if non-NULL pointers are passed.  The alloc count is reset after
- * being read.
+ * In addition, we return the partition's completed-pass count (which is
+ * effectively the higher-order bits of nextVictimBuffer) and the count of
+ * recent buffer allocs from it if non-NULL pointers are passed.  The alloc
+ * count is reset after being read.
  */
 int
-StrategySyncStart(uint32 *complete_passes, uint32 *num_buf_alloc)
+StrategySyncStart(int partition, uint32 *complete_passes, uint32 *num_buf_alloc)
 {
+	ClockSweepPartition *part;
 	uint32		nextVictimBuffer;
 	int			result;
 
-	SpinLockAcquire(&StrategyControl->buffer_strategy_lock);
-	nextVictimBuffer = pg_atomic_read_u32(&StrategyControl->nextVictimBuffer);
-	result = nextVictimBuffer % NBuffers;
+	Assert(partition >= 0 && partition < StrategyControl->numPartitions);
+	part = &ClockSweepPartitions[partition].part;
+
+	SpinLockAcquire(&part->clock_sweep_lock);
+	nextVictimBuffer = pg_atomic_read_u32(&part->nextVictimBuffer);
+	result = part->firstBuffer + nextVictimBuffer % part->numBuffers;
 
 	if (complete_passes)
 	{
-		*complete_passes = StrategyControl->completePasses;
+		*complete_passes = part->completePasses;
 
 		/*
 		 * Additionally add the number of wraparounds that happened before
 		 * completePasses could be incremented. C.f. ClockSweepTick().
 		 */
-		*complete_passes += nextVictimBuffer / NBuffers;
+		*complete_passes += nextVictimBuffer / part->numBuffers;
 	}
 
 	if (num_buf_alloc)
 	{
-		*num_buf_alloc = pg_atomic_exchange_u32(&StrategyControl->numBufferAllocs, 0);
+		*num_buf_alloc = pg_atomic_exchange_u32(&part->numBufferAllocs, 0);
 	}
-	SpinLockRelease(&StrategyControl->buffer_strategy_lock);
+	SpinLockRelease(&part->clock_sweep_lock);
 	return result;
 }
 
+/*
+ * StrategyNumPartitions -- number of clock sweep partitions
+ */
+int
+StrategyNumPartitions(void)
+{
+	return StrategyControl->numPartitions;
+}
+
+/*
+ * StrategyPartitionRange -- report the buffers covered by a partition
+ */
+void
+StrategyPartitionRange(int partition, int *first_buffer, int *num_buffers)
+{
+	ClockSweepPartition *part;
+
+	Assert(partition >= 0 && partition < StrategyControl->numPartitions);
+	part = &ClockSweepPartitions[partition].part;
+
+	*first_buffer = part->firstBuffer;
+	*num_buffers = part->numBuffers;
+}
+
 /*
  * StrategyNotifyBgWriter -- set or clear allocation notification latch
  *
@@ -460,6 +720,11 @@ StrategyShmemSize(void)
 	/* size of the shared replacement strategy control block */
 	size = add_size(size, MAXALIGN(sizeof(BufferStrategyControl)));
 
+	/* size of the clock sweep partitions, plus alignment padding */
+	size = add_size(size, PG_CACHE_LINE_SIZE);
+	size = add_size(size, mul_size(ClockSweepComputePartitions(),
+								   sizeof(ClockSweepPartitionPadded)));
+
 	return size;
 }
 
@@ -467,13 +732,15 @@ StrategyShmemSize(void)
  * StrategyInitialize -- initialize the buffer cache replacement
  *		strategy.
  *
- * Assumes: All of the buffers are already built into a linked list.
- *		Only called by postmaster and only during initialization.
+ * Only called by postmaster and only during initialization.
  */
 void
 StrategyInitialize(bool init)
 {
 	bool		found;
+	bool		foundParts;
+	int			nparts = ClockSweepComputePartitions();
+	char	   *ptr;
 
 	/*
 	 * Initialize the shared buffer lookup hashtable.
@@ -495,6 +762,13 @@ StrategyInitialize(bool init)
 						sizeof(BufferStrategyControl),
 						&found);
 
+	/* Align the partitions to cache lines, as LWLocks do */
+	ptr = ShmemInitStruct("Buffer Strategy Partitions",
+						  PG_CACHE_LINE_SIZE +
+						  nparts * sizeof(ClockSweepPartitionPadded),
+						  &foundParts);
+	ClockSweepPartitions = (ClockSweepPartitionPadded *) CACHELINEALIGN(ptr);
+
 	if (!found)
 	{
 		/*
@@ -505,24 +779,46 @@ StrategyInitialize(bool init)
 		SpinLockInit(&StrategyControl->buffer_strategy_lock);
 
 		/*
-		 * Grab the whole linked list of free buffers for our strategy. We
-		 * assume it was previously set up by InitBufferPool().
+		 * The freelist starts out empty; instead, all buffers are unused and
+		 * get handed out in order.  (lastFreeBuffer is undefined while the
+		 * list is empty.)
 		 */
-		StrategyControl->firstFreeBuffer = 0;
-		StrategyControl->lastFreeBuffer = NBuffers - 1;
-
-		/* Initialize the clock sweep pointer */
-		pg_atomic_init_u32(&StrategyControl->nextVictimBuffer, 0);
-
-		/* Clear statistics */
-		StrategyControl->completePasses = 0;
-		pg_atomic_init_u32(&StrategyControl->numBufferAllocs, 0);
+		StrategyControl->firstFreeBuffer = FREENEXT_END_OF_LIST;
+		StrategyControl->lastFreeBuffer = FREENEXT_END_OF_LIST;
+		StrategyControl->nextUnusedBuffer = 0;
+		pg_atomic_init_u32(&StrategyControl->numUninitializedBuffers, NBuffers);
 
 		/* No pending notification */
 		StrategyControl->bgwprocno = -1;
+
+		/*
+		 * Divide the buffers into nparts contiguous ranges of (nearly) equal
+		 * size, and initialize each range's clock sweep.
+		 */
+		StrategyControl->numPartitions = nparts;
+		for (int i = 0; i < nparts; i++)
+		{
+			ClockSweepPartition *part = &ClockSweepPartitions[i].part;
+			int			first = (int) (((int64) NBuffers * i) / nparts);
+			int			next = (int) (((int64) NBuffers * (i + 1)) / nparts);
+
+			SpinLockInit(&part->clock_sweep_lock);
+			part->firstBuffer = first;
+			part->numBuffers = next - first;
+
+			/* Initialize the clock sweep pointer */
+			pg_atomic_init_u32(&part->nextVictimBuffer, 0);
+
+			/* Clear statistics */
+			part->completePasses = 0;
+			pg_atomic_init_u32(&part->numBufferAllocs, 0);
+		}
 	}
 	else
+	{
 		Assert(!init);
+		Assert(foundParts);
+	}
 }
 
 
@@ -98,9 +98,11 @@
 #include "port/pg_iovec.h"
 #include "portability/mem.h"
 #include "postmaster/startup.h"
+#include "storage/aio.h"
 #include "storage/fd.h"
 #include "storage/ipc.h"
 #include "utils/guc.h"
+#include "utils/varlena.h"
 #include "utils/resowner_private.h"
 
 /* Define PG_FLUSH_DATA_WORKS if we have an implementation for pg_flush_data */
@@ -165,6 +167,9 @@ bool		data_sync_retry = false;
 /* How SyncDataDirectory() should do its job. */
 int			recovery_init_sync_method = RECOVERY_INIT_SYNC_METHOD_FSYNC;
 
+/* Which kinds of files to open with O_DIRECT; see the io_direct GUC. */
+int			io_direct_flags = 0;
+
 /* Debugging.... */
 
 #ifdef FDDEBUG
@@ -2164,6 +2169,121 @@ retry:
 	return returnCode;
 }
 
+/*
+ * Like FileRead(), but scatters the data into the iovcnt buffers described by
+ * iov using a single system call.  As with FileRead(), a short read is not
+ * treated as an error; the caller must check the returned byte count.
+ */
+int
+FileReadV(File file, const struct iovec *iov, int iovcnt, off_t offset,
+		  uint32 wait_event_info)
+{
+	int			returnCode;
+	Vfd		   *vfdP;
+
+	Assert(FileIsValid(file));
+	Assert(iovcnt > 0 && iovcnt <= PG_IOV_MAX);
+
+	DO_DB(elog(LOG, "FileReadV: %d (%s) " INT64_FORMAT " %d",
+			   file, VfdCache[file].fileName,
+			   (int64) offset,
+			   iovcnt));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return returnCode;
+
+	vfdP = &VfdCache[file];
+
+retry:
+	pgstat_report_wait_start(wait_event_info);
+	returnCode = pg_preadv(vfdP->fd, iov, iovcnt, offset);
+	pgstat_report_wait_end();
+
+	if (returnCode < 0)
+	{
+		/* See comments in FileRead() */
+#ifdef WIN32
+		DWORD		error = GetLastError();
+
+		switch (error)
+		{
+			case ERROR_NO_SYSTEM_RESOURCES:
+				pg_usleep(1000L);
+				errno = EINTR;
+				break;
+			default:
+				_dosmaperr(error);
+				break;
+		}
+#endif
+		/* OK to retry if interrupted */
+		if (errno == EINTR)
+			goto retry;
+	}
+
+	return returnCode;
+}
+
+/*
+ * FileStartReadV / FileStartWriteV --- start asynchronous vectored I/O
+ *
+ * The I/O is started with the given AIO handle, and must be completed with
+ * pgaio_io_wait().  Returns 0 on success, or -1 with errno set if the file
+ * could not be opened, in which case the handle has not been used.
+ *
+ * Unlike FileWrite(), no temp_file_limit accounting is done here, so these
+ * are only meant for relation data files.
+ */
+int
+FileStartReadV(PgAioHandle *ioh, File file, const struct iovec *iov,
+			   int iovcnt, off_t offset, uint32 wait_event_info)
+{
+	int			returnCode;
+
+	Assert(FileIsValid(file));
+
+	DO_DB(elog(LOG, "FileStartReadV: %d (%s) " INT64_FORMAT " %d",
+			   file, VfdCache[file].fileName,
+			   (int64) offset,
+			   iovcnt));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return returnCode;
+
+	pgaio_io_start_readv(ioh, VfdCache[file].fd, VfdCache[file].fileName,
+						 VfdCache[file].fileFlags, iov, iovcnt, offset,
+						 wait_event_info);
+
+	return 0;
+}
+
+int
+FileStartWriteV(PgAioHandle *ioh, File file, const struct iovec *iov,
+				int iovcnt, off_t offset, uint32 wait_event_info)
+{
+	int			returnCode;
+
+	Assert(FileIsValid(file));
+	Assert((VfdCache[file].fdstate & FD_TEMP_FILE_LIMIT) == 0);
+
+	DO_DB(elog(LOG, "FileStartWriteV: %d (%s) " INT64_FORMAT " %d",
+			   file, VfdCache[file].fileName,
+			   (int64) offset,
+			   iovcnt));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return returnCode;
+
+	pgaio_io_start_writev(ioh, VfdCache[file].fd, VfdCache[file].fileName,
+						  VfdCache[file].fileFlags, iov, iovcnt, offset,
+						  wait_event_info);
+
+	return 0;
+}
+
 int
 FileWrite(File file, char *buffer, int amount, off_t offset,
 		  uint32 wait_event_info)
@@ -2262,6 +2382,109 @@ retry:
 	return returnCode;
 }
 
+/*
+ * FileZero - write zeroes to a range of a file
+ *
+ * Meant for extending relation files, so it doesn't do the temp_file_limit
+ * accounting FileWrite() does.  Returns 0 on success, or -1 with errno set.
+ */
+int
+FileZero(File file, off_t offset, off_t amount, uint32 wait_event_info)
+{
+	/* aligned so that it can be used with direct I/O */
+	static const PGIOAlignedBlock zbuffer = {{0}};
+	struct iovec iov[PG_IOV_MAX];
+	int			returnCode;
+
+	Assert(FileIsValid(file));
+	Assert(!(VfdCache[file].fdstate & FD_TEMP_FILE_LIMIT));
+
+	DO_DB(elog(LOG, "FileZero: %d (%s) " INT64_FORMAT " " INT64_FORMAT,
+			   file, VfdCache[file].fileName,
+			   (int64) offset, (int64) amount));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return returnCode;
+
+	for (int i = 0; i < PG_IOV_MAX; i++)
+	{
+		iov[i].iov_base = unconstify(char *, &zbuffer.data[0]);
+		iov[i].iov_len = BLCKSZ;
+	}
+
+	while (amount > 0)
+	{
+		off_t		chunk = Min(amount, (off_t) BLCKSZ * PG_IOV_MAX);
+		int			iovcnt = (chunk + BLCKSZ - 1) / BLCKSZ;
+		ssize_t		written;
+
+		/* the last iovec may cover less than a block */
+		iov[iovcnt - 1].iov_len = chunk - (off_t) BLCKSZ * (iovcnt - 1);
+
+		pgstat_report_wait_start(wait_event_info);
+		written = pg_pwritev_with_retry(VfdCache[file].fd, iov, iovcnt, offset);
+		pgstat_report_wait_end();
+
+		iov[iovcnt - 1].iov_len = BLCKSZ;
+
+		if (written < 0)
+			return -1;
+
+		offset += chunk;
+		amount -= chunk;
+	}
+
+	return 0;
+}
+
+/*
+ * FileFallocate - allocate space for a range of a file
+ *
+ * The space reads as zeroes, as with FileZero(), but where the filesystem
+ * supports it the kernel allocates it without us writing anything.  Falls
+ * back to FileZero() elsewhere.  Returns 0 on success, or -1 with errno set.
+ */
+int
+FileFallocate(File file, off_t offset, off_t amount, uint32 wait_event_info)
+{
+#ifdef HAVE_POSIX_FALLOCATE
+	int			returnCode;
+
+	Assert(FileIsValid(file));
+
+	DO_DB(elog(LOG, "FileFallocate: %d (%s) " INT64_FORMAT " " INT64_FORMAT,
+			   file, VfdCache[file].fileName,
+			   (int64) offset, (int64) amount));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return returnCode;
+
+retry:
+	pgstat_report_wait_start(wait_event_info);
+	returnCode = posix_fallocate(VfdCache[file].fd, offset, amount);
+	pgstat_report_wait_end();
+
+	if (returnCode == 0)
+		return 0;
+	else if (returnCode == EINTR)
+		goto retry;
+
+	/* for compatibility with %m printing etc */
+	errno = returnCode;
+
+	/*
+	 * Return in cases of a "real" failure; if fallocate is not supported by
+	 * the filesystem, fall back to writing zeroes.
+	 */
+	if (returnCode != EINVAL && returnCode != EOPNOTSUPP)
+		return -1;
+#endif
+
+	return FileZero(file, offset, amount, wait_event_info);
+}
+
 int
 FileSync(File file, uint32 wait_event_info)
 {
@@ -3891,3 +4114,100 @@ pg_pwritev_with_retry(int fd, const struct iovec *iov, int iovcnt, off_t offset)
 
 	return sum;
 }
+
+/*
+ * GUC check_hook for io_direct
+ */
+bool
+check_io_direct(char **newval, void **extra, GucSource source)
+{
+	bool		result = true;
+	int			flags;
+	int		   *myextra;
+
+#if PG_O_DIRECT == 0
+	if (strcmp(*newval, "") != 0)
+	{
+		GUC_check_errdetail("io_direct is not supported on this platform.");
+		result = false;
+	}
+	flags = 0;
+#else
+	List	   *elemlist;
+	ListCell   *l;
+	char	   *rawstring;
+
+	/* Need a modifiable copy of string */
+	rawstring = pstrdup(*newval);
+
+	if (!SplitGUCList(rawstring, ',', &elemlist))
+	{
+		GUC_check_errdetail("List syntax is invalid.");
+		pfree(rawstring);
+		list_free(elemlist);
+		return false;
+	}
+
+	flags = 0;
+	foreach(l, elemlist)
+	{
+		char	   *item = (char *) lfirst(l);
+
+		if (pg_strcasecmp(item, "data") == 0)
+			flags |= IO_DIRECT_DATA;
+		else if (pg_strcasecmp(item, "wal") == 0)
+			flags |= IO_DIRECT_WAL;
+		else if (pg_strcasecmp(item, "wal_init") == 0)
+			flags |= IO_DIRECT_WAL_INIT;
+		else
+		{
+			GUC_check_errdetail("Unrecognized key word: \"%s\".", item);
+			result = false;
+			break;
+		}
+	}
+
+	/*
+	 * Block sizes smaller than our assumed I/O alignment could result in I/O
+	 * requests the kernel refuses.
+	 */
+#if XLOG_BLCKSZ < PG_IO_ALIGN_SIZE
+	if (result && (flags & (IO_DIRECT_WAL | IO_DIRECT_WAL_INIT)))
+	{
+		GUC_check_errdetail("io_direct is not supported for WAL because XLOG_BLCKSZ is too small.");
+		result = false;
+	}
+#endif
+#if BLCKSZ < PG_IO_ALIGN_SIZE
+	if (result && (flags & IO_DIRECT_DATA))
+	{
+		GUC_check_errdetail("io_direct is not supported for data because BLCKSZ is too small.");
+		result = false;
+	}
+#endif
+
+	pfree(rawstring);
+	list_free(elemlist);
+#endif
+
+	if (!result)
+		return false;
+
+	/* Save the flags for assign_io_direct */
+	myextra = (int *) malloc(sizeof(int));
+	if (!myextra)
+		return false;
+	*myextra = flags;
+	*extra = (void *) myextra;
+
+	return true;
+}
+
+/*
+ * GUC assign_hook for io_direct
+ */
+void
+assign_io_direct(const char *newval, void *extra)
+{
+	io_direct_flags = *((int *) extra);
+}
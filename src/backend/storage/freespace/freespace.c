@@ -191,6 +191,49 @@ RecordPageWithFreeSpace(Relation rel, BlockNumber heapBlk, Size spaceAvail)
 	fsm_set_and_search(rel, addr, slot, new_cat, 0);
 }
 
+/*
+ * RecordPagesWithFreeSpace - update info about a range of pages.
+ *
+ * Like calling RecordPageWithFreeSpace for each of the nblocks pages starting
+ * at firstBlk, except that each FSM page is locked only once.  Meant for
+ * recording a batch of pages just added to the relation.
+ */
+void
+RecordPagesWithFreeSpace(Relation rel, BlockNumber firstBlk,
+						 BlockNumber nblocks, Size spaceAvail)
+{
+	int			new_cat = fsm_space_avail_to_cat(spaceAvail);
+	BlockNumber heapBlk = firstBlk;
+	BlockNumber endBlk = firstBlk + nblocks;
+
+	while (heapBlk < endBlk)
+	{
+		FSMAddress	addr;
+		uint16		slot;
+		Buffer		buf;
+		Page		page;
+		bool		changed = false;
+
+		/* Get the location of the FSM byte representing the heap block */
+		addr = fsm_get_location(heapBlk, &slot);
+
+		buf = fsm_readbuf(rel, addr, true);
+		LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+		page = BufferGetPage(buf);
+
+		/* Update all the slots on this FSM page that are in the range */
+		for (; heapBlk < endBlk && slot < SlotsPerFSMPage; heapBlk++, slot++)
+		{
+			if (fsm_set_avail(page, slot, new_cat))
+				changed = true;
+		}
+
+		if (changed)
+			MarkBufferDirtyHint(buf, false);
+		UnlockReleaseBuffer(buf);
+	}
+}
+
 /*
  * XLogRecordPageWithFreeSpace - like RecordPageWithFreeSpace, for use in
  *		WAL replay
@@ -224,6 +267,18 @@ XLogRecordPageWithFreeSpace(RelFileNode rnode, BlockNumber heapBlk,
 	UnlockReleaseBuffer(buf);
 }
 
+/*
+ * FreeSpaceMapBlockForHeapBlock - return the FSM block holding the entry for
+ *		a heap block, as read by XLogRecordPageWithFreeSpace
+ */
+BlockNumber
+FreeSpaceMapBlockForHeapBlock(BlockNumber heapBlk)
+{
+	uint16		slot;
+
+	return fsm_logical_to_physical(fsm_get_location(heapBlk, &slot));
+}
+
 /*
  * GetRecordedFreeSpace - return the amount of free space on a particular page,
  *		according to the FSM.
@@ -608,7 +663,7 @@ static void
 fsm_extend(Relation rel, BlockNumber fsm_nblocks)
 {
 	BlockNumber fsm_nblocks_now;
-	PGAlignedBlock pg;
+	PGIOAlignedBlock pg;
 	SMgrRelation reln;
 
 	PageInit((Page) pg.data, BLCKSZ, 0);
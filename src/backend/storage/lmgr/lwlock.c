@@ -183,6 +183,20 @@ static const char *const BuiltinTrancheNames[] = {
 	"PgStatsHash",
 	/* LWTRANCHE_PGSTATS_DATA: */
 	"PgStatsData",
+	/* LWTRANCHE_XACT_SLRU: */
+	"XactSLRU",
+	/* LWTRANCHE_COMMITTS_SLRU: */
+	"CommitTsSLRU",
+	/* LWTRANCHE_MULTIXACTMEMBER_SLRU: */
+	"MultiXactMemberSLRU",
+	/* LWTRANCHE_MULTIXACTOFFSET_SLRU: */
+	"MultiXactOffsetSLRU",
+	/* LWTRANCHE_NOTIFY_SLRU: */
+	"NotifySLRU",
+	/* LWTRANCHE_SERIAL_SLRU: */
+	"SerialSLRU",
+	/* LWTRANCHE_SUBTRANS_SLRU: */
+	"SubtransSLRU",
 };
 
 StaticAssertDecl(lengthof(BuiltinTrancheNames) ==
@@ -31,7 +31,9 @@
 #include "miscadmin.h"
 #include "pg_trace.h"
 #include "pgstat.h"
+#include "port/pg_iovec.h"
 #include "postmaster/bgwriter.h"
+#include "storage/aio.h"
 #include "storage/bufmgr.h"
 #include "storage/fd.h"
 #include "storage/md.h"
@@ -143,6 +145,47 @@ static BlockNumber _mdnblocks(SMgrRelation reln, ForkNumber forknum,
 							  MdfdVec *seg);
 
 
+/*
+ * Flags for opening relation segment files.
+ */
+static inline int
+_mdfd_open_flags(void)
+{
+	int			flags = O_RDWR | PG_BINARY;
+
+	if (io_direct_flags & IO_DIRECT_DATA)
+		flags |= PG_O_DIRECT;
+
+	return flags;
+}
+
+/*
+ * With direct I/O, the kernel insists on suitably aligned memory.  Shared and
+ * local buffers always are, but some callers read or write pages they have
+ * palloc'd themselves, such as index builds; those go through a bounce
+ * buffer.
+ */
+static inline bool
+_mdfd_needs_bounce(const char *buffer)
+{
+	return (io_direct_flags & IO_DIRECT_DATA) != 0 &&
+		(uintptr_t) buffer != TYPEALIGN(PG_IO_ALIGN_SIZE, buffer);
+}
+
+static char *
+_mdfd_bounce_buffer(void)
+{
+	static char *bounce = NULL;
+
+	if (bounce == NULL)
+		bounce = (char *)
+			TYPEALIGN(PG_IO_ALIGN_SIZE,
+					  MemoryContextAlloc(TopMemoryContext,
+										 BLCKSZ + PG_IO_ALIGN_SIZE));
+	return bounce;
+}
+
+
 /*
  *	mdinit() -- Initialize private state for magnetic disk storage manager.
  */
@@ -205,14 +248,14 @@ mdcreate(SMgrRelation reln, ForkNumber forkNum, bool isRedo)
 
 	path = relpath(reln->smgr_rnode, forkNum);
 
-	fd = PathNameOpenFile(path, O_RDWR | O_CREAT | O_EXCL | PG_BINARY);
+	fd = PathNameOpenFile(path, _mdfd_open_flags() | O_CREAT | O_EXCL);
 
 	if (fd < 0)
 	{
 		int			save_errno = errno;
 
 		if (isRedo)
-			fd = PathNameOpenFile(path, O_RDWR | PG_BINARY);
+			fd = PathNameOpenFile(path, _mdfd_open_flags());
 		if (fd < 0)
 		{
 			/* be sure to report the error reported by create, not open */
@@ -463,6 +506,9 @@ mdextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 
 	Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
 
+	if (_mdfd_needs_bounce(buffer))
+		buffer = memcpy(_mdfd_bounce_buffer(), buffer, BLCKSZ);
+
 	if ((nbytes = FileWrite(v->mdfd_vfd, buffer, BLCKSZ, seekpos, WAIT_EVENT_DATA_FILE_EXTEND)) != BLCKSZ)
 	{
 		if (nbytes < 0)
@@ -486,6 +532,94 @@ mdextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	Assert(_mdnblocks(reln, forknum, v) <= ((BlockNumber) RELSEG_SIZE));
 }
 
+/*
+ *	mdzeroextend() -- Add new zeroed out blocks to the specified relation.
+ *
+ *		Similar to mdextend(), except the relation can be extended by
+ *		multiple blocks at once and the added blocks will be filled with
+ *		zeroes.
+ */
+void
+mdzeroextend(SMgrRelation reln, ForkNumber forknum,
+			 BlockNumber blocknum, int nblocks, bool skipFsync)
+{
+	MdfdVec    *v;
+	BlockNumber curblocknum = blocknum;
+	int			remblocks = nblocks;
+
+	Assert(nblocks > 0);
+
+	/* This assert is too expensive to have on normally ... */
+#ifdef CHECK_WRITE_VS_EXTEND
+	Assert(blocknum >= mdnblocks(reln, forknum));
+#endif
+
+	/*
+	 * If a relation manages to grow to 2^32-1 blocks, refuse to extend it any
+	 * more --- we mustn't create a block whose number actually is
+	 * InvalidBlockNumber or larger.
+	 */
+	if ((uint64) blocknum + nblocks >= (uint64) InvalidBlockNumber)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("cannot extend file \"%s\" beyond %u blocks",
+						relpath(reln->smgr_rnode, forknum),
+						InvalidBlockNumber)));
+
+	while (remblocks > 0)
+	{
+		BlockNumber segstartblock = curblocknum % ((BlockNumber) RELSEG_SIZE);
+		off_t		seekpos = (off_t) BLCKSZ * segstartblock;
+		int			numblocks;
+		int			ret;
+
+		/* don't cross a segment boundary in one go */
+		if (segstartblock + remblocks > RELSEG_SIZE)
+			numblocks = RELSEG_SIZE - segstartblock;
+		else
+			numblocks = remblocks;
+
+		v = _mdfd_getseg(reln, forknum, curblocknum, skipFsync, EXTENSION_CREATE);
+
+		Assert(segstartblock < RELSEG_SIZE);
+		Assert(segstartblock + numblocks <= RELSEG_SIZE);
+
+		/*
+		 * If available and useful, use posix_fallocate() (via
+		 * FileFallocate()) to extend the relation.  That's often more
+		 * efficient than using write(), as it commonly won't cause the kernel
+		 * to allocate page cache space for the extended pages.
+		 *
+		 * However, we don't use FileFallocate() for small extensions, as it
+		 * defeats delayed allocation on some filesystems; writing a few
+		 * blocks of zeroes is cheap anyway.
+		 */
+		if (numblocks > 8)
+			ret = FileFallocate(v->mdfd_vfd,
+								seekpos, (off_t) BLCKSZ * numblocks,
+								WAIT_EVENT_DATA_FILE_EXTEND);
+		else
+			ret = FileZero(v->mdfd_vfd,
+						   seekpos, (off_t) BLCKSZ * numblocks,
+						   WAIT_EVENT_DATA_FILE_EXTEND);
+
+		if (ret != 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not extend file \"%s\": %m",
+							FilePathName(v->mdfd_vfd)),
+					 errhint("Check free disk space.")));
+
+		if (!skipFsync && !SmgrIsTemp(reln))
+			register_dirty_segment(reln, forknum, v);
+
+		Assert(_mdnblocks(reln, forknum, v) <= ((BlockNumber) RELSEG_SIZE));
+
+		remblocks -= numblocks;
+		curblocknum += numblocks;
+	}
+}
+
 /*
  *	mdopenfork() -- Open one fork of the specified relation.
  *
@@ -509,7 +643,7 @@ mdopenfork(SMgrRelation reln, ForkNumber forknum, int behavior)
 
 	path = relpath(reln->smgr_rnode, forknum);
 
-	fd = PathNameOpenFile(path, O_RDWR | PG_BINARY);
+	fd = PathNameOpenFile(path, _mdfd_open_flags());
 
 	if (fd < 0)
 	{
@@ -589,7 +723,9 @@ mdprefetch(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum)
 
 	Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
 
-	(void) FilePrefetch(v->mdfd_vfd, seekpos, BLCKSZ, WAIT_EVENT_DATA_FILE_PREFETCH);
+	/* the kernel's read-ahead is no use to us with direct I/O */
+	if ((io_direct_flags & IO_DIRECT_DATA) == 0)
+		(void) FilePrefetch(v->mdfd_vfd, seekpos, BLCKSZ, WAIT_EVENT_DATA_FILE_PREFETCH);
 #endif							/* USE_PREFETCH */
 
 	return true;
@@ -674,7 +810,16 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 
 	Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
 
-	nbytes = FileRead(v->mdfd_vfd, buffer, BLCKSZ, seekpos, WAIT_EVENT_DATA_FILE_READ);
+	if (_mdfd_needs_bounce(buffer))
+	{
+		char	   *bounce = _mdfd_bounce_buffer();
+
+		nbytes = FileRead(v->mdfd_vfd, bounce, BLCKSZ, seekpos, WAIT_EVENT_DATA_FILE_READ);
+		if (nbytes > 0)
+			memcpy(buffer, bounce, nbytes);
+	}
+	else
+		nbytes = FileRead(v->mdfd_vfd, buffer, BLCKSZ, seekpos, WAIT_EVENT_DATA_FILE_READ);
 
 	TRACE_POSTGRESQL_SMGR_MD_READ_DONE(forknum, blocknum,
 									   reln->smgr_rnode.node.spcNode,
@@ -711,6 +856,219 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	}
 }
 
+/*
+ *	mdreadv() -- Read nblocks consecutive blocks, starting at blocknum, into
+ *				 the supplied buffers.
+ *
+ *		The blocks are read with as few system calls as possible; we only
+ *		have to split the request at segment boundaries and at PG_IOV_MAX.
+ *		Short reads are handled the same way as in mdread().
+ */
+void
+mdreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		char **buffers, BlockNumber nblocks)
+{
+	/* if any buffer is unsuitable for direct I/O, do it the slow way */
+	for (int i = 0; i < nblocks; i++)
+	{
+		if (_mdfd_needs_bounce(buffers[i]))
+		{
+			for (int j = 0; j < nblocks; j++)
+				mdread(reln, forknum, blocknum + j, buffers[j]);
+			return;
+		}
+	}
+
+	while (nblocks > 0)
+	{
+		struct iovec iov[PG_IOV_MAX];
+		int			iovcnt;
+		off_t		seekpos;
+		int			nbytes;
+		int			transferred;
+		BlockNumber nread;
+		MdfdVec    *v;
+
+		TRACE_POSTGRESQL_SMGR_MD_READ_START(forknum, blocknum,
+											reln->smgr_rnode.node.spcNode,
+											reln->smgr_rnode.node.dbNode,
+											reln->smgr_rnode.node.relNode,
+											reln->smgr_rnode.backend);
+
+		v = _mdfd_getseg(reln, forknum, blocknum, false,
+						 EXTENSION_FAIL | EXTENSION_CREATE_RECOVERY);
+
+		/* don't cross a segment boundary in one read */
+		nread = Min(nblocks, RELSEG_SIZE - (blocknum % ((BlockNumber) RELSEG_SIZE)));
+		nread = Min(nread, PG_IOV_MAX);
+
+		seekpos = (off_t) BLCKSZ * (blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		Assert(seekpos + (off_t) BLCKSZ * nread <= (off_t) BLCKSZ * RELSEG_SIZE);
+
+		/*
+		 * The kernel may return less than requested even though the data is
+		 * there, so keep reading until we get all of it or reach EOF.
+		 */
+		transferred = 0;
+		for (;;)
+		{
+			int			skip = transferred / BLCKSZ;
+
+			for (iovcnt = 0; iovcnt < nread - skip; iovcnt++)
+			{
+				iov[iovcnt].iov_base = buffers[skip + iovcnt];
+				iov[iovcnt].iov_len = BLCKSZ;
+			}
+			iov[0].iov_base = (char *) iov[0].iov_base + transferred % BLCKSZ;
+			iov[0].iov_len -= transferred % BLCKSZ;
+
+			nbytes = FileReadV(v->mdfd_vfd, iov, iovcnt,
+							   seekpos + transferred,
+							   WAIT_EVENT_DATA_FILE_READ);
+			if (nbytes <= 0)
+				break;
+			transferred += nbytes;
+			if (transferred == (int) (BLCKSZ * nread))
+				break;
+		}
+
+		TRACE_POSTGRESQL_SMGR_MD_READ_DONE(forknum, blocknum,
+										   reln->smgr_rnode.node.spcNode,
+										   reln->smgr_rnode.node.dbNode,
+										   reln->smgr_rnode.node.relNode,
+										   reln->smgr_rnode.backend,
+										   transferred,
+										   BLCKSZ * nread);
+
+		if (nbytes < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read blocks %u..%u in file \"%s\": %m",
+							blocknum, blocknum + nread - 1,
+							FilePathName(v->mdfd_vfd))));
+
+		if (transferred != (int) (BLCKSZ * nread))
+		{
+			BlockNumber firstshort = blocknum + transferred / BLCKSZ;
+
+			/* See mdread() for why we might zero-fill a short read */
+			if (zero_damaged_pages || InRecovery)
+			{
+				for (int i = transferred / BLCKSZ; i < nread; i++)
+				{
+					int			done = (i == transferred / BLCKSZ) ?
+					transferred % BLCKSZ : 0;
+
+					MemSet(buffers[i] + done, 0, BLCKSZ - done);
+				}
+			}
+			else
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("could not read block %u in file \"%s\": read only %d of %d bytes",
+								firstshort, FilePathName(v->mdfd_vfd),
+								transferred % BLCKSZ, BLCKSZ)));
+		}
+
+		nblocks -= nread;
+		blocknum += nread;
+		buffers += nread;
+	}
+}
+
+/*
+ *	mdstartreadv() -- Start an asynchronous read of consecutive blocks.
+ *
+ *		At most one I/O is started, so the read stops at the next segment
+ *		boundary or after PG_IOV_MAX blocks; the number of blocks actually
+ *		covered is returned.  The caller must complete it with pgaio_io_wait(),
+ *		and if it comes up short or fails, redo it with mdreadv() to get the
+ *		usual handling of short reads and errors.
+ */
+BlockNumber
+mdstartreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			 char **buffers, BlockNumber nblocks, PgAioHandle *ioh)
+{
+	struct iovec iov[PG_IOV_MAX];
+	BlockNumber nread;
+	off_t		seekpos;
+	MdfdVec    *v;
+
+	v = _mdfd_getseg(reln, forknum, blocknum, false,
+					 EXTENSION_FAIL | EXTENSION_CREATE_RECOVERY);
+
+	nread = Min(nblocks, RELSEG_SIZE - (blocknum % ((BlockNumber) RELSEG_SIZE)));
+	nread = Min(nread, PG_IOV_MAX);
+
+	seekpos = (off_t) BLCKSZ * (blocknum % ((BlockNumber) RELSEG_SIZE));
+
+	for (int i = 0; i < nread; i++)
+	{
+		Assert(!_mdfd_needs_bounce(buffers[i]));
+		iov[i].iov_base = buffers[i];
+		iov[i].iov_len = BLCKSZ;
+	}
+
+	if (FileStartReadV(ioh, v->mdfd_vfd, iov, nread, seekpos,
+					   WAIT_EVENT_DATA_FILE_READ) < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read blocks %u..%u in file \"%s\": %m",
+						blocknum, blocknum + nread - 1,
+						FilePathName(v->mdfd_vfd))));
+
+	return nread;
+}
+
+/*
+ *	mdstartwritev() -- Start an asynchronous write of consecutive blocks.
+ *
+ *		Like mdstartreadv(), this covers at most one segment and PG_IOV_MAX
+ *		blocks, and returns the number of blocks covered.  The fsync request is
+ *		registered right away; that's OK because the caller has to complete
+ *		the write before the next checkpoint's sync phase anyway.  A short or
+ *		failed write should be redone with mdwrite().
+ */
+BlockNumber
+mdstartwritev(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			  char **buffers, BlockNumber nblocks, bool skipFsync,
+			  PgAioHandle *ioh)
+{
+	struct iovec iov[PG_IOV_MAX];
+	BlockNumber nwrite;
+	off_t		seekpos;
+	MdfdVec    *v;
+
+	v = _mdfd_getseg(reln, forknum, blocknum, skipFsync,
+					 EXTENSION_FAIL | EXTENSION_CREATE_RECOVERY);
+
+	nwrite = Min(nblocks, RELSEG_SIZE - (blocknum % ((BlockNumber) RELSEG_SIZE)));
+	nwrite = Min(nwrite, PG_IOV_MAX);
+
+	seekpos = (off_t) BLCKSZ * (blocknum % ((BlockNumber) RELSEG_SIZE));
+
+	for (int i = 0; i < nwrite; i++)
+	{
+		Assert(!_mdfd_needs_bounce(buffers[i]));
+		iov[i].iov_base = buffers[i];
+		iov[i].iov_len = BLCKSZ;
+	}
+
+	if (FileStartWriteV(ioh, v->mdfd_vfd, iov, nwrite, seekpos,
+						WAIT_EVENT_DATA_FILE_WRITE) < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write blocks %u..%u in file \"%s\": %m",
+						blocknum, blocknum + nwrite - 1,
+						FilePathName(v->mdfd_vfd))));
+
+	if (!skipFsync && !SmgrIsTemp(reln))
+		register_dirty_segment(reln, forknum, v);
+
+	return nwrite;
+}
+
 /*
  *	mdwrite() -- Write the supplied block at the appropriate location.
  *
@@ -744,6 +1102,9 @@ mdwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 
 	Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
 
+	if (_mdfd_needs_bounce(buffer))
+		buffer = memcpy(_mdfd_bounce_buffer(), buffer, BLCKSZ);
+
 	nbytes = FileWrite(v->mdfd_vfd, buffer, BLCKSZ, seekpos, WAIT_EVENT_DATA_FILE_WRITE);
 
 	TRACE_POSTGRESQL_SMGR_MD_WRITE_DONE(forknum, blocknum,
@@ -1174,7 +1535,7 @@ _mdfd_openseg(SMgrRelation reln, ForkNumber forknum, BlockNumber segno,
 	fullpath = _mdfd_segpath(reln, forknum, segno);
 
 	/* open the file */
-	fd = PathNameOpenFile(fullpath, O_RDWR | PG_BINARY | oflags);
+	fd = PathNameOpenFile(fullpath, _mdfd_open_flags() | oflags);
 
 	pfree(fullpath);
 
@@ -19,6 +19,7 @@
 
 #include "access/xlogutils.h"
 #include "lib/ilist.h"
+#include "storage/aio.h"
 #include "storage/bufmgr.h"
 #include "storage/ipc.h"
 #include "storage/md.h"
@@ -50,12 +51,25 @@ typedef struct f_smgr
 								bool isRedo);
 	void		(*smgr_extend) (SMgrRelation reln, ForkNumber forknum,
 								BlockNumber blocknum, char *buffer, bool skipFsync);
+	void		(*smgr_zeroextend) (SMgrRelation reln, ForkNumber forknum,
+									BlockNumber blocknum, int nblocks, bool skipFsync);
 	bool		(*smgr_prefetch) (SMgrRelation reln, ForkNumber forknum,
 								  BlockNumber blocknum);
 	void		(*smgr_read) (SMgrRelation reln, ForkNumber forknum,
 							  BlockNumber blocknum, char *buffer);
+	void		(*smgr_readv) (SMgrRelation reln, ForkNumber forknum,
+							   BlockNumber blocknum, char **buffers,
+							   BlockNumber nblocks);
+	BlockNumber (*smgr_startreadv) (SMgrRelation reln, ForkNumber forknum,
+									BlockNumber blocknum, char **buffers,
+									BlockNumber nblocks,
+									PgAioHandle *ioh);
 	void		(*smgr_write) (SMgrRelation reln, ForkNumber forknum,
 							   BlockNumber blocknum, char *buffer, bool skipFsync);
+	BlockNumber (*smgr_startwritev) (SMgrRelation reln, ForkNumber forknum,
+									 BlockNumber blocknum, char **buffers,
+									 BlockNumber nblocks, bool skipFsync,
+									 PgAioHandle *ioh);
 	void		(*smgr_writeback) (SMgrRelation reln, ForkNumber forknum,
 								   BlockNumber blocknum, BlockNumber nblocks);
 	BlockNumber (*smgr_nblocks) (SMgrRelation reln, ForkNumber forknum);
@@ -75,9 +89,13 @@ static const f_smgr smgrsw[] = {
 		.smgr_exists = mdexists,
 		.smgr_unlink = mdunlink,
 		.smgr_extend = mdextend,
+		.smgr_zeroextend = mdzeroextend,
 		.smgr_prefetch = mdprefetch,
 		.smgr_read = mdread,
+		.smgr_readv = mdreadv,
+		.smgr_startreadv = mdstartreadv,
 		.smgr_write = mdwrite,
+		.smgr_startwritev = mdstartwritev,
 		.smgr_writeback = mdwriteback,
 		.smgr_nblocks = mdnblocks,
 		.smgr_truncate = mdtruncate,
@@ -507,6 +525,31 @@ smgrextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 		reln->smgr_cached_nblocks[forknum] = InvalidBlockNumber;
 }
 
+/*
+ *	smgrzeroextend() -- Add new zeroed out blocks to a file.
+ *
+ *		Similar to smgrextend(), except the relation can be extended by
+ *		multiple blocks at once and the added blocks will be filled with
+ *		zeroes.
+ */
+void
+smgrzeroextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			   int nblocks, bool skipFsync)
+{
+	smgrsw[reln->smgr_which].smgr_zeroextend(reln, forknum, blocknum,
+											 nblocks, skipFsync);
+
+	/*
+	 * Normally we expect this to increase the fork size by nblocks, but if
+	 * the cached value isn't as expected, just invalidate it so the next call
+	 * asks the kernel.
+	 */
+	if (reln->smgr_cached_nblocks[forknum] == blocknum)
+		reln->smgr_cached_nblocks[forknum] = blocknum + nblocks;
+	else
+		reln->smgr_cached_nblocks[forknum] = InvalidBlockNumber;
+}
+
 /*
  *	smgrprefetch() -- Initiate asynchronous read of the specified block of a relation.
  *
@@ -535,6 +578,40 @@ smgrread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	smgrsw[reln->smgr_which].smgr_read(reln, forknum, blocknum, buffer);
 }
 
+/*
+ *	smgrreadv() -- read a run of consecutive blocks of a relation into the
+ *				   supplied buffers.
+ *
+ *		This is equivalent to calling smgrread() for each block, but lets the
+ *		storage manager transfer the whole run with a single vectored read
+ *		where possible.
+ */
+void
+smgrreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		  char **buffers, BlockNumber nblocks)
+{
+	smgrsw[reln->smgr_which].smgr_readv(reln, forknum, blocknum, buffers,
+										nblocks);
+}
+
+/*
+ *	smgrstartreadv() -- start reading a run of consecutive blocks
+ *						asynchronously, using the given AIO handle.
+ *
+ *		The storage manager may cover fewer than nblocks blocks with one I/O;
+ *		the number covered is returned, and the caller is expected to start
+ *		another read for the rest.  The caller must wait for the I/O with
+ *		pgaio_io_wait() and, if it transferred less than requested, redo it
+ *		with smgrreadv().
+ */
+BlockNumber
+smgrstartreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			   char **buffers, BlockNumber nblocks, PgAioHandle *ioh)
+{
+	return smgrsw[reln->smgr_which].smgr_startreadv(reln, forknum, blocknum,
+													buffers, nblocks, ioh);
+}
+
 /*
  *	smgrwrite() -- Write the supplied buffer out.
  *
@@ -558,6 +635,24 @@ smgrwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 										buffer, skipFsync);
 }
 
+/*
+ *	smgrstartwritev() -- start writing a run of consecutive blocks
+ *						 asynchronously, using the given AIO handle.
+ *
+ *		The counterpart of smgrstartreadv(), with the semantics of smgrwrite()
+ *		otherwise.  A write that comes up short should be redone with
+ *		smgrwrite().
+ */
+BlockNumber
+smgrstartwritev(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+				char **buffers, BlockNumber nblocks, bool skipFsync,
+				PgAioHandle *ioh)
+{
+	return smgrsw[reln->smgr_which].smgr_startwritev(reln, forknum, blocknum,
+													 buffers, nblocks,
+													 skipFsync, ioh);
+}
+
 
 /*
  *	smgrwriteback() -- Trigger kernel writeback for the supplied range of
@@ -224,12 +224,18 @@ pgstat_get_wait_activity(WaitEventActivity w)
 		case WAIT_EVENT_CHECKPOINTER_MAIN:
 			event_name = "CheckpointerMain";
 			break;
+		case WAIT_EVENT_IO_WORKER_MAIN:
+			event_name = "IoWorkerMain";
+			break;
 		case WAIT_EVENT_LOGICAL_APPLY_MAIN:
 			event_name = "LogicalApplyMain";
 			break;
 		case WAIT_EVENT_LOGICAL_LAUNCHER_MAIN:
 			event_name = "LogicalLauncherMain";
 			break;
+		case WAIT_EVENT_PARALLEL_REDO_WORKER_MAIN:
+			event_name = "ParallelRedoWorkerMain";
+			break;
 		case WAIT_EVENT_RECOVERY_WAL_STREAM:
 			event_name = "RecoveryWalStream";
 			break;
@@ -340,9 +346,15 @@ pgstat_get_wait_ipc(WaitEventIPC w)
 		case WAIT_EVENT_CHECKPOINT_START:
 			event_name = "CheckpointStart";
 			break;
+		case WAIT_EVENT_DOUBLE_WRITE_SLOT_DONE:
+			event_name = "DoubleWriteSlotDone";
+			break;
 		case WAIT_EVENT_EXECUTE_GATHER:
 			event_name = "ExecuteGather";
 			break;
+		case WAIT_EVENT_HASH_AGG_PARTITION:
+			event_name = "HashAggPartition";
+			break;
 		case WAIT_EVENT_HASH_BATCH_ALLOCATE:
 			event_name = "HashBatchAllocate";
 			break;
@@ -415,6 +427,9 @@ pgstat_get_wait_ipc(WaitEventIPC w)
 		case WAIT_EVENT_PARALLEL_FINISH:
 			event_name = "ParallelFinish";
 			break;
+		case WAIT_EVENT_PARALLEL_REDO_QUEUE:
+			event_name = "ParallelRedoQueue";
+			break;
 		case WAIT_EVENT_PROCARRAY_GROUP_UPDATE:
 			event_name = "ProcArrayGroupUpdate";
 			break;
@@ -451,6 +466,9 @@ pgstat_get_wait_ipc(WaitEventIPC w)
 		case WAIT_EVENT_SYNC_REP:
 			event_name = "SyncRep";
 			break;
+		case WAIT_EVENT_WAL_FLUSH_GROUP:
+			event_name = "WalFlushGroup";
+			break;
 		case WAIT_EVENT_WAL_RECEIVER_EXIT:
 			event_name = "WalReceiverExit";
 			break;
@@ -585,6 +603,15 @@ pgstat_get_wait_io(WaitEventIO w)
 		case WAIT_EVENT_DATA_FILE_WRITE:
 			event_name = "DataFileWrite";
 			break;
+		case WAIT_EVENT_DOUBLE_WRITE_READ:
+			event_name = "DoubleWriteRead";
+			break;
+		case WAIT_EVENT_DOUBLE_WRITE_SYNC:
+			event_name = "DoubleWriteSync";
+			break;
+		case WAIT_EVENT_DOUBLE_WRITE_WRITE:
+			event_name = "DoubleWriteWrite";
+			break;
 		case WAIT_EVENT_DSM_FILL_ZERO_WRITE:
 			event_name = "DSMFillZeroWrite";
 			break;
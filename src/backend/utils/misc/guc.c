@@ -35,12 +35,15 @@
 #include "access/commit_ts.h"
 #include "access/gin.h"
 #include "access/rmgr.h"
+#include "access/slru.h"
 #include "access/tableam.h"
 #include "access/toast_compression.h"
 #include "access/transam.h"
 #include "access/twophase.h"
 #include "access/xact.h"
 #include "access/xlog_internal.h"
+#include "access/xlogdict.h"
+#include "access/xlogparallelredo.h"
 #include "access/xlogprefetcher.h"
 #include "access/xlogrecovery.h"
 #include "catalog/namespace.h"
@@ -56,6 +59,7 @@
 #include "commands/vacuum.h"
 #include "commands/variable.h"
 #include "common/string.h"
+#include "executor/executor.h"
 #include "funcapi.h"
 #include "jit/jit.h"
 #include "libpq/auth.h"
@@ -85,7 +89,9 @@
 #include "replication/syncrep.h"
 #include "replication/walreceiver.h"
 #include "replication/walsender.h"
+#include "storage/aio.h"
 #include "storage/bufmgr.h"
+#include "storage/doublewrite.h"
 #include "storage/dsm_impl.h"
 #include "storage/fd.h"
 #include "storage/large_object.h"
@@ -556,6 +562,15 @@ static struct config_enum_entry recovery_init_sync_method_options[] = {
 	{NULL, 0, false}
 };
 
+static struct config_enum_entry io_method_options[] = {
+	{"sync", IOMETHOD_SYNC, false},
+	{"worker", IOMETHOD_WORKER, false},
+#ifdef USE_IO_URING
+	{"io_uring", IOMETHOD_IO_URING, false},
+#endif
+	{NULL, 0, false}
+};
+
 static struct config_enum_entry shared_memory_options[] = {
 #ifndef WIN32
 	{"sysv", SHMEM_TYPE_SYSV, false},
@@ -716,6 +731,7 @@ static char *recovery_target_string;
 static char *recovery_target_xid_string;
 static char *recovery_target_name_string;
 static char *recovery_target_lsn_string;
+static char *io_direct_string;
 
 
 /* should be static, but commands/variable.c needs to get at this */
@@ -1192,6 +1208,16 @@ static struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"enable_parallel_hashagg", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables the planner's use of parallel hash aggregation plans."),
+			NULL,
+			GUC_EXPLAIN
+		},
+		&enable_parallel_hashagg,
+		false,
+		NULL, NULL, NULL
+	},
 	{
 		{"enable_partition_pruning", PGC_USERSET, QUERY_TUNING_METHOD,
 			gettext_noop("Enables plan-time and execution-time partition pruning."),
@@ -1365,6 +1391,16 @@ static struct config_bool ConfigureNamesBool[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"wal_compression_dictionary", PGC_SUSET, WAL_SETTINGS,
+			gettext_noop("Compresses full-page writes with trained dictionaries when using zstd."),
+			NULL
+		},
+		&wal_compression_dictionary,
+		false,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_init_zero", PGC_SUSET, WAL_SETTINGS,
 			gettext_noop("Writes zeroes to new WAL files before first use."),
@@ -2226,6 +2262,36 @@ static struct config_int ConfigureNamesInt[] =
 		8, 1, INT_MAX,
 		NULL, NULL, NULL
 	},
+	{
+		{"executor_batch_size", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Sets the number of tuples passed between executor nodes at a time in batch mode."),
+			gettext_noop("Zero disables batch mode."),
+			GUC_EXPLAIN
+		},
+		&executor_batch_size,
+		0, 0, 1024,
+		NULL, NULL, NULL
+	},
+	{
+		{"jit_cache_entries", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Sets the maximum number of JIT-compiled expressions each backend keeps for reuse."),
+			gettext_noop("Zero disables caching of JIT-compiled code."),
+			GUC_EXPLAIN
+		},
+		&jit_cache_entries,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+	{
+		{"jit_warmup_evaluations", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Sets the number of times an expression is interpreted before it is JIT compiled."),
+			gettext_noop("Zero compiles expressions before execution starts."),
+			GUC_EXPLAIN
+		},
+		&jit_warmup_evaluations,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
 	{
 		{"join_collapse_limit", PGC_USERSET, QUERY_TUNING_OTHER,
 			gettext_noop("Sets the FROM-list size beyond which JOIN "
@@ -2394,6 +2460,93 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"clock_sweep_partitions", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of partitions of the buffer replacement clock sweep."),
+			gettext_noop("-1 sets the number based on shared_buffers.")
+		},
+		&clock_sweep_partitions,
+		-1, -1, 64,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"commit_timestamp_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the commit timestamp cache."),
+			gettext_noop("Specify 0 to have this value determined as a fraction of shared_buffers."),
+			GUC_UNIT_BLOCKS
+		},
+		&commit_timestamp_buffers,
+		0, 0, SLRU_MAX_ALLOWED_BUFFERS,
+		check_commit_ts_buffers, NULL, NULL
+	},
+
+	{
+		{"multixact_member_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the MultiXact member cache."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&multixact_member_buffers,
+		32, 16, SLRU_MAX_ALLOWED_BUFFERS,
+		check_multixact_member_buffers, NULL, NULL
+	},
+
+	{
+		{"multixact_offset_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the MultiXact offset cache."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&multixact_offset_buffers,
+		16, 16, SLRU_MAX_ALLOWED_BUFFERS,
+		check_multixact_offset_buffers, NULL, NULL
+	},
+
+	{
+		{"notify_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the LISTEN/NOTIFY message cache."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&notify_buffers,
+		16, 16, SLRU_MAX_ALLOWED_BUFFERS,
+		check_notify_buffers, NULL, NULL
+	},
+
+	{
+		{"serializable_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the serializable transaction cache."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&serializable_buffers,
+		32, 16, SLRU_MAX_ALLOWED_BUFFERS,
+		check_serial_buffers, NULL, NULL
+	},
+
+	{
+		{"subtransaction_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the subtransaction cache."),
+			gettext_noop("Specify 0 to have this value determined as a fraction of shared_buffers."),
+			GUC_UNIT_BLOCKS
+		},
+		&subtransaction_buffers,
+		0, 0, SLRU_MAX_ALLOWED_BUFFERS,
+		check_subtrans_buffers, NULL, NULL
+	},
+
+	{
+		{"transaction_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the transaction status cache."),
+			gettext_noop("Specify 0 to have this value determined as a fraction of shared_buffers."),
+			GUC_UNIT_BLOCKS
+		},
+		&transaction_buffers,
+		0, 0, SLRU_MAX_ALLOWED_BUFFERS,
+		check_transaction_buffers, NULL, NULL
+	},
+
 	{
 		{"shared_memory_size", PGC_INTERNAL, PRESET_OPTIONS,
 			gettext_noop("Shows the size of the server's main shared memory area (rounded up to the nearest MB)."),
@@ -2836,6 +2989,16 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"recovery_parallel_workers", PGC_POSTMASTER, WAL_RECOVERY,
+			gettext_noop("Sets the number of background workers that replay WAL during recovery."),
+			gettext_noop("Zero means the startup process replays all WAL by itself.")
+		},
+		&recovery_parallel_workers,
+		0, 0, MAX_PARALLEL_REDO_WORKERS,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_keep_size", PGC_SIGHUP, REPLICATION_SENDING,
 			gettext_noop("Sets the size of WAL files held for standby servers."),
@@ -2908,6 +3071,20 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"double_write_buffers", PGC_POSTMASTER, WAL_SETTINGS,
+			gettext_noop("Sets the number of pages in the double-write buffer."),
+			gettext_noop("Pages are written to the double-write buffer before "
+						 "their data files, so that torn pages can be repaired "
+						 "after a crash without full-page writes in WAL. "
+						 "0 disables the double-write buffer."),
+			GUC_UNIT_BLOCKS
+		},
+		&double_write_buffers,
+		0, 0, (1024 * 1024 * 1024) / BLCKSZ,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_buffers", PGC_POSTMASTER, WAL_SETTINGS,
 			gettext_noop("Sets the number of disk-page buffers in shared memory for WAL."),
@@ -2919,6 +3096,16 @@ static struct config_int ConfigureNamesInt[] =
 		check_wal_buffers, NULL, NULL
 	},
 
+	{
+		{"wal_insert_locks", PGC_POSTMASTER, WAL_SETTINGS,
+			gettext_noop("Sets the number of locks used for concurrent WAL insertion."),
+			gettext_noop("-1 sets the number based on the number of CPUs.")
+		},
+		&wal_insert_locks,
+		-1, -1, 128,
+		check_wal_insert_locks, NULL, NULL
+	},
+
 	{
 		{"wal_writer_delay", PGC_SIGHUP, WAL_SETTINGS,
 			gettext_noop("Time between WAL flushes performed in the WAL writer."),
@@ -3163,6 +3350,43 @@ static struct config_int ConfigureNamesInt[] =
 		NULL
 	},
 
+	{
+		{"io_combine_limit",
+			PGC_USERSET,
+			RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Limit on the size of data reads with a single system call."),
+			NULL,
+			GUC_UNIT_BLOCKS | GUC_EXPLAIN
+		},
+		&io_combine_limit,
+		DEFAULT_IO_COMBINE_LIMIT, 1, MAX_IO_COMBINE_LIMIT,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"io_max_concurrency",
+			PGC_POSTMASTER,
+			RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Maximum number of asynchronous I/Os one process can have in flight."),
+			NULL
+		},
+		&io_max_concurrency,
+		64, 1, 1024,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"io_workers",
+			PGC_POSTMASTER,
+			RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Number of I/O worker processes, for io_method = worker."),
+			NULL
+		},
+		&io_workers,
+		3, 1, MAX_IO_WORKERS,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"backend_flush_after", PGC_USERSET, RESOURCES_ASYNCHRONOUS,
 			gettext_noop("Number of pages after which previously performed writes are flushed to disk."),
@@ -4144,6 +4368,17 @@ static struct config_string ConfigureNamesString[] =
 		check_default_tablespace, NULL, NULL
 	},
 
+	{
+		{"io_direct", PGC_POSTMASTER, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Uses direct I/O for the given kinds of files, bypassing the kernel page cache."),
+			gettext_noop("Valid values are \"data\", \"wal\" and \"wal_init\"."),
+			GUC_LIST_INPUT
+		},
+		&io_direct_string,
+		"",
+		check_io_direct, assign_io_direct, NULL
+	},
+
 	{
 		{"temp_tablespaces", PGC_USERSET, CLIENT_CONN_STATEMENT,
 			gettext_noop("Sets the tablespace(s) to use for temporary tables and sort files."),
@@ -5100,6 +5335,16 @@ static struct config_enum ConfigureNamesEnum[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"io_method", PGC_POSTMASTER, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Selects the method for executing asynchronous I/O."),
+			NULL
+		},
+		&io_method,
+		DEFAULT_IO_METHOD, io_method_options,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"recovery_init_sync_method", PGC_SIGHUP, ERROR_HANDLING_OPTIONS,
 			gettext_noop("Sets the method for synchronizing the data directory before crash recovery."),
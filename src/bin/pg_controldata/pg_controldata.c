@@ -288,6 +288,8 @@ main(int argc, char *argv[])
 		   wal_level_str(ControlFile->wal_level));
 	printf(_("wal_log_hints setting:                %s\n"),
 		   ControlFile->wal_log_hints ? _("on") : _("off"));
+	printf(_("double_write_buffers setting:         %s\n"),
+		   ControlFile->double_write ? _("on") : _("off"));
 	printf(_("max_connections setting:              %d\n"),
 		   ControlFile->MaxConnections);
 	printf(_("max_worker_processes setting:         %d\n"),
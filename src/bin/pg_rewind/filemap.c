@@ -138,6 +138,9 @@ static const struct exclude_list_item excludeFiles[] =
 	/* Skip relation cache because it is rebuilt on startup */
 	{"pg_internal.init", true}, /* defined as RELCACHE_INIT_FILENAME */
 
+	/* Skip the double-write buffer, which is recreated on startup */
+	{"pg_double_write", false}, /* defined as DOUBLE_WRITE_FILENAME */
+
 	/*
 	 * If there is a backup_label or tablespace_map file, it indicates that a
 	 * recovery failed and this cluster probably can't be rewound, but exclude
@@ -23,10 +23,44 @@
 #include "access/xlogrecord.h"
 #include "access/xlogstats.h"
 #include "common/fe_memutils.h"
+#include "common/hashfn.h"
 #include "common/logging.h"
+#include "common/relpath.h"
 #include "getopt_long.h"
 #include "rmgrdesc.h"
 
+#ifdef WIN32
+/* Use Windows threads */
+#include <windows.h>
+#define THREAD_T HANDLE
+#define THREAD_FUNC_RETURN_TYPE unsigned
+#define THREAD_FUNC_RETURN return 0
+#define THREAD_FUNC_CC __stdcall
+#define THREAD_CREATE(handle, function, arg) \
+	((*(handle) = (HANDLE) _beginthreadex(NULL, 0, (function), (arg), 0, NULL)) == 0 ? errno : 0)
+#define THREAD_JOIN(handle) \
+	(WaitForSingleObject(handle, INFINITE) != WAIT_OBJECT_0 ? \
+	(_dosmaperr(GetLastError()), errno) : \
+	CloseHandle(handle) ? 0 : (_dosmaperr(GetLastError()), errno))
+#elif defined(ENABLE_THREAD_SAFETY)
+/* Use POSIX threads */
+#include "port/pg_pthread.h"
+#define THREAD_T pthread_t
+#define THREAD_FUNC_RETURN_TYPE void *
+#define THREAD_FUNC_RETURN return NULL
+#define THREAD_FUNC_CC
+#define THREAD_CREATE(handle, function, arg) \
+	pthread_create((handle), NULL, (function), (arg))
+#define THREAD_JOIN(handle) \
+	pthread_join((handle), NULL)
+#else
+/* No threads implementation, use none (-j 1) */
+#define THREAD_T void *
+#define THREAD_FUNC_RETURN_TYPE void *
+#define THREAD_FUNC_RETURN return NULL
+#define THREAD_FUNC_CC
+#endif
+
 /*
  * NOTE: For any code change or issue fix here, it is highly recommended to
  * give a thought about doing the same in pg_walinspect contrib module as well.
@@ -57,6 +91,8 @@ typedef struct XLogDumpConfig
 	bool		follow;
 	bool		stats;
 	bool		stats_per_record;
+	bool		stats_per_relation;
+	int			jobs;
 
 	/* filter options */
 	bool		filter_by_rmgr[RM_MAX_ID + 1];
@@ -72,6 +108,84 @@ typedef struct XLogDumpConfig
 	bool		filter_by_fpw;
 } XLogDumpConfig;
 
+/*
+ * Per-block statistics for --stats=relation.  The per-relation numbers are
+ * summed up from these when displayed.
+ */
+typedef struct XLogDumpBlockKey
+{
+	RelFileNode rnode;
+	ForkNumber	forknum;
+	BlockNumber blkno;
+} XLogDumpBlockKey;
+
+typedef struct XLogDumpBlockStats
+{
+	XLogDumpBlockKey key;		/* hash key */
+	char		status;			/* hash status */
+	uint64		count;			/* number of references to the block */
+	uint64		fpi_count;		/* number of full-page images */
+	uint64		fpi_len;		/* total size of full-page images */
+} XLogDumpBlockStats;
+
+#define SH_PREFIX		blockstats
+#define SH_ELEMENT_TYPE	XLogDumpBlockStats
+#define SH_KEY_TYPE		XLogDumpBlockKey
+#define SH_KEY			key
+#define SH_HASH_KEY(tb, key)	hash_bytes((const unsigned char *) &(key), sizeof(XLogDumpBlockKey))
+#define SH_EQUAL(tb, a, b)		(memcmp(&(a), &(b), sizeof(XLogDumpBlockKey)) == 0)
+#define SH_SCOPE		static inline
+#define SH_RAW_ALLOCATOR	pg_malloc0
+#define SH_DECLARE
+#define SH_DEFINE
+#include "lib/simplehash.h"
+
+#define BLOCKSTATS_INITIAL_SIZE	1024
+
+/* Per-relation statistics, for display */
+typedef struct XLogDumpRelStats
+{
+	RelFileNode rnode;
+	ForkNumber	forknum;
+	uint64		nblocks;		/* number of distinct blocks referenced */
+	uint64		count;
+	uint64		fpi_count;
+	uint64		fpi_len;
+} XLogDumpRelStats;
+
+/* Number of blocks shown in the list of most frequently modified blocks */
+#define XLOGDUMP_HOT_BLOCKS		20
+
+/*
+ * A worker for --stats with --jobs.  Each one reads the records that start
+ * between its startptr and endptr, the first one reading from the start
+ * record and the others from segment boundaries.  A record that crosses
+ * endptr is read to its end by the worker in which it starts.
+ *
+ * Like the serial case, we only report on the records before the first one
+ * that can't be read.  Once a worker fails, the ones after it stop early,
+ * since their results won't be used.
+ */
+typedef struct XLogDumpWorker
+{
+	XLogDumpConfig *config;
+	const char *waldir;
+	XLogRecPtr	startptr;
+	XLogRecPtr	endptr;
+	XLogDumpPrivate private;
+	struct XLogDumpWorker *workers; /* all workers, in WAL order */
+	int			index;			/* our position in workers */
+
+	/* results */
+	XLogStats	stats;
+	blockstats_hash *blocks;
+	char	   *errormsg;
+	XLogRecPtr	errptr;
+	volatile bool failed;		/* tells later workers to stop */
+
+	THREAD_T	thread;
+} XLogDumpWorker;
+
 
 /*
  * When sigint is called, just tell the system to exit at the next possible
@@ -439,6 +553,444 @@ XLogRecordHasFPW(XLogReaderState *record)
 	return false;
 }
 
+/*
+ * Boolean to return whether the given WAL record passes all the filters
+ * specified.
+ */
+static bool
+XLogDumpRecordMatches(XLogDumpConfig *config, XLogReaderState *record)
+{
+	if (config->filter_by_rmgr_enabled &&
+		!config->filter_by_rmgr[XLogRecGetRmid(record)])
+		return false;
+
+	if (config->filter_by_xid_enabled &&
+		config->filter_by_xid != XLogRecGetXid(record))
+		return false;
+
+	/* check for extended filtering */
+	if (config->filter_by_extended &&
+		!XLogRecordMatchesRelationBlock(record,
+										config->filter_by_relation_enabled ?
+										config->filter_by_relation :
+										emptyRelFileNode,
+										config->filter_by_relation_block_enabled ?
+										config->filter_by_relation_block :
+										InvalidBlockNumber,
+										config->filter_by_relation_forknum))
+		return false;
+
+	if (config->filter_by_fpw && !XLogRecordHasFPW(record))
+		return false;
+
+	return true;
+}
+
+/*
+ * Store per-block statistics for a given record.
+ */
+static void
+XLogDumpStoreBlockStats(blockstats_hash *blocks, XLogReaderState *record)
+{
+	int			block_id;
+
+	for (block_id = 0; block_id <= XLogRecMaxBlockId(record); block_id++)
+	{
+		XLogDumpBlockKey key;
+		XLogDumpBlockStats *entry;
+		bool		found;
+
+		memset(&key, 0, sizeof(key));
+		if (!XLogRecGetBlockTagExtended(record, block_id, &key.rnode,
+										&key.forknum, &key.blkno, NULL))
+			continue;
+
+		entry = blockstats_insert(blocks, key, &found);
+		if (!found)
+		{
+			entry->count = 0;
+			entry->fpi_count = 0;
+			entry->fpi_len = 0;
+		}
+
+		entry->count++;
+		if (XLogRecHasBlockImage(record, block_id))
+		{
+			entry->fpi_count++;
+			entry->fpi_len += XLogRecGetBlock(record, block_id)->bimg_len;
+		}
+	}
+}
+
+/*
+ * Add the statistics gathered by a worker to the totals.
+ */
+static void
+XLogDumpMergeStats(XLogStats *stats, blockstats_hash *blocks,
+				   XLogDumpWorker *worker)
+{
+	int			ri,
+				rj;
+
+	if (XLogRecPtrIsInvalid(worker->stats.endptr))
+		return;
+
+	stats->count += worker->stats.count;
+	if (worker->stats.endptr > stats->endptr)
+		stats->endptr = worker->stats.endptr;
+
+	for (ri = 0; ri <= RM_MAX_ID; ri++)
+	{
+		stats->rmgr_stats[ri].count += worker->stats.rmgr_stats[ri].count;
+		stats->rmgr_stats[ri].rec_len += worker->stats.rmgr_stats[ri].rec_len;
+		stats->rmgr_stats[ri].fpi_len += worker->stats.rmgr_stats[ri].fpi_len;
+
+		for (rj = 0; rj < MAX_XLINFO_TYPES; rj++)
+		{
+			XLogRecStats *dst = &stats->record_stats[ri][rj];
+			XLogRecStats *src = &worker->stats.record_stats[ri][rj];
+
+			dst->count += src->count;
+			dst->rec_len += src->rec_len;
+			dst->fpi_len += src->fpi_len;
+		}
+	}
+
+	if (worker->blocks != NULL)
+	{
+		blockstats_iterator it;
+		XLogDumpBlockStats *src;
+
+		blockstats_start_iterate(worker->blocks, &it);
+		while ((src = blockstats_iterate(worker->blocks, &it)) != NULL)
+		{
+			XLogDumpBlockStats *entry;
+			bool		found;
+
+			entry = blockstats_insert(blocks, src->key, &found);
+			if (!found)
+			{
+				entry->count = 0;
+				entry->fpi_count = 0;
+				entry->fpi_len = 0;
+			}
+			entry->count += src->count;
+			entry->fpi_count += src->fpi_count;
+			entry->fpi_len += src->fpi_len;
+		}
+	}
+}
+
+/*
+ * Has a worker reading earlier WAL than this one failed?
+ */
+static bool
+XLogDumpEarlierWorkerFailed(XLogDumpWorker *worker)
+{
+	for (int i = 0; i < worker->index; i++)
+	{
+		if (worker->workers[i].failed)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Read and gather statistics about the records in a worker's range.
+ */
+static THREAD_FUNC_RETURN_TYPE THREAD_FUNC_CC
+XLogDumpStatsWorker(void *arg)
+{
+	XLogDumpWorker *worker = (XLogDumpWorker *) arg;
+	XLogReaderState *state;
+	XLogRecord *record;
+	char	   *errormsg;
+
+	state = XLogReaderAllocate(WalSegSz, worker->waldir,
+							   XL_ROUTINE(.page_read = WALDumpReadPage,
+										  .segment_open = WALDumpOpenSegment,
+										  .segment_close = WALDumpCloseSegment),
+							   &worker->private);
+	if (!state)
+		pg_fatal("out of memory while allocating a WAL reading processor");
+
+	/*
+	 * If no record starts between our startptr and the end of the WAL to
+	 * read, because a single record spans all of it, there's nothing to do.
+	 * Failing to find a record for any other reason is an error, like failing
+	 * to read one.
+	 */
+	if (XLogRecPtrIsInvalid(XLogFindNextRecord(state, worker->startptr)))
+	{
+		if (!worker->private.endptr_reached)
+		{
+			worker->errormsg =
+				psprintf("could not find a valid record after %X/%X",
+						 LSN_FORMAT_ARGS(worker->startptr));
+			worker->errptr = worker->startptr;
+			worker->failed = true;
+		}
+		XLogReaderFree(state);
+		THREAD_FUNC_RETURN;
+	}
+
+	while (!time_to_stop && !XLogDumpEarlierWorkerFailed(worker))
+	{
+		record = XLogReadRecord(state, &errormsg);
+		if (!record)
+		{
+			if (errormsg)
+			{
+				worker->errormsg = pg_strdup(errormsg);
+				worker->errptr = state->ReadRecPtr;
+				worker->failed = true;
+			}
+			break;
+		}
+
+		/* the rest belongs to the next worker */
+		if (state->ReadRecPtr >= worker->endptr)
+			break;
+
+		if (!XLogDumpRecordMatches(worker->config, state))
+			continue;
+
+		XLogRecStoreStats(&worker->stats, state);
+		if (worker->blocks != NULL)
+			XLogDumpStoreBlockStats(worker->blocks, state);
+		worker->stats.endptr = state->EndRecPtr;
+	}
+
+	XLogReaderFree(state);
+	THREAD_FUNC_RETURN;
+}
+
+/*
+ * Gather statistics about the records between first_record and the end
+ * location with config->jobs threads, each reading a range of segments.
+ *
+ * Returns the error message of the first worker that failed to read a
+ * record, or NULL.  Only the records before that one are counted.
+ */
+static char *
+XLogDumpStatsParallel(XLogDumpConfig *config, XLogDumpPrivate *private,
+					  const char *waldir, XLogRecPtr first_record,
+					  XLogStats *stats, blockstats_hash *blocks,
+					  XLogRecPtr *errptr)
+{
+	XLogSegNo	startseg;
+	XLogSegNo	endseg;
+	uint64		nsegs;
+	int			njobs;
+	XLogDumpWorker *workers;
+	char	   *errormsg = NULL;
+	int			i;
+
+	Assert(!XLogRecPtrIsInvalid(private->endptr));
+
+	XLByteToSeg(first_record, startseg, WalSegSz);
+	XLByteToPrevSeg(private->endptr, endseg, WalSegSz);
+	nsegs = endseg >= startseg ? endseg - startseg + 1 : 1;
+	njobs = (int) Min((uint64) config->jobs, nsegs);
+
+	workers = pg_malloc0(sizeof(XLogDumpWorker) * njobs);
+	for (i = 0; i < njobs; i++)
+	{
+		XLogDumpWorker *worker = &workers[i];
+
+		worker->config = config;
+		worker->waldir = waldir;
+		worker->private = *private;
+		worker->workers = workers;
+		worker->index = i;
+		if (i == 0)
+			worker->startptr = first_record;
+		else
+		{
+			XLogSegNoOffsetToRecPtr(startseg + nsegs * i / njobs, 0,
+									WalSegSz, worker->startptr);
+			workers[i - 1].endptr = worker->startptr;
+		}
+		worker->endptr = private->endptr;
+		worker->stats.startptr = InvalidXLogRecPtr;
+		worker->stats.endptr = InvalidXLogRecPtr;
+		if (config->stats_per_relation)
+			worker->blocks = blockstats_create(BLOCKSTATS_INITIAL_SIZE, NULL);
+	}
+
+#if defined(WIN32) || defined(ENABLE_THREAD_SAFETY)
+	for (i = 0; i < njobs; i++)
+	{
+		errno = THREAD_CREATE(&workers[i].thread, XLogDumpStatsWorker,
+							  &workers[i]);
+		if (errno != 0)
+			pg_fatal("could not create thread: %m");
+	}
+	for (i = 0; i < njobs; i++)
+		THREAD_JOIN(workers[i].thread);
+#else
+	/* --jobs is rejected above 1 without threads, so this isn't reached */
+	Assert(njobs == 1);
+	XLogDumpStatsWorker(&workers[0]);
+#endif
+
+	for (i = 0; i < njobs; i++)
+	{
+		/* stop counting at the first record we couldn't read */
+		if (errormsg == NULL)
+		{
+			XLogDumpMergeStats(stats, blocks, &workers[i]);
+			if (workers[i].errormsg != NULL)
+			{
+				errormsg = workers[i].errormsg;
+				*errptr = workers[i].errptr;
+			}
+		}
+		if (workers[i].blocks != NULL)
+			blockstats_destroy(workers[i].blocks);
+	}
+	pg_free(workers);
+
+	return errormsg;
+}
+
+static int
+XLogDumpBlockKeyCmp(const void *a, const void *b)
+{
+	const XLogDumpBlockStats *ba = *(XLogDumpBlockStats *const *) a;
+	const XLogDumpBlockStats *bb = *(XLogDumpBlockStats *const *) b;
+
+	if (ba->key.rnode.spcNode != bb->key.rnode.spcNode)
+		return ba->key.rnode.spcNode < bb->key.rnode.spcNode ? -1 : 1;
+	if (ba->key.rnode.dbNode != bb->key.rnode.dbNode)
+		return ba->key.rnode.dbNode < bb->key.rnode.dbNode ? -1 : 1;
+	if (ba->key.rnode.relNode != bb->key.rnode.relNode)
+		return ba->key.rnode.relNode < bb->key.rnode.relNode ? -1 : 1;
+	if (ba->key.forknum != bb->key.forknum)
+		return ba->key.forknum < bb->key.forknum ? -1 : 1;
+	if (ba->key.blkno != bb->key.blkno)
+		return ba->key.blkno < bb->key.blkno ? -1 : 1;
+	return 0;
+}
+
+/* hottest blocks first */
+static int
+XLogDumpBlockCountCmp(const void *a, const void *b)
+{
+	const XLogDumpBlockStats *ba = *(XLogDumpBlockStats *const *) a;
+	const XLogDumpBlockStats *bb = *(XLogDumpBlockStats *const *) b;
+
+	if (ba->count != bb->count)
+		return ba->count > bb->count ? -1 : 1;
+	if (ba->fpi_len != bb->fpi_len)
+		return ba->fpi_len > bb->fpi_len ? -1 : 1;
+	return XLogDumpBlockKeyCmp(a, b);
+}
+
+/* relations with the most full-page image data first */
+static int
+XLogDumpRelStatsCmp(const void *a, const void *b)
+{
+	const XLogDumpRelStats *ra = (const XLogDumpRelStats *) a;
+	const XLogDumpRelStats *rb = (const XLogDumpRelStats *) b;
+
+	if (ra->fpi_len != rb->fpi_len)
+		return ra->fpi_len > rb->fpi_len ? -1 : 1;
+	if (ra->count != rb->count)
+		return ra->count > rb->count ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Display per-relation statistics, and the most frequently modified blocks.
+ */
+static void
+XLogDumpDisplayRelationStats(blockstats_hash *blocks)
+{
+	XLogDumpBlockStats **entries;
+	XLogDumpRelStats *rels;
+	blockstats_iterator it;
+	XLogDumpBlockStats *entry;
+	int			nentries = 0;
+	int			nrels = 0;
+	int			i;
+
+	entries = pg_malloc(sizeof(XLogDumpBlockStats *) * Max(blocks->members, 1));
+	blockstats_start_iterate(blocks, &it);
+	while ((entry = blockstats_iterate(blocks, &it)) != NULL)
+		entries[nentries++] = entry;
+
+	/* sum up the blocks of each relation fork */
+	qsort(entries, nentries, sizeof(XLogDumpBlockStats *), XLogDumpBlockKeyCmp);
+	rels = pg_malloc0(sizeof(XLogDumpRelStats) * Max(nentries, 1));
+	for (i = 0; i < nentries; i++)
+	{
+		XLogDumpRelStats *rel;
+
+		entry = entries[i];
+		if (nrels == 0 ||
+			!RelFileNodeEquals(rels[nrels - 1].rnode, entry->key.rnode) ||
+			rels[nrels - 1].forknum != entry->key.forknum)
+		{
+			rel = &rels[nrels++];
+			rel->rnode = entry->key.rnode;
+			rel->forknum = entry->key.forknum;
+		}
+		else
+			rel = &rels[nrels - 1];
+
+		rel->nblocks++;
+		rel->count += entry->count;
+		rel->fpi_count += entry->fpi_count;
+		rel->fpi_len += entry->fpi_len;
+	}
+	qsort(rels, nrels, sizeof(XLogDumpRelStats), XLogDumpRelStatsCmp);
+
+	printf("\nPer-relation statistics:\n");
+	printf("%-32s %-4s %20s %20s %20s %20s\n"
+		   "%-32s %-4s %20s %20s %20s %20s\n",
+		   "Relation", "Fork", "Blocks", "References", "FPIs", "FPI size",
+		   "--------", "----", "------", "----------", "----", "--------");
+	for (i = 0; i < nrels; i++)
+	{
+		XLogDumpRelStats *rel = &rels[i];
+
+		printf("%-32s %-4s "
+			   "%20" INT64_MODIFIER "u "
+			   "%20" INT64_MODIFIER "u "
+			   "%20" INT64_MODIFIER "u "
+			   "%20" INT64_MODIFIER "u\n",
+			   psprintf("%u/%u/%u", rel->rnode.spcNode, rel->rnode.dbNode,
+						rel->rnode.relNode),
+			   forkNames[rel->forknum],
+			   rel->nblocks, rel->count, rel->fpi_count, rel->fpi_len);
+	}
+
+	qsort(entries, nentries, sizeof(XLogDumpBlockStats *), XLogDumpBlockCountCmp);
+
+	printf("\nMost frequently modified blocks:\n");
+	printf("%-32s %-4s %20s %20s %20s %20s\n"
+		   "%-32s %-4s %20s %20s %20s %20s\n",
+		   "Relation", "Fork", "Block", "References", "FPIs", "FPI size",
+		   "--------", "----", "-----", "----------", "----", "--------");
+	for (i = 0; i < nentries && i < XLOGDUMP_HOT_BLOCKS; i++)
+	{
+		entry = entries[i];
+
+		printf("%-32s %-4s %20u "
+			   "%20" INT64_MODIFIER "u "
+			   "%20" INT64_MODIFIER "u "
+			   "%20" INT64_MODIFIER "u\n",
+			   psprintf("%u/%u/%u", entry->key.rnode.spcNode,
+						entry->key.rnode.dbNode, entry->key.rnode.relNode),
+			   forkNames[entry->key.forknum], entry->key.blkno,
+			   entry->count, entry->fpi_count, entry->fpi_len);
+	}
+
+	pg_free(rels);
+	pg_free(entries);
+}
+
 /*
  * Print a record to stdout
  */
@@ -523,7 +1075,8 @@ XLogDumpStatsRow(const char *name,
  * Display summary statistics about the records seen so far.
  */
 static void
-XLogDumpDisplayStats(XLogDumpConfig *config, XLogStats *stats)
+XLogDumpDisplayStats(XLogDumpConfig *config, XLogStats *stats,
+					 blockstats_hash *blocks)
 {
 	int			ri,
 				rj;
@@ -650,6 +1203,9 @@ XLogDumpDisplayStats(XLogDumpConfig *config, XLogStats *stats)
 		   total_rec_len, psprintf("[%.02f%%]", rec_len_pct),
 		   total_fpi_len, psprintf("[%.02f%%]", fpi_len_pct),
 		   total_len, "[100%]");
+
+	if (config->stats_per_relation)
+		XLogDumpDisplayRelationStats(blocks);
 }
 
 static void
@@ -666,6 +1222,7 @@ usage(void)
 	printf(_("  -f, --follow           keep retrying after reaching end of WAL\n"));
 	printf(_("  -F, --fork=FORK        only show records that modify blocks in fork FORK;\n"
 			 "                         valid names are main, fsm, vm, init\n"));
+	printf(_("  -j, --jobs=NUM         use this many threads to compute statistics\n"));
 	printf(_("  -n, --limit=N          number of records to display\n"));
 	printf(_("  -p, --path=PATH        directory in which to find log segment files or a\n"
 			 "                         directory with a ./pg_wal that contains such files\n"
@@ -680,8 +1237,10 @@ usage(void)
 	printf(_("  -V, --version          output version information, then exit\n"));
 	printf(_("  -w, --fullpage         only show records with a full page write\n"));
 	printf(_("  -x, --xid=XID          only show records with transaction ID XID\n"));
-	printf(_("  -z, --stats[=record]   show statistics instead of records\n"
-			 "                         (optionally, show per-record statistics)\n"));
+	printf(_("  -z, --stats[=record|relation]\n"
+			 "                         show statistics instead of records\n"
+			 "                         (optionally, show per-record statistics, or\n"
+			 "                         per-relation statistics and the hottest blocks)\n"));
 	printf(_("  -?, --help             show this help, then exit\n"));
 	printf(_("\nReport bugs to <%s>.\n"), PACKAGE_BUGREPORT);
 	printf(_("%s home page: <%s>\n"), PACKAGE_NAME, PACKAGE_URL);
@@ -698,8 +1257,10 @@ main(int argc, char **argv)
 	XLogStats	stats;
 	XLogRecord *record;
 	XLogRecPtr	first_record;
+	XLogRecPtr	errptr = InvalidXLogRecPtr;
+	blockstats_hash *blocks = NULL;
 	char	   *waldir = NULL;
-	char	   *errormsg;
+	char	   *errormsg = NULL;
 
 	static struct option long_options[] = {
 		{"bkp-details", no_argument, NULL, 'b'},
@@ -709,6 +1270,7 @@ main(int argc, char **argv)
 		{"fork", required_argument, NULL, 'F'},
 		{"fullpage", no_argument, NULL, 'w'},
 		{"help", no_argument, NULL, '?'},
+		{"jobs", required_argument, NULL, 'j'},
 		{"limit", required_argument, NULL, 'n'},
 		{"path", required_argument, NULL, 'p'},
 		{"quiet", no_argument, NULL, 'q'},
@@ -772,6 +1334,8 @@ main(int argc, char **argv)
 	config.filter_by_fpw = false;
 	config.stats = false;
 	config.stats_per_record = false;
+	config.stats_per_relation = false;
+	config.jobs = 1;
 
 	stats.startptr = InvalidXLogRecPtr;
 	stats.endptr = InvalidXLogRecPtr;
@@ -782,7 +1346,7 @@ main(int argc, char **argv)
 		goto bad_argument;
 	}
 
-	while ((option = getopt_long(argc, argv, "bB:e:fF:n:p:qr:R:s:t:wx:z",
+	while ((option = getopt_long(argc, argv, "bB:e:fF:j:n:p:qr:R:s:t:wx:z",
 								 long_options, &optindex)) != -1)
 	{
 		switch (option)
@@ -821,6 +1385,18 @@ main(int argc, char **argv)
 				}
 				config.filter_by_extended = true;
 				break;
+			case 'j':
+				if (sscanf(optarg, "%d", &config.jobs) != 1 ||
+					config.jobs < 1)
+				{
+					pg_log_error("invalid value \"%s\" for option %s", optarg, "-j/--jobs");
+					goto bad_argument;
+				}
+#if !defined(WIN32) && !defined(ENABLE_THREAD_SAFETY)
+				if (config.jobs != 1)
+					pg_fatal("threads are not supported on this platform; use -j1");
+#endif
+				break;
 			case 'n':
 				if (sscanf(optarg, "%d", &config.stop_after_records) != 1)
 				{
@@ -930,10 +1506,13 @@ main(int argc, char **argv)
 			case 'z':
 				config.stats = true;
 				config.stats_per_record = false;
+				config.stats_per_relation = false;
 				if (optarg)
 				{
 					if (strcmp(optarg, "record") == 0)
 						config.stats_per_record = true;
+					else if (strcmp(optarg, "relation") == 0)
+						config.stats_per_relation = true;
 					else if (strcmp(optarg, "rmgr") != 0)
 					{
 						pg_log_error("unrecognized value for option %s: %s",
@@ -955,6 +1534,28 @@ main(int argc, char **argv)
 		goto bad_argument;
 	}
 
+	if (config.jobs > 1)
+	{
+		if (!config.stats)
+		{
+			pg_log_error("option %s requires option %s to be specified",
+						 "-j/--jobs", "-z/--stats");
+			goto bad_argument;
+		}
+		if (config.follow)
+		{
+			pg_log_error("options %s and %s cannot be used together",
+						 "-j/--jobs", "-f/--follow");
+			goto bad_argument;
+		}
+		if (config.stop_after_records > 0)
+		{
+			pg_log_error("options %s and %s cannot be used together",
+						 "-j/--jobs", "-n/--limit");
+			goto bad_argument;
+		}
+	}
+
 	if ((optind + 2) < argc)
 	{
 		pg_log_error("too many command-line arguments (first is \"%s\")",
@@ -1061,6 +1662,17 @@ main(int argc, char **argv)
 		goto bad_argument;
 	}
 
+	/* the work can only be divided up if we know where it ends */
+	if (config.jobs > 1 && XLogRecPtrIsInvalid(private.endptr))
+	{
+		pg_log_error("option %s requires an end WAL location to be given",
+					 "-j/--jobs");
+		goto bad_argument;
+	}
+
+	if (config.stats_per_relation)
+		blocks = blockstats_create(BLOCKSTATS_INITIAL_SIZE, NULL);
+
 	/* done with argument parsing, do the actual work */
 
 	/* we have everything we need, start reading */
@@ -1097,7 +1709,12 @@ main(int argc, char **argv)
 	if (config.stats == true && !config.quiet)
 		stats.startptr = first_record;
 
-	for (;;)
+	if (config.jobs > 1)
+		errormsg = XLogDumpStatsParallel(&config, &private, waldir,
+										 first_record, &stats, blocks,
+										 &errptr);
+
+	while (config.jobs == 1)
 	{
 		if (time_to_stop)
 		{
@@ -1109,6 +1726,7 @@ main(int argc, char **argv)
 		record = XLogReadRecord(xlogreader_state, &errormsg);
 		if (!record)
 		{
+			errptr = xlogreader_state->ReadRecPtr;
 			if (!config.follow || private.endptr_reached)
 				break;
 			else
@@ -1119,27 +1737,7 @@ main(int argc, char **argv)
 		}
 
 		/* apply all specified filters */
-		if (config.filter_by_rmgr_enabled &&
-			!config.filter_by_rmgr[record->xl_rmid])
-			continue;
-
-		if (config.filter_by_xid_enabled &&
-			config.filter_by_xid != record->xl_xid)
-			continue;
-
-		/* check for extended filtering */
-		if (config.filter_by_extended &&
-			!XLogRecordMatchesRelationBlock(xlogreader_state,
-											config.filter_by_relation_enabled ?
-											config.filter_by_relation :
-											emptyRelFileNode,
-											config.filter_by_relation_block_enabled ?
-											config.filter_by_relation_block :
-											InvalidBlockNumber,
-											config.filter_by_relation_forknum))
-			continue;
-
-		if (config.filter_by_fpw && !XLogRecordHasFPW(xlogreader_state))
+		if (!XLogDumpRecordMatches(&config, xlogreader_state))
 			continue;
 
 		/* perform any per-record work */
@@ -1148,6 +1746,8 @@ main(int argc, char **argv)
 			if (config.stats == true)
 			{
 				XLogRecStoreStats(&stats, xlogreader_state);
+				if (config.stats_per_relation)
+					XLogDumpStoreBlockStats(blocks, xlogreader_state);
 				stats.endptr = xlogreader_state->EndRecPtr;
 			}
 			else
@@ -1162,15 +1762,14 @@ main(int argc, char **argv)
 	}
 
 	if (config.stats == true && !config.quiet)
-		XLogDumpDisplayStats(&config, &stats);
+		XLogDumpDisplayStats(&config, &stats, blocks);
 
 	if (time_to_stop)
 		exit(0);
 
 	if (errormsg)
 		pg_fatal("error in WAL record at %X/%X: %s",
-				 LSN_FORMAT_ARGS(xlogreader_state->ReadRecPtr),
-				 errormsg);
+				 LSN_FORMAT_ARGS(errptr), errormsg);
 
 	XLogReaderFree(xlogreader_state);
 
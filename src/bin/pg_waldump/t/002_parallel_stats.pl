@@ -0,0 +1,111 @@
+
+# Copyright (c) 2022, PostgreSQL Global Development Group
+
+# Check that --stats with --jobs reports the same as without, also when
+# reading stops at a broken record.
+use strict;
+use warnings;
+use Fcntl qw(SEEK_SET);
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+if (!check_pg_config("#define ENABLE_THREAD_SAFETY 1") && $windows_os == 0)
+{
+	plan skip_all => '--jobs requires thread safety';
+}
+
+# Small segments, so that the WAL below spans several of them
+my $node = PostgreSQL::Test::Cluster->new('main');
+$node->init(extra => ['--wal-segsize=1']);
+$node->append_conf(
+	'postgresql.conf', qq(
+autovacuum = off
+wal_keep_size = 64MB
+));
+$node->start;
+
+my $start_lsn =
+  $node->safe_psql('postgres', 'SELECT pg_current_wal_insert_lsn()');
+
+$node->safe_psql(
+	'postgres', q(
+CREATE TABLE stats_t (id int PRIMARY KEY, v int, pad text);
+INSERT INTO stats_t SELECT g, 0, repeat('a', 100) FROM generate_series(1, 20000) g;
+CHECKPOINT;
+UPDATE stats_t SET v = 1 WHERE id % 2 = 0;
+));
+
+# Remember a place in the middle of the WAL, well past the start of its
+# segment, where we break a record later
+my ($mid_lsn, $mid_file, $mid_offset);
+for (;;)
+{
+	$node->safe_psql('postgres',
+		'UPDATE stats_t SET v = v + 1 WHERE id % 10 = 0');
+	($mid_lsn, $mid_file, $mid_offset) = split /\|/,
+	  $node->safe_psql('postgres',
+		'SELECT lsn, file_name, file_offset FROM pg_current_wal_insert_lsn() lsn, pg_walfile_name_offset(lsn)'
+	  );
+	last if $mid_offset >= 65536;
+}
+
+$node->safe_psql(
+	'postgres', q(
+DELETE FROM stats_t WHERE id % 3 = 0;
+VACUUM stats_t;
+INSERT INTO stats_t SELECT g, 2, repeat('b', 100) FROM generate_series(20001, 30000) g;
+));
+
+my $end_lsn =
+  $node->safe_psql('postgres', 'SELECT pg_current_wal_insert_lsn()');
+$node->safe_psql('postgres', 'CHECKPOINT');
+$node->stop;
+
+my $waldir = $node->data_dir . '/pg_wal';
+
+sub waldump
+{
+	my @args = @_;
+	my ($stdout, $stderr) = run_command(
+		[
+			'pg_waldump', '--path', $waldir, '--start', $start_lsn,
+			'--end', $end_lsn, @args
+		]);
+	return ($stdout, $stderr);
+}
+
+foreach my $kind ('rmgr', 'record', 'relation')
+{
+	my ($serial, $serial_err) = waldump("--stats=$kind");
+	my ($parallel, $parallel_err) = waldump("--stats=$kind", '--jobs=4');
+
+	is($serial_err, '', "--stats=$kind succeeds");
+	like($serial, qr/Total/, "--stats=$kind shows statistics");
+	is($parallel, $serial, "--stats=$kind with --jobs matches serial");
+	is($parallel_err, $serial_err, "--stats=$kind with --jobs succeeds");
+}
+
+# Break the record at $mid_lsn.  Both ways of reading must report the
+# records before it, and the same error.
+open(my $fh, '+<', "$waldir/$mid_file")
+  or die "could not open \"$waldir/$mid_file\": $!";
+binmode $fh;
+sysseek($fh, $mid_offset, SEEK_SET)
+  or die "could not seek in \"$waldir/$mid_file\": $!";
+syswrite($fh, "\xff" x 16) == 16
+  or die "could not write \"$waldir/$mid_file\": $!";
+close($fh);
+
+my ($serial, $serial_err) = waldump('--stats=record');
+my ($parallel, $parallel_err) = waldump('--stats=record', '--jobs=4');
+
+like(
+	$serial_err,
+	qr/error in WAL record at \Q$mid_lsn\E/,
+	'serial --stats stops at the broken record');
+is($parallel_err, $serial_err, 'parallel --stats reports the same error');
+is($parallel, $serial,
+	'parallel --stats only counts the records before the broken one');
+
+done_testing();
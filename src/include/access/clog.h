@@ -39,8 +39,9 @@ typedef struct xl_clog_truncate
 extern void TransactionIdSetTreeStatus(TransactionId xid, int nsubxids,
 									   TransactionId *subxids, XidStatus status, XLogRecPtr lsn);
 extern XidStatus TransactionIdGetStatus(TransactionId xid, XLogRecPtr *lsn);
+extern int	CLOGPageForXid(TransactionId xid);
+extern bool PrefetchCLOGPage(int pageno, bool *hit);
 
-extern Size CLOGShmemBuffers(void);
 extern Size CLOGShmemSize(void);
 extern void CLOGShmemInit(void);
 extern void BootStrapCLOG(void);
@@ -22,6 +22,7 @@
 #include "access/tableam.h"
 #include "nodes/lockoptions.h"
 #include "nodes/primnodes.h"
+#include "storage/bufmgr.h"
 #include "storage/bufpage.h"
 #include "storage/dsm.h"
 #include "storage/lockdefs.h"
@@ -63,6 +64,17 @@ typedef struct HeapScanDescData
 	/* rs_numblocks is usually InvalidBlockNumber, meaning "scan whole rel" */
 	BufferAccessStrategy rs_strategy;	/* access strategy for reads */
 
+	/*
+	 * Read-ahead window: buffers read together with rs_cbuf by
+	 * ReadBufferRange(), but not yet handed out.  rs_rabuffers[i] holds block
+	 * rs_rablock + i; entries from rs_raindex up to rs_nrabuffers - 1 are
+	 * still pinned.
+	 */
+	BlockNumber rs_rablock;
+	int			rs_raindex;
+	int			rs_nrabuffers;
+	Buffer		rs_rabuffers[MAX_IO_COMBINE_LIMIT];
+
 	HeapTupleData rs_ctup;		/* current tuple in scan, if any */
 
 	/*
@@ -121,6 +133,9 @@ extern TableScanDesc heap_beginscan(Relation relation, Snapshot snapshot,
 extern void heap_setscanlimits(TableScanDesc scan, BlockNumber startBlk,
 							   BlockNumber numBlks);
 extern void heapgetpage(TableScanDesc scan, BlockNumber page);
+extern Buffer heap_scan_read_page(HeapScanDesc scan, BlockNumber page,
+								  int nahead);
+extern void heap_scan_release_readahead(HeapScanDesc scan);
 extern void heap_rescan(TableScanDesc scan, ScanKey key, bool set_params,
 						bool allow_strat, bool allow_sync, bool allow_pagemode);
 extern void heap_endscan(TableScanDesc scan);
@@ -30,6 +30,7 @@ typedef struct BulkInsertStateData
 {
 	BufferAccessStrategy strategy;	/* our BULKWRITE strategy object */
 	Buffer		current_buf;	/* current insertion target page */
+	BlockNumber already_extended_by;	/* blocks added by this bulk insert */
 } BulkInsertStateData;
 
 
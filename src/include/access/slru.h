@@ -14,6 +14,7 @@
 #define SLRU_H
 
 #include "access/xlogdefs.h"
+#include "port/atomics.h"
 #include "storage/lwlock.h"
 #include "storage/sync.h"
 
@@ -33,6 +34,20 @@
  */
 #define SLRU_PAGES_PER_SEGMENT	32
 
+/*
+ * Number of buffer slots per bank.  A page can only be held in the bank
+ * selected by its page number, so each bank can have its own lock and
+ * lookups only need to search one bank.  The number of buffers of every SLRU
+ * must be a multiple of this.
+ */
+#define SLRU_BANK_SIZE			16
+
+/*
+ * Maximum number of buffers of an SLRU, which is 1GB with the default 8kB
+ * block size.
+ */
+#define SLRU_MAX_ALLOWED_BUFFERS ((1024 * 1024 * 1024) / BLCKSZ)
+
 /*
  * Page status codes.  Note that these do not include the "dirty" bit.
  * page_dirty can be true only in the VALID or WRITE_IN_PROGRESS states;
@@ -52,11 +67,18 @@ typedef enum
  */
 typedef struct SlruSharedData
 {
-	LWLock	   *ControlLock;
-
 	/* Number of buffers managed by this SLRU structure */
 	int			num_slots;
 
+	/*
+	 * The buffer slots are divided into num_banks banks of SLRU_BANK_SIZE
+	 * consecutive slots.  A page can only be held in the bank selected by
+	 * SimpleLruGetBankno(), and that bank's lock protects the state of its
+	 * slots.
+	 */
+	int			num_banks;
+	LWLockPadded *bank_locks;
+
 	/*
 	 * Arrays holding info for each buffer slot.  Page number is undefined
 	 * when status is EMPTY, as is page_lru_count.
@@ -80,22 +102,25 @@ typedef struct SlruSharedData
 	int			lsn_groups_per_page;
 
 	/*----------
-	 * We mark a page "most recently used" by setting
-	 *		page_lru_count[slotno] = ++cur_lru_count;
-	 * The oldest page is therefore the one with the highest value of
-	 *		cur_lru_count - page_lru_count[slotno]
+	 * Each bank has its own LRU clock.  We mark a page "most recently used"
+	 * by setting
+	 *		page_lru_count[slotno] = ++bank_cur_lru_count[bankno];
+	 * The oldest page in a bank is therefore the one with the highest value
+	 * of
+	 *		bank_cur_lru_count[bankno] - page_lru_count[slotno]
 	 * The counts will eventually wrap around, but this calculation still
 	 * works as long as no page's age exceeds INT_MAX counts.
 	 *----------
 	 */
-	int			cur_lru_count;
+	int		   *bank_cur_lru_count;
 
 	/*
 	 * latest_page_number is the page number of the current end of the log;
 	 * this is not critical data, since we use it only to avoid swapping out
-	 * the latest page.
+	 * the latest page.  It's atomic because it is read and written under
+	 * different bank locks.
 	 */
-	int			latest_page_number;
+	pg_atomic_uint32 latest_page_number;
 
 	/* SLRU's index for statistics purposes (might not be unique) */
 	int			slru_stats_idx;
@@ -138,16 +163,38 @@ typedef struct SlruCtlData
 
 typedef SlruCtlData *SlruCtl;
 
+/*
+ * Return the bank that holds, or would hold, a given page.
+ */
+static inline int
+SimpleLruGetBankno(SlruCtl ctl, int pageno)
+{
+	return (uint32) pageno % ctl->shared->num_banks;
+}
+
+/*
+ * Return the lock protecting the bank that holds, or would hold, a given
+ * page.  It must be held to call most of the functions below.
+ */
+static inline LWLock *
+SimpleLruGetBankLock(SlruCtl ctl, int pageno)
+{
+	return &ctl->shared->bank_locks[SimpleLruGetBankno(ctl, pageno)].lock;
+}
+
 
+extern bool check_slru_buffers(const char *name, int *newval);
+extern int	SimpleLruAutotuneBuffers(int divisor, int max);
 extern Size SimpleLruShmemSize(int nslots, int nlsns);
 extern void SimpleLruInit(SlruCtl ctl, const char *name, int nslots, int nlsns,
-						  LWLock *ctllock, const char *subdir, int tranche_id,
-						  SyncRequestHandler sync_handler);
+						  const char *subdir, int buffer_tranche_id,
+						  int bank_tranche_id, SyncRequestHandler sync_handler);
 extern int	SimpleLruZeroPage(SlruCtl ctl, int pageno);
 extern int	SimpleLruReadPage(SlruCtl ctl, int pageno, bool write_ok,
 							  TransactionId xid);
 extern int	SimpleLruReadPage_ReadOnly(SlruCtl ctl, int pageno,
 									   TransactionId xid);
+extern bool SimpleLruPrefetchPage(SlruCtl ctl, int pageno, bool *hit);
 extern void SimpleLruWritePage(SlruCtl ctl, int slotno);
 extern void SimpleLruWriteAll(SlruCtl ctl, bool allow_redirtied);
 #ifdef USE_ASSERT_CHECKING
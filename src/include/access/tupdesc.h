@@ -75,6 +75,13 @@ typedef struct TupleConstr
  * context and go away when the context is freed.  We set the tdrefcount
  * field of such a descriptor to -1, while reference-counted descriptors
  * always have tdrefcount >= 0.
+ *
+ * tdfixedatts and tdnotnullatts describe the leading run of fixed-width
+ * attributes, whose offsets within a tuple's data do not depend on the
+ * data as long as none of them is null.  They are computed on first use
+ * by TupleDescComputeFixedAtts(), which also fills in those attributes'
+ * attcacheoff; -1 means not computed yet.  Anything that changes the
+ * attributes of an existing tupdesc must reset them to -1.
  */
 typedef struct TupleDescData
 {
@@ -82,6 +89,9 @@ typedef struct TupleDescData
 	Oid			tdtypeid;		/* composite type ID for tuple type */
 	int32		tdtypmod;		/* typmod for tuple type */
 	int			tdrefcount;		/* reference count, or -1 if not counting */
+	int			tdfixedatts;	/* # of leading fixed-width attributes */
+	int			tdnotnullatts;	/* # of leading fixed-width NOT NULL
+								 * attributes, <= tdfixedatts */
 	TupleConstr *constr;		/* constraints, or NULL if none */
 	/* attrs[N] is the description of Attribute Number N+1 */
 	FormData_pg_attribute attrs[FLEXIBLE_ARRAY_MEMBER];
@@ -108,6 +118,8 @@ extern void TupleDescCopy(TupleDesc dst, TupleDesc src);
 extern void TupleDescCopyEntry(TupleDesc dst, AttrNumber dstAttno,
 							   TupleDesc src, AttrNumber srcAttno);
 
+extern void TupleDescComputeFixedAtts(TupleDesc tupdesc);
+
 extern void FreeTupleDesc(TupleDesc tupdesc);
 
 extern void IncrTupleDescRefCount(TupleDesc tupdesc);
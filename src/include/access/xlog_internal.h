@@ -31,7 +31,7 @@
 /*
  * Each page of XLOG file has a header like this:
  */
-#define XLOG_PAGE_MAGIC 0xD110	/* can be used as WAL version indicator */
+#define XLOG_PAGE_MAGIC 0xD111	/* can be used as WAL version indicator */
 
 typedef struct XLogPageHeaderData
 {
@@ -242,6 +242,7 @@ typedef struct xl_parameter_change
 	int			wal_level;
 	bool		wal_log_hints;
 	bool		track_commit_timestamp;
+	bool		double_write;
 } xl_parameter_change;
 
 /* logs restore point */
@@ -258,6 +259,23 @@ typedef struct xl_overwrite_contrecord
 	TimestampTz overwrite_time;
 } xl_overwrite_contrecord;
 
+/*
+ * WAL compression dictionary for full-page images.  Readers remember the
+ * dictionaries they have seen, and full-page images compressed with
+ * BKPIMAGE_COMPRESS_ZSTD_DICT refer to them by ID.  A dictionary is logged
+ * again after every redo point it is used after, so that replay starting at
+ * any checkpoint knows all the dictionaries it needs.
+ */
+typedef struct xl_fpi_dictionary
+{
+	uint32		dict_id;		/* zstd dictionary ID, never 0 */
+	uint32		dict_len;		/* length of the dictionary */
+	RmgrId		dict_rmid;		/* kind of pages it was trained on */
+	/* dictionary content follows */
+} xl_fpi_dictionary;
+
+#define SizeOfFPIDictionary	(offsetof(xl_fpi_dictionary, dict_rmid) + sizeof(RmgrId))
+
 /* End of recovery mark, when we don't do an END_OF_RECOVERY checkpoint */
 typedef struct xl_end_of_recovery
 {
@@ -0,0 +1,43 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogdict.h
+ *		Dictionaries for compressing full-page images in WAL.
+ *
+ * Portions Copyright (c) 2022, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *		src/include/access/xlogdict.h
+ *-------------------------------------------------------------------------
+ */
+#ifndef XLOGDICT_H
+#define XLOGDICT_H
+
+#include "access/rmgr.h"
+#include "access/xlogdefs.h"
+
+/* Maximum size of a trained dictionary */
+#define XLOG_DICT_MAX_SIZE		(16 * 1024)
+
+/*
+ * Number of page images a dictionary is trained on.  zstd wants about 100
+ * times as much sample data as the dictionary it trains, so this is 2MB of
+ * samples for a 16kB dictionary with the default block size.  The sample
+ * area for each kind of page lives in shared memory.
+ */
+#define XLOG_DICT_NUM_SAMPLES	256
+
+/* GUCs */
+extern PGDLLIMPORT bool wal_compression_dictionary;
+
+extern Size XLogDictShmemSize(void);
+extern void XLogDictShmemInit(void);
+
+extern bool XLogDictCompress(RmgrId rmid, const char *page,
+							 XLogRecPtr RedoRecPtr,
+							 const char *source, int32 slen,
+							 char *dest, int32 capacity, int32 *dlen,
+							 uint32 *dict_id, XLogRecPtr *dict_lsn);
+extern void XLogDictCheckpoint(void);
+
+#endif							/* XLOGDICT_H */
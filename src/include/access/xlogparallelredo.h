@@ -0,0 +1,47 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogparallelredo.h
+ *		Declarations for parallel WAL redo.
+ *
+ * Portions Copyright (c) 2022, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *		src/include/access/xlogparallelredo.h
+ *-------------------------------------------------------------------------
+ */
+#ifndef XLOGPARALLELREDO_H
+#define XLOGPARALLELREDO_H
+
+#include "access/xlogreader.h"
+#include "common/relpath.h"
+#include "storage/block.h"
+#include "storage/relfilenode.h"
+
+/* Upper limit for recovery_parallel_workers */
+#define MAX_PARALLEL_REDO_WORKERS	64
+
+/* GUCs */
+extern PGDLLIMPORT int recovery_parallel_workers;
+
+extern Size ParallelRedoShmemSize(void);
+extern void ParallelRedoShmemInit(void);
+
+/* Called by the startup process */
+extern void ParallelRedoStartup(void);
+extern void ParallelRedoShutdown(void);
+extern bool ParallelRedoDispatch(XLogReaderState *record);
+extern void ParallelRedoWaitForWorkers(void);
+extern bool ParallelRedoActive(void);
+
+/* Invalid-page bookkeeping, see xlogutils.c */
+extern void ParallelRedoForgetInvalidPages(RelFileNode rnode,
+										   ForkNumber forkno,
+										   BlockNumber minblkno);
+extern void ParallelRedoForgetInvalidPagesDb(Oid dbid);
+extern bool ParallelRedoHaveInvalidPages(void);
+extern void ParallelRedoCheckInvalidPages(void);
+
+extern void ParallelRedoWorkerMain(Datum main_arg);
+
+#endif
@@ -140,6 +140,7 @@ typedef struct
 	uint16		hole_length;
 	uint16		bimg_len;
 	uint8		bimg_info;
+	uint32		bimg_dict_id;	/* for BKPIMAGE_COMPRESS_ZSTD_DICT */
 
 	/* Buffer holding the rmgr-specific data associated with this block */
 	bool		has_data;
@@ -316,6 +317,14 @@ struct XLogReaderState
 	 * data.
 	 */
 	bool		nonblocking;
+
+	/*
+	 * WAL compression dictionaries seen in XLOG_FPI_DICTIONARY records,
+	 * allocated on first use.  See XLogReaderRememberDictionary().
+	 */
+	struct XLogReaderDictionary *dictionaries;
+	int			next_dictionary;	/* slot to replace next */
+	void	   *zstd_dctx;		/* decompression context, if any */
 };
 
 /*
@@ -376,6 +385,10 @@ extern bool XLogReaderValidatePageHeader(XLogReaderState *state,
 /* Forget error produced by XLogReaderValidatePageHeader(). */
 extern void XLogReaderResetError(XLogReaderState *state);
 
+/* Remember a WAL compression dictionary, from an XLOG_FPI_DICTIONARY record */
+extern bool XLogReaderRememberDictionary(XLogReaderState *state,
+										 const char *data, Size len);
+
 /*
  * Error information from WALRead that both backend and frontend caller can
  * process.  Currently only errors from pg_pread can be reported.
@@ -135,7 +135,9 @@ typedef struct XLogRecordBlockImageHeader
 
 	/*
 	 * If BKPIMAGE_HAS_HOLE and BKPIMAGE_COMPRESSED(), an
-	 * XLogRecordBlockCompressHeader struct follows.
+	 * XLogRecordBlockCompressHeader struct follows.  If
+	 * BKPIMAGE_COMPRESS_ZSTD_DICT, the uint32 ID of the dictionary follows
+	 * that.
 	 */
 } XLogRecordBlockImageHeader;
 
@@ -150,10 +152,12 @@ typedef struct XLogRecordBlockImageHeader
 #define BKPIMAGE_COMPRESS_PGLZ	0x04
 #define BKPIMAGE_COMPRESS_LZ4	0x08
 #define BKPIMAGE_COMPRESS_ZSTD	0x10
+#define BKPIMAGE_COMPRESS_ZSTD_DICT	0x20	/* zstd with a dictionary logged
+											 * by XLOG_FPI_DICTIONARY */
 
 #define	BKPIMAGE_COMPRESSED(info) \
 	((info & (BKPIMAGE_COMPRESS_PGLZ | BKPIMAGE_COMPRESS_LZ4 | \
-			  BKPIMAGE_COMPRESS_ZSTD)) != 0)
+			  BKPIMAGE_COMPRESS_ZSTD | BKPIMAGE_COMPRESS_ZSTD_DICT)) != 0)
 
 /*
  * Extra header information used when page image has "hole" and
@@ -175,6 +179,7 @@ typedef struct XLogRecordBlockCompressHeader
 	(SizeOfXLogRecordBlockHeader + \
 	 SizeOfXLogRecordBlockImageHeader + \
 	 SizeOfXLogRecordBlockCompressHeader + \
+	 sizeof(uint32) + \
 	 sizeof(RelFileNode) + \
 	 sizeof(BlockNumber))
 
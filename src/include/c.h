@@ -1143,9 +1143,26 @@ typedef union PGAlignedBlock
 	int64		force_align_i64;
 } PGAlignedBlock;
 
-/* Same, but for an XLOG_BLCKSZ-sized buffer */
+/*
+ * Use this to declare a local variable holding a page that is passed to an
+ * smgr read or write routine, so that it is suitably aligned for direct I/O.
+ */
+typedef union PGIOAlignedBlock
+{
+#ifdef pg_attribute_aligned
+	pg_attribute_aligned(PG_IO_ALIGN_SIZE)
+#endif
+	char		data[BLCKSZ];
+	double		force_align_d;
+	int64		force_align_i64;
+} PGIOAlignedBlock;
+
+/* Same, but for an XLOG_BLCKSZ-sized buffer; also aligned for direct I/O */
 typedef union PGAlignedXLogBlock
 {
+#ifdef pg_attribute_aligned
+	pg_attribute_aligned(PG_IO_ALIGN_SIZE)
+#endif
 	char		data[XLOG_BLCKSZ];
 	double		force_align_d;
 	int64		force_align_i64;
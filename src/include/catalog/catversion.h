@@ -53,6 +53,6 @@
  */
 
 /*							yyyymmddN */
-#define CATALOG_VERSION_NO	202209061
+#define CATALOG_VERSION_NO	202209062
 
 #endif
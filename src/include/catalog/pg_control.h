@@ -22,7 +22,7 @@
 
 
 /* Version identifier for this pg_control format */
-#define PG_CONTROL_VERSION	1300
+#define PG_CONTROL_VERSION	1301
 
 /* Nonce key length, see below */
 #define MOCK_AUTH_NONCE_LEN		32
@@ -78,6 +78,7 @@ typedef struct CheckPoint
 #define XLOG_FPI						0xB0
 /* 0xC0 is used in Postgres 9.5-11 */
 #define XLOG_OVERWRITE_CONTRECORD		0xD0
+#define XLOG_FPI_DICTIONARY				0xE0
 
 
 /*
@@ -175,6 +176,7 @@ typedef struct ControlFileData
 	 */
 	int			wal_level;
 	bool		wal_log_hints;
+	bool		double_write;
 	int			MaxConnections;
 	int			max_worker_processes;
 	int			max_wal_senders;
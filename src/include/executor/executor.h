@@ -235,8 +235,12 @@ extern void EvalPlanQualEnd(EPQState *epqstate);
 /*
  * functions in execProcnode.c
  */
+extern PGDLLIMPORT int executor_batch_size;
+
 extern PlanState *ExecInitNode(Plan *node, EState *estate, int eflags);
 extern void ExecSetExecProcNode(PlanState *node, ExecProcNodeMtd function);
+extern void ExecSetExecProcNodeBatch(PlanState *node,
+									 ExecProcNodeBatchMtd function);
 extern Node *MultiExecProcNode(PlanState *node);
 extern void ExecEndNode(PlanState *node);
 extern bool ExecShutdownNode(PlanState *node);
@@ -260,6 +264,26 @@ ExecProcNode(PlanState *node)
 }
 #endif
 
+/* ----------------------------------------------------------------
+ *		ExecProcNodeBatch
+ *
+ *		Execute the given node to return the next batch of tuples.
+ *		Only valid if node->ExecProcNodeBatch is set.
+ * ----------------------------------------------------------------
+ */
+#ifndef FRONTEND
+static inline TupleBatch *
+ExecProcNodeBatch(PlanState *node)
+{
+	Assert(node->ExecProcNodeBatch != NULL);
+
+	if (node->chgParam != NULL) /* something changed? */
+		ExecReScan(node);		/* let ReScan handle this */
+
+	return node->ExecProcNodeBatch(node);
+}
+#endif
+
 /*
  * prototypes from functions in execExpr.c
  */
@@ -385,6 +409,33 @@ ExecProject(ProjectionInfo *projInfo)
 }
 #endif
 
+/*
+ * ExecProjectInto
+ *
+ * Like ExecProject(), but stores the result in the given slot rather than
+ * in the projection's own result slot.  The slot must have the same tuple
+ * descriptor and slot type as the projection's result slot.  This allows
+ * batch mode execution to project a whole batch of tuples without copying
+ * each result out of the shared result slot.
+ */
+#ifndef FRONTEND
+static inline TupleTableSlot *
+ExecProjectInto(ProjectionInfo *projInfo, TupleTableSlot *slot)
+{
+	TupleTableSlot *saveslot = projInfo->pi_state.resultslot;
+
+	Assert(slot->tts_ops == saveslot->tts_ops);
+	Assert(slot->tts_tupleDescriptor->natts ==
+		   saveslot->tts_tupleDescriptor->natts);
+
+	projInfo->pi_state.resultslot = slot;
+	(void) ExecProject(projInfo);
+	projInfo->pi_state.resultslot = saveslot;
+
+	return slot;
+}
+#endif
+
 /*
  * ExecQual - evaluate a qual prepared with ExecInitQual (possibly via
  * ExecPrepareQual).  Returns true if qual is satisfied, else false.
@@ -480,6 +531,9 @@ extern TupleTableSlot *ExecInitExtraTupleSlot(EState *estate,
 											  const TupleTableSlotOps *tts_ops);
 extern TupleTableSlot *ExecInitNullTupleSlot(EState *estate, TupleDesc tupType,
 											 const TupleTableSlotOps *tts_ops);
+extern TupleBatch *ExecInitTupleBatch(EState *estate, int nslots,
+									  TupleDesc tupledesc,
+									  const TupleTableSlotOps *tts_ops);
 extern TupleDesc ExecTypeFromTL(List *targetList);
 extern TupleDesc ExecCleanTypeFromTL(List *targetList);
 extern TupleDesc ExecTypeFromExprList(List *exprList);
@@ -29,6 +29,9 @@ typedef struct JitInstrumentation
 	/* number of emitted functions */
 	size_t		created_functions;
 
+	/* number of those reused from a code cache */
+	size_t		cached_functions;
+
 	/* accumulated time to generate code */
 	instr_time	generation_counter;
 
@@ -86,6 +89,8 @@ extern PGDLLIMPORT bool jit_dump_bitcode;
 extern PGDLLIMPORT bool jit_expressions;
 extern PGDLLIMPORT bool jit_profiling_support;
 extern PGDLLIMPORT bool jit_tuple_deforming;
+extern PGDLLIMPORT int jit_cache_entries;
+extern PGDLLIMPORT int jit_warmup_evaluations;
 extern PGDLLIMPORT double jit_above_cost;
 extern PGDLLIMPORT double jit_inline_above_cost;
 extern PGDLLIMPORT double jit_optimize_above_cost;
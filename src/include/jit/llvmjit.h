@@ -53,6 +53,18 @@ typedef struct LLVMJitContext
 
 	/* list of handles for code emitted via Orc */
 	List	   *handles;
+
+	/* generate code for, and look it up in, the per-backend code cache */
+	bool		use_cache;
+
+	/* pending module, set aside while generating code that may be cached */
+	LLVMModuleRef pending_module;
+
+	/* cache entries whose code is used by this context */
+	List	   *cache_entries;
+
+	/* cache entries created by this context, whose code isn't emitted yet */
+	List	   *cache_pending;
 } LLVMJitContext;
 
 /* llvm module containing information about types */
@@ -92,6 +104,8 @@ extern LLVMJitContext *llvm_create_context(int jitFlags);
 extern LLVMModuleRef llvm_mutable_module(LLVMJitContext *context);
 extern char *llvm_expand_funcname(LLVMJitContext *context, const char *basename);
 extern void *llvm_get_function(LLVMJitContext *context, const char *funcname);
+extern void *llvm_compile_cached_module(LLVMJitContext *context,
+										const char **funcname);
 extern void llvm_split_symbol_name(const char *name, char **modname, char **funcname);
 extern LLVMTypeRef llvm_pg_var_type(const char *varname);
 extern LLVMTypeRef llvm_pg_var_func_type(const char *varname);
@@ -114,6 +114,13 @@ typedef struct ExprState
 
 	Datum	   *innermost_domainval;
 	bool	   *innermost_domainnull;
+
+	/*
+	 * Instance specific values used by JIT compiled code that was generated
+	 * so it can be shared between structurally identical expressions.
+	 */
+#define FIELDNO_EXPRSTATE_JIT_CONSTS 17
+	Datum	   *jit_consts;
 } ExprState;
 
 
@@ -673,10 +680,14 @@ typedef struct EState
 	 * es_jit_worker_instr is the combined, on demand allocated,
 	 * instrumentation from all workers. The leader's instrumentation is kept
 	 * separate, and is combined on demand by ExplainPrintJITSummary().
+	 *
+	 * es_jit_pending lists the ExprStates that are interpreted until one of
+	 * them has been evaluated jit_warmup_evaluations times.
 	 */
 	int			es_jit_flags;
 	struct JitContext *es_jit;
 	struct JitInstrumentation *es_jit_worker_instr;
+	List	   *es_jit_pending;
 } EState;
 
 
@@ -984,6 +995,33 @@ typedef struct DomainConstraintState
  */
 typedef TupleTableSlot *(*ExecProcNodeMtd) (struct PlanState *pstate);
 
+/* ----------------
+ *	 TupleBatch
+ *
+ * A set of tuples returned by a single ExecProcNodeBatch call.  slots[0]
+ * through slots[nvalid - 1] hold the tuples, in scan order; all slots are
+ * of the type the node would return from ExecProcNode.  The batch, and the
+ * contents of its slots, belong to the node that returned it and remain
+ * valid only until the next call on that node.
+ * ----------------
+ */
+typedef struct TupleBatch
+{
+	int			nvalid;			/* number of valid entries in slots[] */
+	int			maxslots;		/* allocated length of slots[] */
+	TupleTableSlot **slots;		/* array of slots holding the tuples */
+} TupleBatch;
+
+/* ----------------
+ *	 ExecProcNodeBatchMtd
+ *
+ * This is the method called by ExecProcNodeBatch to return the next batch
+ * of tuples from an executor node.  It returns NULL if no more tuples are
+ * available; a batch that is returned always contains at least one tuple.
+ * ----------------
+ */
+typedef TupleBatch *(*ExecProcNodeBatchMtd) (struct PlanState *pstate);
+
 /* ----------------
  *		PlanState node
  *
@@ -1004,6 +1042,11 @@ typedef struct PlanState
 	ExecProcNodeMtd ExecProcNode;	/* function to return next tuple */
 	ExecProcNodeMtd ExecProcNodeReal;	/* actual function, if above is a
 										 * wrapper */
+	ExecProcNodeBatchMtd ExecProcNodeBatch; /* function to return next batch
+											 * of tuples, or NULL if the node
+											 * does not support batch mode */
+	ExecProcNodeBatchMtd ExecProcNodeBatchReal; /* actual function, if above
+												 * is a wrapper */
 
 	Instrumentation *instrument;	/* Optional runtime stats for this node */
 	WorkerInstrumentation *worker_instrument;	/* per-worker instrumentation */
@@ -1191,6 +1234,7 @@ typedef struct ResultState
 	ExprState  *resconstantqual;
 	bool		rs_done;		/* are we done? */
 	bool		rs_checkqual;	/* do we need to check the qual? */
+	TupleBatch *rs_batch;		/* result batch, in batch mode */
 } ResultState;
 
 /* ----------------
@@ -1434,6 +1478,11 @@ typedef struct SeqScanState
 {
 	ScanState	ss;				/* its first field is NodeTag */
 	Size		pscan_len;		/* size of parallel heap scan descriptor */
+	/* these fields are used in batch mode only: */
+	int			ss_BatchSize;	/* max tuples per batch */
+	TupleTableSlot **ss_BatchScanSlots; /* slots the scan reads into */
+	TupleBatch *ss_Batch;		/* batch returned to the parent */
+	bool		ss_BatchDone;	/* reached end of scan? */
 } SeqScanState;
 
 /* ----------------
@@ -1664,6 +1713,7 @@ typedef struct ParallelBitmapHeapState
  *		prefetch_pages	   # pages prefetch iterator is ahead of current
  *		prefetch_target    current target prefetch distance
  *		prefetch_maximum   maximum value for prefetch_target
+ *		readahead_pages    # upcoming pages already reported as read-ahead
  *		pscan_len		   size of the shared memory for parallel bitmap
  *		initialized		   is node is ready to iterate
  *		shared_tbmiterator	   shared iterator
@@ -1688,6 +1738,7 @@ typedef struct BitmapHeapScanState
 	int			prefetch_pages;
 	int			prefetch_target;
 	int			prefetch_maximum;
+	int			readahead_pages;
 	Size		pscan_len;
 	bool		initialized;
 	TBMSharedIterator *shared_tbmiterator;
@@ -2396,6 +2447,13 @@ typedef struct AggState
 										 * ->hash_pergroup */
 	ProjectionInfo *combinedproj;	/* projection machinery */
 	SharedAggInfo *shared_info; /* one entry per worker */
+	/* these fields are used by Parallel HashAggregate: */
+	struct ParallelHashAggState *hash_pstate;	/* shared state, or NULL */
+	struct SharedTuplestoreAccessor **hash_shared_parts;	/* accessors for
+															 * shared partitions */
+	/* these fields are used when the outer plan supports batch mode: */
+	TupleBatch *input_batch;	/* current input batch, or NULL */
+	int			input_batch_next;	/* next slot to return from input_batch */
 } AggState;
 
 /* ----------------
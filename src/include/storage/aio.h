@@ -0,0 +1,98 @@
+/*-------------------------------------------------------------------------
+ *
+ * aio.h
+ *	  Asynchronous I/O for relation data files.
+ *
+ * A backend can have up to io_max_concurrency vectored reads and writes in
+ * flight at once.  Each one is described by a PgAioHandle, which is acquired
+ * with pgaio_io_acquire(), started with pgaio_io_start_readv() or
+ * pgaio_io_start_writev(), and completed with pgaio_io_wait(), after which
+ * the handle must be given back with pgaio_io_release().
+ *
+ * With io_method = sync, the I/O is performed synchronously when it is
+ * started; with io_method = io_uring, it is handed to the kernel, and with
+ * io_method = worker, to an I/O worker process, and only waited for when the
+ * caller needs the result.  Either way the caller must keep the memory the
+ * iovecs point to valid until the I/O has completed.
+ *
+ *
+ * Portions Copyright (c) 1996-2022, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/storage/aio.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef AIO_H
+#define AIO_H
+
+#include "port/pg_iovec.h"
+
+#ifdef HAVE_LINUX_IO_URING_H
+#define USE_IO_URING
+#endif
+
+/* Possible values for io_method */
+typedef enum IoMethod
+{
+	IOMETHOD_SYNC,
+	IOMETHOD_WORKER,
+	IOMETHOD_IO_URING
+} IoMethod;
+
+/* We don't want the io_method GUC's default to depend on the platform */
+#define DEFAULT_IO_METHOD IOMETHOD_SYNC
+
+/* Upper limit of io_workers */
+#define MAX_IO_WORKERS 32
+
+typedef enum PgAioHandleState
+{
+	PGAIO_HS_IDLE,				/* not in use */
+	PGAIO_HS_ACQUIRED,			/* acquired, I/O not yet started */
+	PGAIO_HS_INFLIGHT,			/* I/O started, not yet known to be done */
+	PGAIO_HS_DONE				/* I/O finished, result is valid */
+} PgAioHandleState;
+
+typedef struct PgAioHandle
+{
+	PgAioHandleState state;
+	bool		is_write;
+	int			fd;				/* kernel file descriptor */
+	off_t		offset;
+	int			iovcnt;
+	struct iovec iov[PG_IOV_MAX];	/* must stay put while in flight */
+	uint32		wait_event_info;	/* reported while waiting for it */
+	int			worker_req;		/* I/O worker request slot, or -1 */
+
+	/* result: number of bytes transferred, or -1 with error set to errno */
+	ssize_t		result;
+	int			error;
+} PgAioHandle;
+
+/* GUC variables */
+extern PGDLLIMPORT int io_method;
+extern PGDLLIMPORT int io_max_concurrency;
+extern PGDLLIMPORT int io_workers;
+
+extern Size AioShmemSize(void);
+extern void AioShmemInit(void);
+extern void IoWorkerRegister(void);
+extern void IoWorkerMain(Datum main_arg);
+
+extern PgAioHandle *pgaio_io_acquire(void);
+extern void pgaio_io_start_readv(PgAioHandle *ioh, int fd, const char *path,
+								 int flags, const struct iovec *iov,
+								 int iovcnt, off_t offset,
+								 uint32 wait_event_info);
+extern void pgaio_io_start_writev(PgAioHandle *ioh, int fd, const char *path,
+								  int flags, const struct iovec *iov,
+								  int iovcnt, off_t offset,
+								  uint32 wait_event_info);
+extern ssize_t pgaio_io_wait(PgAioHandle *ioh);
+extern bool pgaio_io_poll(PgAioHandle *ioh);
+extern void pgaio_io_release(PgAioHandle *ioh);
+extern int	pgaio_io_inflight_count(void);
+extern void pgaio_at_error(void);
+
+#endif							/* AIO_H */
@@ -0,0 +1,40 @@
+/*-------------------------------------------------------------------------
+ *
+ * doublewrite.h
+ *	  Double-write buffer protecting data-file writes against torn pages.
+ *
+ *
+ * Portions Copyright (c) 1996-2022, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/storage/doublewrite.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef DOUBLEWRITE_H
+#define DOUBLEWRITE_H
+
+#include "storage/buf_internals.h"
+
+/* Name of the double-write buffer file, relative to the data directory */
+#define DOUBLE_WRITE_FILENAME	"pg_double_write"
+
+/* GUC variable */
+extern PGDLLIMPORT int double_write_buffers;
+
+extern Size DoubleWriteShmemSize(void);
+extern void DoubleWriteShmemInit(void);
+
+extern bool DoubleWriteEnabled(void);
+extern void DoubleWriteStartup(bool didCrash);
+
+extern bool DoubleWriteReserve(int n, uint64 *seq, bool nowait);
+extern void DoubleWriteWrite(uint64 seq, const BufferTag *tags,
+							 char **pages, int n);
+extern void DoubleWriteDone(uint64 seq, int n);
+extern void DoubleWriteAbort(void);
+
+extern uint64 DoubleWriteCheckpointHorizon(void);
+extern void DoubleWriteCheckpointDone(uint64 horizon);
+
+#endif							/* DOUBLEWRITE_H */
@@ -27,8 +27,11 @@ extern BlockNumber RecordAndGetPageWithFreeSpace(Relation rel,
 												 Size spaceNeeded);
 extern void RecordPageWithFreeSpace(Relation rel, BlockNumber heapBlk,
 									Size spaceAvail);
+extern void RecordPagesWithFreeSpace(Relation rel, BlockNumber firstBlk,
+									 BlockNumber nblocks, Size spaceAvail);
 extern void XLogRecordPageWithFreeSpace(RelFileNode rnode, BlockNumber heapBlk,
 										Size spaceAvail);
+extern BlockNumber FreeSpaceMapBlockForHeapBlock(BlockNumber heapBlk);
 
 extern BlockNumber FreeSpaceMapPrepareTruncateRel(Relation rel,
 												  BlockNumber nblocks);
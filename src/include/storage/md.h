@@ -28,12 +28,23 @@ extern bool mdexists(SMgrRelation reln, ForkNumber forknum);
 extern void mdunlink(RelFileNodeBackend rnode, ForkNumber forknum, bool isRedo);
 extern void mdextend(SMgrRelation reln, ForkNumber forknum,
 					 BlockNumber blocknum, char *buffer, bool skipFsync);
+extern void mdzeroextend(SMgrRelation reln, ForkNumber forknum,
+						 BlockNumber blocknum, int nblocks, bool skipFsync);
 extern bool mdprefetch(SMgrRelation reln, ForkNumber forknum,
 					   BlockNumber blocknum);
 extern void mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 				   char *buffer);
+extern void mdreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+					char **buffers, BlockNumber nblocks);
+extern BlockNumber mdstartreadv(SMgrRelation reln, ForkNumber forknum,
+								BlockNumber blocknum, char **buffers,
+								BlockNumber nblocks, struct PgAioHandle *ioh);
 extern void mdwrite(SMgrRelation reln, ForkNumber forknum,
 					BlockNumber blocknum, char *buffer, bool skipFsync);
+extern BlockNumber mdstartwritev(SMgrRelation reln, ForkNumber forknum,
+								 BlockNumber blocknum, char **buffers,
+								 BlockNumber nblocks, bool skipFsync,
+								 struct PgAioHandle *ioh);
 extern void mdwriteback(SMgrRelation reln, ForkNumber forknum,
 						BlockNumber blocknum, BlockNumber nblocks);
 extern BlockNumber mdnblocks(SMgrRelation reln, ForkNumber forknum);
@@ -458,10 +458,34 @@ extern void assign_temp_tablespaces(const char *newval, void *extra);
 extern bool check_search_path(char **newval, void **extra, GucSource source);
 extern void assign_search_path(const char *newval, void *extra);
 
+/* in access/transam/clog.c */
+extern bool check_transaction_buffers(int *newval, void **extra, GucSource source);
+
+/* in access/transam/commit_ts.c */
+extern bool check_commit_ts_buffers(int *newval, void **extra, GucSource source);
+
+/* in access/transam/multixact.c */
+extern bool check_multixact_member_buffers(int *newval, void **extra, GucSource source);
+extern bool check_multixact_offset_buffers(int *newval, void **extra, GucSource source);
+
+/* in access/transam/subtrans.c */
+extern bool check_subtrans_buffers(int *newval, void **extra, GucSource source);
+
+/* in commands/async.c */
+extern bool check_notify_buffers(int *newval, void **extra, GucSource source);
+
+/* in storage/lmgr/predicate.c */
+extern bool check_serial_buffers(int *newval, void **extra, GucSource source);
+
 /* in access/transam/xlog.c */
 extern bool check_wal_buffers(int *newval, void **extra, GucSource source);
+extern bool check_wal_insert_locks(int *newval, void **extra, GucSource source);
 extern void assign_xlog_sync_method(int new_sync_method, void *extra);
 
+/* in storage/file/fd.c */
+extern bool check_io_direct(char **newval, void **extra, GucSource source);
+extern void assign_io_direct(const char *newval, void *extra);
+
 /* in access/transam/xlogprefetcher.c */
 extern bool check_recovery_prefetch(int *new_value, void **extra, GucSource source);
 extern void assign_recovery_prefetch(int new_value, void *extra);
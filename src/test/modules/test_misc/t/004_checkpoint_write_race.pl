@@ -0,0 +1,61 @@
+
+# Copyright (c) 2022, PostgreSQL Global Development Group
+
+# Race backend reads and writes against the checkpointer's combined
+# asynchronous writes.  With a tiny shared_buffers, backends constantly evict
+# and re-read buffers that the checkpointer is in the middle of writing, and
+# the checkpointer keeps running into buffers with I/O in progress.  A buffer
+# left with BM_IO_IN_PROGRESS would make the next reader or checkpoint hang;
+# statement_timeout turns such a hang into a failure.
+
+use strict;
+use warnings;
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $node = PostgreSQL::Test::Cluster->new('main');
+$node->init;
+$node->append_conf(
+	'postgresql.conf', qq(
+shared_buffers = 256kB
+io_combine_limit = 16
+checkpoint_flush_after = 0
+statement_timeout = '60s'
+));
+$node->start;
+
+$node->safe_psql(
+	'postgres', q(
+CREATE TABLE race (id int PRIMARY KEY, v int, pad text)
+  WITH (fillfactor = 50);
+INSERT INTO race
+  SELECT g, 0, repeat('x', 200) FROM generate_series(1, 20000) g;
+));
+
+$node->pgbench(
+	'--no-vacuum --client=8 --time=15',
+	0,
+	[ qr{processed: [1-9]} ],
+	[qr{^$}],
+	'backend reads and writes race with checkpoint writes',
+	{
+		'004_race_rw@20' => q{
+\set id random(1, 19500)
+UPDATE race SET v = v + 1 WHERE id = :id;
+SELECT count(*) FROM race WHERE id BETWEEN :id AND :id + 500;
+},
+		'004_race_checkpoint@1' => q{
+CHECKPOINT;
+}
+	});
+
+# Every buffer must be usable again: read the whole table and checkpoint.
+is( $node->safe_psql(
+		'postgres', 'SELECT count(*), sum(v) > 0 FROM race; CHECKPOINT;'),
+	'20000|t',
+	'all buffers are usable after the race');
+
+$node->stop;
+
+done_testing();
@@ -0,0 +1,57 @@
+
+# Copyright (c) 2022, PostgreSQL Global Development Group
+
+# Test reads and writes through I/O worker processes.
+use strict;
+use warnings;
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $node = PostgreSQL::Test::Cluster->new('main');
+$node->init;
+
+# A small buffer pool, so that scans and checkpoints do actual I/O
+$node->append_conf(
+	'postgresql.conf', qq(
+io_method = worker
+io_workers = 2
+shared_buffers = 1MB
+effective_io_concurrency = 16
+autovacuum = off
+));
+$node->start;
+
+$node->poll_query_until('postgres',
+	"SELECT count(*) = 2 FROM pg_stat_activity WHERE backend_type = 'io worker'"
+) or die "timed out waiting for I/O workers to start";
+
+$node->safe_psql(
+	'postgres', q(
+CREATE TABLE io_t (id int, pad text);
+INSERT INTO io_t SELECT g, repeat('x', 200) FROM generate_series(1, 50000) g;
+CHECKPOINT;
+UPDATE io_t SET id = id + 1 WHERE id % 7 = 0;
+CHECKPOINT;
+));
+
+my $check = 'SELECT count(*), sum(id) FROM io_t';
+my $expected = '50000|1250032142';
+is($node->safe_psql('postgres', $check),
+	$expected, 'sequential scan reads through I/O workers');
+
+# After a restart, everything comes from disk
+$node->restart;
+is($node->safe_psql('postgres', $check),
+	$expected, 'data written through I/O workers survives a restart');
+
+# Backends do their I/O themselves while no I/O worker is running
+$node->safe_psql('postgres',
+	"SELECT pg_terminate_backend(pid) FROM pg_stat_activity WHERE backend_type = 'io worker'"
+);
+is($node->safe_psql('postgres', $check),
+	$expected, 'scan works while I/O workers restart');
+
+$node->stop;
+
+done_testing();
@@ -0,0 +1,117 @@
+
+# Copyright (c) 2022, PostgreSQL Global Development Group
+
+# Test that crash recovery repairs a torn page from the double-write buffer.
+#
+# With double_write_buffers set, no full-page images are written to WAL, so
+# WAL replay alone cannot fix a page whose data-file write was interrupted
+# half way.  We simulate that by putting the old contents back into the
+# first half of a block that was written after the last checkpoint, and
+# check that the block is restored before replay.
+#
+# Also check that a standby refuses to replay such WAL without a
+# double-write buffer of its own.
+
+use strict;
+use warnings;
+use Fcntl qw(SEEK_SET);
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $node = PostgreSQL::Test::Cluster->new('main');
+$node->init;
+
+# A tiny buffer pool, so that the UPDATE below has to evict dirty pages
+# through the double-write buffer itself, and a ring large enough that none
+# of its slots are retired before the crash.
+$node->append_conf(
+	'postgresql.conf', qq(
+shared_buffers = 128kB
+double_write_buffers = 1024
+autovacuum = off
+bgwriter_lru_maxpages = 0
+));
+$node->start;
+
+$node->safe_psql(
+	'postgres', q(
+CREATE TABLE torn (id int, v int) WITH (fillfactor = 50);
+INSERT INTO torn SELECT g, 0 FROM generate_series(1, 20000) g;
+CHECKPOINT;
+));
+
+my $relpath = $node->safe_psql('postgres',
+	"SELECT pg_relation_filepath('torn')");
+my $file = $node->data_dir . '/' . $relpath;
+my $blcksz = $node->safe_psql('postgres', 'SHOW block_size');
+
+# Remember the first block as of the checkpoint
+open(my $fh, '+<', $file) or die "could not open \"$file\": $!";
+binmode $fh;
+my $old_block;
+sysseek($fh, 0, SEEK_SET) or die "could not seek in \"$file\": $!";
+sysread($fh, $old_block, $blcksz) == $blcksz
+  or die "could not read \"$file\": $!";
+
+$node->safe_psql('postgres', 'UPDATE torn SET v = 1;');
+
+$node->stop('immediate');
+
+# Tear the first block: old first half, new second half
+my $new_block;
+sysseek($fh, 0, SEEK_SET) or die "could not seek in \"$file\": $!";
+sysread($fh, $new_block, $blcksz) == $blcksz
+  or die "could not read \"$file\": $!";
+isnt($new_block, $old_block, 'first block was written after the checkpoint');
+
+sysseek($fh, 0, SEEK_SET) or die "could not seek in \"$file\": $!";
+syswrite($fh, substr($old_block, 0, $blcksz / 2)) == $blcksz / 2
+  or die "could not write \"$file\": $!";
+close($fh);
+
+my $log_offset = -s $node->logfile;
+$node->start;
+
+like(
+	slurp_file($node->logfile, $log_offset),
+	qr/restored \d+ pages? from double-write buffer/,
+	'torn page restored from double-write buffer');
+
+is( $node->safe_psql(
+		'postgres', 'SELECT count(*), min(v), max(v) FROM torn'),
+	'20000|1|1',
+	'all rows have their updated values after recovery');
+
+$node->stop;
+
+my $node_primary = PostgreSQL::Test::Cluster->new('primary');
+$node_primary->init(allows_streaming => 1);
+$node_primary->append_conf('postgresql.conf', 'double_write_buffers = 64');
+$node_primary->start;
+$node_primary->backup('my_backup');
+
+my $node_standby = PostgreSQL::Test::Cluster->new('standby');
+$node_standby->init_from_backup($node_primary, 'my_backup',
+	has_streaming => 1);
+$node_standby->append_conf('postgresql.conf', 'double_write_buffers = 0');
+$log_offset = -s $node_standby->logfile;
+is($node_standby->start(fail_ok => 1),
+	0, 'standby without double-write buffer does not start');
+like(
+	slurp_file($node_standby->logfile, $log_offset),
+	qr/WAL was generated with double_write_buffers enabled/,
+	'standby reports the missing double-write buffer');
+
+$node_standby->append_conf('postgresql.conf', 'double_write_buffers = 64');
+$node_standby->start;
+$node_primary->safe_psql('postgres',
+	'CREATE TABLE after_standby AS SELECT 1 AS a');
+$node_primary->wait_for_catchup($node_standby);
+is($node_standby->safe_psql('postgres', 'SELECT a FROM after_standby'),
+	'1', 'standby with double-write buffer replays');
+
+$node_standby->stop;
+$node_primary->stop;
+
+done_testing();
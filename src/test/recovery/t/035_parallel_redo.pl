@@ -0,0 +1,108 @@
+
+# Copyright (c) 2022, PostgreSQL Global Development Group
+
+# Test WAL replay with recovery_parallel_workers, both in crash recovery and
+# on a hot standby that is queried while it replays.
+use strict;
+use warnings;
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $node_primary = PostgreSQL::Test::Cluster->new('primary');
+$node_primary->init(allows_streaming => 1);
+$node_primary->append_conf(
+	'postgresql.conf', qq(
+recovery_parallel_workers = 4
+max_worker_processes = 16
+autovacuum = off
+));
+$node_primary->start;
+
+$node_primary->backup('my_backup');
+
+my $node_standby = PostgreSQL::Test::Cluster->new('standby');
+$node_standby->init_from_backup($node_primary, 'my_backup',
+	has_streaming => 1);
+$node_standby->start;
+
+# A workload that touches many blocks of a few relations and their indexes,
+# spreads each relation over several workers, extends the relations
+# concurrently, and leaves records for the standby to resolve conflicts for.
+my $workload = q(
+CREATE TABLE pr_a (id int PRIMARY KEY, v int, pad text);
+CREATE TABLE pr_b (id int, v int, pad text);
+CREATE INDEX pr_b_v ON pr_b USING hash (v);
+INSERT INTO pr_a SELECT g, 0, repeat('a', 100) FROM generate_series(1, 20000) g;
+INSERT INTO pr_b SELECT g, g % 100, repeat('b', 100) FROM generate_series(1, 20000) g;
+VACUUM pr_a, pr_b;
+UPDATE pr_a SET v = v + 1 WHERE id % 3 = 0;
+DELETE FROM pr_b WHERE id % 5 = 0;
+VACUUM pr_b;
+INSERT INTO pr_b SELECT g, g % 100, repeat('c', 100) FROM generate_series(20001, 30000) g;
+UPDATE pr_a SET v = v + 1 WHERE id % 7 = 0;
+);
+my $check = q(
+SET enable_seqscan = off;
+SELECT count(*), sum(v) FROM pr_a WHERE id > 0;
+SELECT count(*), sum(v) FROM pr_b WHERE v = 42;
+RESET enable_seqscan;
+SELECT count(*), sum(v), sum(length(pad)) FROM pr_b;
+);
+
+# Hot standby: query the standby repeatedly while it replays the workload
+$node_primary->safe_psql('postgres', $workload);
+for my $i (1 .. 10)
+{
+	$node_primary->safe_psql('postgres',
+		"UPDATE pr_a SET v = v + 1 WHERE id % 10 = $i % 10");
+	$node_standby->safe_psql('postgres',
+		'SELECT count(*) FROM pr_a WHERE id BETWEEN 1 AND 1000');
+}
+$node_primary->wait_for_catchup($node_standby);
+
+my $expected = $node_primary->safe_psql('postgres', $check);
+is($node_standby->safe_psql('postgres', $check),
+	$expected, 'hot standby replayed with parallel workers matches primary');
+
+# Each committed transaction must be visible together with all of its changes
+$node_primary->safe_psql('postgres',
+	'CREATE TABLE pr_c (id int PRIMARY KEY, v int)');
+$node_primary->safe_psql('postgres',
+	'INSERT INTO pr_c SELECT g, 0 FROM generate_series(1, 1000) g');
+$node_primary->wait_for_catchup($node_standby);
+for my $i (1 .. 20)
+{
+	$node_primary->safe_psql('postgres', "UPDATE pr_c SET v = $i");
+}
+my $torn = 0;
+for my $i (1 .. 20)
+{
+	$torn++
+	  if $node_standby->safe_psql('postgres',
+		'SELECT count(DISTINCT v) FROM pr_c') ne '1';
+}
+is($torn, 0, 'hot standby never sees part of a transaction');
+$node_primary->wait_for_catchup($node_standby);
+is($node_standby->safe_psql('postgres', 'SELECT min(v), max(v) FROM pr_c'),
+	'20|20', 'all updates of pr_c replayed');
+
+# Crash recovery
+$node_primary->safe_psql('postgres',
+	"CHECKPOINT; DROP TABLE pr_a, pr_b; $workload");
+$expected = $node_primary->safe_psql('postgres', $check);
+$node_primary->stop('immediate');
+
+my $log_offset = -s $node_primary->logfile;
+$node_primary->start;
+like(
+	slurp_file($node_primary->logfile, $log_offset),
+	qr/redo done at/,
+	'crash recovery completed');
+is($node_primary->safe_psql('postgres', $check),
+	$expected, 'crash recovery with parallel workers restored all changes');
+
+$node_standby->stop;
+$node_primary->stop;
+
+done_testing();
@@ -0,0 +1,100 @@
+
+# Copyright (c) 2022, PostgreSQL Global Development Group
+
+# Test full-page images compressed with WAL compression dictionaries: train
+# a dictionary, rotate it at a later checkpoint, and check that both a
+# standby and crash recovery replay the images, and that pg_waldump reads
+# them.
+use strict;
+use warnings;
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+if (!check_pg_config("#define USE_ZSTD 1"))
+{
+	plan skip_all => 'zstd not supported by this build';
+}
+
+my $node_primary = PostgreSQL::Test::Cluster->new('primary');
+$node_primary->init(allows_streaming => 1);
+$node_primary->append_conf(
+	'postgresql.conf', qq(
+wal_compression = zstd
+wal_compression_dictionary = on
+wal_keep_size = 256MB
+autovacuum = off
+));
+$node_primary->start;
+
+$node_primary->backup('my_backup');
+
+my $node_standby = PostgreSQL::Test::Cluster->new('standby');
+$node_standby->init_from_backup($node_primary, 'my_backup',
+	has_streaming => 1);
+$node_standby->start;
+
+my $start_lsn =
+  $node_primary->safe_psql('postgres', 'SELECT pg_current_wal_insert_lsn()');
+
+# Enough heap pages that one pass over the table fills the sample area
+$node_primary->safe_psql(
+	'postgres', q(
+CREATE TABLE dict_t (id int, v int, pad text) WITH (fillfactor = 90);
+INSERT INTO dict_t SELECT g, 0, repeat('a', 200) FROM generate_series(1, 20000) g;
+CHECKPOINT;
+));
+
+# Each pass after a checkpoint logs an image of every page.  The first pass
+# collects samples, the checkpoint after it trains the first dictionary, the
+# second pass is compressed with it and collects samples that look different
+# enough for the checkpoint after that to train a new dictionary, and the
+# third pass uses the new one.
+$node_primary->safe_psql(
+	'postgres', q(
+UPDATE dict_t SET v = 1;
+CHECKPOINT;
+UPDATE dict_t SET v = 2, pad = repeat('b', 150) || id;
+CHECKPOINT;
+UPDATE dict_t SET v = 3;
+));
+my $check = 'SELECT count(*), sum(v), sum(length(pad)) FROM dict_t';
+my $expected = $node_primary->safe_psql('postgres', $check);
+like($expected, qr/^20000\|60000\|/, 'all rows updated on primary');
+
+$node_primary->wait_for_catchup($node_standby);
+is($node_standby->safe_psql('postgres', $check),
+	$expected, 'standby replayed images compressed with dictionaries');
+
+# Crash recovery, starting at the checkpoint that logged the new dictionary
+my $end_lsn =
+  $node_primary->safe_psql('postgres', 'SELECT pg_current_wal_insert_lsn()');
+$node_primary->stop('immediate');
+$node_primary->start;
+is($node_primary->safe_psql('postgres', $check),
+	$expected, 'crash recovery replayed images compressed with dictionaries');
+
+$node_standby->stop;
+$node_primary->stop;
+
+# pg_waldump reads all of it, including the images it can't have the
+# dictionary for unless it remembered the XLOG_FPI_DICTIONARY records
+my ($stdout, $stderr) = run_command(
+	[
+		'pg_waldump', '--bkp-details',
+		'--path', $node_primary->data_dir . '/pg_wal',
+		'--start', $start_lsn,
+		'--end', $end_lsn
+	]);
+is($stderr, '', 'pg_waldump reads WAL with dictionary-compressed images');
+
+my %heap_dicts;
+while ($stdout =~ /FPI_DICTIONARY\s+id (\d+); rmgr 10;/g)
+{
+	$heap_dicts{$1} = 1;
+}
+cmp_ok(scalar(keys %heap_dicts),
+	'>=', 2, 'heap dictionary was rotated at a later checkpoint');
+like($stdout, qr/method: zstd-dict/, 'images compressed with a dictionary');
+
+done_testing();
@@ -1260,3 +1260,28 @@ drop table agg_hash_1;
 drop table agg_hash_2;
 drop table agg_hash_3;
 drop table agg_hash_4;
+
+-- Test batch mode execution of the aggregates' input
+create temp table batch_order (x int);
+insert into batch_order values (1), (2), (3);
+create function batch_qual(int) returns bool language plpgsql as
+$$ begin raise notice 'qual %', $1; return $1 <> 2; end $$;
+create function batch_arg(int) returns int language plpgsql as
+$$ begin raise notice 'arg %', $1; return $1; end $$;
+-- one tuple at a time, the qual and the aggregate argument alternate
+select sum(batch_arg(x)) from batch_order where batch_qual(x);
+set executor_batch_size = 7;
+-- in batch mode, the scan checks the qual for the whole batch first
+select sum(batch_arg(x)) from batch_order where batch_qual(x);
+-- each row of the batch is projected on its own
+select x % 2 as odd, sum(x * 10) from batch_order group by 1 order by 1;
+drop function batch_qual(int);
+drop function batch_arg(int);
+drop table batch_order;
+select count(*), sum(unique1), max(ten) from tenk1 where unique1 % 3 = 0;
+select ten, count(*), sum(unique1 + 1) from tenk1 where unique2 < 5000
+  group by ten order by ten;
+select a.ten,
+  (select count(*) from tenk1 b where b.ten = a.ten and b.unique1 < 100)
+  from tenk1 a where a.unique1 < 3 order by 1;
+reset executor_batch_size;
@@ -0,0 +1,100 @@
+--
+-- JIT compilation of expressions after a warm-up period
+--
+SELECT NOT pg_jit_available() AS skip_test \gset
+\if :skip_test
+\quit
+\endif
+
+SET jit_above_cost = 0;
+SET jit_inline_above_cost = -1;
+SET jit_optimize_above_cost = -1;
+SET max_parallel_workers_per_gather = 0;
+SET jit_warmup_evaluations = 100;
+
+-- number of functions JIT compiled while running a query
+CREATE FUNCTION jit_functions(query text) RETURNS int
+LANGUAGE plpgsql AS
+$$
+DECLARE
+    plan json;
+BEGIN
+    EXECUTE 'EXPLAIN (ANALYZE, TIMING OFF, FORMAT JSON) ' || query INTO plan;
+    RETURN coalesce((plan->0->'JIT'->>'Functions')::int, 0);
+END;
+$$;
+
+-- too few evaluations, everything stays interpreted
+SELECT jit_functions('SELECT count(*) FROM generate_series(1, 10) g WHERE g % 3 = 0');
+SELECT count(*), sum(g) FROM generate_series(1, 10) g WHERE g % 3 = 0;
+
+-- the qual gets hot, and all of the query's expressions are compiled
+SELECT jit_functions('SELECT count(*) FROM generate_series(1, 1000) g WHERE g % 3 = 0') > 1 AS compiled;
+SELECT count(*), sum(g) FROM generate_series(1, 1000) g WHERE g % 3 = 0;
+
+-- JIT gets disabled before the qual is hot, so it keeps being interpreted
+SELECT jit_functions('SELECT count(*) FROM generate_series(1, 1000) g WHERE set_config(''jit'', ''off'', true) IS NOT NULL AND g % 3 = 0');
+SELECT count(*), sum(g) FROM generate_series(1, 1000) g
+  WHERE set_config('jit', 'off', true) IS NOT NULL AND g % 3 = 0;
+SHOW jit;
+
+DROP FUNCTION jit_functions(text);
+RESET jit_warmup_evaluations;
+RESET max_parallel_workers_per_gather;
+RESET jit_optimize_above_cost;
+RESET jit_inline_above_cost;
+RESET jit_above_cost;
+
+--
+-- Per-backend cache of compiled code
+--
+CREATE FUNCTION jit_cache_stats(query text, OUT functions int, OUT cached int)
+LANGUAGE plpgsql
+SET jit_above_cost = 0
+SET jit_inline_above_cost = -1
+SET jit_optimize_above_cost = -1
+SET max_parallel_workers_per_gather = 0
+AS
+$$
+DECLARE
+    plan json;
+BEGIN
+    EXECUTE 'EXPLAIN (ANALYZE, TIMING OFF, FORMAT JSON) ' || query INTO plan;
+    functions := coalesce((plan->0->'JIT'->>'Functions')::int, 0);
+    cached := coalesce((plan->0->'JIT'->>'Cached Functions')::int, 0);
+END;
+$$;
+
+SET jit_cache_entries = 100;
+-- the first execution misses the cache, the second finds all of its code
+SELECT functions > 0 AND cached < functions AS miss
+  FROM jit_cache_stats('SELECT count(*) FROM generate_series(1, 10) g WHERE g % 3 = 0');
+SELECT cached = functions AS hit
+  FROM jit_cache_stats('SELECT count(*) FROM generate_series(1, 10) g WHERE g % 3 = 0');
+-- constants are loaded at run time, so they don't prevent reuse
+SELECT cached = functions AS hit
+  FROM jit_cache_stats('SELECT count(*) FROM generate_series(1, 10) g WHERE g % 5 = 1');
+
+-- unused code beyond jit_cache_entries is evicted once a query finishes
+SET jit_cache_entries = 1;
+SELECT functions > 0 AS compiled FROM jit_cache_stats('SELECT 1');
+SELECT cached < functions AS evicted
+  FROM jit_cache_stats('SELECT count(*) FROM generate_series(1, 10) g WHERE g % 3 = 0');
+-- but code in use is not, so the second branch reuses the first one's code
+SELECT cached * 2 >= functions AS pinned
+  FROM jit_cache_stats('SELECT count(*) FROM generate_series(1, 10) a WHERE a % 3 = 0 UNION ALL SELECT count(*) FROM generate_series(1, 10) b WHERE b % 7 = 0');
+
+-- cached code computes the right results
+SET jit_above_cost = 0;
+SET jit_inline_above_cost = -1;
+SET jit_optimize_above_cost = -1;
+SELECT count(*) FROM generate_series(1, 10) a WHERE a % 3 = 0
+UNION ALL
+SELECT count(*) FROM generate_series(1, 10) b WHERE b % 7 = 0;
+SELECT count(*) FROM generate_series(1, 10) g WHERE g % 5 = 1;
+RESET jit_optimize_above_cost;
+RESET jit_inline_above_cost;
+RESET jit_above_cost;
+
+DROP FUNCTION jit_cache_stats(text);
+RESET jit_cache_entries;
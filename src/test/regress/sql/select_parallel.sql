@@ -314,6 +314,43 @@ reset enable_material;
 
 reset enable_hashagg;
 
+-- test parallel hash aggregation, including an aggregate that can't be
+-- partially aggregated
+set enable_parallel_hashagg = on;
+select count(*), sum(cnt), sum(total), sum(len) from
+  (select unique1 % 1000 as k, count(*) as cnt, sum(unique1) as total,
+          length(string_agg('x'::text, '')) as len
+   from tenk1 group by 1) ss;
+
+explain (costs off)
+select unique1 % 5000 as k, length(string_agg('x'::text, '')) as len
+  from tenk1 group by 1;
+
+-- partitions that don't fit in hash_mem are spilled again locally
+set work_mem = '64kB';
+select count(*), sum(cnt), sum(total), sum(len) from
+  (select unique1 % 5000 as k, count(*) as cnt, sum(unique1) as total,
+          length(string_agg('x'::text, '')) as len
+   from tenk1 group by 1) ss;
+reset work_mem;
+
+-- test rescan behavior of parallel hash aggregation
+set enable_material = false;
+
+explain (costs off)
+select * from
+  (select unique1 % 5000 as k, length(string_agg('x'::text, '')) as len
+   from tenk1 group by 1 having min(unique1) = 0) ss
+  right join (values (1),(2),(3)) v(x) on true;
+
+select * from
+  (select unique1 % 5000 as k, length(string_agg('x'::text, '')) as len
+   from tenk1 group by 1 having min(unique1) = 0) ss
+  right join (values (1),(2),(3)) v(x) on true;
+
+reset enable_material;
+reset enable_parallel_hashagg;
+
 -- check parallelized int8 aggregate (bug #14897)
 explain (costs off)
 select avg(unique1::int8) from tenk1;
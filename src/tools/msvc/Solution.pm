@@ -315,6 +315,7 @@ sub GenerateFiles
 		HAVE_LIBZ                   => $self->{options}->{zlib} ? 1 : undef,
 		HAVE_LIBZSTD                => undef,
 		HAVE_LINK                   => undef,
+		HAVE_LINUX_IO_URING_H       => undef,
 		HAVE_LOCALE_T               => 1,
 		HAVE_LONG_INT_64            => undef,
 		HAVE_LONG_LONG_INT_64       => 1,